@@ -18,6 +18,7 @@ else {
 
 	LIBS+= -lSDL2
 	LIBS+= -lGL
+	LIBS+= -lpthread
 }
 
 CONFIG( debug, debug|release ) {
@@ -50,6 +51,7 @@ SOURCES+= \
 	client/minimap_state.cpp \
 	client/map_state.cpp \
 	client/movement_controller.cpp \
+	client/player_predictor.cpp \
 	client/opengl_renderer/animations_buffer.cpp \
 	client/opengl_renderer/map_light.cpp \
 	client/opengl_renderer/models_textures_corrector.cpp \
@@ -60,6 +62,7 @@ SOURCES+= \
 	commands_processor.cpp \
 	connection_info.cpp \
 	console.cpp \
+	demo.cpp \
 	drawers_factory_gl.cpp \
 	drawers_factory_soft.cpp \
 	game_resources.cpp \
@@ -75,24 +78,38 @@ SOURCES+= \
 	menu_drawer_gl.cpp \
 	menu_drawer_soft.cpp \
 	messages.cpp \
+	messages_encoding.cpp \
 	messages_extractor.cpp \
 	messages_sender.cpp \
 	model.cpp \
 	net/net.cpp \
+	net/reliable_channel.cpp \
+	network_simulator.cpp \
 	obj.cpp \
 	program_arguments.cpp \
 	rand.cpp \
 	save_load.cpp \
 	save_load_streams.cpp \
+	server/bots.cpp \
+	server/client_baselines.cpp \
 	server/collisions.cpp \
 	server/collision_index.cpp \
+	server/explosion_index.cpp \
+	server/input_record.cpp \
+	server/interest_manager.cpp \
 	server/map.cpp \
 	server/map_save_load.cpp \
 	server/monster.cpp \
 	server/monster_base.cpp \
+	server/monsters_history.cpp \
 	server/movement_restriction.cpp \
 	server/player.cpp \
+	server/player_movement.cpp \
+	server/procedures_scheduler.cpp \
 	server/server.cpp \
+	server/shots_broad_phase.cpp \
+	server/tick_profiler.cpp \
+	server/visibility_cache.cpp \
 	settings.cpp \
 	shared_drawers.cpp \
 	sound/ambient_sound_processor.cpp \
@@ -102,6 +119,7 @@ SOURCES+= \
 	sound/sounds_loader.cpp \
 	system_event.cpp \
 	system_window.cpp \
+	tick_scheduler.cpp \
 	ticks_counter.cpp \
 	time.cpp \
 	text_drawers_common.cpp \
@@ -121,6 +139,8 @@ HEADERS+= \
 	client/hud_drawer_base.hpp \
 	client/hud_drawer_gl.hpp \
 	client/hud_drawer_soft.hpp \
+	client/interpolation_buffer.hpp \
+	client/interpolation_buffer.inl \
 	client/map_drawers_common.hpp \
 	client/map_drawer_gl.hpp \
 	client/map_drawer_soft.hpp \
@@ -130,6 +150,7 @@ HEADERS+= \
 	client/minimap_drawer_soft.hpp \
 	client/minimap_state.hpp \
 	client/movement_controller.hpp \
+	client/player_predictor.hpp \
 	client/opengl_renderer/animations_buffer.hpp \
 	client/opengl_renderer/map_light.hpp \
 	client/opengl_renderer/models_textures_corrector.hpp \
@@ -143,6 +164,7 @@ HEADERS+= \
 	commands_processor.hpp \
 	connection_info.hpp \
 	console.hpp \
+	demo.hpp \
 	drawers_factory_gl.hpp \
 	drawers_factory_soft.hpp \
 	fwd.hpp \
@@ -164,12 +186,15 @@ HEADERS+= \
 	menu_drawer_gl.hpp \
 	menu_drawer_soft.hpp \
 	messages.hpp \
+	messages_encoding.hpp \
 	messages_extractor.hpp \
 	messages_extractor.inl \
 	messages_list.h \
 	messages_sender.hpp \
 	model.hpp \
 	net/net.hpp \
+	net/reliable_channel.hpp \
+	network_simulator.hpp \
 	obj.hpp \
 	particles.hpp \
 	program_arguments.hpp \
@@ -179,16 +204,31 @@ HEADERS+= \
 	save_load_streams.hpp \
 	server/a_code.hpp \
 	server/backpack.hpp \
+	server/bots.hpp \
+	server/client_baselines.hpp \
 	server/collisions.hpp \
 	server/collision_index.hpp \
 	server/collision_index.inl \
+	server/explosion_index.hpp \
 	server/fwd.hpp \
+	server/input_record.hpp \
+	server/interest_manager.hpp \
 	server/map.hpp \
+	server/map_collisions.hpp \
+	server/map_collisions.inl \
 	server/monster.hpp \
 	server/monster_base.hpp \
+	server/monsters_history.hpp \
 	server/movement_restriction.hpp \
 	server/player.hpp \
+	server/player_movement.hpp \
+	server/procedures_scheduler.hpp \
 	server/server.hpp \
+	server/shots_broad_phase.hpp \
+	server/shots_broad_phase.inl \
+	server/tick_profiler.hpp \
+	server/visibility_cache.hpp \
+	server/zones_field.hpp \
 	settings.hpp \
 	shared_drawers.hpp \
 	shared_settings_keys.hpp \
@@ -202,6 +242,7 @@ HEADERS+= \
 	sound/sounds_loader.hpp \
 	system_event.hpp \
 	system_window.hpp \
+	tick_scheduler.hpp \
 	ticks_counter.hpp \
 	text_drawers_common.hpp \
 	text_drawer_gl.hpp \
@@ -23,6 +23,7 @@ namespace PanzerChasm
 {
 
 static const char g_small_hud_mode[]= "cl_small_hud_mode";
+static const char g_prediction[]= "cl_prediction";
 
 struct Client::LoadedMinimapState
 {
@@ -66,6 +67,7 @@ Client::Client(
 	CommandsMapPtr commands= std::make_shared<CommandsMap>();
 	commands->emplace( "fullmap", std::bind( &Client::FullMap, this ) );
 	commands->emplace( "pos", std::bind( &Client::PrintPlayerPos, this ) );
+	commands->emplace( "prediction_stats", std::bind( &Client::PrintPredictionStats, this ) );
 	commands_= std::move( commands );
 	commands_processor.RegisterCommands(commands_);
 
@@ -186,6 +188,8 @@ void Client::SetConnection( IConnectionPtr connection )
 	else
 	{
 		connection_info_.reset( new ConnectionInfo( connection ) );
+		received_reliable_update_number_= 0u;
+		acknowledged_update_number_= 0u;
 		TransmitPlayerName();
 	}
 }
@@ -337,6 +341,9 @@ void Client::Loop( const InputState& input_state, const bool paused )
 
 	if( map_state_ != nullptr )
 	{
+		map_state_->SetInterpolation(
+			settings_.GetOrSetBool( "cl_interpolation", true ),
+			float( settings_.GetOrSetInt( "cl_interpolation_delay", 0 ) ) / 1000.0f );
 		map_state_->Tick( current_tick_time_ );
 
 		if( minimap_state_ != nullptr )
@@ -372,8 +379,25 @@ void Client::Loop( const InputState& input_state, const bool paused )
 			message.view_dir_angle_z= AngleToMessageAngle( camera_controller_.GetViewAngleZ() );
 			message.shoot_pressed= shoot_pressed_;
 			message.color= settings_.GetOrSetInt( SettingsKeys::player_color );
+			// Server compensates lag for shots, using number of tick, which we see.
+			message.acknowledged_tick_number=
+				map_state_ != nullptr
+					? map_state_->GetShownTickNumber()
+					: server_state_.tick_number;
+			message.acknowledged_update_number= acknowledged_update_number_;
+			message.move_number= ++move_number_;
 
 			connection_info_->messages_sender.SendUnreliableMessage( message );
+
+			// Move player immediately, do not wait for position from server.
+			if( player_predictor_ != nullptr && map_state_ != nullptr &&
+				player_state_.health > 0u &&
+				settings_.GetOrSetBool( g_prediction, true ) )
+			{
+				player_predictor_->ApplyMove( message, current_tick_time_ - prev_tick_time, *map_state_ );
+				player_position_= player_predictor_->GetPosition();
+				camera_controller_.SetSpeed( player_predictor_->GetSpeed() );
+			}
 		}
 
 		connection_info_->messages_sender.Flush();
@@ -495,6 +519,17 @@ void Client::operator()( const Messages::MessageBase& message )
 void Client::operator()( const Messages::ServerState& message )
 {
 	server_state_= message;
+
+	if( message.reliable_update_number == received_reliable_update_number_ )
+		acknowledged_update_number_= message.update_number;
+
+	if( map_state_ != nullptr )
+		map_state_->ProcessServerState( message, current_tick_time_ );
+}
+
+void Client::operator()( const Messages::ReliableUpdateMark& message )
+{
+	received_reliable_update_number_= message.update_number;
 }
 
 void Client::operator()( const Messages::DynamicTextMessage& message )
@@ -508,17 +543,38 @@ void Client::operator()( const Messages::PlayerSpawn& message )
 	MessagePositionToPosition( message.xyz, player_position_ );
 	camera_controller_.SetAngles( MessageAngleToAngle( message.direction ) - Constants::half_pi, 0.0f );
 	player_monster_id_= message.player_monster_id;
+
+	if( player_predictor_ != nullptr )
+		player_predictor_->Reset( player_position_ );
 }
 
 void Client::operator()( const Messages::PlayerPosition& message )
 {
+	if( player_predictor_ != nullptr && map_state_ != nullptr &&
+		settings_.GetOrSetBool( g_prediction, true ) )
+	{
+		player_predictor_->ProcessPosition( message, *map_state_ );
+		player_position_= player_predictor_->GetPosition();
+		camera_controller_.SetSpeed( player_predictor_->GetSpeed() );
+		return;
+	}
+
 	MessagePositionToPosition( message.xyz, player_position_ );
-	camera_controller_.SetSpeed( MessageCoordToCoord( message.speed ) );
+
+	m_Vec3 speed;
+	MessagePositionToPosition( message.speed, speed );
+	camera_controller_.SetSpeed( speed.xy().Length() );
+
+	if( player_predictor_ != nullptr )
+		player_predictor_->Reset( player_position_ );
 }
 
 void Client::operator()( const Messages::PlayerState& message )
 {
 	player_state_= message;
+
+	if( player_predictor_ != nullptr )
+		player_predictor_->SetNoclip( message.noclip );
 }
 
 void Client::operator()( const Messages::PlayerWeapon& message )
@@ -611,6 +667,9 @@ void Client::operator()( const Messages::MapChange& message )
 	show_progress( 0.5 );
 	map_state_.reset( new MapState( map_data, game_resources_, Time::CurrentTime() ) );
 	minimap_state_.reset( new MinimapState( map_data ) );
+	player_predictor_.reset( new PlayerPredictor( map_data ) );
+	player_predictor_->Reset( player_position_ );
+	player_predictor_->SetNoclip( player_state_.noclip );
 
 	if( loaded_minimap_state_ != nullptr &&
 		loaded_minimap_state_->map_number == message.map_number )
@@ -683,6 +742,7 @@ void Client::StopMap()
 	current_map_data_= nullptr;
 	map_state_= nullptr;
 	minimap_state_= nullptr;
+	player_predictor_= nullptr;
 
 	cutscene_player_= nullptr;
 }
@@ -740,4 +800,21 @@ void Client::PrintPlayerPos()
 	Log::Info( "Pos: ", player_position_.x, ", ", player_position_.y, ", ", player_position_.z );
 }
 
+void Client::PrintPredictionStats()
+{
+	if( player_predictor_ == nullptr )
+	{
+		Log::Info( "No map" );
+		return;
+	}
+
+	const PlayerPredictor::Stats& stats= player_predictor_->GetStats();
+	Log::Info( "Prediction: ", settings_.GetOrSetBool( g_prediction, true ) ? "on" : "off" );
+	Log::Info( "Positions received: ", stats.positions_received );
+	Log::Info( "Mispredictions: ", stats.mispredictions, ", snaps: ", stats.snaps, ", dropped inputs: ", stats.dropped_inputs );
+	Log::Info( "Last error: ", stats.last_error, ", max error: ", stats.max_error );
+
+	player_predictor_->ResetStats();
+}
+
 } // namespace PanzerChasm
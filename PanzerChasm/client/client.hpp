@@ -8,6 +8,7 @@
 #include "map_state.hpp"
 #include "minimap_state.hpp"
 #include "movement_controller.hpp"
+#include "player_predictor.hpp"
 #include "weapon_state.hpp"
 
 namespace PanzerChasm
@@ -54,6 +55,7 @@ public: // Messages handlers
 	void operator()( const Messages::MessageBase& message );
 	void operator()( const Messages::DummyNetMessage& ) {}
 	void operator()( const Messages::ServerState& message );
+	void operator()( const Messages::ReliableUpdateMark& message );
 	void operator()( const Messages::DynamicTextMessage& message );
 
 	// Handler for messages, that can be simply transfered to "MapState".
@@ -86,6 +88,7 @@ private:
 
 	void FullMap();
 	void PrintPlayerPos();
+	void PrintPredictionStats();
 
 private:
 	Settings& settings_;
@@ -112,6 +115,10 @@ private:
 	EntityId player_monster_id_= 0u;
 	Messages::PlayerState player_state_;
 	Messages::ServerState server_state_;
+	// Server uses states from acknowledged updates as baselines for delta compression.
+	// So, acknowledge only updates, received after all reliable messages of them - births, map change.
+	unsigned short received_reliable_update_number_= 0u;
+	unsigned short acknowledged_update_number_= 0u;
 	unsigned int requested_weapon_index_= 0u;
 	MovementController camera_controller_;
 	bool minimap_mode_= false;
@@ -124,6 +131,8 @@ private:
 	MapDataConstPtr current_map_data_;
 	std::unique_ptr<MapState> map_state_;
 	std::unique_ptr<MinimapState> minimap_state_;
+	std::unique_ptr<PlayerPredictor> player_predictor_;
+	unsigned short move_number_= 0u;
 	std::unique_ptr<LoadedMinimapState> loaded_minimap_state_;
 
 	WeaponState weapon_state_;
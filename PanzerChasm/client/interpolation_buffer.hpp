@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../time.hpp"
+
+namespace PanzerChasm
+{
+
+// Buffer of last states of one entity, received from server, together with server time of each state.
+// Used for rendering of entities in past - between two received states.
+template<class State>
+class InterpolationBuffer final
+{
+public:
+	// Result state is "a + ( b - a ) * k".
+	// "k" is greater, than 1, if requested time is after last state and extrapolation is needed.
+	struct Sample
+	{
+		const State* a;
+		const State* b;
+		float k;
+	};
+
+	InterpolationBuffer();
+
+	// Time must not decrease. State with same time replaces previous state.
+	void Push( Time server_time, const State& state );
+	void Clear();
+	bool Empty() const;
+	// Buffer must be nonempty.
+	Time GetLastTime() const;
+	const State& GetLastState() const;
+
+	// Buffer must be nonempty.
+	Sample GetSample( Time server_time, Time max_extrapolation_time ) const;
+
+private:
+	struct Snapshot
+	{
+		Time time= Time::FromSeconds(0);
+		State state;
+	};
+
+	static constexpr unsigned int c_max_snapshots= 16u;
+
+private:
+	const Snapshot& GetSnapshot( unsigned int index ) const;
+
+private:
+	// Ring buffer.
+	Snapshot snapshots_[ c_max_snapshots ];
+	unsigned int first_snapshot_= 0u;
+	unsigned int snapshot_count_= 0u;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+
+#include "../assert.hpp"
+
+#include "interpolation_buffer.hpp"
+
+namespace PanzerChasm
+{
+
+template<class State>
+constexpr unsigned int InterpolationBuffer<State>::c_max_snapshots;
+
+template<class State>
+InterpolationBuffer<State>::InterpolationBuffer()
+{}
+
+template<class State>
+void InterpolationBuffer<State>::Push( const Time server_time, const State& state )
+{
+	if( snapshot_count_ > 0u )
+	{
+		Snapshot& last_snapshot= snapshots_[ ( first_snapshot_ + snapshot_count_ - 1u ) % c_max_snapshots ];
+		if( server_time <= last_snapshot.time )
+		{
+			last_snapshot.state= state;
+			return;
+		}
+	}
+
+	if( snapshot_count_ == c_max_snapshots )
+	{
+		// Overwrite oldest snapshot.
+		first_snapshot_= ( first_snapshot_ + 1u ) % c_max_snapshots;
+		snapshot_count_--;
+	}
+
+	Snapshot& snapshot= snapshots_[ ( first_snapshot_ + snapshot_count_ ) % c_max_snapshots ];
+	snapshot.time= server_time;
+	snapshot.state= state;
+	snapshot_count_++;
+}
+
+template<class State>
+void InterpolationBuffer<State>::Clear()
+{
+	first_snapshot_= 0u;
+	snapshot_count_= 0u;
+}
+
+template<class State>
+bool InterpolationBuffer<State>::Empty() const
+{
+	return snapshot_count_ == 0u;
+}
+
+template<class State>
+Time InterpolationBuffer<State>::GetLastTime() const
+{
+	PC_ASSERT( snapshot_count_ > 0u );
+	return GetSnapshot( snapshot_count_ - 1u ).time;
+}
+
+template<class State>
+const State& InterpolationBuffer<State>::GetLastState() const
+{
+	PC_ASSERT( snapshot_count_ > 0u );
+	return GetSnapshot( snapshot_count_ - 1u ).state;
+}
+
+template<class State>
+typename InterpolationBuffer<State>::Sample InterpolationBuffer<State>::GetSample(
+	const Time server_time,
+	const Time max_extrapolation_time ) const
+{
+	PC_ASSERT( snapshot_count_ > 0u );
+
+	Sample result;
+
+	const Snapshot& first_snapshot= GetSnapshot( 0u );
+	if( snapshot_count_ == 1u || server_time <= first_snapshot.time )
+	{
+		result.a= result.b= &first_snapshot.state;
+		result.k= 0.0f;
+		return result;
+	}
+
+	const Snapshot& last_snapshot= GetSnapshot( snapshot_count_ - 1u );
+	if( server_time >= last_snapshot.time )
+	{
+		// Extrapolate from two last states, but not too far.
+		const Snapshot& prev_snapshot= GetSnapshot( snapshot_count_ - 2u );
+		result.a= &prev_snapshot.state;
+		result.b= &last_snapshot.state;
+		result.k=
+			1.0f +
+			std::min( server_time - last_snapshot.time, max_extrapolation_time ).ToSeconds() /
+			( last_snapshot.time - prev_snapshot.time ).ToSeconds();
+		return result;
+	}
+
+	// Find pair of snapshots around given time. Search from end, because usually requested time is near to end.
+	for( unsigned int i= snapshot_count_ - 1u; i > 0u; i-- )
+	{
+		const Snapshot& prev_snapshot= GetSnapshot( i - 1u );
+		if( prev_snapshot.time <= server_time )
+		{
+			const Snapshot& next_snapshot= GetSnapshot( i );
+			result.a= &prev_snapshot.state;
+			result.b= &next_snapshot.state;
+			result.k= ( server_time - prev_snapshot.time ).ToSeconds() / ( next_snapshot.time - prev_snapshot.time ).ToSeconds();
+			return result;
+		}
+	}
+
+	PC_ASSERT( false );
+	result.a= result.b= &first_snapshot.state;
+	result.k= 0.0f;
+	return result;
+}
+
+template<class State>
+const typename InterpolationBuffer<State>::Snapshot& InterpolationBuffer<State>::GetSnapshot( const unsigned int index ) const
+{
+	PC_ASSERT( index < snapshot_count_ );
+	return snapshots_[ ( first_snapshot_ + index ) % c_max_snapshots ];
+}
+
+} // namespace PanzerChasm
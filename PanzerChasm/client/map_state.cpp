@@ -3,12 +3,50 @@
 #include "../map_loader.hpp"
 #include "../math_utils.hpp"
 #include "../particles.hpp"
+#include "interpolation_buffer.inl"
 
 #include "map_state.hpp"
 
 namespace PanzerChasm
 {
 
+// Extrapolate entities not so far, if there are no new states from server - because of loss, for example.
+static const float g_max_extrapolation_time_s= 0.1f;
+static const float g_max_update_interval_scale= 1.5f; // Longer interval means, that some updates are lost.
+// Do not interpolate position, if distance is too big - entity was teleported.
+static const float g_max_interpolation_distance= 3.0f;
+// Limit for automatic interpolation delay.
+static const float g_max_auto_interpolation_delay_s= 0.25f;
+// Reset server time offset, if it changes too fast - after pause, for example.
+static const float g_max_server_time_offset_change_s= 0.5f;
+
+// If entity was missing in previous update, which was received, entity was unchanged before it.
+// Hold last state until previous update in this case, instead of slow interpolation through whole gap.
+template<class State>
+static void PushReceivedState(
+	InterpolationBuffer<State>& snapshots,
+	const State& state,
+	const Time server_time,
+	const Time previous_server_time,
+	const bool previous_update_received )
+{
+	if( previous_update_received && !snapshots.Empty() && snapshots.GetLastTime() < previous_server_time )
+	{
+		const State last_state= snapshots.GetLastState();
+		snapshots.Push( previous_server_time, last_state );
+	}
+	snapshots.Push( server_time, state );
+}
+
+static float InterpolateAngle( const float angle0, const float angle1, const float k )
+{
+	float delta= NormalizeAngle( angle1 - angle0 );
+	if( delta > Constants::pi )
+		delta-= Constants::two_pi;
+
+	return NormalizeAngle( angle0 + delta * k );
+}
+
 MapState::MapState(
 	const MapDataConstPtr& map,
 	const GameResourcesConstPtr& game_resources,
@@ -33,6 +71,10 @@ MapState::MapState(
 		out_wall.texture_id= in_wall.texture_id;
 	}
 
+	received_dynamic_walls_.resize( dynamic_walls_.size() );
+	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
+		received_dynamic_walls_[w].state= dynamic_walls_[w];
+
 	static_models_.resize( map_data_->static_models.size() );
 	for( unsigned int m= 0u; m < static_models_.size(); m++ )
 	{
@@ -168,6 +210,8 @@ void MapState::Tick( const Time current_time )
 
 	last_tick_time_= current_time;
 
+	UpdateInterpolatedEntities( current_time );
+
 	for( Item& item : items_ )
 	{
 		if( item.item_id < game_resources_->items_models.size() )
@@ -436,15 +480,16 @@ void MapState::Tick( const Time current_time )
 
 void MapState::ProcessMessage( const Messages::MonsterState& message )
 {
-	const auto it= monsters_.find( message.monster_id );
-	if( it == monsters_.end() )
+	const auto it= received_monsters_.find( message.monster_id );
+	if( it == received_monsters_.end() )
 		return;
 
 	if( message.monster_type >= game_resources_->monsters_models.size() )
 		return;
 	const Model& model= game_resources_->monsters_models[ message.monster_type ];
 
-	Monster& monster= it->second;
+	Monster& monster= it->second.state;
+	it->second.updated= true;
 
 	MessagePositionToPosition( message.xyz, monster.pos );
 	monster.angle= MessageAngleToAngle( message.angle );
@@ -464,12 +509,49 @@ void MapState::ProcessMessage( const Messages::MonsterState& message )
 	}
 }
 
+void MapState::ProcessMessage( const Messages::MonsterStateDelta& message )
+{
+	const auto it= received_monsters_.find( message.monster_id );
+	if( it == received_monsters_.end() )
+		return;
+
+	Monster& monster= it->second.state;
+
+	// Build full state from known state and apply delta to it.
+	Messages::MonsterState state;
+	state.monster_id= message.monster_id;
+	PositionToMessagePosition( monster.pos, state.xyz );
+	state.angle= AngleToMessageAngle( monster.angle );
+	state.monster_type= monster.monster_id;
+	state.body_parts_mask= monster.body_parts_mask;
+	state.animation= monster.animation;
+	state.animation_frame= monster.animation_frame;
+	state.is_fully_dead= monster.is_fully_dead;
+	state.is_invisible= monster.is_invisible;
+	state.color= monster.color;
+
+	if( !UnpackMonsterStateDelta( message, state ) )
+		return;
+
+	// Do not convert unchanged position and angle back and forth, because it is not exact.
+	const m_Vec3 pos= monster.pos;
+	const float angle= monster.angle;
+
+	ProcessMessage( state );
+
+	if( ( message.fields_mask & Messages::MonsterStateDelta::Position ) == 0u )
+		monster.pos= pos;
+	if( ( message.fields_mask & Messages::MonsterStateDelta::Angle ) == 0u )
+		monster.angle= angle;
+}
+
 void MapState::ProcessMessage( const Messages::WallPosition& message )
 {
 	if( message.wall_index >= dynamic_walls_.size() )
 		return; // Bad wall index.
 
-	DynamicWall& wall= dynamic_walls_[ message.wall_index ];
+	DynamicWall& wall= received_dynamic_walls_[ message.wall_index ].state;
+	received_dynamic_walls_[ message.wall_index ].updated= true;
 
 	MessagePositionToPosition( message.vertices_xy[0], wall.vert_pos[0] );
 	MessagePositionToPosition( message.vertices_xy[1], wall.vert_pos[1] );
@@ -778,30 +860,35 @@ void MapState::ProcessMessage( const Messages::MonsterPartBirth& message )
 
 void MapState::ProcessMessage( const Messages::MonsterBirth& message )
 {
-	auto it= monsters_.find( message.monster_id );
-	if( it == monsters_.end() )
-		it= monsters_.emplace( message.monster_id, Monster() ).first;
+	auto it= received_monsters_.find( message.monster_id );
+	if( it == received_monsters_.end() )
+		it= received_monsters_.emplace( message.monster_id, ReceivedMonster() ).first;
 
 	ProcessMessage( message.initial_state );
+
+	// Show new monster immediately.
+	monsters_[ message.monster_id ]= it->second.state;
 }
 
 void MapState::ProcessMessage( const Messages::MonsterDeath& message )
 {
 	monsters_.erase( message.monster_id );
+	received_monsters_.erase( message.monster_id );
 }
 
 void MapState::ProcessMessage( const Messages::RocketState& message )
 {
-	const auto it= rockets_.find( message.rocket_id );
-	if( it == rockets_.end() )
+	const auto it= received_rockets_.find( message.rocket_id );
+	if( it == received_rockets_.end() )
 		return;
 
-	Rocket& rocket= it->second;
+	RocketPosition& position= it->second.position;
+	it->second.updated= true;
 
-	MessagePositionToPosition( message.xyz, rocket.pos );
+	MessagePositionToPosition( message.xyz, position.pos );
 
 	for( unsigned int j= 0u; j < 2u; j++ )
-		rocket.angle[j]= MessageAngleToAngle( message.angle[j] );
+		position.angle[j]= MessageAngleToAngle( message.angle[j] );
 }
 
 void MapState::ProcessMessage( const Messages::RocketBirth& message )
@@ -811,17 +898,26 @@ void MapState::ProcessMessage( const Messages::RocketBirth& message )
 		return;
 
 	const auto inserted_it= rockets_.emplace( message.rocket_id, Rocket() ).first;
-	inserted_it->second.rocket_id= message.rocket_type;
+	Rocket& rocket= inserted_it->second;
+	rocket.rocket_id= message.rocket_type;
 
-	inserted_it->second.start_time= last_tick_time_;
-	inserted_it->second.frame= 0u;
+	rocket.start_time= last_tick_time_;
+	rocket.frame= 0u;
 
+	received_rockets_.emplace( message.rocket_id, ReceivedRocket() );
 	ProcessMessage( static_cast<const Messages::RocketState&>( message ) );
+
+	// Show new rocket immediately.
+	const RocketPosition& position= received_rockets_[ message.rocket_id ].position;
+	rocket.start_pos= rocket.pos= position.pos;
+	rocket.angle[0]= position.angle[0];
+	rocket.angle[1]= position.angle[1];
 }
 
 void MapState::ProcessMessage( const Messages::RocketDeath& message )
 {
 	rockets_.erase( message.rocket_id );
+	received_rockets_.erase( message.rocket_id );
 }
 
 void MapState::ProcessMessage( const Messages::DynamicItemBirth& message )
@@ -904,4 +1000,225 @@ void MapState::ProcessMessage( const Messages::RotatingLightSourceDeath& message
 	directed_light_sources_.erase( message.light_source_id );
 }
 
+
+void MapState::SetInterpolation( const bool enabled, const float delay_s )
+{
+	interpolation_enabled_= enabled;
+	interpolation_delay_s_= std::max( 0.0f, delay_s );
+}
+
+unsigned short MapState::GetShownTickNumber() const
+{
+	if( !interpolation_enabled_ || tick_numbers_.Empty() )
+		return last_tick_number_;
+
+	const InterpolationBuffer<unsigned short>::Sample sample=
+		tick_numbers_.GetSample( shown_server_time_, Time::FromSeconds( g_max_extrapolation_time_s ) );
+	return sample.k < 0.5f ? *sample.a : *sample.b;
+}
+
+void MapState::ProcessServerState( const Messages::ServerState& message, const Time current_time )
+{
+	const Time server_time=
+		Time::FromInternalRepresentation(
+			int64_t(message.map_time_ms) * Time::FromSeconds(1).GetInternalRepresentation() / 1000 );
+	const Time server_time_offset= server_time - current_time;
+
+	// Server time goes back after game loading, for example. Forget old states in this case.
+	if( has_server_time_ && server_time < last_server_time_ )
+		ResetInterpolation();
+
+	if( !has_server_time_ )
+		server_time_offset_= server_time_offset;
+	else
+	{
+		const float offset_change_s= std::abs( ( server_time_offset - server_time_offset_ ).ToSeconds() );
+		if( offset_change_s > g_max_server_time_offset_change_s )
+			server_time_offset_= server_time_offset;
+		else
+		{
+			// Smooth offset, because updates arrive with jitter.
+			server_time_offset_+=
+				Time::FromInternalRepresentation( ( server_time_offset - server_time_offset_ ).GetInternalRepresentation() / 16 );
+			server_time_jitter_s_= 0.9f * server_time_jitter_s_ + 0.1f * offset_change_s;
+		}
+
+		const float update_interval_s= ( server_time - last_server_time_ ).ToSeconds();
+		if( update_interval_s > 0.0f )
+			update_interval_s_=
+				update_interval_s_ == 0.0f
+					? update_interval_s
+					: ( 0.9f * update_interval_s_ + 0.1f * update_interval_s );
+	}
+
+	// Previous update is not lost, if interval between updates is normal.
+	const bool previous_update_received=
+		has_server_time_ && update_interval_s_ > 0.0f &&
+		( server_time - last_server_time_ ).ToSeconds() <= update_interval_s_ * g_max_update_interval_scale;
+	const Time previous_server_time= last_server_time_;
+
+	has_server_time_= true;
+	last_server_time_= server_time;
+	last_tick_number_= message.tick_number;
+
+	// Save states only of entities, received in this update.
+	// Other entities are unchanged, not relevant or their states are lost - there is no new information about them.
+	for( auto& monster_value : received_monsters_ )
+	{
+		ReceivedMonster& received_monster= monster_value.second;
+		if( received_monster.updated )
+			PushReceivedState(
+				received_monster.snapshots, received_monster.state,
+				server_time, previous_server_time, previous_update_received );
+		received_monster.updated= false;
+	}
+	for( auto& rocket_value : received_rockets_ )
+	{
+		ReceivedRocket& received_rocket= rocket_value.second;
+		if( received_rocket.updated )
+			PushReceivedState(
+				received_rocket.snapshots, received_rocket.position,
+				server_time, previous_server_time, previous_update_received );
+		received_rocket.updated= false;
+	}
+	for( ReceivedDynamicWall& wall : received_dynamic_walls_ )
+	{
+		if( wall.updated )
+			PushReceivedState(
+				wall.snapshots, wall.state,
+				server_time, previous_server_time, previous_update_received );
+		wall.updated= false;
+	}
+	tick_numbers_.Push( server_time, message.tick_number );
+}
+
+void MapState::UpdateInterpolatedEntities( const Time current_time )
+{
+	const bool interpolate= interpolation_enabled_ && has_server_time_;
+	if( interpolate )
+	{
+		const float delay_s=
+			interpolation_delay_s_ > 0.0f
+				? interpolation_delay_s_
+				// Wait for two updates, so, one lost update does not break interpolation.
+				: std::min( 2.0f * ( update_interval_s_ + server_time_jitter_s_ ), g_max_auto_interpolation_delay_s );
+
+		// Do not move back in time.
+		const Time shown_server_time= current_time + server_time_offset_ - Time::FromSeconds( delay_s );
+		if( shown_server_time > shown_server_time_ )
+			shown_server_time_= shown_server_time;
+	}
+
+	// Extrapolate entities only if they were updated in last server update - in this case shown time is after last
+	// state because of late update. Entities, missing in newer updates, are usually unchanged (delta compression
+	// does not send them), so, they are shown in last known state.
+	const auto get_max_extrapolation_time=
+	[&]( const Time last_state_time ) -> Time
+	{
+		return
+			last_state_time < last_server_time_
+				? Time::FromSeconds(0)
+				: Time::FromSeconds( g_max_extrapolation_time_s );
+	};
+
+	for( const auto& monster_value : received_monsters_ )
+	{
+		const ReceivedMonster& received_monster= monster_value.second;
+		Monster& monster= monsters_[ monster_value.first ];
+
+		if( !interpolate || received_monster.snapshots.Empty() )
+		{
+			monster= received_monster.state;
+			continue;
+		}
+
+		const InterpolationBuffer<Monster>::Sample sample=
+			received_monster.snapshots.GetSample(
+				shown_server_time_,
+				get_max_extrapolation_time( received_monster.snapshots.GetLastTime() ) );
+		const Monster& a= *sample.a;
+		const Monster& b= *sample.b;
+
+		// Take animation and other discrete fields from last state before shown time.
+		monster= sample.k < 1.0f ? a : b;
+
+		const m_Vec3 pos_delta= b.pos - a.pos;
+		if( pos_delta.SquareLength() <= g_max_interpolation_distance * g_max_interpolation_distance )
+		{
+			monster.pos= a.pos + pos_delta * sample.k;
+			monster.angle= InterpolateAngle( a.angle, b.angle, sample.k );
+		}
+	}
+
+	for( const auto& rocket_value : received_rockets_ )
+	{
+		const ReceivedRocket& received_rocket= rocket_value.second;
+		const auto it= rockets_.find( rocket_value.first );
+		if( it == rockets_.end() )
+			continue;
+		Rocket& rocket= it->second;
+
+		if( !interpolate || received_rocket.snapshots.Empty() )
+		{
+			rocket.pos= received_rocket.position.pos;
+			rocket.angle[0]= received_rocket.position.angle[0];
+			rocket.angle[1]= received_rocket.position.angle[1];
+			continue;
+		}
+
+		const InterpolationBuffer<RocketPosition>::Sample sample=
+			received_rocket.snapshots.GetSample(
+				shown_server_time_,
+				get_max_extrapolation_time( received_rocket.snapshots.GetLastTime() ) );
+		const RocketPosition& a= *sample.a;
+		const RocketPosition& b= *sample.b;
+
+		rocket.pos= a.pos + ( b.pos - a.pos ) * sample.k;
+		for( unsigned int j= 0u; j < 2u; j++ )
+			rocket.angle[j]= InterpolateAngle( a.angle[j], b.angle[j], sample.k );
+	}
+
+	for( unsigned int w= 0u; w < dynamic_walls_.size(); w++ )
+	{
+		const ReceivedDynamicWall& received_wall= received_dynamic_walls_[w];
+		DynamicWall& wall= dynamic_walls_[w];
+
+		if( !interpolate || received_wall.snapshots.Empty() )
+		{
+			wall= received_wall.state;
+			continue;
+		}
+
+		const InterpolationBuffer<DynamicWall>::Sample sample=
+			received_wall.snapshots.GetSample(
+				shown_server_time_,
+				get_max_extrapolation_time( received_wall.snapshots.GetLastTime() ) );
+		const DynamicWall& a= *sample.a;
+		const DynamicWall& b= *sample.b;
+
+		// Do not extrapolate walls - they usually stop at end positions.
+		const float k= std::min( sample.k, 1.0f );
+		for( unsigned int v= 0u; v < 2u; v++ )
+			wall.vert_pos[v]= a.vert_pos[v] + ( b.vert_pos[v] - a.vert_pos[v] ) * k;
+		wall.z= a.z + ( b.z - a.z ) * k;
+		wall.texture_id= k < 1.0f ? a.texture_id : b.texture_id;
+	}
+}
+
+void MapState::ResetInterpolation()
+{
+	for( auto& monster_value : received_monsters_ )
+		monster_value.second.snapshots.Clear();
+	for( auto& rocket_value : received_rockets_ )
+		rocket_value.second.snapshots.Clear();
+	for( ReceivedDynamicWall& wall : received_dynamic_walls_ )
+		wall.snapshots.Clear();
+	tick_numbers_.Clear();
+
+	has_server_time_= false;
+	server_time_jitter_s_= 0.0f;
+	update_interval_s_= 0.0f;
+	shown_server_time_= Time::FromSeconds(0);
+}
+
 } // namespace PanzerChasm
@@ -5,6 +5,7 @@
 #include "../messages.hpp"
 #include "../rand.hpp"
 #include "../time.hpp"
+#include "interpolation_buffer.hpp"
 
 namespace PanzerChasm
 {
@@ -179,7 +180,18 @@ public:
 
 	void Tick( Time current_time );
 
+	// Entities, moved by server, are shown with delay - between two last received states.
+	// Zero delay means automatic delay, calculated from interval between server updates.
+	void SetInterpolation( bool enabled, float delay_s );
+
+	// Returns number of server tick, state of which is shown now.
+	unsigned short GetShownTickNumber() const;
+
+	// Server state message is last message of server update. Received states of entities are saved together with server time.
+	void ProcessServerState( const Messages::ServerState& message, Time current_time );
+
 	void ProcessMessage( const Messages::MonsterState& message );
+	void ProcessMessage( const Messages::MonsterStateDelta& message );
 	void ProcessMessage( const Messages::WallPosition& message );
 	void ProcessMessage( const Messages::ItemState& message );
 	void ProcessMessage( const Messages::StaticModelState& message );
@@ -208,9 +220,41 @@ private:
 		unsigned char color_index;
 	};
 
+	struct RocketPosition
+	{
+		m_Vec3 pos;
+		float angle[2];
+	};
+
+	// Last received states of entities and buffers of previous states.
+	// "updated" flag is set, if state is received in current server update.
+	struct ReceivedMonster
+	{
+		Monster state;
+		InterpolationBuffer<Monster> snapshots;
+		bool updated= false;
+	};
+
+	struct ReceivedRocket
+	{
+		RocketPosition position;
+		InterpolationBuffer<RocketPosition> snapshots;
+		bool updated= false;
+	};
+
+	struct ReceivedDynamicWall
+	{
+		DynamicWall state;
+		InterpolationBuffer<DynamicWall> snapshots;
+		bool updated= false;
+	};
+
 private:
 	void SpawnLightFlash( const m_Vec2& pos );
 
+	void UpdateInterpolatedEntities( Time current_time );
+	void ResetInterpolation();
+
 private:
 	const MapDataConstPtr map_data_;
 	const GameResourcesConstPtr game_resources_;
@@ -234,6 +278,23 @@ private:
 	DirectedLightSourcesContainer directed_light_sources_;
 
 	std::vector<FullscreenBlendEffect> fullscreen_blend_effects_;
+
+	// Interpolation.
+	bool interpolation_enabled_= true;
+	float interpolation_delay_s_= 0.0f;
+
+	std::unordered_map< EntityId, ReceivedMonster > received_monsters_;
+	std::unordered_map< EntityId, ReceivedRocket > received_rockets_;
+	std::vector<ReceivedDynamicWall> received_dynamic_walls_;
+	InterpolationBuffer<unsigned short> tick_numbers_;
+	unsigned short last_tick_number_= 0u;
+
+	bool has_server_time_= false;
+	Time last_server_time_= Time::FromSeconds(0);
+	Time server_time_offset_= Time::FromSeconds(0); // Server time minus client time.
+	float server_time_jitter_s_= 0.0f;
+	float update_interval_s_= 0.0f; // Average server time between updates.
+	Time shown_server_time_= Time::FromSeconds(0);
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "../server/map_collisions.inl"
+#include "map_state.hpp"
+
+#include "player_predictor.hpp"
+
+namespace PanzerChasm
+{
+
+// Position errors less, than this, are result of messages coordinates quantization and of different tick durations on server.
+static const float g_misprediction_threshold= 1.0f / 32.0f;
+// Errors greater, than this, are teleports, respawns, etc. Such errors are not smoothed.
+static const float g_snap_distance= 1.0f;
+// Time constant of exponential decay of correction.
+static const float g_correction_smooth_time_s= 0.1f;
+// Server splits long ticks into ticks of this duration.
+static const float g_max_step_duration_s= 28.0f / 1000.0f;
+
+constexpr unsigned int PlayerPredictor::c_max_inputs;
+
+PlayerPredictor::PlayerPredictor( const MapDataConstPtr& map_data )
+	: map_data_(map_data)
+	, collision_index_(map_data)
+	, pos_( 0.0f, 0.0f, 0.0f )
+	, speed_( 0.0f, 0.0f, 0.0f )
+	, correction_offset_( 0.0f, 0.0f, 0.0f )
+{
+	PC_ASSERT( map_data_ != nullptr );
+}
+
+PlayerPredictor::~PlayerPredictor()
+{}
+
+void PlayerPredictor::Reset( const m_Vec3& pos )
+{
+	pos_= pos;
+	speed_= m_Vec3( 0.0f, 0.0f, 0.0f );
+	on_floor_= false;
+	inputs_.clear();
+	correction_offset_= m_Vec3( 0.0f, 0.0f, 0.0f );
+}
+
+void PlayerPredictor::SetNoclip( const bool noclip )
+{
+	noclip_= noclip;
+}
+
+void PlayerPredictor::ApplyMove( const Messages::PlayerMove& message, const Time time_delta, const MapState& map_state )
+{
+	// Decode input from message, because server gets exactly same quantized values.
+	Input input;
+	input.move_number= message.move_number;
+	input.movement.movement_direction= MessageAngleToAngle( message.move_direction );
+	input.movement.acceleration= float(message.acceleration) / 255.0f;
+	input.movement.jump_pressed= message.jump_pressed;
+	input.duration= time_delta;
+
+	if( inputs_.size() >= c_max_inputs )
+	{
+		inputs_.pop_front();
+		stats_.dropped_inputs++;
+	}
+	inputs_.push_back( input );
+
+	Step( input.movement, input.duration, map_state );
+
+	correction_offset_*= std::exp( -time_delta.ToSeconds() / g_correction_smooth_time_s );
+}
+
+void PlayerPredictor::ProcessPosition( const Messages::PlayerPosition& message, const MapState& map_state )
+{
+	stats_.positions_received++;
+
+	// Drop inputs, already applied by server. Compare sequence numbers with wrapping.
+	while( !inputs_.empty() &&
+		static_cast<short>( static_cast<unsigned short>( inputs_.front().move_number - message.acknowledged_move_number ) ) <= 0 )
+		inputs_.pop_front();
+
+	const m_Vec3 predicted_pos= pos_;
+
+	MessagePositionToPosition( message.xyz, pos_ );
+	MessagePositionToPosition( message.speed, speed_ );
+	on_floor_= message.on_floor;
+
+	for( const Input& input : inputs_ )
+		Step( input.movement, input.duration, map_state );
+
+	const m_Vec3 error= predicted_pos - pos_;
+	const float error_length= error.Length();
+	stats_.last_error= error_length;
+	stats_.max_error= std::max( stats_.max_error, error_length );
+
+	if( error_length > g_misprediction_threshold )
+		stats_.mispredictions++;
+
+	if( error_length > g_snap_distance )
+	{
+		stats_.snaps++;
+		correction_offset_= m_Vec3( 0.0f, 0.0f, 0.0f );
+	}
+	else
+		correction_offset_+= error;
+}
+
+m_Vec3 PlayerPredictor::GetPosition() const
+{
+	return pos_ + correction_offset_;
+}
+
+float PlayerPredictor::GetSpeed() const
+{
+	return speed_.xy().Length();
+}
+
+const PlayerPredictor::Stats& PlayerPredictor::GetStats() const
+{
+	return stats_;
+}
+
+void PlayerPredictor::ResetStats()
+{
+	stats_= Stats();
+}
+
+void PlayerPredictor::Step( const PlayerMovementInput& input, const Time time_delta, const MapState& map_state )
+{
+	// Same sequence, as in server map tick - move player, than collide it with map.
+	const unsigned int step_count=
+		std::max( 1u, static_cast<unsigned int>( std::ceil( time_delta.ToSeconds() / g_max_step_duration_s ) ) );
+	const Time step_duration= Time::FromInternalRepresentation( time_delta.GetInternalRepresentation() / step_count );
+
+	for( unsigned int i= 0u; i < step_count; i++ )
+	{
+		MovePlayer( input, true, noclip_, on_floor_, step_duration, pos_, speed_ );
+
+		// Server does not collide player with map in noclip mode.
+		if( noclip_ )
+			continue;
+
+		MovementRestriction movement_restriction;
+		bool on_floor= false;
+		const m_Vec3 new_pos=
+			CollideWithMapGeometry(
+				*map_data_, collision_index_,
+				map_state.GetStaticModels(), map_state.GetDynamicWalls(),
+				pos_, GameConstants::player_height, GameConstants::player_radius, step_duration,
+				on_floor, movement_restriction );
+
+		const m_Vec3 position_delta= new_pos - pos_;
+
+		if( position_delta.z != 0.0f ) // Vertical clamp
+			ClampPlayerSpeed( m_Vec3( 0.0f, 0.0f, position_delta.z > 0.0f ? 1.0f : -1.0f ), speed_ );
+
+		const float position_delta_length= position_delta.xy().Length();
+		if( position_delta_length != 0.0f ) // Horizontal clamp
+			ClampPlayerSpeed( m_Vec3( position_delta.xy() / position_delta_length, 0.0f ), speed_ );
+
+		pos_= new_pos;
+		on_floor_= on_floor;
+		SetPlayerOnFloor( on_floor_, speed_ );
+	}
+}
+
+} // namespace PanzerChasm
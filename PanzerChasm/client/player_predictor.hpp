@@ -0,0 +1,82 @@
+#pragma once
+#include <deque>
+
+#include "../map_loader.hpp"
+#include "../messages.hpp"
+#include "../server/collision_index.hpp"
+#include "../server/player_movement.hpp"
+#include "../time.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Client-side prediction of local player movement.
+// Local input is applied immediately, using same movement and collision code, as on server.
+// Inputs, which are not yet applied by server, are stored and replayed over each authoritative position.
+class PlayerPredictor final
+{
+public:
+	struct Stats
+	{
+		unsigned int positions_received= 0u;
+		unsigned int mispredictions= 0u; // Authoritative position differs from predicted more, than threshold.
+		unsigned int snaps= 0u; // Mispredictions, too big for smooth correction.
+		unsigned int dropped_inputs= 0u; // Inputs, dropped because of history overflow.
+		float last_error= 0.0f;
+		float max_error= 0.0f;
+	};
+
+	explicit PlayerPredictor( const MapDataConstPtr& map_data );
+	~PlayerPredictor();
+
+	// Start prediction from given position, drop all stored inputs.
+	void Reset( const m_Vec3& pos );
+
+	// Noclip mode of player, received from server. Movement is not collided with map in this mode.
+	void SetNoclip( bool noclip );
+
+	// Apply input of move message, sent to server, for duration of client frame.
+	void ApplyMove( const Messages::PlayerMove& message, Time time_delta, const MapState& map_state );
+
+	// Take authoritative state from server and replay over it inputs, which are not yet applied by server.
+	void ProcessPosition( const Messages::PlayerPosition& message, const MapState& map_state );
+
+	// Predicted position with smoothed corrections.
+	m_Vec3 GetPosition() const;
+	float GetSpeed() const;
+
+	const Stats& GetStats() const;
+	void ResetStats();
+
+private:
+	struct Input
+	{
+		unsigned short move_number;
+		PlayerMovementInput movement;
+		Time duration= Time::FromSeconds(0);
+	};
+
+	static constexpr unsigned int c_max_inputs= 128u;
+
+private:
+	void Step( const PlayerMovementInput& input, Time time_delta, const MapState& map_state );
+
+private:
+	const MapDataConstPtr map_data_;
+	const CollisionIndex collision_index_;
+
+	m_Vec3 pos_;
+	m_Vec3 speed_;
+	bool on_floor_= false;
+	bool noclip_= false;
+
+	std::deque<Input> inputs_;
+
+	// Difference between shown and predicted position. Decreases to zero after each correction.
+	m_Vec3 correction_offset_;
+
+	Stats stats_;
+};
+
+} // namespace PanzerChasm
@@ -46,6 +46,8 @@ void Console::ProcessEvents( const SystemEvents& events )
 {
 	using KeyCode= SystemEvent::KeyEvent::KeyCode;
 
+	TakePendingLines();
+
 	for( const SystemEvent& event : events )
 	{
 		if( event.type == SystemEvent::Type::CharInput )
@@ -141,6 +143,8 @@ void Console::Draw()
 	const float time_delta_s= ( current_time - last_draw_time_ ).ToSeconds();
 	last_draw_time_= current_time;
 
+	TakePendingLines();
+
 	position_+= current_speed_ * time_delta_s;
 	position_= std::min( 1.0f, std::max( 0.0f, position_ ) );
 
@@ -229,18 +233,33 @@ void Console::DrawUserMessages()
 
 void Console::LogCallback( std::string str, const Log::LogLevel log_level )
 {
-	lines_.emplace_back( std::move(str) );
-
-	if( lines_.size() == c_max_lines )
-		lines_.pop_front();
+	std::lock_guard<std::mutex> lock( pending_lines_mutex_ );
+	pending_lines_.emplace_back( std::move(str), log_level );
+}
 
-	lines_position_= 0u;
+void Console::TakePendingLines()
+{
+	std::vector< std::pair< std::string, Log::LogLevel > > pending_lines;
+	{
+		std::lock_guard<std::mutex> lock( pending_lines_mutex_ );
+		pending_lines.swap( pending_lines_ );
+	}
 
-	if( log_level == Log::LogLevel::User )
+	for( std::pair< std::string, Log::LogLevel >& line : pending_lines )
 	{
-		user_messages_.emplace_back();
-		user_messages_.back().text= lines_.back();
-		user_messages_.back().time= Time::CurrentTime();
+		lines_.emplace_back( std::move(line.first) );
+
+		if( lines_.size() == c_max_lines )
+			lines_.pop_front();
+
+		lines_position_= 0u;
+
+		if( line.second == Log::LogLevel::User )
+		{
+			user_messages_.emplace_back();
+			user_messages_.back().text= lines_.back();
+			user_messages_.back().time= Time::CurrentTime();
+		}
 	}
 }
 
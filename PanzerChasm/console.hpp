@@ -1,6 +1,8 @@
 #pragma once
 #include <list>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "commands_processor.hpp"
 #include "log.hpp"
@@ -33,7 +35,9 @@ private:
 	void RemoveOldUserMessages( Time current_time );
 	void DrawUserMessages();
 
+	// May be called from any thread.
 	void LogCallback( std::string str, Log::LogLevel log_level );
+	void TakePendingLines();
 
 	void WriteHistory();
 	void CopyLineFromHistory();
@@ -63,6 +67,10 @@ private:
 	unsigned int input_cursor_pos_= 0u;
 
 	std::list<UserMessage> user_messages_;
+
+	// Lines, logged since last console update. Log may be written from other threads.
+	std::mutex pending_lines_mutex_;
+	std::vector< std::pair< std::string, Log::LogLevel > > pending_lines_;
 };
 
 } // namespace PanzerChasm
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "game_resources.hpp"
+#include "log.hpp"
+#include "map_loader.hpp"
+#include "vfs.hpp"
+
+#include "dedicated_host.hpp"
+
+namespace PanzerChasm
+{
+
+// Loop rate for variable timestep mode.
+static const unsigned int g_default_loop_rate= 60u;
+
+static DifficultyType DifficultyNumberToDifficulty( const int n )
+{
+	switch( n )
+	{
+	case 0: return Difficulty::Easy;
+	case 1: return Difficulty::Normal;
+	case 2: return Difficulty::Hard;
+	default: return Difficulty::Normal;
+	};
+}
+
+DedicatedHost::DedicatedHost( const int argc, const char* const* const argv )
+	: program_arguments_( argc, argv )
+	, settings_( program_arguments_.GetParamValue( "config" ) != nullptr ? program_arguments_.GetParamValue( "config" ) : "PanzerChasm.cfg" )
+	, commands_processor_( settings_ )
+{
+	{ // Register host commands
+		CommandsMapPtr commands= std::make_shared<CommandsMap>();
+
+		commands->emplace( "quit", std::bind( &DedicatedHost::Quit, this ) );
+		commands->emplace( "net_stats", std::bind( &DedicatedHost::PrintNetStats, this ) );
+		commands->emplace( "net_sim", std::bind( &DedicatedHost::PrintNetSimStats, this ) );
+
+		host_commands_= std::move( commands );
+		commands_processor_.RegisterCommands( host_commands_ );
+	}
+
+	{
+		Log::Info( "Read game archive" );
+
+		const char* csm_file= "CSM.BIN";
+		if( const char* const overrided_csm_file = program_arguments_.GetParamValue( "csm" ) )
+		{
+			csm_file= overrided_csm_file;
+			Log::Info( "Trying to load CSM file: \"", overrided_csm_file, "\"" );
+		}
+
+		const char* const addon_path= program_arguments_.GetParamValue( "addon" );
+		if( addon_path != nullptr )
+			Log::Info( "Trying to load addon \"", addon_path, "\"" );
+
+		vfs_= std::make_shared<Vfs>( csm_file, addon_path );
+	}
+
+	Log::Info( "Loading game resources" );
+	game_resources_= LoadGameResources( vfs_ );
+
+	map_loader_= std::make_shared<MapLoader>( vfs_ );
+
+	Log::Info( "Initialize net subsystem" );
+	net_.reset( new Net() );
+
+	const int tcp_port= GetIntParam( "port", "sv_port", Net::c_default_server_tcp_port );
+	const int udp_base_port= GetIntParam( "udp-port", "sv_udp_base_port", Net::c_default_server_udp_base_port );
+	const bool reliable_over_udp= GetIntParam( "reliable-udp", "sv_reliable_udp", 1 ) != 0;
+
+	const IConnectionsListenerPtr net_listener=
+		net_->CreateServerListener(
+			static_cast<uint16_t>(tcp_port),
+			static_cast<uint16_t>(udp_base_port),
+			reliable_over_udp );
+	if( net_listener == nullptr )
+		Log::FatalError( "Can not start server: network error" );
+
+	// Simulation of bad network for connected clients.
+	NetworkConditions network_conditions;
+	network_conditions.latency_ms= static_cast<unsigned int>( std::max( 0, GetIntParam( "net-latency", "net_sim_latency", 0 ) ) );
+	network_conditions.jitter_ms= static_cast<unsigned int>( std::max( 0, GetIntParam( "net-jitter", "net_sim_jitter", 0 ) ) );
+	network_conditions.loss_percent= static_cast<unsigned int>( std::max( 0, GetIntParam( "net-loss", "net_sim_loss", 0 ) ) );
+	network_conditions.duplication_percent= static_cast<unsigned int>( std::max( 0, GetIntParam( "net-duplication", "net_sim_duplication", 0 ) ) );
+	network_conditions.bandwidth_kbps= static_cast<unsigned int>( std::max( 0, GetIntParam( "net-bandwidth", "net_sim_bandwidth", 0 ) ) );
+	network_simulator_.SetConditions( network_conditions );
+
+	const IConnectionsListenerPtr listener= network_simulator_.WrapConnectionsListener( net_listener );
+
+	const int tick_rate= std::max( 0, GetIntParam( "tick-rate", "sv_tick_rate", 0 ) );
+	const Time tick_duration=
+		Time::FromInternalRepresentation(
+			Time::FromSeconds(1).GetInternalRepresentation() /
+			int64_t( tick_rate > 0 ? tick_rate : int(g_default_loop_rate) ) );
+	const Time stats_interval= Time::FromSeconds( std::max( 1, GetIntParam( "stats-interval", "sv_stats_interval", 10 ) ) );
+
+	const int map_number= GetIntParam( "map", "sv_map", 1 );
+	const DifficultyType difficulty= DifficultyNumberToDifficulty( GetIntParam( "difficulty", "sv_difficulty", 1 ) );
+	const GameRules game_rules=
+		GetIntParam( "coop", "sv_coop", 0 ) != 0
+			? GameRules::Cooperative
+			: GameRules::Deathmatch;
+	const LongRand::RandResultType random_seed= static_cast<LongRand::RandResultType>( GetIntParam( "seed", "sv_random_seed", 0 ) );
+
+	// Optional per-loop tick profile dump.
+	if( const char* const profile_csv_file= program_arguments_.GetParamValue( "profile-csv" ) )
+		settings_.SetSetting( "sv_profile_csv", profile_csv_file );
+	const std::string profile_csv_file= settings_.GetString( "sv_profile_csv" );
+
+	const int lag_compensation_max_ticks= std::max( 0, GetIntParam( "lag-compensation", "sv_lag_compensation_max_ticks", 16 ) );
+	const bool interest_management= GetIntParam( "interest-management", "sv_interest_management", 1 ) != 0;
+	const bool delta_compression= GetIntParam( "delta-compression", "sv_delta_compression", 1 ) != 0;
+
+	// Bots for load testing. In multi-room mode - count of bots in each room.
+	const int bot_count= std::max( 0, GetIntParam( "bots", "sv_bots", 0 ) );
+
+	const int room_count= std::max( 1, GetIntParam( "rooms", "sv_rooms", 1 ) );
+	if( room_count == 1 )
+	{
+		Log::Info( "Create dedicated server" );
+		bots_= std::make_shared<Bots>( listener, map_loader_, "Server" );
+		bots_->SetStatsInterval( stats_interval );
+
+		server_.reset(
+			new Server(
+				commands_processor_,
+				game_resources_,
+				map_loader_,
+				bots_,
+				nullptr ) );
+
+		server_->SetFixedTickRate( static_cast<unsigned int>(tick_rate) );
+		server_->SetRandomSeed( random_seed );
+		server_->SetStateHashLogging( settings_.GetOrSetBool( "sv_log_state_hash", false ) );
+		server_->SetTickProfileCsvFile( profile_csv_file.c_str() );
+		server_->SetLagCompensation( static_cast<unsigned int>( lag_compensation_max_ticks ) );
+		server_->SetInterestManagement( interest_management );
+		server_->SetDeltaCompression( delta_compression );
+
+		if( !server_->ChangeMap( static_cast<unsigned int>(map_number), difficulty, game_rules ) )
+			Log::FatalError( "Can not start map ", map_number );
+
+		if( bot_count > 0 )
+			bots_->AddBots( static_cast<unsigned int>(bot_count) );
+
+		{ // Bots commands are available only for single server, because rooms bots live in other threads.
+			CommandsMapPtr commands= std::make_shared<CommandsMap>();
+			commands->emplace( "bots_add", std::bind( &DedicatedHost::AddBots, this, std::placeholders::_1 ) );
+			commands->emplace( "bots_remove", std::bind( &DedicatedHost::RemoveBots, this ) );
+			commands->emplace( "bots_stats", std::bind( &DedicatedHost::PrintBotsStats, this ) );
+
+			bots_commands_= std::move( commands );
+			commands_processor_.RegisterCommands( bots_commands_ );
+		}
+
+		tick_scheduler_.reset( new TickScheduler( tick_duration, stats_interval, "Server" ) );
+	}
+	else
+	{
+		Log::Info( "Create dedicated server with ", room_count, " rooms" );
+		server_rooms_.reset(
+			new ServerRooms(
+				static_cast<unsigned int>(room_count),
+				settings_,
+				game_resources_,
+				map_loader_,
+				listener ) );
+
+		ServerRooms::RoomsParams params;
+		params.map_number= static_cast<unsigned int>(map_number);
+		params.difficulty= difficulty;
+		params.game_rules= game_rules;
+		params.fixed_tick_rate= static_cast<unsigned int>(tick_rate);
+		params.random_seed= random_seed;
+		params.tick_duration= tick_duration;
+		params.stats_interval= stats_interval;
+		params.profile_csv_file= profile_csv_file;
+		params.bots_per_room= static_cast<unsigned int>(bot_count);
+		params.lag_compensation_max_ticks= static_cast<unsigned int>(lag_compensation_max_ticks);
+		params.interest_management= interest_management;
+		params.delta_compression= delta_compression;
+
+		if( !server_rooms_->Start( params ) )
+			Log::FatalError( "Can not start map ", map_number );
+
+		// Main thread only accepts connections. Rooms threads have own schedulers.
+		tick_scheduler_.reset( new TickScheduler( tick_duration, Time::FromSeconds( 1 << 30 ), "Connections" ) );
+	}
+
+	// Wait for network events instead of sleeping - readiness of sockets is collected while waiting.
+	tick_scheduler_->SetWaitFunction(
+		[this]( const Time wait_time )
+		{
+			net_->Poll( wait_time );
+		} );
+
+	stdin_commands_reader_.reset( new StdinCommandsReader() );
+
+	Log::Info( "Dedicated server started on port ", tcp_port );
+	Log::Info( "Type commands into terminal, \"quit\" to stop server" );
+}
+
+DedicatedHost::~DedicatedHost()
+{
+	Log::Info( "Stopping dedicated server" );
+
+	// Stop rooms threads before other destruction.
+	server_rooms_.reset();
+
+	if( server_ != nullptr )
+	{
+		server_->DisconnectAllClients();
+		server_->StopMap();
+	}
+}
+
+bool DedicatedHost::Loop()
+{
+	tick_scheduler_->BeginTick();
+
+	for( const std::string& command : stdin_commands_reader_->TakeLines() )
+		commands_processor_.ProcessCommand( command.c_str() );
+
+	if( bots_ != nullptr )
+		bots_->Tick();
+	if( server_ != nullptr )
+		server_->Loop( false );
+	if( server_rooms_ != nullptr )
+		server_rooms_->RouteNewConnections();
+
+	tick_scheduler_->EndTick();
+
+	return !quit_requested_;
+}
+
+void DedicatedHost::Quit()
+{
+	quit_requested_= true;
+}
+
+void DedicatedHost::AddBots( const CommandsArguments& args )
+{
+	const int count= args.empty() ? 1 : std::atoi( args.front().c_str() );
+	if( count > 0 )
+		bots_->AddBots( static_cast<unsigned int>(count) );
+}
+
+void DedicatedHost::RemoveBots()
+{
+	bots_->RemoveAllBots();
+}
+
+void DedicatedHost::PrintBotsStats()
+{
+	bots_->PrintStats();
+}
+
+void DedicatedHost::PrintNetStats()
+{
+	net_->PrintStats();
+}
+
+void DedicatedHost::PrintNetSimStats()
+{
+	network_simulator_.PrintStats();
+}
+
+int DedicatedHost::GetIntParam( const char* const param_name, const char* const settings_key, const int default_value )
+{
+	if( const char* const value= program_arguments_.GetParamValue( param_name ) )
+		settings_.SetSetting( settings_key, std::atoi( value ) );
+
+	return settings_.GetOrSetInt( settings_key, default_value );
+}
+
+} // namespace PanzerChasm
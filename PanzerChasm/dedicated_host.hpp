@@ -0,0 +1,73 @@
+#pragma once
+#include <memory>
+
+#include "commands_processor.hpp"
+#include "net/net.hpp"
+#include "network_simulator.hpp"
+#include "program_arguments.hpp"
+#include "server/bots.hpp"
+#include "server/server.hpp"
+#include "server/server_rooms.hpp"
+#include "settings.hpp"
+#include "stdin_commands_reader.hpp"
+#include "tick_scheduler.hpp"
+
+namespace PanzerChasm
+{
+
+// Host for dedicated server.
+// Does not create window, drawers, sound, menu, console and client.
+// Can run one server in main thread or many server rooms in separate threads.
+class DedicatedHost final
+{
+public:
+	DedicatedHost( int argc, const char* const* argv );
+	~DedicatedHost();
+
+	// Returns false on quit
+	bool Loop();
+
+	void Quit();
+
+private:
+	void AddBots( const CommandsArguments& args );
+	void RemoveBots();
+	void PrintBotsStats();
+	void PrintNetStats();
+	void PrintNetSimStats();
+
+	// Returns value from command line, if exists, or from settings.
+	// Value from command line is saved in settings.
+	int GetIntParam( const char* param_name, const char* settings_key, int default_value );
+
+private:
+	// Put members here in reverse deinitialization order.
+
+	bool quit_requested_= false;
+
+	const ProgramArguments program_arguments_;
+	Settings settings_;
+	CommandsProcessor commands_processor_;
+	CommandsMapConstPtr host_commands_;
+	CommandsMapConstPtr bots_commands_;
+
+	VfsPtr vfs_;
+	GameResourcesConstPtr game_resources_;
+	MapLoaderPtr map_loader_;
+
+	std::unique_ptr<Net> net_;
+	NetworkSimulator network_simulator_;
+
+	BotsPtr bots_; // For single server only. Rooms have own bots.
+
+	// Only one of them exists.
+	std::unique_ptr<Server> server_;
+	std::unique_ptr<ServerRooms> server_rooms_;
+
+	std::unique_ptr<TickScheduler> tick_scheduler_;
+
+	// Console commands, typed into terminal of server.
+	std::unique_ptr<StdinCommandsReader> stdin_commands_reader_;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "../Common/files.hpp"
+using namespace ChasmReverse;
+
+#include "log.hpp"
+#include "messages.hpp"
+
+#include "demo.hpp"
+
+namespace PanzerChasm
+{
+
+const char DemoHeader::c_expected_id[8]= "PanChDm"; // PanzerChasmDemo
+
+constexpr unsigned int DemoHeader::c_expected_version;
+
+static uint32_t TimeToMs( const Time time )
+{
+	return static_cast<uint32_t>(
+		time.GetInternalRepresentation() * 1000 / Time::FromSeconds(1).GetInternalRepresentation() );
+}
+
+DemoRecorderPtr DemoRecorder::Create( IConnectionPtr connection, const char* const file_name )
+{
+	std::FILE* const file= std::fopen( file_name, "wb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not write demo \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	DemoHeader header;
+	std::memcpy( header.id, DemoHeader::c_expected_id, sizeof(header.id) );
+	header.version= DemoHeader::c_expected_version;
+	header.protocol_version= Messages::c_protocol_version;
+	FileWrite( file, &header, sizeof(DemoHeader) );
+
+	Log::Info( "Recording demo \"", file_name, "\"" );
+	return std::make_shared<DemoRecorder>( std::move(connection), file );
+}
+
+DemoRecorder::DemoRecorder( IConnectionPtr connection, std::FILE* const file )
+	: connection_( std::move(connection) )
+	, file_(file)
+	, start_time_( Time::CurrentTime() )
+{
+	PC_ASSERT( connection_ != nullptr );
+	PC_ASSERT( file_ != nullptr );
+}
+
+DemoRecorder::~DemoRecorder()
+{
+	Stop();
+}
+
+void DemoRecorder::Frame()
+{
+	if( file_ == nullptr )
+		return;
+	if( frame_reliable_data_.empty() && frame_unreliable_data_.empty() )
+		return;
+
+	DemoFrameHeader frame_header;
+	frame_header.time_ms= TimeToMs( Time::CurrentTime() - start_time_ );
+	frame_header.reliable_data_size= frame_reliable_data_.size();
+	frame_header.unreliable_data_size= frame_unreliable_data_.size();
+
+	FileWrite( file_, &frame_header, sizeof(DemoFrameHeader) );
+	FileWrite( file_, frame_reliable_data_.data(), frame_reliable_data_.size() );
+	FileWrite( file_, frame_unreliable_data_.data(), frame_unreliable_data_.size() );
+
+	frame_reliable_data_.clear();
+	frame_unreliable_data_.clear();
+	frame_count_++;
+}
+
+void DemoRecorder::Stop()
+{
+	if( file_ == nullptr )
+		return;
+
+	Frame();
+	std::fclose( file_ );
+	file_= nullptr;
+
+	Log::Info( "Demo recording finished. ", frame_count_, " frames recorded" );
+}
+
+void DemoRecorder::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	connection_->SendReliablePacket( data, data_size );
+}
+
+void DemoRecorder::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	connection_->SendUnreliablePacket( data, data_size );
+}
+
+void DemoRecorder::SendUnreliablePackets( const UnreliablePacket* const packets, const unsigned int packet_count )
+{
+	connection_->SendUnreliablePackets( packets, packet_count );
+}
+
+unsigned int DemoRecorder::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int size= connection_->ReadRealiableData( out_data, buffer_size );
+	RecordData( true, static_cast<const unsigned char*>(out_data), size );
+	return size;
+}
+
+unsigned int DemoRecorder::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int size= connection_->ReadUnrealiableData( out_data, buffer_size );
+	RecordData( false, static_cast<const unsigned char*>(out_data), size );
+	return size;
+}
+
+unsigned char* DemoRecorder::BeginDirectWrite( const bool reliable, const unsigned int max_size )
+{
+	return connection_->BeginDirectWrite( reliable, max_size );
+}
+
+void DemoRecorder::EndDirectWrite( const bool reliable, const unsigned int size )
+{
+	connection_->EndDirectWrite( reliable, size );
+}
+
+bool DemoRecorder::PeekReceivedData( const bool reliable, const unsigned char*& out_data, unsigned int& out_size )
+{
+	const bool result= connection_->PeekReceivedData( reliable, out_data, out_size );
+
+	peeked_data_[ reliable ? 0u : 1u ]= result ? out_data : nullptr;
+	peeked_size_[ reliable ? 0u : 1u ]= result ? out_size : 0u;
+	return result;
+}
+
+void DemoRecorder::ConsumeReceivedData( const bool reliable, const unsigned int size )
+{
+	const unsigned char*& peeked_data= peeked_data_[ reliable ? 0u : 1u ];
+	unsigned int& peeked_size= peeked_size_[ reliable ? 0u : 1u ];
+	PC_ASSERT( size <= peeked_size );
+
+	// Record data before consuming, because consumed data is not valid anymore.
+	RecordData( reliable, peeked_data, size );
+	peeked_data= nullptr;
+	peeked_size= 0u;
+
+	connection_->ConsumeReceivedData( reliable, size );
+}
+
+void DemoRecorder::RecordData( const bool reliable, const unsigned char* const data, const unsigned int size )
+{
+	if( file_ == nullptr || size == 0u )
+		return;
+
+	std::vector<unsigned char>& frame_data= reliable ? frame_reliable_data_ : frame_unreliable_data_;
+	frame_data.insert( frame_data.end(), data, data + size );
+}
+
+void DemoRecorder::Disconnect()
+{
+	connection_->Disconnect();
+}
+
+bool DemoRecorder::Disconnected()
+{
+	return connection_->Disconnected();
+}
+
+std::string DemoRecorder::GetConnectionInfo()
+{
+	return connection_->GetConnectionInfo();
+}
+
+DemoPlayerPtr DemoPlayer::Load( const char* const file_name, const bool timedemo )
+{
+	std::FILE* const file= std::fopen( file_name, "rb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not read demo \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	// Read whole file, because file reading must not affect timedemo.
+	std::fseek( file, 0, SEEK_END );
+	const long file_size= std::ftell( file );
+	std::fseek( file, 0, SEEK_SET );
+
+	if( file_size < 0 || static_cast<unsigned long>(file_size) > std::numeric_limits<unsigned int>::max() )
+	{
+		std::fclose( file );
+		Log::Warning( "Can not read demo \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	std::vector<unsigned char> data( static_cast<size_t>(file_size) );
+	FileRead( file, data.data(), data.size() );
+	std::fclose( file );
+
+	if( data.size() < sizeof(DemoHeader) )
+	{
+		Log::Warning( "Demo file is broken - it is too small" );
+		return nullptr;
+	}
+
+	DemoHeader header;
+	std::memcpy( &header, data.data(), sizeof(DemoHeader) );
+	if( std::memcmp( header.id, DemoHeader::c_expected_id, sizeof(header.id) ) != 0 )
+	{
+		Log::Warning( "File is not a PanzerChasm demo" );
+		return nullptr;
+	}
+	if( header.version != DemoHeader::c_expected_version || header.protocol_version != Messages::c_protocol_version )
+	{
+		Log::Warning( "Demo has different version" );
+		return nullptr;
+	}
+
+	Log::Info( timedemo ? "Timedemo \"" : "Playing demo \"", file_name, "\"" );
+	return std::make_shared<DemoPlayer>( std::move(data), timedemo );
+}
+
+DemoPlayer::DemoPlayer( std::vector<unsigned char> data, const bool timedemo )
+	: data_( std::move(data) )
+	, timedemo_(timedemo)
+	, start_time_( Time::FromSeconds(0) )
+	, last_frame_time_( Time::FromSeconds(0) )
+{
+	unsigned int pos= sizeof(DemoHeader);
+	while( data_.size() - pos >= sizeof(DemoFrameHeader) )
+	{
+		DemoFrameHeader frame_header;
+		std::memcpy( &frame_header, data_.data() + pos, sizeof(DemoFrameHeader) );
+		pos+= sizeof(DemoFrameHeader);
+
+		if( frame_header.reliable_data_size > data_.size() - pos ||
+			frame_header.unreliable_data_size > data_.size() - pos - frame_header.reliable_data_size )
+			break;
+
+		FrameData frame;
+		frame.time_ms= frame_header.time_ms;
+		frame.data_offset[0]= pos;
+		frame.data_size[0]= frame_header.reliable_data_size;
+		frame.data_offset[1]= pos + frame_header.reliable_data_size;
+		frame.data_size[1]= frame_header.unreliable_data_size;
+		frames_.push_back( frame );
+
+		pos+= frame_header.reliable_data_size + frame_header.unreliable_data_size;
+	}
+
+	if( pos != data_.size() )
+		Log::Warning( "Demo file is broken - last frame is incomplete" );
+
+	Log::Info( "Demo contains ", frames_.size(), " frames" );
+}
+
+DemoPlayer::~DemoPlayer()
+{}
+
+void DemoPlayer::Frame()
+{
+	const Time current_time= Time::CurrentTime();
+	if( !started_ )
+	{
+		started_= true;
+		start_time_= current_time;
+	}
+	else if( timedemo_ )
+		frame_durations_ms_.push_back( ( current_time - last_frame_time_ ).ToSeconds() * 1000.0f );
+	last_frame_time_= current_time;
+
+	if( available_frame_count_ == frames_.size() )
+	{
+		// All frames are given to client in previous loops.
+		disconnected_= true;
+		return;
+	}
+
+	if( timedemo_ )
+		available_frame_count_++;
+	else
+	{
+		const uint32_t time_ms= TimeToMs( current_time - start_time_ );
+		while( available_frame_count_ < frames_.size() && frames_[ available_frame_count_ ].time_ms <= time_ms )
+			available_frame_count_++;
+	}
+}
+
+bool DemoPlayer::IsTimedemo() const
+{
+	return timedemo_;
+}
+
+bool DemoPlayer::Finished() const
+{
+	return disconnected_;
+}
+
+void DemoPlayer::PrintTimedemoStats() const
+{
+	if( frame_durations_ms_.empty() )
+	{
+		Log::Info( "Timedemo: no frames" );
+		return;
+	}
+
+	std::vector<float> durations= frame_durations_ms_;
+	std::sort( durations.begin(), durations.end() );
+
+	float sum= 0.0f;
+	for( const float duration : durations )
+		sum+= duration;
+
+	const float avg= sum / float( durations.size() );
+	const size_t p99_index=
+		std::min( durations.size() - 1u, static_cast<size_t>( std::ceil( float( durations.size() ) * 0.99f ) ) - 1u );
+
+	Log::Info(
+		"Timedemo: ", durations.size(), " frames in ", sum / 1000.0f, " s, ",
+		avg > 0.0f ? 1000.0f / avg : 0.0f, " fps. Frame time ",
+		"avg: ", avg, " ms",
+		" min: ", durations.front(), " ms",
+		" p99: ", durations[ p99_index ], " ms",
+		" max: ", durations.back(), " ms" );
+}
+
+void DemoPlayer::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	PC_UNUSED( data );
+	PC_UNUSED( data_size );
+}
+
+void DemoPlayer::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	PC_UNUSED( data );
+	PC_UNUSED( data_size );
+}
+
+unsigned int DemoPlayer::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	return ReadStream( 0u, out_data, buffer_size );
+}
+
+unsigned int DemoPlayer::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	return ReadStream( 1u, out_data, buffer_size );
+}
+
+void DemoPlayer::Disconnect()
+{
+	disconnected_= true;
+}
+
+bool DemoPlayer::Disconnected()
+{
+	return disconnected_;
+}
+
+std::string DemoPlayer::GetConnectionInfo()
+{
+	return "demo";
+}
+
+unsigned int DemoPlayer::ReadStream( const unsigned int stream, void* const out_data, const unsigned int buffer_size )
+{
+	if( disconnected_ )
+		return 0u;
+
+	StreamPos& pos= streams_pos_[stream];
+	unsigned int result_size= 0u;
+	while( result_size < buffer_size && pos.frame < available_frame_count_ )
+	{
+		const FrameData& frame= frames_[ pos.frame ];
+		const unsigned int copy_size= std::min( buffer_size - result_size, frame.data_size[stream] - pos.offset );
+
+		std::memcpy(
+			static_cast<unsigned char*>(out_data) + result_size,
+			data_.data() + frame.data_offset[stream] + pos.offset,
+			copy_size );
+
+		result_size+= copy_size;
+		pos.offset+= copy_size;
+		if( pos.offset == frame.data_size[stream] )
+		{
+			pos.frame++;
+			pos.offset= 0u;
+		}
+	}
+
+	return result_size;
+}
+
+} // namespace PanzerChasm
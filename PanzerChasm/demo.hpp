@@ -0,0 +1,156 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "assert.hpp"
+#include "fwd.hpp"
+#include "i_connection.hpp"
+#include "time.hpp"
+
+namespace PanzerChasm
+{
+
+// Demo file contains data, received by client from server, as is - encoded messages.
+// Data is splitted into frames. Each frame is data, received by client in one loop.
+// File structure: header, than frames. Each frame is frame header, than reliable data, than unreliable data.
+
+struct DemoHeader
+{
+public:
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 0x100u; // Change each time, when format changed.
+
+public:
+	unsigned char id[8]; // must be equal to c_expected_id
+	uint32_t version;
+	uint32_t protocol_version; // Messages can be read only with same protocol.
+};
+
+SIZE_ASSERT( DemoHeader, 16u );
+
+struct DemoFrameHeader
+{
+	uint32_t time_ms; // Since demo start.
+	uint32_t reliable_data_size;
+	uint32_t unreliable_data_size;
+};
+
+SIZE_ASSERT( DemoFrameHeader, 12u );
+
+// Connection wrapper, which writes all data, received by client, into demo file.
+class DemoRecorder final : public IConnection
+{
+public:
+	// Returns nullptr, if can not create file.
+	static DemoRecorderPtr Create( IConnectionPtr connection, const char* file_name );
+
+	DemoRecorder( IConnectionPtr connection, std::FILE* file );
+	virtual ~DemoRecorder() override;
+
+	// Write data, received since previous call, as one frame. Call it once per client loop.
+	void Frame();
+	// Finish demo file. After it recorder only passes data through, so, it may be still used as connection.
+	void Stop();
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePackets( const UnreliablePacket* packets, unsigned int packet_count ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual unsigned char* BeginDirectWrite( bool reliable, unsigned int max_size ) override;
+	virtual void EndDirectWrite( bool reliable, unsigned int size ) override;
+	virtual bool PeekReceivedData( bool reliable, const unsigned char*& out_data, unsigned int& out_size ) override;
+	virtual void ConsumeReceivedData( bool reliable, unsigned int size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+
+private:
+	void RecordData( bool reliable, const unsigned char* data, unsigned int size );
+
+private:
+	const IConnectionPtr connection_;
+	std::FILE* file_; // nullptr after stop
+	const Time start_time_;
+
+	std::vector<unsigned char> frame_reliable_data_;
+	std::vector<unsigned char> frame_unreliable_data_;
+	unsigned int frame_count_= 0u;
+
+	// Last blocks, returned by "PeekReceivedData", for reliable and unreliable data. Consumed data is recorded from them.
+	const unsigned char* peeked_data_[2]= { nullptr, nullptr };
+	unsigned int peeked_size_[2]= { 0u, 0u };
+};
+
+// Connection, which gives to client data from demo file, as if it was received from server.
+// Data, sent by client, is ignored.
+class DemoPlayer final : public IConnection
+{
+public:
+	// Returns nullptr, if can not load demo.
+	// In timedemo mode frames are played as fast as possible - one demo frame per client loop.
+	static DemoPlayerPtr Load( const char* file_name, bool timedemo );
+
+	DemoPlayer( std::vector<unsigned char> data, bool timedemo );
+	virtual ~DemoPlayer() override;
+
+	// Make next frames available for reading. Call it once per client loop, before client loop.
+	void Frame();
+	bool IsTimedemo() const;
+	bool Finished() const;
+
+	// Print statistics of client loops durations in timedemo mode.
+	void PrintTimedemoStats() const;
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+
+private:
+	struct FrameData
+	{
+		uint32_t time_ms;
+		unsigned int data_offset[2]; // For reliable and unreliable data.
+		unsigned int data_size[2];
+	};
+
+	struct StreamPos
+	{
+		unsigned int frame= 0u;
+		unsigned int offset= 0u; // In frame data.
+	};
+
+private:
+	unsigned int ReadStream( unsigned int stream, void* out_data, unsigned int buffer_size );
+
+private:
+	const std::vector<unsigned char> data_;
+	const bool timedemo_;
+
+	std::vector<FrameData> frames_;
+	unsigned int available_frame_count_= 0u;
+	StreamPos streams_pos_[2];
+
+	bool started_= false;
+	bool disconnected_= false;
+	Time start_time_;
+	Time last_frame_time_;
+
+	std::vector<float> frame_durations_ms_;
+};
+
+} // namespace PanzerChasm
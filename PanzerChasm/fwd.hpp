@@ -24,6 +24,12 @@ struct GameResources;
 typedef std::shared_ptr<GameResources> GameResourcesPtr;
 typedef std::shared_ptr<const GameResources> GameResourcesConstPtr;
 
+class DemoRecorder;
+typedef std::shared_ptr<DemoRecorder> DemoRecorderPtr;
+
+class DemoPlayer;
+typedef std::shared_ptr<DemoPlayer> DemoPlayerPtr;
+
 class LoopbackBuffer;
 typedef  std::shared_ptr<LoopbackBuffer> LoopbackBufferPtr;
 
@@ -5,6 +5,7 @@
 #include <ogl_state_manager.hpp>
 #include <shaders_loading.hpp>
 
+#include "demo.hpp"
 #include "drawers_factory_gl.hpp"
 #include "drawers_factory_soft.hpp"
 #include "game_resources.hpp"
@@ -15,6 +16,7 @@
 #include "shared_drawers.hpp"
 #include "save_load.hpp"
 #include "sound/sound_engine.hpp"
+#include "tick_scheduler.hpp"
 
 #include "host.hpp"
 
@@ -68,6 +70,9 @@ Host::Host( const int argc, const char* const* const argv )
 	: program_arguments_( argc, argv )
 	, settings_( "PanzerChasm.cfg" )
 	, commands_processor_( settings_ )
+	, local_server_thread_quit_( false )
+	, local_server_paused_( false )
+	, main_thread_id_( std::this_thread::get_id() )
 {
 	{ // Register host commands
 		CommandsMapPtr commands= std::make_shared<CommandsMap>();
@@ -81,6 +86,13 @@ Host::Host( const int argc, const char* const* const argv )
 		commands->emplace( "save", std::bind( &Host::SaveCommand, this, std::placeholders::_1 ) );
 		commands->emplace( "load", std::bind( &Host::LoadCommand, this, std::placeholders::_1 ) );
 		commands->emplace( "vid_restart", std::bind( &Host::VidRestart, this ) );
+		commands->emplace( "net_stats", std::bind( &Host::NetStatsCommand, this ) );
+		commands->emplace( "net_sim", std::bind( &Host::NetSimCommand, this ) );
+		commands->emplace( "loopback_stats", std::bind( &Host::LoopbackStatsCommand, this ) );
+		commands->emplace( "record", std::bind( &Host::RecordCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "stopdemo", std::bind( &Host::StopDemoCommand, this ) );
+		commands->emplace( "playdemo", std::bind( &Host::PlayDemoCommand, this, std::placeholders::_1 ) );
+		commands->emplace( "timedemo", std::bind( &Host::TimedemoCommand, this, std::placeholders::_1 ) );
 
 		host_commands_= std::move( commands );
 		commands_processor_.RegisterCommands( host_commands_ );
@@ -88,6 +100,14 @@ Host::Host( const int argc, const char* const* const argv )
 
 	base_window_title_= "PanzerChasm";
 
+	// Network simulation parameters from command line, like "--net-latency 100".
+	for( const char* const param : { "latency", "jitter", "loss", "duplication", "bandwidth" } )
+	{
+		if( const char* const value= program_arguments_.GetParamValue( ( std::string( "net-" ) + param ).c_str() ) )
+			settings_.SetSetting( ( std::string( "net_sim_" ) + param ).c_str(), std::atoi( value ) );
+	}
+	UpdateNetworkConditions();
+
 	{
 		Log::Info( "Read game archive" );
 
@@ -142,12 +162,27 @@ Host::Host( const int argc, const char* const* const argv )
 
 Host::~Host()
 {
+	if( local_server_thread_.joinable() )
+		StopLocalServerThread();
 }
 
 bool Host::Loop()
 {
 	const Time tick_start_time= Time::CurrentTime();
 
+	UpdateNetworkConditions();
+
+	const bool need_local_server_thread= local_server_ != nullptr && settings_.GetOrSetBool( "sv_thread", false );
+	if( need_local_server_thread && !local_server_thread_.joinable() )
+		StartLocalServerThread();
+	else if( !need_local_server_thread && local_server_thread_.joinable() )
+		StopLocalServerThread();
+
+	// Lock server while processing input, because console commands and menu may access server.
+	std::unique_lock<std::mutex> local_server_lock( local_server_mutex_, std::defer_lock );
+	if( local_server_thread_.joinable() )
+		local_server_lock.lock();
+
 	// Events processing
 	InputState input_state;
 	if( system_window_ != nullptr )
@@ -201,12 +236,43 @@ bool Host::Loop()
 		sound_engine_->Tick();
 
 	// Loop operations
+	if( net_ != nullptr )
+		net_->Poll( Time::FromSeconds(0) );
+
 	if( local_server_ != nullptr )
-		local_server_->Loop( really_paused || needs_pause_server );
+	{
+		if( local_server_thread_.joinable() )
+			local_server_paused_.store( really_paused || needs_pause_server );
+		else
+			local_server_->Loop( really_paused || needs_pause_server );
+	}
+
+	// Client works in parallel with server thread. They communicate only through loopback buffer.
+	if( local_server_lock.owns_lock() )
+		local_server_lock.unlock();
+
+	if( loopback_buffer_ != nullptr )
+		loopback_buffer_->CountFrame();
+
+	if( demo_player_ != nullptr )
+	{
+		demo_player_->Frame();
+		if( demo_player_->Finished() )
+		{
+			if( demo_player_->IsTimedemo() )
+				demo_player_->PrintTimedemoStats();
+			Log::Info( "Demo finished" );
+
+			demo_player_= nullptr;
+			if( client_ != nullptr )
+				client_->SetConnection( nullptr );
+		}
+	}
 
 	if( client_ != nullptr )
 	{
-		if( input_goes_to_console || input_goes_to_menu )
+		// Player input must not affect demo playback.
+		if( input_goes_to_console || input_goes_to_menu || demo_player_ != nullptr )
 		{
 			InputState dummy_input_state;
 			client_->Loop( dummy_input_state, really_paused );
@@ -215,6 +281,9 @@ bool Host::Loop()
 			client_->Loop( input_state, really_paused );
 	}
 
+	if( demo_recorder_ != nullptr )
+		demo_recorder_->Frame();
+
 	// Draw operations
 	if( system_window_ && !system_window_->IsMinimized() )
 	{
@@ -261,9 +330,10 @@ bool Host::Loop()
 	const int max_fps= settings_.GetOrSetInt( "r_max_fps", 0 );
 	const double min_acceptable_tick_duration_ms= ( max_fps > 0 ) ? 1000.0 / max_fps : 5.0;
 
-	// Try sleep just a bit, if we run too fast.
+	// Try sleep just a bit, if we run too fast. Do not sleep in timedemo - it must run as fast, as possible.
+	const bool timedemo= demo_player_ != nullptr && demo_player_->IsTimedemo();
 	const auto sleep_time = static_cast<Uint32>( std::max( min_acceptable_tick_duration_ms - tick_duration_ms, 1.01 ) );
-	if( tick_duration_ms < 0.9 * min_acceptable_tick_duration_ms )
+	if( !timedemo && tick_duration_ms < 0.9 * min_acceptable_tick_duration_ms )
 		SDL_Delay( sleep_time );
 
 	loops_counter_.Tick();
@@ -322,7 +392,7 @@ void Host::ConnectToServer( const char* server_address )
 		return;
 	}
 
-	client_->SetConnection( connection );
+	client_->SetConnection( WrapClientConnection( connection ) );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - multiplayer client" );
@@ -349,7 +419,8 @@ void Host::StartServer(
 	const IConnectionsListenerPtr listener=
 		net_->CreateServerListener(
 			server_tcp_port != 0u ? server_tcp_port : Net::c_default_server_tcp_port,
-			server_base_udp_port != 0u ? server_base_udp_port : Net::c_default_server_udp_base_port );
+			server_base_udp_port != 0u ? server_base_udp_port : Net::c_default_server_udp_base_port,
+			settings_.GetOrSetBool( "sv_reliable_udp", true ) );
 
 	if( listener == nullptr )
 	{
@@ -363,14 +434,14 @@ void Host::StartServer(
 	if( !map_changed )
 		return;
 
-	connections_listener_proxy_->AddConnectionsListener( listener );
+	connections_listener_proxy_->AddConnectionsListener( network_simulator_.WrapConnectionsListener( listener ) );
 	if( !dedicated )
-		connections_listener_proxy_->AddConnectionsListener( loopback_buffer_ );
+		connections_listener_proxy_->AddConnectionsListener( network_simulator_.WrapConnectionsListener( loopback_buffer_ ) );
 
 	if( !dedicated )
 	{
 		loopback_buffer_->RequestConnect();
-		client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+		client_->SetConnection( WrapClientConnection( loopback_buffer_->GetClientSideConnection() ) );
 	}
 
 	if( system_window_ != nullptr )
@@ -490,6 +561,95 @@ void Host::LoadCommand( const CommandsArguments& args )
 	DoLoad( args.front().c_str() );
 }
 
+void Host::NetStatsCommand()
+{
+	if( net_ == nullptr )
+	{
+		Log::Info( "Net is not started" );
+		return;
+	}
+
+	net_->PrintStats();
+}
+
+void Host::NetSimCommand()
+{
+	network_simulator_.PrintStats();
+}
+
+void Host::LoopbackStatsCommand()
+{
+	if( loopback_buffer_ == nullptr )
+	{
+		Log::Info( "Loopback is not created" );
+		return;
+	}
+
+	// Print stats since previous call.
+	loopback_buffer_->PrintStats();
+	loopback_buffer_->ResetStats();
+}
+
+void Host::RecordCommand( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Info( "Expected demo file name" );
+		return;
+	}
+
+	if( demo_player_ != nullptr )
+	{
+		Log::Info( "Can not record demo while playing demo" );
+		return;
+	}
+
+	// Start recording with next connection, because demo must contain all messages, since map start.
+	demo_record_file_name_= args.front();
+	Log::Info( "Demo \"", demo_record_file_name_, "\" will be recorded since next game start" );
+}
+
+void Host::StopDemoCommand()
+{
+	demo_record_file_name_.clear();
+
+	if( demo_recorder_ != nullptr )
+	{
+		// Recorder is still used by client as connection, so, just stop writing.
+		demo_recorder_->Stop();
+		demo_recorder_= nullptr;
+	}
+
+	if( demo_player_ != nullptr )
+	{
+		demo_player_= nullptr;
+		if( client_ != nullptr )
+			client_->SetConnection( nullptr );
+	}
+}
+
+void Host::PlayDemoCommand( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Info( "Expected demo file name" );
+		return;
+	}
+
+	DoPlayDemo( args.front().c_str(), false );
+}
+
+void Host::TimedemoCommand( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Info( "Expected demo file name" );
+		return;
+	}
+
+	DoPlayDemo( args.front().c_str(), true );
+}
+
 void Host::DoVidRestart()
 {
 	// Clear old resources.
@@ -585,11 +745,11 @@ void Host::DoRunLevel( const unsigned int map_number, const DifficultyType diffi
 		return;
 
 	// Making server listen connections from loopback buffer.
-	connections_listener_proxy_->AddConnectionsListener( loopback_buffer_ );
+	connections_listener_proxy_->AddConnectionsListener( network_simulator_.WrapConnectionsListener( loopback_buffer_ ) );
 	loopback_buffer_->RequestConnect();
 
 	// Make client working with loopback buffer connection.
-	client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+	client_->SetConnection( WrapClientConnection( loopback_buffer_->GetClientSideConnection() ) );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - singleplayer" );
@@ -649,11 +809,11 @@ void Host::DoLoad( const char* const save_file_name )
 	client_->Load( save_buffer, save_buffer_pos );
 
 	// Making server listen connections from loopback buffer.
-	connections_listener_proxy_->AddConnectionsListener( loopback_buffer_ );
+	connections_listener_proxy_->AddConnectionsListener( network_simulator_.WrapConnectionsListener( loopback_buffer_ ) );
 	loopback_buffer_->RequestConnect();
 
 	// Make client working with loopback buffer connection.
-	client_->SetConnection( loopback_buffer_->GetClientSideConnection() );
+	client_->SetConnection( WrapClientConnection( loopback_buffer_->GetClientSideConnection() ) );
 
 	if( system_window_ != nullptr )
 		system_window_->SetTitle( base_window_title_ + " - singleplayer" );
@@ -663,11 +823,30 @@ void Host::DoLoad( const char* const save_file_name )
 	Log::User( "Game loaded." );
 }
 
+void Host::DoPlayDemo( const char* const file_name, const bool timedemo )
+{
+	DemoPlayerPtr demo_player= DemoPlayer::Load( file_name, timedemo );
+	if( demo_player == nullptr )
+		return;
+
+	ClearBeforeGameStart();
+	demo_record_file_name_.clear();
+
+	EnsureClient();
+
+	demo_player_= std::move(demo_player);
+	client_->SetConnection( demo_player_ );
+}
+
 void Host::DrawLoadingFrame( const float progress, const char* const caption )
 {
 	// TODO - use this.
 	PC_UNUSED( caption );
 
+	// Server, working in own thread, can not draw.
+	if( std::this_thread::get_id() != main_thread_id_ )
+		return;
+
 	if( system_window_ != nullptr && shared_drawers_ != nullptr )
 	{
 		system_window_->BeginFrame();
@@ -718,6 +897,11 @@ void Host::EnsureServer()
 			map_loader_,
 			connections_listener_proxy_,
 			draw_loading_callback ) );
+
+	// Deterministic simulation settings.
+	local_server_->SetFixedTickRate( static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "sv_tick_rate", 0 ) ) ) );
+	local_server_->SetRandomSeed( static_cast<LongRand::RandResultType>( settings_.GetOrSetInt( "sv_random_seed", 0 ) ) );
+	local_server_->SetStateHashLogging( settings_.GetOrSetBool( "sv_log_state_hash", false ) );
 }
 
 void Host::EnsureLoopbackBuffer()
@@ -738,6 +922,44 @@ void Host::EnsureNet()
 	net_.reset( new Net() );
 }
 
+void Host::StartLocalServerThread()
+{
+	PC_ASSERT( local_server_ != nullptr );
+	PC_ASSERT( !local_server_thread_.joinable() );
+
+	const int loop_rate= std::max( 1, settings_.GetOrSetInt( "sv_thread_rate", 60 ) );
+	const Time tick_duration= Time::FromSeconds( 1.0f / float(loop_rate) );
+
+	Log::Info( "Start local server thread with rate ", loop_rate );
+	local_server_thread_quit_.store( false );
+	local_server_thread_= std::thread( &Host::LocalServerThreadFunc, this, tick_duration );
+}
+
+void Host::StopLocalServerThread()
+{
+	PC_ASSERT( local_server_thread_.joinable() );
+
+	local_server_thread_quit_.store( true );
+	local_server_thread_.join();
+
+	Log::Info( "Local server thread stopped" );
+}
+
+void Host::LocalServerThreadFunc( const Time tick_duration )
+{
+	TickScheduler scheduler( tick_duration, Time::FromSeconds( 1 << 30 ), "Local server" );
+
+	while( !local_server_thread_quit_.load() )
+	{
+		scheduler.BeginTick();
+		{
+			std::lock_guard<std::mutex> lock( local_server_mutex_ );
+			local_server_->Loop( local_server_paused_.load() );
+		}
+		scheduler.EndTick();
+	}
+}
+
 void Host::ClearBeforeGameStart()
 {
 	if( system_window_ != nullptr )
@@ -762,8 +984,40 @@ void Host::ClearBeforeGameStart()
 	if( menu_ != nullptr )
 		menu_->Deactivate();
 
+	// Finish demo recording or playback. Connection is already reset, so, demo file is written here.
+	demo_recorder_= nullptr;
+	demo_player_= nullptr;
+
 	is_single_player_= false;
 	paused_= false;
 }
 
+IConnectionPtr Host::WrapClientConnection( IConnectionPtr connection )
+{
+	connection= network_simulator_.WrapConnection( std::move(connection) );
+
+	if( !demo_record_file_name_.empty() )
+	{
+		// Record data after network simulation - exactly, what client gets.
+		demo_recorder_= DemoRecorder::Create( connection, demo_record_file_name_.c_str() );
+		demo_record_file_name_.clear();
+		if( demo_recorder_ != nullptr )
+			return demo_recorder_;
+	}
+
+	return connection;
+}
+
+void Host::UpdateNetworkConditions()
+{
+	NetworkConditions conditions;
+	conditions.latency_ms= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "net_sim_latency", 0 ) ) );
+	conditions.jitter_ms= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "net_sim_jitter", 0 ) ) );
+	conditions.loss_percent= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "net_sim_loss", 0 ) ) );
+	conditions.duplication_percent= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "net_sim_duplication", 0 ) ) );
+	conditions.bandwidth_kbps= static_cast<unsigned int>( std::max( 0, settings_.GetOrSetInt( "net_sim_bandwidth", 0 ) ) );
+
+	network_simulator_.SetConditions( conditions );
+}
+
 } // namespace PanzerChasm
@@ -1,5 +1,8 @@
 #pragma once
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "client/client.hpp"
 #include "commands_processor.hpp"
@@ -7,6 +10,7 @@
 #include "host_commands.hpp"
 #include "menu.hpp"
 #include "net/net.hpp"
+#include "network_simulator.hpp"
 #include "program_arguments.hpp"
 #include "server/server.hpp"
 #include "settings.hpp"
@@ -61,6 +65,13 @@ private:
 	void RunServerCommand( const CommandsArguments& args );
 	void SaveCommand( const CommandsArguments& args );
 	void LoadCommand( const CommandsArguments& args );
+	void NetStatsCommand();
+	void NetSimCommand();
+	void LoopbackStatsCommand();
+	void RecordCommand( const CommandsArguments& args );
+	void StopDemoCommand();
+	void PlayDemoCommand( const CommandsArguments& args );
+	void TimedemoCommand( const CommandsArguments& args );
 
 	void DoVidRestart();
 
@@ -75,8 +86,18 @@ private:
 	void EnsureLoopbackBuffer();
 	void EnsureNet();
 
+	void DoPlayDemo( const char* file_name, bool timedemo );
+	// Apply network simulation and demo recording to client connection.
+	IConnectionPtr WrapClientConnection( IConnectionPtr connection );
+
+	void StartLocalServerThread();
+	void StopLocalServerThread();
+	void LocalServerThreadFunc( Time tick_duration );
+
 	void ClearBeforeGameStart();
 
+	void UpdateNetworkConditions();
+
 private:
 	// Put members here in reverse deinitialization order.
 
@@ -93,6 +114,7 @@ private:
 	GameResourcesConstPtr game_resources_;
 
 	std::unique_ptr<Net> net_;
+	NetworkSimulator network_simulator_;
 
 	std::unique_ptr<SystemWindow> system_window_;
 	SystemEvents events_;
@@ -111,6 +133,18 @@ private:
 	std::unique_ptr<Server> local_server_;
 	std::unique_ptr<Client> client_;
 
+	std::string demo_record_file_name_; // Recording starts with next client connection.
+	DemoRecorderPtr demo_recorder_;
+	DemoPlayerPtr demo_player_;
+
+	// Local server may work in own thread, in parallel with client.
+	// Main thread may access server and its connections only under this mutex.
+	std::mutex local_server_mutex_;
+	std::thread local_server_thread_;
+	std::atomic<bool> local_server_thread_quit_;
+	std::atomic<bool> local_server_paused_;
+	const std::thread::id main_thread_id_;
+
 	std::string base_window_title_;
 	bool is_single_player_= false;
 	bool paused_= false;
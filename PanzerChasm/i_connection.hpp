@@ -11,14 +11,61 @@ public:
 	// Size of UDP packet, than can be safely transmited without framgentations.
 	static constexpr unsigned int c_max_unreliable_packet_size= 1400u;
 
+	struct UnreliablePacket
+	{
+		const void* data;
+		unsigned int size;
+	};
+
 	virtual ~IConnection(){}
 
 	virtual void SendReliablePacket( const void* data, unsigned int data_size )= 0;
 	virtual void SendUnreliablePacket( const void* data, unsigned int data_size )= 0;
 
+	// Send group of packets - for example, all packets of one tick. Connection may send them with one system call.
+	virtual void SendUnreliablePackets( const UnreliablePacket* const packets, const unsigned int packet_count )
+	{
+		for( unsigned int i= 0u; i < packet_count; i++ )
+			SendUnreliablePacket( packets[i].data, packets[i].size );
+	}
+
 	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size )= 0;
 	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size )= 0;
 
+	// Optional direct access to internal buffers of connection, for connections inside one process.
+	// Allows writing of messages directly into buffer of connection and processing them in place, without copying.
+
+	// Returns pointer to space for writing of one packet, or nullptr, if direct writing is not possible now.
+	// Written data must be commited with "EndDirectWrite" before any other sending call.
+	virtual unsigned char* BeginDirectWrite( bool reliable, unsigned int max_size )
+	{
+		(void)reliable;
+		(void)max_size;
+		return nullptr;
+	}
+
+	virtual void EndDirectWrite( bool reliable, unsigned int size )
+	{
+		(void)reliable;
+		(void)size;
+	}
+
+	// Returns false, if direct reading is not supported. Otherwise returns contiguous block of received data.
+	// Block contains only whole packets. Data is valid until "ConsumeReceivedData" call.
+	virtual bool PeekReceivedData( bool reliable, const unsigned char*& out_data, unsigned int& out_size )
+	{
+		(void)reliable;
+		out_data= nullptr;
+		out_size= 0u;
+		return false;
+	}
+
+	virtual void ConsumeReceivedData( bool reliable, unsigned int size )
+	{
+		(void)reliable;
+		(void)size;
+	}
+
 	virtual void Disconnect()= 0;
 	virtual bool Disconnected()= 0;
 
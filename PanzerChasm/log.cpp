@@ -1,5 +1,8 @@
+#ifndef PC_DEDICATED_SERVER
 #include <SDL_messagebox.h>
+#endif
 
+#include "assert.hpp"
 #include "log.hpp"
 
 namespace PanzerChasm
@@ -7,19 +10,26 @@ namespace PanzerChasm
 
 Log::LogCallback Log::log_callback_;
 std::ofstream Log::log_file_{ "panzer_chasm.log" };
+std::mutex Log::mutex_;
 
 void Log::SetLogCallback( LogCallback callback )
 {
+	std::lock_guard<std::mutex> lock( mutex_ );
 	log_callback_= std::move(callback);
 }
 
 void Log::ShowFatalMessageBox( const std::string& error_message )
 {
+#ifdef PC_DEDICATED_SERVER
+	// Dedicated server has no windows. Message is already printed to console and log file.
+	PC_UNUSED( error_message );
+#else
 	SDL_ShowSimpleMessageBox(
 		SDL_MESSAGEBOX_ERROR,
 		"Fatal error",
 		error_message.c_str(),
 		nullptr );
+#endif
 }
 
 } // namespace PanzerChasm
@@ -3,13 +3,14 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 namespace PanzerChasm
 {
 
 // Simple logger. You can write messages to it.
-// Not thread-safe.
+// Thread-safe, but log callback is called in thread of message writer.
 class Log
 {
 public:
@@ -53,6 +54,7 @@ private:
 private:
 	static LogCallback log_callback_;
 	static std::ofstream log_file_;
+	static std::mutex mutex_;
 };
 
 template<class...Args>
@@ -80,6 +82,7 @@ void Log::FatalError( const Args&... args )
 	Print( stream, args... );
 	const std::string str= stream.str();
 
+	std::lock_guard<std::mutex> lock( mutex_ );
 	std::cout << str << std::endl;
 	log_file_ << str << std::endl;
 	ShowFatalMessageBox( str );
@@ -101,6 +104,7 @@ void Log::PrinLine( const LogLevel log_level, const Args&... args )
 	Print( stream, args... );
 	const std::string str= stream.str();
 
+	std::lock_guard<std::mutex> lock( mutex_ );
 	std::cout << str << std::endl;
 	log_file_ << str << std::endl;
 
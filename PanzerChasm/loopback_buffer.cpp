@@ -1,13 +1,18 @@
+#include <algorithm>
 #include <cstring>
 
 #include "assert.hpp"
 #include "i_connection.hpp"
+#include "log.hpp"
 
 #include "loopback_buffer.hpp"
 
 namespace PanzerChasm
 {
 
+// Enough for many seconds of game traffic. Memory is not touched until it is used.
+static const unsigned int g_queue_capacity= 1024u * 1024u;
+
 class LoopbackBuffer::Connection final : public IConnection
 {
 public:
@@ -26,6 +31,11 @@ public: // IConnection
 	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
 	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
 
+	virtual unsigned char* BeginDirectWrite( bool reliable, unsigned int max_size ) override;
+	virtual void EndDirectWrite( bool reliable, unsigned int size ) override;
+	virtual bool PeekReceivedData( bool reliable, const unsigned char*& out_data, unsigned int& out_size ) override;
+	virtual void ConsumeReceivedData( bool reliable, unsigned int size ) override;
+
 	virtual void Disconnect() override;
 	virtual bool Disconnected() override;
 
@@ -37,7 +47,7 @@ private:
 	Queue& out_reliable_buffer_;
 	Queue& out_unreliable_buffer_;
 
-	bool disconnected_= false;
+	std::atomic<bool> disconnected_;
 };
 
 LoopbackBuffer::Connection::Connection(
@@ -49,6 +59,7 @@ LoopbackBuffer::Connection::Connection(
 	, in_unreliable_buffer_(in_unreliable_buffer)
 	, out_reliable_buffer_(out_reliable_buffer)
 	, out_unreliable_buffer_(out_unreliable_buffer)
+	, disconnected_(false)
 {}
 
 LoopbackBuffer::Connection::~Connection()
@@ -57,13 +68,19 @@ LoopbackBuffer::Connection::~Connection()
 void LoopbackBuffer::Connection::SendReliablePacket( const void *data, unsigned int data_size )
 {
 	if( disconnected_ ) return;
-	in_reliable_buffer_.PushBytes( data, data_size );
+
+	// Reliable data can not be dropped, so, break connection. Normally, this happens only if receiver hangs.
+	if( !in_reliable_buffer_.PushBytes( data, data_size ) )
+	{
+		Log::Warning( "Loopback reliable buffer overflow" );
+		disconnected_= true;
+	}
 }
 
 void LoopbackBuffer::Connection::SendUnreliablePacket( const void *data, unsigned int data_size )
 {
 	if( disconnected_ ) return;
-	in_unreliable_buffer_.PushBytes( data, data_size );
+	in_unreliable_buffer_.PushBytes( data, data_size ); // Drop packet, if there is no space, like UDP does.
 }
 
 unsigned int LoopbackBuffer::Connection::ReadRealiableData( void* out_data, unsigned int buffer_size )
@@ -84,6 +101,36 @@ unsigned int LoopbackBuffer::Connection::ReadUnrealiableData( void* out_data, un
 	return result_size;
 }
 
+unsigned char* LoopbackBuffer::Connection::BeginDirectWrite( const bool reliable, const unsigned int max_size )
+{
+	if( disconnected_ ) return nullptr;
+	return ( reliable ? in_reliable_buffer_ : in_unreliable_buffer_ ).BeginWrite( max_size );
+}
+
+void LoopbackBuffer::Connection::EndDirectWrite( const bool reliable, const unsigned int size )
+{
+	( reliable ? in_reliable_buffer_ : in_unreliable_buffer_ ).EndWrite( size );
+}
+
+bool LoopbackBuffer::Connection::PeekReceivedData( const bool reliable, const unsigned char*& out_data, unsigned int& out_size )
+{
+	if( disconnected_ )
+	{
+		out_data= nullptr;
+		out_size= 0u;
+		return true;
+	}
+
+	out_size= ( reliable ? out_reliable_buffer_ : out_unreliable_buffer_ ).Peek( out_data );
+	return true;
+}
+
+void LoopbackBuffer::Connection::ConsumeReceivedData( const bool reliable, const unsigned int size )
+{
+	if( disconnected_ ) return;
+	( reliable ? out_reliable_buffer_ : out_unreliable_buffer_ ).Consume( size );
+}
+
 void LoopbackBuffer::Connection::Disconnect()
 {
 	disconnected_= true;
@@ -99,66 +146,194 @@ std::string LoopbackBuffer::Connection::GetConnectionInfo()
 	return "loopback";
 }
 
-LoopbackBuffer::Queue::Queue()
-	: pos_(0u)
+LoopbackBuffer::Queue::Queue( const unsigned int capacity )
+	: capacity_(capacity)
+	, buffer_( new unsigned char[ capacity ] )
+	, write_pos_(0u), watermark_(0u), read_pos_(0u)
+	, copied_bytes_(0u), direct_written_bytes_(0u), direct_read_bytes_(0u), overflows_(0u)
 {}
 
 LoopbackBuffer::Queue::~Queue()
 {}
 
-unsigned int LoopbackBuffer::Queue::Size() const
+bool LoopbackBuffer::Queue::PushBytes( const void* const data, const unsigned int data_size )
 {
-	return buffer_.size() - pos_;
+	unsigned char* const dst= Reserve( data_size );
+	if( dst == nullptr )
+		return false;
+
+	std::memcpy( dst, data, data_size );
+	Commit( data_size );
+
+	copied_bytes_.fetch_add( data_size, std::memory_order_relaxed );
+	return true;
 }
 
-void LoopbackBuffer::Queue::Clear()
+unsigned char* LoopbackBuffer::Queue::BeginWrite( const unsigned int max_size )
 {
-	buffer_.clear();
-	pos_= 0u;
+	return Reserve( max_size );
 }
 
-void LoopbackBuffer::Queue::PushBytes( const void* data, const unsigned int data_size )
+void LoopbackBuffer::Queue::EndWrite( const unsigned int size )
 {
-	buffer_.insert(
-		buffer_.end(),
-		static_cast<const unsigned char*>(data),
-		static_cast<const unsigned char*>(data) + data_size );
+	Commit( size );
+	direct_written_bytes_.fetch_add( size, std::memory_order_relaxed );
 }
 
-void LoopbackBuffer::Queue::PopBytes( void* out_data, const unsigned int data_size )
+unsigned int LoopbackBuffer::Queue::Size() const
+{
+	const unsigned int write_pos= write_pos_.load( std::memory_order_acquire );
+	const unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+	if( write_pos >= read_pos )
+		return write_pos - read_pos;
+	return watermark_.load( std::memory_order_relaxed ) - read_pos + write_pos;
+}
+
+void LoopbackBuffer::Queue::PopBytes( void* const out_data, const unsigned int data_size )
 {
 	PC_ASSERT( data_size <= Size() );
 
-	std::memcpy(
-		out_data,
-		buffer_.data() + pos_,
-		data_size );
+	unsigned int bytes_left= data_size;
+	unsigned char* dst= static_cast<unsigned char*>(out_data);
+	while( bytes_left > 0u )
+	{
+		const unsigned char* src;
+		const unsigned int chunk_size= std::min( bytes_left, Peek( src ) );
+		std::memcpy( dst, src, chunk_size );
+		Skip( chunk_size );
+
+		dst+= chunk_size;
+		bytes_left-= chunk_size;
+	}
+
+	copied_bytes_.fetch_add( data_size, std::memory_order_relaxed );
+}
+
+unsigned int LoopbackBuffer::Queue::Peek( const unsigned char*& out_data )
+{
+	const unsigned int write_pos= write_pos_.load( std::memory_order_acquire );
+	unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+
+	if( write_pos < read_pos )
+	{
+		// Producer wrapped. Read data before watermark, than jump to buffer start.
+		const unsigned int watermark= watermark_.load( std::memory_order_relaxed );
+		if( read_pos < watermark )
+		{
+			out_data= buffer_.get() + read_pos;
+			return watermark - read_pos;
+		}
+
+		read_pos= 0u;
+		read_pos_.store( read_pos, std::memory_order_release );
+	}
+
+	out_data= buffer_.get() + read_pos;
+	return write_pos - read_pos;
+}
+
+void LoopbackBuffer::Queue::Consume( const unsigned int size )
+{
+	Skip( size );
+	direct_read_bytes_.fetch_add( size, std::memory_order_relaxed );
+}
+
+void LoopbackBuffer::Queue::Clear()
+{
+	PC_ASSERT( !writing_ );
 
-	pos_+= data_size;
+	write_pos_.store( 0u );
+	watermark_.store( 0u );
+	read_pos_.store( 0u );
+}
+
+LoopbackBuffer::Stats LoopbackBuffer::Queue::GetStats() const
+{
+	Stats stats;
+	stats.copied_bytes= copied_bytes_.load( std::memory_order_relaxed );
+	stats.direct_written_bytes= direct_written_bytes_.load( std::memory_order_relaxed );
+	stats.direct_read_bytes= direct_read_bytes_.load( std::memory_order_relaxed );
+	stats.overflows= overflows_.load( std::memory_order_relaxed );
+	return stats;
+}
 
-	TryShrink();
+void LoopbackBuffer::Queue::ResetStats()
+{
+	copied_bytes_.store( 0u, std::memory_order_relaxed );
+	direct_written_bytes_.store( 0u, std::memory_order_relaxed );
+	direct_read_bytes_.store( 0u, std::memory_order_relaxed );
+	overflows_.store( 0u, std::memory_order_relaxed );
 }
 
-void LoopbackBuffer::Queue::TryShrink()
+unsigned char* LoopbackBuffer::Queue::Reserve( const unsigned int max_size )
 {
-	// Some magic constants here.
-	const unsigned int c_min_buffer_size_to_shrink= 64u;
-	const unsigned int c_rate_mult= 16u;
+	PC_ASSERT( !writing_ );
+	PC_ASSERT( max_size < capacity_ );
 
-	if( buffer_.size() < c_min_buffer_size_to_shrink )
-		return;
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	// Acquire - consumer must finish reading of data, before we overwrite it.
+	const unsigned int read_pos= read_pos_.load( std::memory_order_acquire );
 
-	if( Size() * c_rate_mult < buffer_.size() )
+	// Write position must not reach read position after writing - equal positions mean empty queue.
+	if( write_pos >= read_pos )
 	{
-		buffer_.erase( buffer_.begin(), buffer_.begin() + pos_ );
-		pos_= 0u;
+		if( capacity_ - write_pos >= max_size )
+			reserved_pos_= write_pos;
+		else if( read_pos > max_size )
+			reserved_pos_= 0u; // Wrap.
+		else
+		{
+			overflows_.fetch_add( 1u, std::memory_order_relaxed );
+			return nullptr;
+		}
 	}
+	else
+	{
+		if( read_pos - write_pos > max_size )
+			reserved_pos_= write_pos;
+		else
+		{
+			overflows_.fetch_add( 1u, std::memory_order_relaxed );
+			return nullptr;
+		}
+	}
+
+	writing_= true;
+	reserved_size_= max_size;
+	return buffer_.get() + reserved_pos_;
 }
 
-LoopbackBuffer::LoopbackBuffer()
+void LoopbackBuffer::Queue::Commit( const unsigned int size )
+{
+	PC_ASSERT( writing_ );
+	PC_ASSERT( size <= reserved_size_ );
+	writing_= false;
+
+	const unsigned int write_pos= write_pos_.load( std::memory_order_relaxed );
+	if( reserved_pos_ != write_pos )
+	{
+		// Wrapped. Release store of write position publishes watermark too.
+		watermark_.store( write_pos, std::memory_order_relaxed );
+		write_pos_.store( size, std::memory_order_release );
+	}
+	else
+		write_pos_.store( write_pos + size, std::memory_order_release );
+}
+
+void LoopbackBuffer::Queue::Skip( const unsigned int size )
 {
+	const unsigned int read_pos= read_pos_.load( std::memory_order_relaxed );
+	// Release - producer may overwrite data only after we finish reading.
+	read_pos_.store( read_pos + size, std::memory_order_release );
 }
 
+LoopbackBuffer::LoopbackBuffer()
+	: client_to_server_reliable_buffer_( g_queue_capacity )
+	, client_to_server_unreliable_buffer_( g_queue_capacity )
+	, server_to_client_reliable_buffer_( g_queue_capacity )
+	, server_to_client_unreliable_buffer_( g_queue_capacity )
+{}
+
 LoopbackBuffer::~LoopbackBuffer()
 {
 	RequestDisconnect();
@@ -212,6 +387,52 @@ IConnectionPtr LoopbackBuffer::GetClientSideConnection()
 	return client_side_connection_;
 }
 
+void LoopbackBuffer::CountFrame()
+{
+	stats_frames_++;
+}
+
+void LoopbackBuffer::PrintStats() const
+{
+	const Queue* const queues[]=
+	{
+		&client_to_server_reliable_buffer_,
+		&client_to_server_unreliable_buffer_,
+		&server_to_client_reliable_buffer_,
+		&server_to_client_unreliable_buffer_,
+	};
+	const char* const queues_names[]=
+	{
+		"client to server reliable",
+		"client to server unreliable",
+		"server to client reliable",
+		"server to client unreliable",
+	};
+
+	const unsigned int frames= std::max( stats_frames_, 1u );
+
+	Log::Info( "Loopback stats for ", stats_frames_, " frames:" );
+	for( unsigned int i= 0u; i < 4u; i++ )
+	{
+		const Stats stats= queues[i]->GetStats();
+		Log::Info(
+			queues_names[i], ": ",
+			"copied ", stats.copied_bytes, " (", stats.copied_bytes / frames, " per frame), ",
+			"direct written ", stats.direct_written_bytes, " (", stats.direct_written_bytes / frames, " per frame), ",
+			"direct read ", stats.direct_read_bytes, " (", stats.direct_read_bytes / frames, " per frame), ",
+			"overflows ", stats.overflows );
+	}
+}
+
+void LoopbackBuffer::ResetStats()
+{
+	client_to_server_reliable_buffer_.ResetStats();
+	client_to_server_unreliable_buffer_.ResetStats();
+	server_to_client_reliable_buffer_.ResetStats();
+	server_to_client_unreliable_buffer_.ResetStats();
+	stats_frames_= 0u;
+}
+
 IConnectionPtr LoopbackBuffer::GetNewConnection()
 {
 	if( state_ == State::WaitingForConnection )
@@ -1,13 +1,27 @@
 #pragma once
-#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 
 #include "server/i_connections_listener.hpp"
 
 namespace PanzerChasm
 {
 
+// Connection between client and server inside one process.
+// Supports direct access to its buffers, so, messages are encoded directly into buffer by sender and processed in place by receiver.
+// Client and server may work in different threads. Connect and disconnect only when server thread does not use connection.
 class LoopbackBuffer final : public IConnectionsListener
 {
+public:
+	struct Stats
+	{
+		uint64_t copied_bytes= 0u; // Copied into queues or out of queues.
+		uint64_t direct_written_bytes= 0u;
+		uint64_t direct_read_bytes= 0u;
+		uint64_t overflows= 0u; // Writes, failed because of lack of space.
+	};
+
 public:
 	LoopbackBuffer();
 	virtual ~LoopbackBuffer() override;
@@ -17,30 +31,66 @@ public:
 
 	IConnectionPtr GetClientSideConnection();
 
+	// Call it once per frame, for calculation of average values.
+	void CountFrame();
+	void PrintStats() const;
+	void ResetStats();
+
 public: // IConnectionsListener
 	virtual IConnectionPtr GetNewConnection() override;
 
 private:
 	class Connection;
 
+	// Lock-free ring buffer for one producer thread and one consumer thread.
+	// Each written block is contiguous. If block does not fit into buffer end, it is written at buffer start,
+	// and end of data before wrapping is marked with watermark.
 	class Queue final
 	{
 	public:
-		Queue();
+		explicit Queue( unsigned int capacity );
 		~Queue();
 
+		// Producer methods. Return false or nullptr, if there is no space.
+		bool PushBytes( const void* data, unsigned int data_size );
+		unsigned char* BeginWrite( unsigned int max_size );
+		void EndWrite( unsigned int size );
+
+		// Consumer methods.
 		unsigned int Size() const;
+		void PopBytes( void* out_data, unsigned int data_size );
+		// Returns contiguous block of data from queue start.
+		unsigned int Peek( const unsigned char*& out_data );
+		void Consume( unsigned int size );
+
+		// Call it only when producer and consumer do not use queue.
 		void Clear();
 
-		void PushBytes( const void* data, unsigned int data_size );
-		void PopBytes( void* out_data, unsigned int data_size );
+		Stats GetStats() const;
+		void ResetStats();
 
 	private:
-		void TryShrink();
+		unsigned char* Reserve( unsigned int max_size );
+		void Commit( unsigned int size );
+		void Skip( unsigned int size );
 
 	private:
-		std::vector<unsigned char> buffer_;
-		unsigned int pos_;
+		const unsigned int capacity_;
+		const std::unique_ptr<unsigned char[]> buffer_;
+
+		std::atomic<unsigned int> write_pos_; // Written by producer.
+		std::atomic<unsigned int> watermark_; // Written by producer. Valid, if write position is less, than read position.
+		std::atomic<unsigned int> read_pos_; // Written by consumer.
+
+		// Producer state.
+		unsigned int reserved_pos_= 0u;
+		unsigned int reserved_size_= 0u;
+		bool writing_= false; // Between "Reserve" and "Commit".
+
+		std::atomic<uint64_t> copied_bytes_;
+		std::atomic<uint64_t> direct_written_bytes_;
+		std::atomic<uint64_t> direct_read_bytes_;
+		std::atomic<uint64_t> overflows_;
 	};
 
 	enum class State
@@ -61,6 +111,8 @@ private:
 
 	Queue server_to_client_reliable_buffer_;
 	Queue server_to_client_unreliable_buffer_;
+
+	unsigned int stats_frames_= 0u;
 };
 
 } // namespace PanzerChasm
@@ -178,9 +178,21 @@ MapDataConstPtr MapLoader::LoadMap( const unsigned int map_number )
 	if( map_number >= 100 )
 		return nullptr;
 
+	std::lock_guard<std::mutex> lock( mutex_ );
+
 	if( last_loaded_map_ != nullptr && last_loaded_map_->number == map_number )
 		return last_loaded_map_;
 
+	const auto it= loaded_maps_.find( map_number );
+	if( it != loaded_maps_.end() )
+	{
+		if( const MapDataConstPtr map_data= it->second.lock() )
+		{
+			last_loaded_map_= map_data;
+			return map_data;
+		}
+	}
+
 	Log::Info( "Loading map ", map_number );
 
 	char level_path[ MapData::c_max_file_path_size ];
@@ -246,14 +258,19 @@ MapDataConstPtr MapLoader::LoadMap( const unsigned int map_number )
 
 	LoadModels( *result );
 
+	BuildLinksIndex( *result );
+
 	// Cache result and return it.
 	result->number= map_number;
 	last_loaded_map_= result;
+	loaded_maps_[ map_number ]= result;
 	return result;
 }
 
 MapLoader::MapInfo MapLoader::GetNextMapInfo( unsigned int map_number )
 {
+	std::lock_guard<std::mutex> lock( mutex_ );
+
 	MapInfo result;
 
 	// TODO - check if there are no maps?
@@ -270,6 +287,8 @@ MapLoader::MapInfo MapLoader::GetNextMapInfo( unsigned int map_number )
 
 MapLoader::MapInfo MapLoader::GetPrevMapInfo( unsigned int map_number )
 {
+	std::lock_guard<std::mutex> lock( mutex_ );
+
 	MapInfo result;
 
 	// TODO - check if there are no maps?
@@ -1005,6 +1024,78 @@ void MapLoader::MarkDynamicWalls( const MapData& map_data, DynamicWallsMask& out
 	} // for procedures
 }
 
+void MapLoader::BuildLinksIndex( MapData& map_data )
+{
+	const auto get_link_element=
+	[&]( const MapData::Link& link ) -> const MapData::IndexElement*
+	{
+		if( link.x >= MapData::c_map_size || link.y >= MapData::c_map_size )
+			return nullptr;
+
+		const MapData::IndexElement& element= map_data.map_index[ link.x + link.y * MapData::c_map_size ];
+		if( element.type == MapData::IndexElement::None )
+			return nullptr;
+		return &element;
+	};
+
+	// Count links for each element.
+	for( std::vector<unsigned int>& offsets : map_data.elements_links_offsets )
+		offsets.clear();
+
+	for( const MapData::Link& link : map_data.links )
+	{
+		const MapData::IndexElement* const element= get_link_element( link );
+		if( element == nullptr )
+			continue;
+
+		std::vector<unsigned int>& offsets= map_data.elements_links_offsets[ element->type ];
+		if( offsets.size() < element->index + 2u )
+			offsets.resize( element->index + 2u, 0u );
+		offsets[ element->index + 1u ]++;
+	}
+
+	// Convert counts to offsets.
+	for( std::vector<unsigned int>& offsets : map_data.elements_links_offsets )
+	{
+		for( unsigned int i= 1u; i < offsets.size(); i++ )
+			offsets[i]+= offsets[i - 1u];
+	}
+
+	// Fill links. Keep order of links for each element same, as in links list.
+	unsigned int total_links= 0u;
+	for( const std::vector<unsigned int>& offsets : map_data.elements_links_offsets )
+	{
+		if( !offsets.empty() )
+			total_links+= offsets.back();
+	}
+	map_data.elements_links.resize( total_links );
+
+	// Offsets are in separate ranges for each type, so, shift it.
+	unsigned int type_base= 0u;
+	for( std::vector<unsigned int>& offsets : map_data.elements_links_offsets )
+	{
+		const unsigned int type_links= offsets.empty() ? 0u : offsets.back();
+		for( unsigned int& offset : offsets )
+			offset+= type_base;
+		type_base+= type_links;
+	}
+
+	std::vector<unsigned int> fill_positions[ MapData::IndexElement::Item + 1u ];
+	for( unsigned int t= 0u; t <= MapData::IndexElement::Item; t++ )
+		fill_positions[t]= map_data.elements_links_offsets[t];
+
+	for( const MapData::Link& link : map_data.links )
+	{
+		const MapData::IndexElement* const element= get_link_element( link );
+		if( element == nullptr )
+			continue;
+
+		unsigned int& fill_position= fill_positions[ element->type ][ element->index ];
+		map_data.elements_links[ fill_position ]= static_cast<unsigned short>( &link - map_data.links.data() );
+		fill_position++;
+	}
+}
+
 void MapLoader::LoadModels( MapData& map_data )
 {
 	Log::Info( "Loading map models" );
@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 #include <vec.hpp>
 
@@ -268,6 +270,12 @@ public:
 	std::vector<Link> links;
 	std::vector<Teleport> teleports;
 
+	// Reverse index for links, built after loading of links and map index.
+	// Links of element with type "t" and index "i" are links[ elements_links[j] ],
+	// where j in range [ elements_links_offsets[t][i]; elements_links_offsets[t][i+1] ).
+	std::vector<unsigned short> elements_links;
+	std::vector<unsigned int> elements_links_offsets[ IndexElement::Item + 1u ];
+
 	char map_name[ c_max_map_name_size ];
 	char sky_texture_name[ c_max_file_path_size ];
 
@@ -292,6 +300,7 @@ public:
 	unsigned char floor_textures_data[ c_floors_textures_count ][ c_floor_texture_size * c_floor_texture_size ];
 };
 
+// Thread-safe. Can be shared between many servers.
 class MapLoader final
 {
 public:
@@ -337,6 +346,7 @@ private:
 	void LoadTeleports( std::istringstream& stream, MapData& map_data );
 
 	void MarkDynamicWalls( const MapData& map_data, DynamicWallsMask& out_dynamic_walls );
+	void BuildLinksIndex( MapData& map_data );
 
 	void LoadModels( MapData& map_data );
 
@@ -346,7 +356,11 @@ private:
 private:
 	const VfsPtr vfs_;
 
+	std::mutex mutex_;
+
 	MapDataConstPtr last_loaded_map_;
+	// All maps, which are still alive. Used for sharing of same map data between many maps instances.
+	std::unordered_map< unsigned int, std::weak_ptr<const MapData> > loaded_maps_;
 
 	char textures_path_[ MapData::c_max_file_name_size ];
 	char models_path_[ MapData::c_max_file_name_size ];
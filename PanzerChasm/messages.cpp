@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstring>
 
 #include "math_utils.hpp"
 
@@ -51,4 +52,125 @@ float MessageAngleToAngle( const Messages::AngleType angle )
 	return float(angle) / 65536.0f * Constants::two_pi;
 }
 
+bool IsVariableSizeMessage( const MessageId message_id )
+{
+	return message_id == MessageId::MonsterStateDelta;
+}
+
+const char* GetMessageName( const MessageId message_id )
+{
+	static const char* const c_names[ size_t(MessageId::NumMessages) ]=
+	{
+		"Unknown",
+
+		#define MESSAGE_FUNC(x) #x,
+		#include "messages_list.h"
+		#undef MESSAGE_FUNC
+	};
+
+	if( message_id >= MessageId::NumMessages )
+		return "Invalid";
+	return c_names[ size_t(message_id) ];
+}
+
+static unsigned char GetMonsterStateFlags( const Messages::MonsterState& state )
+{
+	return
+		( state.is_fully_dead ? 1u : 0u ) |
+		( state.is_invisible ? 2u : 0u ) |
+		( ( state.color & 15u ) << 2u );
+}
+
+unsigned char GetMonsterStateChangedFields( const Messages::MonsterState& state0, const Messages::MonsterState& state1 )
+{
+	unsigned char mask= 0u;
+
+	if( state0.xyz[0] != state1.xyz[0] || state0.xyz[1] != state1.xyz[1] || state0.xyz[2] != state1.xyz[2] )
+		mask|= Messages::MonsterStateDelta::Position;
+	if( state0.angle != state1.angle )
+		mask|= Messages::MonsterStateDelta::Angle;
+	if( state0.monster_type != state1.monster_type )
+		mask|= Messages::MonsterStateDelta::MonsterType;
+	if( state0.body_parts_mask != state1.body_parts_mask )
+		mask|= Messages::MonsterStateDelta::BodyPartsMask;
+	if( state0.animation != state1.animation )
+		mask|= Messages::MonsterStateDelta::Animation;
+	if( state0.animation_frame != state1.animation_frame )
+		mask|= Messages::MonsterStateDelta::AnimationFrame;
+	if( GetMonsterStateFlags( state0 ) != GetMonsterStateFlags( state1 ) )
+		mask|= Messages::MonsterStateDelta::Flags;
+
+	return mask;
+}
+
+void PackMonsterStateDelta( const Messages::MonsterState& state, const unsigned char fields_mask, Messages::MonsterStateDelta& out_delta )
+{
+	typedef Messages::MonsterStateDelta Delta;
+
+	out_delta.monster_id= state.monster_id;
+	out_delta.fields_mask= fields_mask & Delta::AllFields;
+
+	unsigned char* data= out_delta.fields_data;
+	const auto write=
+	[&]( const Delta::Field field, const void* const field_data, const unsigned int size )
+	{
+		if( ( fields_mask & field ) == 0u )
+			return;
+		std::memcpy( data, field_data, size );
+		data+= size;
+	};
+
+	const unsigned char flags= GetMonsterStateFlags( state );
+
+	write( Delta::Position, state.xyz, sizeof(state.xyz) );
+	write( Delta::Angle, &state.angle, sizeof(state.angle) );
+	write( Delta::MonsterType, &state.monster_type, sizeof(state.monster_type) );
+	write( Delta::BodyPartsMask, &state.body_parts_mask, sizeof(state.body_parts_mask) );
+	write( Delta::Animation, &state.animation, sizeof(state.animation) );
+	write( Delta::AnimationFrame, &state.animation_frame, sizeof(state.animation_frame) );
+	write( Delta::Flags, &flags, sizeof(flags) );
+
+	out_delta.message_size= static_cast<unsigned char>( data - reinterpret_cast<unsigned char*>(&out_delta) );
+}
+
+bool UnpackMonsterStateDelta( const Messages::MonsterStateDelta& delta, Messages::MonsterState& state )
+{
+	typedef Messages::MonsterStateDelta Delta;
+
+	const unsigned char* data= delta.fields_data;
+	const unsigned char* const data_end= reinterpret_cast<const unsigned char*>(&delta) + delta.message_size;
+	bool ok= true;
+
+	const auto read=
+	[&]( const Delta::Field field, void* const field_data, const unsigned int size )
+	{
+		if( ( delta.fields_mask & field ) == 0u )
+			return;
+		if( data + size > data_end )
+		{
+			ok= false;
+			return;
+		}
+		std::memcpy( field_data, data, size );
+		data+= size;
+	};
+
+	unsigned char flags= GetMonsterStateFlags( state );
+
+	read( Delta::Position, state.xyz, sizeof(state.xyz) );
+	read( Delta::Angle, &state.angle, sizeof(state.angle) );
+	read( Delta::MonsterType, &state.monster_type, sizeof(state.monster_type) );
+	read( Delta::BodyPartsMask, &state.body_parts_mask, sizeof(state.body_parts_mask) );
+	read( Delta::Animation, &state.animation, sizeof(state.animation) );
+	read( Delta::AnimationFrame, &state.animation_frame, sizeof(state.animation_frame) );
+	read( Delta::Flags, &flags, sizeof(flags) );
+
+	state.monster_id= delta.monster_id;
+	state.is_fully_dead= ( flags & 1u ) != 0u;
+	state.is_invisible= ( flags & 2u ) != 0u;
+	state.color= ( flags >> 2u ) & 15u;
+
+	return ok && data == data_end;
+}
+
 } // namespace PanzerChasm
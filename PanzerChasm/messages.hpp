@@ -24,7 +24,7 @@ enum class MessageId : unsigned char
 namespace Messages
 {
 
-constexpr unsigned int c_protocol_version= 106u; // Increment each time, when protocol changed.
+constexpr unsigned int c_protocol_version= 116u; // Increment each time, when protocol changed.
 
 typedef short CoordType;
 typedef unsigned short AngleType;
@@ -52,9 +52,12 @@ struct ServerState : public MessageBase
 	DEFINE_MESSAGE_CONSTRUCTOR(ServerState)
 
 	unsigned char frags[ GameConstants::max_players ];
-	unsigned short map_time_s;
+	unsigned int map_time_ms; // Server time of last map tick.
 	unsigned char player_count;
 	GameRules game_rules;
+	unsigned short tick_number; // Low bits of number of map ticks since map start.
+	unsigned short update_number; // Low bits of number of updates, sent by server.
+	unsigned short reliable_update_number; // "update_number" of last "ReliableUpdateMark", sent to this client.
 };
 
 struct MonsterState : public MessageBase
@@ -73,6 +76,30 @@ struct MonsterState : public MessageBase
 	unsigned char color : 4; // For players only.
 };
 
+// Variable size message. Contains only fields of "MonsterState", which are changed since state, known by client.
+// Fields are packed one after another, in order of mask bits. Real size of message is in "message_size" field.
+struct MonsterStateDelta : public MessageBase
+{
+	DEFINE_MESSAGE_CONSTRUCTOR(MonsterStateDelta)
+
+	enum Field : unsigned char
+	{
+		Position= 1u << 0u, // xyz
+		Angle= 1u << 1u,
+		MonsterType= 1u << 2u,
+		BodyPartsMask= 1u << 3u,
+		Animation= 1u << 4u,
+		AnimationFrame= 1u << 5u,
+		Flags= 1u << 6u, // is_fully_dead, is_invisible, color - in one byte.
+		AllFields= ( 1u << 7u ) - 1u,
+	};
+
+	unsigned char message_size;
+	EntityId monster_id;
+	unsigned char fields_mask;
+	unsigned char fields_data[15u];
+};
+
 struct WallPosition : public MessageBase
 {
 	DEFINE_MESSAGE_CONSTRUCTOR(WallPosition)
@@ -97,7 +124,9 @@ struct PlayerPosition : public MessageBase
 	DEFINE_MESSAGE_CONSTRUCTOR(PlayerPosition)
 
 	CoordType xyz[3];
-	CoordType speed; // Units/s
+	CoordType speed[3]; // Units/s
+	bool on_floor;
+	unsigned short acknowledged_move_number; // "move_number" of last PlayerMove message, applied before building of this position.
 };
 
 struct PlayerState : public MessageBase
@@ -119,6 +148,7 @@ struct PlayerState : public MessageBase
 	bool is_invisible : 1;
 	bool show_shield : 1;
 	bool show_chojin : 1;
+	bool noclip : 1;
 };
 
 struct PlayerWeapon : public MessageBase
@@ -327,6 +357,15 @@ struct MonsterDeath : public MessageBase
 	EntityId monster_id;
 };
 
+// Sent after reliable messages of update, if there are any.
+// Client acknowledges update only if it has received reliable messages of this update and of all previous updates.
+struct ReliableUpdateMark : public MessageBase
+{
+	DEFINE_MESSAGE_CONSTRUCTOR(ReliableUpdateMark)
+
+	unsigned short update_number;
+};
+
 struct TextMessage : public MessageBase
 {
 	DEFINE_MESSAGE_CONSTRUCTOR(TextMessage)
@@ -354,6 +393,9 @@ struct PlayerMove : public MessageBase
 	bool shoot_pressed : 1;
 	bool jump_pressed : 1;
 	unsigned char color : 4;
+	unsigned short acknowledged_tick_number; // "tick_number" from last received ServerState message.
+	unsigned short acknowledged_update_number; // "update_number" from last received ServerState message.
+	unsigned short move_number; // Sequence number of move message, used by client-side prediction.
 };
 
 // Client to server. Transmited, when client renamed.
@@ -381,4 +423,16 @@ void MessagePositionToPosition( const Messages::CoordType* pos, m_Vec3& out_pos
 Messages::AngleType AngleToMessageAngle( float angle );
 float MessageAngleToAngle( Messages::AngleType angle );
 
+// Variable size messages have size in byte after message id.
+bool IsVariableSizeMessage( MessageId message_id );
+
+const char* GetMessageName( MessageId message_id );
+
+// Returns mask of "MonsterStateDelta" fields, which are different in two states.
+unsigned char GetMonsterStateChangedFields( const Messages::MonsterState& state0, const Messages::MonsterState& state1 );
+// Writes fields from mask. Sets size of message.
+void PackMonsterStateDelta( const Messages::MonsterState& state, unsigned char fields_mask, Messages::MonsterStateDelta& out_delta );
+// Writes fields from delta into state. Returns false, if delta is broken.
+bool UnpackMonsterStateDelta( const Messages::MonsterStateDelta& delta, Messages::MonsterState& state );
+
 } // namespace PanzerChasm
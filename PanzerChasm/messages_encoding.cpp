@@ -0,0 +1,352 @@
+#include "game_constants.hpp"
+#include "map_loader.hpp"
+
+#include "messages_encoding.hpp"
+
+namespace PanzerChasm
+{
+
+// Message coordinates are fixed point 8.8 values.
+static const unsigned int g_coord_fraction_bits= 8u;
+// Coordinates inside map bounds are written with less bits.
+static const unsigned int g_coord_xy_bits= MapData::c_map_size_log2 + g_coord_fraction_bits;
+static const unsigned int g_coord_z_bits= 2u + g_coord_fraction_bits; // [0; 4) - enough for walls height and jumps.
+static_assert( GameConstants::walls_height < 4.0f, "Too low z coordinate bits" );
+
+// Speed in range [-16; 16) - enough for maximum player speed.
+static const unsigned int g_speed_bits= 5u + g_coord_fraction_bits;
+
+// Angles are quantized. 4096 directions are enough for drawing.
+static const unsigned int g_angle_bits= 12u;
+static const unsigned int g_angle_shift= 16u - g_angle_bits;
+
+static const unsigned int g_entity_id_group_bits= 7u;
+
+BitWriter::BitWriter( unsigned char* const data, const unsigned int capacity )
+	: data_(data), capacity_(capacity)
+{}
+
+void BitWriter::WriteBits( const uint32_t value, const unsigned int bit_count )
+{
+	PC_ASSERT( bit_count <= 32u );
+
+	const uint64_t mask= ( uint64_t(1u) << bit_count ) - 1u;
+	accumulator_|= ( uint64_t(value) & mask ) << accumulator_bits_;
+	accumulator_bits_+= bit_count;
+
+	while( accumulator_bits_ >= 8u )
+	{
+		PC_ASSERT( pos_ < capacity_ );
+		data_[pos_]= static_cast<unsigned char>( accumulator_ & 0xFFu );
+		pos_++;
+		accumulator_>>= 8u;
+		accumulator_bits_-= 8u;
+	}
+}
+
+void BitWriter::WriteBool( const bool value )
+{
+	WriteBits( value ? 1u : 0u, 1u );
+}
+
+void BitWriter::WriteVarUInt( uint32_t value, const unsigned int group_bits )
+{
+	while(1)
+	{
+		WriteBits( value, group_bits );
+		value>>= group_bits;
+		WriteBool( value != 0u );
+		if( value == 0u )
+			break;
+	}
+}
+
+void BitWriter::WriteRangedShort( const short value, const int min_value, const unsigned int bit_count )
+{
+	const int offset= int(value) - min_value;
+	if( offset >= 0 && offset < ( 1 << bit_count ) )
+	{
+		WriteBool( false );
+		WriteBits( static_cast<uint32_t>(offset), bit_count );
+	}
+	else
+	{
+		WriteBool( true );
+		WriteBits( static_cast<uint16_t>(value), 16u );
+	}
+}
+
+unsigned int BitWriter::Finish()
+{
+	if( accumulator_bits_ > 0u )
+		WriteBits( 0u, 8u - accumulator_bits_ );
+	return pos_;
+}
+
+BitReader::BitReader( const unsigned char* const data, const unsigned int size )
+	: data_(data), size_(size)
+{}
+
+uint32_t BitReader::ReadBits( const unsigned int bit_count )
+{
+	PC_ASSERT( bit_count <= 32u );
+
+	while( accumulator_bits_ < bit_count )
+	{
+		if( pos_ >= size_ )
+		{
+			overflowed_= true;
+			return 0u;
+		}
+		accumulator_|= uint64_t( data_[pos_] ) << accumulator_bits_;
+		pos_++;
+		accumulator_bits_+= 8u;
+	}
+
+	const uint64_t mask= ( uint64_t(1u) << bit_count ) - 1u;
+	const uint32_t result= static_cast<uint32_t>( accumulator_ & mask );
+	accumulator_>>= bit_count;
+	accumulator_bits_-= bit_count;
+	return result;
+}
+
+bool BitReader::ReadBool()
+{
+	return ReadBits( 1u ) != 0u;
+}
+
+uint32_t BitReader::ReadVarUInt( const unsigned int group_bits )
+{
+	uint32_t result= 0u;
+	for( unsigned int shift= 0u; shift < 32u; shift+= group_bits )
+	{
+		result|= ReadBits( group_bits ) << shift;
+		if( !ReadBool() )
+			break;
+	}
+	return result;
+}
+
+short BitReader::ReadRangedShort( const int min_value, const unsigned int bit_count )
+{
+	if( !ReadBool() )
+		return static_cast<short>( min_value + int( ReadBits( bit_count ) ) );
+	return static_cast<short>( static_cast<uint16_t>( ReadBits( 16u ) ) );
+}
+
+bool BitReader::Overflowed() const
+{
+	return overflowed_;
+}
+
+unsigned int BitReader::GetBytesRead() const
+{
+	return pos_;
+}
+
+static void WritePosition( BitWriter& writer, const Messages::CoordType* const xyz )
+{
+	writer.WriteRangedShort( xyz[0], 0, g_coord_xy_bits );
+	writer.WriteRangedShort( xyz[1], 0, g_coord_xy_bits );
+	writer.WriteRangedShort( xyz[2], 0, g_coord_z_bits );
+}
+
+static void ReadPosition( BitReader& reader, Messages::CoordType* const out_xyz )
+{
+	out_xyz[0]= reader.ReadRangedShort( 0, g_coord_xy_bits );
+	out_xyz[1]= reader.ReadRangedShort( 0, g_coord_xy_bits );
+	out_xyz[2]= reader.ReadRangedShort( 0, g_coord_z_bits );
+}
+
+static void WriteAngle( BitWriter& writer, const Messages::AngleType angle )
+{
+	// Round to nearest quantized angle.
+	writer.WriteBits( ( uint32_t(angle) + ( 1u << ( g_angle_shift - 1u ) ) ) >> g_angle_shift, g_angle_bits );
+}
+
+static Messages::AngleType ReadAngle( BitReader& reader )
+{
+	return static_cast<Messages::AngleType>( reader.ReadBits( g_angle_bits ) << g_angle_shift );
+}
+
+static void WriteMessageId( BitWriter& writer, const MessageId message_id )
+{
+	writer.WriteBits( static_cast<uint32_t>( message_id ), 8u );
+}
+
+static void WriteEntityId( BitWriter& writer, const EntityId id )
+{
+	writer.WriteVarUInt( id, g_entity_id_group_bits );
+}
+
+static bool ReadEntityId( BitReader& reader, EntityId& out_id )
+{
+	const uint32_t id= reader.ReadVarUInt( g_entity_id_group_bits );
+	out_id= static_cast<EntityId>( id );
+	return id <= 0xFFFFu;
+}
+
+static DecodeResult FinishDecoding( const BitReader& reader, const bool data_is_valid, unsigned int& out_size )
+{
+	if( reader.Overflowed() )
+		return DecodeResult::NotEnoughData;
+	if( !data_is_valid )
+		return DecodeResult::Broken;
+
+	out_size= reader.GetBytesRead();
+	return DecodeResult::Ok;
+}
+
+unsigned int EncodeMessage( const Messages::MonsterStateDelta& message, unsigned char* const out_data )
+{
+	PC_ASSERT( message.message_size <= sizeof(Messages::MonsterStateDelta) );
+	std::memcpy( out_data, &message, message.message_size );
+	return message.message_size;
+}
+
+DecodeResult DecodeMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Messages::MonsterStateDelta& out_message, unsigned int& out_size )
+{
+	// Real size is stored after message id.
+	if( data_size < sizeof(MessageId) + 1u )
+		return DecodeResult::NotEnoughData;
+
+	const unsigned int message_size= data[ sizeof(MessageId) ];
+	if( message_size < sizeof(MessageId) + 1u || message_size > sizeof(Messages::MonsterStateDelta) )
+		return DecodeResult::Broken;
+	if( data_size < message_size )
+		return DecodeResult::NotEnoughData;
+
+	std::memcpy( &out_message, data, message_size );
+	out_size= message_size;
+	return DecodeResult::Ok;
+}
+
+unsigned int EncodeMessage( const Messages::MonsterState& message, unsigned char* const out_data )
+{
+	BitWriter writer( out_data, sizeof(Messages::MonsterState) + c_max_message_encoding_overhead );
+
+	WriteMessageId( writer, message.message_id );
+	WriteEntityId( writer, message.monster_id );
+	WritePosition( writer, message.xyz );
+	WriteAngle( writer, message.angle );
+	writer.WriteBits( message.monster_type, 8u );
+	writer.WriteBits( message.body_parts_mask, 8u );
+	writer.WriteVarUInt( message.animation, 4u );
+	writer.WriteVarUInt( message.animation_frame, 5u );
+	writer.WriteBool( message.is_fully_dead );
+	writer.WriteBool( message.is_invisible );
+	writer.WriteBits( message.color, 4u );
+
+	return writer.Finish();
+}
+
+DecodeResult DecodeMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Messages::MonsterState& out_message, unsigned int& out_size )
+{
+	BitReader reader( data, data_size );
+
+	reader.ReadBits( 8u ); // Message id
+	bool valid= ReadEntityId( reader, out_message.monster_id );
+	ReadPosition( reader, out_message.xyz );
+	out_message.angle= ReadAngle( reader );
+	out_message.monster_type= static_cast<unsigned char>( reader.ReadBits( 8u ) );
+	out_message.body_parts_mask= static_cast<unsigned char>( reader.ReadBits( 8u ) );
+	const uint32_t animation= reader.ReadVarUInt( 4u );
+	const uint32_t animation_frame= reader.ReadVarUInt( 5u );
+	valid= valid && animation <= 0xFFFFu && animation_frame <= 0xFFFFu;
+	out_message.animation= static_cast<unsigned short>( animation );
+	out_message.animation_frame= static_cast<unsigned short>( animation_frame );
+	out_message.is_fully_dead= reader.ReadBool();
+	out_message.is_invisible= reader.ReadBool();
+	out_message.color= static_cast<unsigned char>( reader.ReadBits( 4u ) );
+
+	return FinishDecoding( reader, valid, out_size );
+}
+
+unsigned int EncodeMessage( const Messages::PlayerPosition& message, unsigned char* const out_data )
+{
+	BitWriter writer( out_data, sizeof(Messages::PlayerPosition) + c_max_message_encoding_overhead );
+
+	WriteMessageId( writer, message.message_id );
+	WritePosition( writer, message.xyz );
+	for( unsigned int i= 0u; i < 3u; i++ )
+		writer.WriteRangedShort( message.speed[i], -( 1 << ( g_speed_bits - 1u ) ), g_speed_bits );
+	writer.WriteBool( message.on_floor );
+	writer.WriteBits( message.acknowledged_move_number, 16u );
+
+	return writer.Finish();
+}
+
+DecodeResult DecodeMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Messages::PlayerPosition& out_message, unsigned int& out_size )
+{
+	BitReader reader( data, data_size );
+
+	reader.ReadBits( 8u ); // Message id
+	ReadPosition( reader, out_message.xyz );
+	for( unsigned int i= 0u; i < 3u; i++ )
+		out_message.speed[i]= reader.ReadRangedShort( -( 1 << ( g_speed_bits - 1u ) ), g_speed_bits );
+	out_message.on_floor= reader.ReadBool();
+	out_message.acknowledged_move_number= static_cast<unsigned short>( reader.ReadBits( 16u ) );
+
+	return FinishDecoding( reader, true, out_size );
+}
+
+static void WriteRocketState( BitWriter& writer, const Messages::RocketState& message )
+{
+	WriteMessageId( writer, message.message_id );
+	WriteEntityId( writer, message.rocket_id );
+	WritePosition( writer, message.xyz );
+	WriteAngle( writer, message.angle[0] );
+	WriteAngle( writer, message.angle[1] );
+}
+
+static bool ReadRocketState( BitReader& reader, Messages::RocketState& out_message )
+{
+	reader.ReadBits( 8u ); // Message id
+	const bool valid= ReadEntityId( reader, out_message.rocket_id );
+	ReadPosition( reader, out_message.xyz );
+	out_message.angle[0]= ReadAngle( reader );
+	out_message.angle[1]= ReadAngle( reader );
+	return valid;
+}
+
+unsigned int EncodeMessage( const Messages::RocketState& message, unsigned char* const out_data )
+{
+	BitWriter writer( out_data, sizeof(Messages::RocketState) + c_max_message_encoding_overhead );
+	WriteRocketState( writer, message );
+	return writer.Finish();
+}
+
+DecodeResult DecodeMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Messages::RocketState& out_message, unsigned int& out_size )
+{
+	BitReader reader( data, data_size );
+	const bool valid= ReadRocketState( reader, out_message );
+	return FinishDecoding( reader, valid, out_size );
+}
+
+unsigned int EncodeMessage( const Messages::RocketBirth& message, unsigned char* const out_data )
+{
+	BitWriter writer( out_data, sizeof(Messages::RocketBirth) + c_max_message_encoding_overhead );
+	WriteRocketState( writer, message );
+	writer.WriteBits( message.rocket_type, 8u );
+	return writer.Finish();
+}
+
+DecodeResult DecodeMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Messages::RocketBirth& out_message, unsigned int& out_size )
+{
+	BitReader reader( data, data_size );
+	const bool valid= ReadRocketState( reader, out_message );
+	out_message.rocket_type= static_cast<unsigned char>( reader.ReadBits( 8u ) );
+	return FinishDecoding( reader, valid, out_size );
+}
+
+} // namespace PanzerChasm
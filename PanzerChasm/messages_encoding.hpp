@@ -0,0 +1,157 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "assert.hpp"
+#include "messages.hpp"
+
+namespace PanzerChasm
+{
+
+// Writes values with given bit width into bytes buffer. Bits are written from lower to higher.
+class BitWriter final
+{
+public:
+	BitWriter( unsigned char* data, unsigned int capacity );
+
+	void WriteBits( uint32_t value, unsigned int bit_count ); // bit_count <= 32
+	void WriteBool( bool value );
+	// Groups of "group_bits" bits, each group followed by continuation bit. Small values occupy less bits.
+	void WriteVarUInt( uint32_t value, unsigned int group_bits );
+	// Values in range [ min_value; min_value + 2^bit_count ) are written with "bit_count" bits, other values - with full 16 bits.
+	void WriteRangedShort( short value, int min_value, unsigned int bit_count );
+
+	// Writes unfinished byte. Returns size in bytes.
+	unsigned int Finish();
+
+private:
+	unsigned char* const data_;
+	const unsigned int capacity_;
+	unsigned int pos_= 0u;
+
+	uint64_t accumulator_= 0u;
+	unsigned int accumulator_bits_= 0u;
+};
+
+// Reads values, written by "BitWriter". Reading after end of data sets overflow flag and returns zeros.
+class BitReader final
+{
+public:
+	BitReader( const unsigned char* data, unsigned int size );
+
+	uint32_t ReadBits( unsigned int bit_count );
+	bool ReadBool();
+	uint32_t ReadVarUInt( unsigned int group_bits );
+	short ReadRangedShort( int min_value, unsigned int bit_count );
+
+	bool Overflowed() const;
+	// Bytes, consumed by reader, including partially read last byte.
+	unsigned int GetBytesRead() const;
+
+private:
+	const unsigned char* const data_;
+	const unsigned int size_;
+	unsigned int pos_= 0u;
+	bool overflowed_= false;
+
+	uint64_t accumulator_= 0u;
+	unsigned int accumulator_bits_= 0u;
+};
+
+// Network encoding of messages.
+// Each encoded message starts with byte of message id and occupies whole number of bytes.
+// Most messages are just copied as is. Frequent messages are bit-packed: coordinates are written relative to map bounds,
+// angles are quantized, entity ids have variable length.
+// Functions for bit-packed messages are overloads, selected by message type in compile time.
+
+// Encoded message is never bigger, than message struct plus this.
+constexpr unsigned int c_max_message_encoding_overhead= 8u;
+
+enum class DecodeResult
+{
+	Ok,
+	NotEnoughData, // Message is not fully received yet.
+	Broken,
+};
+
+// Messages with own encoding functions. Encoded form of other messages is same, as message struct.
+template<class Message> struct IsPackedMessage : public std::false_type {};
+template<> struct IsPackedMessage<Messages::MonsterStateDelta> : public std::true_type {};
+template<> struct IsPackedMessage<Messages::MonsterState> : public std::true_type {};
+template<> struct IsPackedMessage<Messages::PlayerPosition> : public std::true_type {};
+template<> struct IsPackedMessage<Messages::RocketState> : public std::true_type {};
+template<> struct IsPackedMessage<Messages::RocketBirth> : public std::true_type {};
+
+template<class Message>
+unsigned int EncodeMessage( const Message& message, unsigned char* const out_data )
+{
+	static_assert( !IsPackedMessage<Message>::value, "Packed message must have own encoding function" );
+	std::memcpy( out_data, &message, sizeof(Message) );
+	return sizeof(Message);
+}
+
+template<class Message>
+DecodeResult DecodeMessage( const unsigned char* const data, const unsigned int data_size, Message& out_message, unsigned int& out_size )
+{
+	static_assert( !IsPackedMessage<Message>::value, "Packed message must have own decoding function" );
+	if( data_size < sizeof(Message) )
+		return DecodeResult::NotEnoughData;
+
+	std::memcpy( &out_message, data, sizeof(Message) );
+	out_size= sizeof(Message);
+	return DecodeResult::Ok;
+}
+
+// Variable size message - copy only used part.
+unsigned int EncodeMessage( const Messages::MonsterStateDelta& message, unsigned char* out_data );
+DecodeResult DecodeMessage( const unsigned char* data, unsigned int data_size, Messages::MonsterStateDelta& out_message, unsigned int& out_size );
+
+// Bit-packed messages.
+unsigned int EncodeMessage( const Messages::MonsterState& message, unsigned char* out_data );
+DecodeResult DecodeMessage( const unsigned char* data, unsigned int data_size, Messages::MonsterState& out_message, unsigned int& out_size );
+
+unsigned int EncodeMessage( const Messages::PlayerPosition& message, unsigned char* out_data );
+DecodeResult DecodeMessage( const unsigned char* data, unsigned int data_size, Messages::PlayerPosition& out_message, unsigned int& out_size );
+
+unsigned int EncodeMessage( const Messages::RocketState& message, unsigned char* out_data );
+DecodeResult DecodeMessage( const unsigned char* data, unsigned int data_size, Messages::RocketState& out_message, unsigned int& out_size );
+
+unsigned int EncodeMessage( const Messages::RocketBirth& message, unsigned char* out_data );
+DecodeResult DecodeMessage( const unsigned char* data, unsigned int data_size, Messages::RocketBirth& out_message, unsigned int& out_size );
+
+// Size of message in network encoding. Packed messages are encoded for this.
+template<class Message>
+unsigned int GetEncodedMessageSize( const Message& message )
+{
+	if( !IsPackedMessage<Message>::value )
+		return sizeof(Message);
+
+	unsigned char data[ sizeof(Message) + c_max_message_encoding_overhead ];
+	return EncodeMessage( message, data );
+}
+
+// Get message without copying, if it is not packed - messages structs have alignment 1, so, they may be used in place.
+// Packed messages are decoded into storage.
+template<class Message>
+DecodeResult ReferenceMessage(
+	const unsigned char* const data, const unsigned int data_size,
+	Message& storage, const Message*& out_message, unsigned int& out_size )
+{
+	static_assert( alignof(Message) == 1u, "Message must be packed" );
+
+	if( IsPackedMessage<Message>::value )
+	{
+		out_message= &storage;
+		return DecodeMessage( data, data_size, storage, out_size );
+	}
+
+	if( data_size < sizeof(Message) )
+		return DecodeResult::NotEnoughData;
+
+	out_message= reinterpret_cast<const Message*>( data );
+	out_size= sizeof(Message);
+	return DecodeResult::Ok;
+}
+
+} // namespace PanzerChasm
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 #include "fwd.hpp"
 #include "i_connection.hpp"
@@ -21,12 +22,23 @@ public:
 		return broken_;
 	}
 
+	// Size of all processed encoded messages, as they were received.
+	uint64_t GetProcessedBytes() const
+	{
+		return processed_bytes_;
+	}
+
+private:
+	// Process whole messages in buffer. Returns size of processed messages.
+	template<class MessagesHandler>
+	unsigned int ProcessBuffer( const unsigned char* data, unsigned int data_size, MessagesHandler& messages_handler );
+
 private:
-	static size_t c_messages_size[ size_t(MessageId::NumMessages) ];
 	static constexpr unsigned int c_buffer_size= IConnection::c_max_unreliable_packet_size * 2u;
 
 	IConnectionPtr connection_;
 	bool broken_= false;
+	uint64_t processed_bytes_= 0u;
 
 	unsigned char reliable_buffer_[ c_buffer_size ];
 	unsigned int reliable_buffer_pos_= 0u;
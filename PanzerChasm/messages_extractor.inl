@@ -3,6 +3,7 @@
 #include "assert.hpp"
 #include "i_connection.hpp"
 #include "messages.hpp"
+#include "messages_encoding.hpp"
 
 #include "messages_extractor.hpp"
 
@@ -16,15 +17,41 @@ void MessagesExtractor::ProcessMessages( MessagesHandler& messages_handler )
 
 	for( unsigned int i= 0u; i < 2u; i++ ) // for reliable and unreliable messages
 	{
-		unsigned char* const buffer= i == 0u ? reliable_buffer_ : unreliable_buffer_;
-		unsigned int& buffer_pos= i == 0u ? reliable_buffer_pos_ : unreliable_buffer_pos_;
-		const unsigned int max_buffer_size= i == 0u ? sizeof(reliable_buffer_) : sizeof(unreliable_buffer_);
+		const bool reliable= i == 0u;
+
+		// Process messages directly in buffer of connection, if possible.
+		const unsigned char* direct_data= nullptr;
+		unsigned int direct_data_size= 0u;
+		if( connection_->PeekReceivedData( reliable, direct_data, direct_data_size ) )
+		{
+			while( direct_data_size > 0u )
+			{
+				const unsigned int processed_size= ProcessBuffer( direct_data, direct_data_size, messages_handler );
+				if( broken_ )
+					return;
+
+				// Messages are never splitted in buffer of connection.
+				if( processed_size != direct_data_size )
+				{
+					broken_= true;
+					return;
+				}
+
+				connection_->ConsumeReceivedData( reliable, processed_size );
+				connection_->PeekReceivedData( reliable, direct_data, direct_data_size );
+			}
+			continue;
+		}
+
+		unsigned char* const buffer= reliable ? reliable_buffer_ : unreliable_buffer_;
+		unsigned int& buffer_pos= reliable ? reliable_buffer_pos_ : unreliable_buffer_pos_;
+		const unsigned int max_buffer_size= reliable ? sizeof(reliable_buffer_) : sizeof(unreliable_buffer_);
 
 		while(1)
 		{
 			unsigned int bytes_to_process= buffer_pos;
 			unsigned int bytes_read= 0u;
-			if( i == 0u )
+			if( reliable )
 				bytes_read=
 					connection_->ReadRealiableData(
 						buffer + buffer_pos,
@@ -40,51 +67,74 @@ void MessagesExtractor::ProcessMessages( MessagesHandler& messages_handler )
 			if( bytes_to_process == 0u || bytes_read == 0u )
 				break;
 
-			unsigned int pos= 0u;
-			while(1)
-			{
-				if( bytes_to_process - pos < sizeof(MessageId) )
-					break;
-
-				const unsigned char* const msg_ptr= buffer + pos;
+			const unsigned int pos= ProcessBuffer( buffer, bytes_to_process, messages_handler );
+			if( broken_ )
+				return;
 
-				MessageId message_id;
-				std::memcpy( &message_id, msg_ptr, sizeof(MessageId) );
-
-				if( message_id >= MessageId::NumMessages || message_id <= MessageId::Unknown )
-				{
-					// TODO - handel error
-					PC_ASSERT( false );
-				}
+			std::memmove( buffer, buffer + pos, bytes_to_process - pos );
+			buffer_pos= bytes_to_process - pos;
+		}
+	}
+}
 
-				const unsigned int message_size= c_messages_size[ size_t(message_id) ];
-				if( pos + message_size > bytes_to_process )
-					break;
+template<class MessagesHandler>
+unsigned int MessagesExtractor::ProcessBuffer(
+	const unsigned char* const data, const unsigned int data_size,
+	MessagesHandler& messages_handler )
+{
+	unsigned int pos= 0u;
+	while(1)
+	{
+		if( data_size - pos < sizeof(MessageId) )
+			break;
 
-				switch(message_id)
-				{
-				case MessageId::Unknown:
-				case MessageId::NumMessages:
-					broken_= true;
-					return;
+		const unsigned char* const msg_ptr= data + pos;
+		const unsigned int bytes_left= data_size - pos;
 
-				#define MESSAGE_FUNC(x)\
-				case MessageId::x:\
-					messages_handler( *reinterpret_cast<const Messages::x*>( msg_ptr ) );\
-					break;
+		MessageId message_id;
+		std::memcpy( &message_id, msg_ptr, sizeof(MessageId) );
 
-				#include "messages_list.h"
-				#undef MESSAGE_FUNC
+		unsigned int message_size= 0u;
+		DecodeResult decode_result= DecodeResult::Broken;
 
-				};
+		switch(message_id)
+		{
+		case MessageId::Unknown:
+		case MessageId::NumMessages:
+			break;
+
+		// Handler gets message in place, if it is not packed.
+		#define MESSAGE_FUNC(x)\
+		case MessageId::x:\
+			{\
+				Messages::x message_storage;\
+				const Messages::x* message= nullptr;\
+				decode_result= ReferenceMessage( msg_ptr, bytes_left, message_storage, message, message_size );\
+				if( decode_result == DecodeResult::Ok )\
+					messages_handler( *message );\
+			}\
+			break;
+
+		#include "messages_list.h"
+		#undef MESSAGE_FUNC
+
+		default:
+			break;
+		};
+
+		if( decode_result == DecodeResult::NotEnoughData )
+			break;
+		if( decode_result == DecodeResult::Broken )
+		{
+			broken_= true;
+			break;
+		}
 
-				pos+= message_size;
-			} // for messages in buffer
+		pos+= message_size;
+	} // for messages in buffer
 
-			std::memmove( buffer, buffer + pos, bytes_to_process - pos );
-			buffer_pos= bytes_to_process - pos;
-		}
-	}
+	processed_bytes_+= pos;
+	return pos;
 }
 
 } // namespace PanzerChasm
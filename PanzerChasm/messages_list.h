@@ -7,6 +7,7 @@ MESSAGE_FUNC(DummyNetMessage)
 
 MESSAGE_FUNC(ServerState)
 MESSAGE_FUNC(MonsterState)
+MESSAGE_FUNC(MonsterStateDelta)
 MESSAGE_FUNC(WallPosition)
 MESSAGE_FUNC(PlayerSpawn)
 MESSAGE_FUNC(PlayerPosition) // position of player, which recieve this message.
@@ -37,6 +38,7 @@ MESSAGE_FUNC(RotatingLightSourceDeath)
 MESSAGE_FUNC(MapChange)
 MESSAGE_FUNC(MonsterBirth)
 MESSAGE_FUNC(MonsterDeath)
+MESSAGE_FUNC(ReliableUpdateMark)
 MESSAGE_FUNC(TextMessage)
 MESSAGE_FUNC(DynamicTextMessage)
 
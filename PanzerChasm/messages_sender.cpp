@@ -8,6 +8,8 @@
 namespace PanzerChasm
 {
 
+constexpr unsigned int MessagesSender::c_max_unreliable_packets;
+
 MessagesSender::MessagesSender( IConnectionPtr connection )
 	: connection_( std::move(connection) )
 {}
@@ -17,11 +19,43 @@ MessagesSender::~MessagesSender()
 
 void MessagesSender::Flush()
 {
-	if( unreliable_messages_buffer_pos_ > 0u )
+	if( unreliable_packet_count_ == 0u )
+		return;
+
+	IConnection::UnreliablePacket packets[ c_max_unreliable_packets ];
+	for( unsigned int i= 0u; i < unreliable_packet_count_; i++ )
 	{
-		connection_->SendUnreliablePacket( unreliable_messages_buffer_, unreliable_messages_buffer_pos_ );
-		unreliable_messages_buffer_pos_= 0u;
+		packets[i].data= unreliable_packets_[i];
+		packets[i].size= unreliable_packets_size_[i];
 	}
+
+	connection_->SendUnreliablePackets( packets, unreliable_packet_count_ );
+	unreliable_packet_count_= 0u;
+}
+
+const MessagesSender::Stats& MessagesSender::GetStats() const
+{
+	return stats_;
+}
+
+void MessagesSender::ResetStats()
+{
+	stats_= Stats();
+}
+
+uint64_t MessagesSender::GetReliableMessagesSent() const
+{
+	return reliable_messages_sent_;
+}
+
+unsigned char* MessagesSender::BeginDirectWrite( const bool reliable, const unsigned int max_size )
+{
+	// Do not mix direct and bufferized unreliable messages, because order of messages must be preserved.
+	// Bufferized messages remain only if direct writing was not possible earlier in this tick.
+	if( !reliable && unreliable_packet_count_ != 0u )
+		return nullptr;
+
+	return connection_->BeginDirectWrite( reliable, max_size );
 }
 
 void MessagesSender::SendReliableMessageImpl( const void* const data, const unsigned int size )
@@ -31,17 +65,36 @@ void MessagesSender::SendReliableMessageImpl( const void* const data, const unsi
 
 void MessagesSender::SendUnreliableMessageImpl( const void* const data, const unsigned int size )
 {
-	if( unreliable_messages_buffer_pos_ + size > sizeof(unreliable_messages_buffer_) )
+	PC_ASSERT( size <= IConnection::c_max_unreliable_packet_size );
+
+	// Messages are not splitted between packets. Start new packet, if message does not fit into current.
+	if( unreliable_packet_count_ == 0u ||
+		unreliable_packets_size_[ unreliable_packet_count_ - 1u ] + size > IConnection::c_max_unreliable_packet_size )
 	{
-		Flush();
+		if( unreliable_packet_count_ == c_max_unreliable_packets )
+			Flush();
+
+		unreliable_packets_size_[ unreliable_packet_count_ ]= 0u;
+		unreliable_packet_count_++;
 	}
 
+	const unsigned int packet_index= unreliable_packet_count_ - 1u;
 	std::memcpy(
-		unreliable_messages_buffer_ + unreliable_messages_buffer_pos_,
+		unreliable_packets_[ packet_index ] + unreliable_packets_size_[ packet_index ],
 		data,
 		size );
 
-	unreliable_messages_buffer_pos_+= size;
+	unreliable_packets_size_[ packet_index ]+= size;
+}
+
+void MessagesSender::CountMessage( const MessageId message_id, const unsigned int raw_size, const unsigned int encoded_size )
+{
+	const size_t index= size_t(message_id);
+	PC_ASSERT( index < size_t(MessageId::NumMessages) );
+
+	stats_.messages[index]++;
+	stats_.raw_bytes[index]+= raw_size;
+	stats_.encoded_bytes[index]+= encoded_size;
 }
 
 } // namespace PanzerChasm
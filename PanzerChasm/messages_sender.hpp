@@ -1,15 +1,27 @@
 #pragma once
+#include <cstdint>
 #include <type_traits>
 
+#include "assert.hpp"
 #include "fwd.hpp"
 #include "i_connection.hpp"
 #include "messages.hpp"
+#include "messages_encoding.hpp"
 
 namespace PanzerChasm
 {
 
 class MessagesSender final
 {
+public:
+	// Sizes of sent messages, for measurement of encoding effectiveness.
+	struct Stats
+	{
+		uint64_t messages[ size_t(MessageId::NumMessages) ]= {};
+		uint64_t raw_bytes[ size_t(MessageId::NumMessages) ]= {}; // Sizes of messages structs.
+		uint64_t encoded_bytes[ size_t(MessageId::NumMessages) ]= {};
+	};
+
 public:
 	explicit MessagesSender( IConnectionPtr connection );
 	~MessagesSender();
@@ -21,7 +33,7 @@ public:
 			std::is_base_of< Messages::MessageBase, Message >::value,
 			"Invalid message type" );
 
-		SendReliableMessageImpl( &message, sizeof(Message) );
+		EncodeAndSend( message, sizeof(Message), true );
 	}
 
 	template<class Message>
@@ -32,24 +44,87 @@ public:
 			"Invalid message type" );
 
 		static_assert(
-			sizeof(Message) <= sizeof(unreliable_messages_buffer_),
+			sizeof(Message) + c_max_message_encoding_overhead <= IConnection::c_max_unreliable_packet_size,
 			"Message is too big" );
 
-		SendUnreliableMessageImpl( &message, sizeof(Message) );
+		EncodeAndSend( message, sizeof(Message), false );
 	}
 
+	// Send only used part of variable size message.
+	template<class Message>
+	void SendUnreliableVariableSizeMessage( const Message& message )
+	{
+		static_assert(
+			std::is_base_of< Messages::MessageBase, Message >::value,
+			"Invalid message type" );
+
+		static_assert(
+			sizeof(Message) + c_max_message_encoding_overhead <= IConnection::c_max_unreliable_packet_size,
+			"Message is too big" );
+
+		PC_ASSERT( IsVariableSizeMessage( message.message_id ) );
+		PC_ASSERT( message.message_size <= sizeof(Message) );
+
+		EncodeAndSend( message, message.message_size, false );
+	}
+
+	// Send all bufferized unreliable messages. Call it once per tick.
 	void Flush();
 
+	const Stats& GetStats() const;
+	void ResetStats();
+
+	// Number of reliable messages, sent since creation. Not affected by stats reset.
+	uint64_t GetReliableMessagesSent() const;
+
 private:
+	// Unreliable messages of whole tick are packed into packets, which are sent together.
+	static constexpr unsigned int c_max_unreliable_packets= 16u;
+
+private:
+	template<class Message>
+	void EncodeAndSend( const Message& message, const unsigned int raw_size, const bool reliable )
+	{
+		constexpr unsigned int c_max_size= sizeof(Message) + c_max_message_encoding_overhead;
+
+		if( reliable )
+			reliable_messages_sent_++;
+
+		// Encode message directly into buffer of connection, if possible.
+		unsigned char* const direct_data= BeginDirectWrite( reliable, c_max_size );
+		if( direct_data != nullptr )
+		{
+			const unsigned int size= EncodeMessage( message, direct_data );
+			CountMessage( message.message_id, raw_size, size );
+			connection_->EndDirectWrite( reliable, size );
+			return;
+		}
+
+		unsigned char data[ c_max_size ];
+		const unsigned int size= EncodeMessage( message, data );
+		CountMessage( message.message_id, raw_size, size );
+		if( reliable )
+			SendReliableMessageImpl( data, size );
+		else
+			SendUnreliableMessageImpl( data, size );
+	}
+
+	unsigned char* BeginDirectWrite( bool reliable, unsigned int max_size );
 	void SendReliableMessageImpl( const void* data, unsigned int size );
 	void SendUnreliableMessageImpl( const void* data, unsigned int size );
+	void CountMessage( MessageId message_id, unsigned int raw_size, unsigned int encoded_size );
 
 private:
 	const IConnectionPtr connection_;
 
+	Stats stats_;
+	uint64_t reliable_messages_sent_= 0u;
+
 	// Bufferize unreliable messages, which works via UDP.
-	unsigned char unreliable_messages_buffer_[ IConnection::c_max_unreliable_packet_size ];
-	unsigned int unreliable_messages_buffer_pos_= 0u;
+	unsigned int unreliable_packets_size_[ c_max_unreliable_packets ];
+	unsigned int unreliable_packet_count_= 0u;
+	// Put large objects here.
+	unsigned char unreliable_packets_[ c_max_unreliable_packets ][ IConnection::c_max_unreliable_packet_size ];
 };
 
 } // namespace PanzerChasm
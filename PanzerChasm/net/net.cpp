@@ -1,5 +1,11 @@
+#include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -12,14 +18,20 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #define INVALID_SOCKET (-1)
 typedef int SOCKET;
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 #endif
 
 #include "../assert.hpp"
@@ -28,6 +40,7 @@ typedef int SOCKET;
 #include "../messages.hpp"
 #include "../server/i_connections_listener.hpp"
 
+#include "reliable_channel.hpp"
 #include "net.hpp"
 
 #define FUNC_NAME  __FUNCTION__
@@ -80,6 +93,141 @@ static bool IsSocketReady( const SOCKET& socket )
 #endif
 }
 
+// Readiness tracker for all sockets of one Net instance.
+// On Linux it uses edge-triggered epoll - one "epoll_wait" call per tick collects readiness of all sockets,
+// so, sockets without data are not touched by "recv" calls. Reading of sockets may happen in other threads.
+// On other platforms each readiness check is zero-timeout "select" call.
+class NetReactor final
+{
+public:
+	struct SocketWatch
+	{
+		SOCKET socket= INVALID_SOCKET;
+		uint64_t id= 0u;
+		// Initially true - socket may have data, received before watching start.
+		std::atomic<bool> ready{true};
+	};
+
+	explicit NetReactor( std::shared_ptr<NetCounters> counters )
+		: counters_( std::move(counters) )
+	{
+#ifdef __linux__
+		epoll_fd_= ::epoll_create1( EPOLL_CLOEXEC );
+		if( epoll_fd_ == -1 )
+			Log::Warning( FUNC_NAME, " can not create epoll. Error code: ", errno );
+#endif
+	}
+
+	~NetReactor()
+	{
+#ifdef __linux__
+		if( epoll_fd_ != -1 )
+			::close( epoll_fd_ );
+#endif
+	}
+
+	void Add( SocketWatch& watch, const SOCKET socket )
+	{
+		watch.socket= socket;
+		watch.ready.store( true );
+
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock( watches_mutex_ );
+		watch.id= next_watch_id_;
+		++next_watch_id_;
+		watches_[ watch.id ]= &watch;
+
+		epoll_event event;
+		event.events= EPOLLIN | EPOLLET;
+		event.data.u64= watch.id;
+		if( ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, socket, &event ) != 0 )
+			Log::Warning( FUNC_NAME, " epoll_ctl error: ", errno );
+#endif
+	}
+
+	void Remove( SocketWatch& watch )
+	{
+		if( watch.socket == INVALID_SOCKET )
+			return;
+
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock( watches_mutex_ );
+		watches_.erase( watch.id );
+		::epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, watch.socket, nullptr );
+#endif
+		watch.socket= INVALID_SOCKET;
+	}
+
+	// Returns true, if socket may have data. Resets readiness.
+	bool TakeReadiness( SocketWatch& watch )
+	{
+#ifdef __linux__
+		if( epoll_fd_ != -1 )
+			return watch.ready.exchange( false );
+#endif
+		return IsSocketReady( watch.socket );
+	}
+
+	// Call it after reading, if socket still may have data.
+	void MarkReady( SocketWatch& watch )
+	{
+		watch.ready.store( true );
+	}
+
+	void Poll( const Time max_wait_time )
+	{
+		const int64_t wait_time_units= std::max( int64_t(0), max_wait_time.GetInternalRepresentation() );
+		const int64_t units_in_second= Time::FromSeconds(1).GetInternalRepresentation();
+
+#ifdef __linux__
+		if( epoll_fd_ != -1 )
+		{
+			// Round up, because tick scheduler waits again, if we return too early.
+			const int timeout_ms= static_cast<int>( ( wait_time_units * 1000 + units_in_second - 1 ) / units_in_second );
+
+			epoll_event events[ c_max_events ];
+			counters_->poll_syscalls++;
+			const int result= ::epoll_wait( epoll_fd_, events, c_max_events, timeout_ms );
+			if( result == -1 )
+			{
+				if( errno != EINTR )
+					Log::Warning( FUNC_NAME, " epoll_wait error: ", errno );
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock( watches_mutex_ );
+			for( int i= 0; i < result; i++ )
+			{
+				// Watch may be removed after "epoll_wait".
+				const auto it= watches_.find( events[i].data.u64 );
+				if( it != watches_.end() )
+					it->second->ready.store( true );
+			}
+			return;
+		}
+#endif
+		if( wait_time_units > 0 )
+			std::this_thread::sleep_for( std::chrono::microseconds( wait_time_units * 1000000 / units_in_second ) );
+	}
+
+private:
+	static constexpr int c_max_events= 64;
+
+private:
+	const std::shared_ptr<NetCounters> counters_;
+
+#ifdef __linux__
+	int epoll_fd_= -1;
+	std::mutex watches_mutex_;
+	std::unordered_map< uint64_t, SocketWatch* > watches_;
+	uint64_t next_watch_id_= 1u;
+#endif
+};
+
+constexpr int NetReactor::c_max_events;
+
+typedef std::shared_ptr<NetReactor> NetReactorPtr;
+
 bool InetAddress::Parse( const std::string& address_string, InetAddress& out_address )
 {
 #ifdef _WIN32
@@ -185,14 +333,399 @@ std::string InetAddress::ToString() const
 	return result;
 }
 
+// Header of each unreliable datagram.
+// Packets of one batch (one server tick, usually) have same batch number.
+// Acknowledgement fields contain last received sequence number and bits of previous received packets.
+// Token identifies connection on server side, where one UDP socket is used for all clients.
+// Header is followed by reliable data section (if reliable data is sent over UDP) and unreliable data.
+#pragma pack(push, 1)
+struct UnreliablePacketHeader
+{
+	uint32_t token;
+	uint16_t sequence;
+	uint16_t batch;
+	uint16_t ack_sequence;
+	uint32_t ack_bits;
+	uint16_t reliable_size;
+};
+#pragma pack(pop)
+
+SIZE_ASSERT( UnreliablePacketHeader, 16u );
+
+// First datagrams from client, which bind client UDP address to connection.
+// Token is sent to client via TCP.
+#pragma pack(push, 1)
+struct UdpHandshake
+{
+	uint32_t magic;
+	uint32_t token;
+};
+#pragma pack(pop)
+
+SIZE_ASSERT( UdpHandshake, 8u );
+
+static const uint32_t c_udp_handshake_magic= 0x48435043u;
+
+// Connection flags, sent by server via TCP.
+static const uint32_t c_connection_flag_reliable_over_udp= 1u;
+
+static const unsigned int c_max_datagram_size= sizeof(UnreliablePacketHeader) + IConnection::c_max_unreliable_packet_size;
+
+struct ReceivedDatagram
+{
+	unsigned int size; // Zero for discarded datagrams.
+	unsigned char data[ c_max_datagram_size ];
+};
+
+// One UDP socket for all clients of server.
+// Datagrams are demultiplexed into per-connection queues through source address and connection token.
+// Connections may be read from different threads, so, socket reading and queues are protected by mutex.
+// Whoever reads first, reads datagrams for all connections.
+class SharedUdpSocket final
+{
+public:
+	SharedUdpSocket( const uint16_t port, std::shared_ptr<NetCounters> counters, NetReactorPtr reactor )
+		: port_(port)
+		, counters_( std::move(counters) )
+		, reactor_( std::move(reactor) )
+		, random_generator_( std::random_device()() )
+	{
+		socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
+		if( socket_ == INVALID_SOCKET )
+		{
+#ifdef _WIN32
+			Log::Warning( "Can not create udp socket. Error code: ", ::WSAGetLastError() );
+#else
+			Log::Warning( "Can not create udp socket. Error code: ", errno );
+#endif
+			return;
+		}
+
+		// All clients send data into this socket, so, make receive buffer bigger.
+		const int receive_buffer_size= 1 << 20;
+		::setsockopt( socket_, SOL_SOCKET, SO_RCVBUF, (const char*)&receive_buffer_size, sizeof(receive_buffer_size) );
+
+		sockaddr_in udp_address;
+		std::memset( &udp_address, 0, sizeof(udp_address) );
+		udp_address.sin_family= AF_INET;
+		udp_address.sin_addr.s_addr= INADDR_ANY;
+		udp_address.sin_port= htons( port_ );
+		if( ::bind( socket_, (sockaddr*) &udp_address, sizeof(udp_address) ) != 0 )
+		{
+#ifdef _WIN32
+			Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", ::WSAGetLastError() );
+			::closesocket( socket_ );
+#else
+			Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", errno );
+			::close( socket_ );
+#endif
+			socket_= INVALID_SOCKET;
+			return;
+		}
+
+		reactor_->Add( watch_, socket_ );
+	}
+
+	~SharedUdpSocket()
+	{
+		if( socket_ == INVALID_SOCKET )
+			return;
+
+		reactor_->Remove( watch_ );
+#ifdef _WIN32
+		::closesocket( socket_ );
+#else
+		::close( socket_ );
+#endif
+	}
+
+	bool IsOk() const
+	{
+		return socket_ != INVALID_SOCKET;
+	}
+
+	SOCKET GetSocket() const
+	{
+		return socket_;
+	}
+
+	uint16_t GetPort() const
+	{
+		return port_;
+	}
+
+	// Register connection, which waits for handshake from given ip address. Returns token of connection.
+	uint32_t AddClient( const IpAddress ip_address )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		uint32_t token;
+		do
+		{
+			token= random_generator_();
+		} while( token == 0u || clients_.find( token ) != clients_.end() );
+
+		std::unique_ptr<Client> client( new Client );
+		client->ip_address= ip_address;
+		clients_[ token ]= std::move( client );
+
+		return token;
+	}
+
+	void RemoveClient( const uint32_t token )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+
+		const auto it= clients_.find( token );
+		if( it == clients_.end() )
+			return;
+
+		if( it->second->has_address )
+			address_to_token_.erase( GetAddressKey( it->second->address ) );
+		clients_.erase( it );
+	}
+
+	// Returns true, if handshake from client received.
+	bool GetClientAddress( const uint32_t token, sockaddr_in& out_address )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		Drain();
+
+		const auto it= clients_.find( token );
+		if( it == clients_.end() || !it->second->has_address )
+			return false;
+
+		out_address= it->second->address;
+		return true;
+	}
+
+	// Returns number of datagrams, taken from queue of connection.
+	unsigned int Receive( const uint32_t token, ReceivedDatagram* const out_datagrams, const unsigned int max_datagrams )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		Drain();
+
+		const auto it= clients_.find( token );
+		if( it == clients_.end() )
+			return 0u;
+
+		Client& client= *it->second;
+		unsigned int count= 0u;
+		while( client.datagram_count > 0u && count < max_datagrams )
+		{
+			const ReceivedDatagram& datagram= client.datagrams[ client.first_datagram ];
+			out_datagrams[ count ].size= datagram.size;
+			std::memcpy( out_datagrams[ count ].data, datagram.data, datagram.size );
+
+			client.first_datagram= ( client.first_datagram + 1u ) % c_client_queue_size;
+			client.datagram_count--;
+			count++;
+		}
+
+		return count;
+	}
+
+private:
+	static constexpr unsigned int c_client_queue_size= 32u;
+	static constexpr unsigned int c_receive_batch_size= 32u;
+
+	struct Client
+	{
+		IpAddress ip_address;
+		bool has_address= false;
+		sockaddr_in address;
+
+		// Ring buffer of received datagrams.
+		unsigned int first_datagram= 0u;
+		unsigned int datagram_count= 0u;
+		ReceivedDatagram datagrams[ c_client_queue_size ];
+	};
+
+private:
+	static uint64_t GetAddressKey( const sockaddr_in& address )
+	{
+		uint32_t ip;
+		std::memcpy( &ip, &address.sin_addr, sizeof(ip) );
+		return ( uint64_t(ip) << 16u ) | uint64_t(address.sin_port);
+	}
+
+	// Read all available datagrams. Mutex must be locked.
+	void Drain()
+	{
+		while( reactor_->TakeReadiness( watch_ ) )
+		{
+#ifdef __linux__
+			mmsghdr messages[ c_receive_batch_size ];
+			iovec io_vectors[ c_receive_batch_size ];
+			std::memset( messages, 0, sizeof(messages) );
+			for( unsigned int i= 0u; i < c_receive_batch_size; i++ )
+			{
+				io_vectors[i].iov_base= receive_buffer_[i].data;
+				io_vectors[i].iov_len= sizeof(receive_buffer_[i].data);
+
+				messages[i].msg_hdr.msg_name= &receive_addresses_[i];
+				messages[i].msg_hdr.msg_namelen= sizeof(receive_addresses_[i]);
+				messages[i].msg_hdr.msg_iov= &io_vectors[i];
+				messages[i].msg_hdr.msg_iovlen= 1u;
+			}
+
+			counters_->receive_syscalls++;
+			const int result= ::recvmmsg( socket_, messages, c_receive_batch_size, MSG_DONTWAIT, nullptr );
+			if( result == -1 )
+			{
+				if( errno != EAGAIN && errno != EWOULDBLOCK )
+					Log::Warning( FUNC_NAME, " error: ", errno );
+				return;
+			}
+
+			// Batch is full - socket may have more datagrams.
+			if( static_cast<unsigned int>(result) == c_receive_batch_size )
+				reactor_->MarkReady( watch_ );
+
+			for( unsigned int i= 0u; i < static_cast<unsigned int>(result); i++ )
+			{
+				receive_buffer_[i].size= messages[i].msg_len;
+				Dispatch( receive_addresses_[i], receive_buffer_[i] );
+			}
+#else
+#ifdef _WIN32
+			int reciever_address_length= sizeof(receive_addresses_[0]);
+#else
+			socklen_t reciever_address_length= sizeof(receive_addresses_[0]);
+#endif
+			counters_->receive_syscalls++;
+			const int result=
+				::recvfrom(
+					socket_,
+					(char*) receive_buffer_[0].data, sizeof(receive_buffer_[0].data),
+					0,
+					(sockaddr*) &receive_addresses_[0], &reciever_address_length );
+			if( result < 0 )
+			{
+#ifdef _WIN32
+				Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+#else
+				Log::Warning( FUNC_NAME, " error: ", errno );
+#endif
+				return;
+			}
+
+			receive_buffer_[0].size= static_cast<unsigned int>(result);
+			Dispatch( receive_addresses_[0], receive_buffer_[0] );
+#endif
+		}
+	}
+
+	void Dispatch( const sockaddr_in& address, const ReceivedDatagram& datagram )
+	{
+		counters_->packets_received++;
+		counters_->bytes_received+= datagram.size;
+
+		const uint64_t address_key= GetAddressKey( address );
+		const auto address_it= address_to_token_.find( address_key );
+		if( address_it != address_to_token_.end() )
+		{
+			UnreliablePacketHeader header;
+			if( datagram.size < sizeof(UnreliablePacketHeader) )
+			{
+				// Repeated handshake, for example.
+				counters_->packets_dropped++;
+				return;
+			}
+			std::memcpy( &header, datagram.data, sizeof(UnreliablePacketHeader) );
+			if( header.token != address_it->second )
+			{
+				counters_->packets_dropped++;
+				return;
+			}
+
+			Client& client= *clients_[ address_it->second ];
+			if( client.datagram_count == c_client_queue_size )
+			{
+				// Queue overflow - drop oldest datagram.
+				client.first_datagram= ( client.first_datagram + 1u ) % c_client_queue_size;
+				client.datagram_count--;
+				counters_->packets_dropped++;
+			}
+
+			ReceivedDatagram& dst= client.datagrams[ ( client.first_datagram + client.datagram_count ) % c_client_queue_size ];
+			dst.size= datagram.size;
+			std::memcpy( dst.data, datagram.data, datagram.size );
+			client.datagram_count++;
+			return;
+		}
+
+		// Unknown address - datagram may be handshake of new client.
+		if( datagram.size == sizeof(UdpHandshake) )
+		{
+			UdpHandshake handshake;
+			std::memcpy( &handshake, datagram.data, sizeof(UdpHandshake) );
+
+			const auto client_it= clients_.find( handshake.token );
+			if( handshake.magic == c_udp_handshake_magic && client_it != clients_.end() && !client_it->second->has_address )
+			{
+				Client& client= *client_it->second;
+				if( std::memcmp( &address.sin_addr, &client.ip_address, sizeof(IpAddress) ) == 0 )
+				{
+					client.address= address;
+					client.has_address= true;
+					address_to_token_[ address_key ]= handshake.token;
+					return;
+				}
+
+				Log::Info( "Unknown user ", inet_ntoa( address.sin_addr ), " trying to connect. Discard him." );
+			}
+		}
+
+		counters_->packets_dropped++;
+	}
+
+private:
+	SOCKET socket_= INVALID_SOCKET;
+	const uint16_t port_;
+	const std::shared_ptr<NetCounters> counters_;
+	const NetReactorPtr reactor_;
+	NetReactor::SocketWatch watch_;
+
+	std::mutex mutex_;
+	std::mt19937 random_generator_;
+	std::unordered_map< uint32_t, std::unique_ptr<Client> > clients_;
+	std::unordered_map< uint64_t, uint32_t > address_to_token_;
+
+	// Put large objects here.
+	sockaddr_in receive_addresses_[ c_receive_batch_size ];
+	ReceivedDatagram receive_buffer_[ c_receive_batch_size ];
+};
+
+constexpr unsigned int SharedUdpSocket::c_client_queue_size;
+constexpr unsigned int SharedUdpSocket::c_receive_batch_size;
+
+typedef std::shared_ptr<SharedUdpSocket> SharedUdpSocketPtr;
+
 class NetConnection final : public IConnection
 {
 public:
-	NetConnection( const SOCKET& tcp_socket, const SOCKET& udp_socket, const sockaddr_in& destination_udp_address )
+	NetConnection(
+		const SOCKET& tcp_socket, const SOCKET& udp_socket, const sockaddr_in& destination_udp_address,
+		const uint32_t token,
+		const bool reliable_over_udp,
+		std::shared_ptr<NetCounters> counters,
+		NetReactorPtr reactor,
+		SharedUdpSocketPtr shared_udp_socket= nullptr )
 		: tcp_socket_( tcp_socket )
 		, udp_socket_( udp_socket )
 		, destination_udp_address_( destination_udp_address )
+		, token_( token )
+		, reliable_over_udp_( reliable_over_udp )
+		, counters_( std::move(counters) )
+		, reactor_( std::move(reactor) )
+		, shared_udp_socket_( std::move(shared_udp_socket) )
+		, reliable_channel_( *counters_ )
 	{
+		reactor_->Add( tcp_watch_, tcp_socket_ );
+		if( shared_udp_socket_ == nullptr )
+			reactor_->Add( udp_watch_, udp_socket_ );
+
 		// TEST - use nonblocking sockets.
 		//u_long socket_mode= 1;
 		//::ioctlsocket( tcp_socket_, FIONBIO, &socket_mode );
@@ -202,11 +735,23 @@ public:
 	virtual ~NetConnection() override
 	{
 		Disconnect();
+		reactor_->Remove( tcp_watch_ );
 #ifdef _WIN32
 		::closesocket( tcp_socket_ );
-		::closesocket( udp_socket_ );
 #else
 		::close( tcp_socket_ );
+#endif
+
+		if( shared_udp_socket_ != nullptr )
+		{
+			shared_udp_socket_->RemoveClient( token_ );
+			return;
+		}
+
+		reactor_->Remove( udp_watch_ );
+#ifdef _WIN32
+		::closesocket( udp_socket_ );
+#else
 		::close( udp_socket_ );
 #endif
 	}
@@ -217,6 +762,16 @@ public: // IConnection
 		if( disconnected_ ) return;
 		if( data_size == 0u ) return;
 
+		if( reliable_over_udp_ )
+		{
+			// Data is sent later, together with unreliable packets, or during reading.
+			reliable_channel_.Write( data, data_size );
+			return;
+		}
+
+		counters_->send_syscalls++;
+		counters_->bytes_sent+= data_size;
+
 #ifdef _WIN32
 		const int result= ::send( tcp_socket_, (const char*) data, data_size, 0 );
 		if( result == SOCKET_ERROR )
@@ -229,47 +784,88 @@ public: // IConnection
 	}
 
 	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override
+	{
+		UnreliablePacket packet;
+		packet.data= data;
+		packet.size= data_size;
+		SendUnreliablePackets( &packet, 1u );
+	}
+
+	virtual void SendUnreliablePackets( const UnreliablePacket* const packets, const unsigned int packet_count ) override
 	{
 		if( disconnected_ ) return;
 
-#ifdef _WIN32
-		const int result=
-			::sendto( udp_socket_, (const char*) data, data_size, 0, (sockaddr*) &destination_udp_address_, sizeof(destination_udp_address_) );
+		// Reliable data goes first, in separate datagrams of same batch.
+		const unsigned int reliable_datagram_count= BuildReliableDatagrams();
+		const unsigned int total_datagram_count= reliable_datagram_count + packet_count;
+		if( total_datagram_count == 0u ) return;
 
-		if( result == SOCKET_ERROR )
-			Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
-		else if( result < static_cast<int>(data_size) )
-			Log::Warning( FUNC_NAME, " not all data transmited: ", result, " from ", data_size );
-#else
-		const int result=
-			::sendto( udp_socket_, (const char*) data, data_size, 0, (sockaddr*) &destination_udp_address_, sizeof(destination_udp_address_) );
+		OutgoingDatagram datagrams[ c_max_datagrams_per_call ];
+		for( unsigned int first_datagram= 0u; first_datagram < total_datagram_count; first_datagram+= c_max_datagrams_per_call )
+		{
+			const unsigned int count= std::min( total_datagram_count - first_datagram, c_max_datagrams_per_call );
+			for( unsigned int i= 0u; i < count; i++ )
+			{
+				const unsigned int n= first_datagram + i;
+				OutgoingDatagram& datagram= datagrams[i];
+				if( n < reliable_datagram_count )
+				{
+					datagram.reliable_data= reliable_datagrams_[n];
+					datagram.reliable_size= reliable_datagrams_size_[n];
+					datagram.data= nullptr;
+					datagram.size= 0u;
+				}
+				else
+				{
+					PC_ASSERT( packets[ n - reliable_datagram_count ].size <= c_max_unreliable_packet_size );
+					datagram.reliable_data= nullptr;
+					datagram.reliable_size= 0u;
+					datagram.data= packets[ n - reliable_datagram_count ].data;
+					datagram.size= packets[ n - reliable_datagram_count ].size;
+				}
+			}
 
-		if( result == -1 )
-			Log::Warning( FUNC_NAME, " error: ", errno );
-		else if( result < static_cast<int>(data_size) )
-			Log::Warning( FUNC_NAME, " not all data transmited: ", result, " from ", data_size );
-#endif
+			SendDatagrams( datagrams, count );
+		}
+
+		send_batch_++;
 	}
 
 	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override
 	{
 		if( disconnected_ ) return 0u;
 
-		if( IsSocketReady( tcp_socket_ ) )
+		if( reliable_over_udp_ )
 		{
+			// Reliable data arrives in datagrams. Tcp connection is needed only for detection of disconnection.
+			CheckTcpClosed();
+			if( received_datagram_index_ == received_datagram_count_ )
+				ReceiveDatagrams();
+
+			PumpReliableData();
+			return reliable_channel_.Read( out_data, buffer_size );
+		}
+
+		if( reactor_->TakeReadiness( tcp_watch_ ) )
+		{
+			counters_->receive_syscalls++;
 #ifdef _WIN32
 			int result= ::recv( tcp_socket_, (char*) out_data, buffer_size, 0 );
 			if( result == SOCKET_ERROR )
 				Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
 #else
-			int result= ::recv( tcp_socket_, (char*) out_data, buffer_size, 0 );
-			if( result == -1 )
+			int result= ::recv( tcp_socket_, (char*) out_data, buffer_size, MSG_DONTWAIT );
+			if( result == -1 && errno != EAGAIN && errno != EWOULDBLOCK )
 				Log::Warning( FUNC_NAME, " error: ", errno );
 #endif
 			// If socket is ready, but recv return zero, this means, that other side closes connection.
 			if( result == 0 )
 				Disconnect();
+			// Buffer is full - socket may have more data.
+			if( result == static_cast<int>(buffer_size) )
+				reactor_->MarkReady( tcp_watch_ );
 
+			counters_->bytes_received+= std::max( 0, result );
 			return std::max( 0, result );
 		}
 		return 0u;
@@ -279,49 +875,35 @@ public: // IConnection
 	{
 		if( disconnected_ ) return 0u;
 
-		if( IsSocketReady( udp_socket_ ) )
+		while(1)
 		{
-#ifdef _WIN32
-			sockaddr_in reciever_address;
-			int reciever_address_length= sizeof(reciever_address);
-			int result=
-				::recvfrom( udp_socket_, (char*) out_data, buffer_size, 0, (sockaddr*) &reciever_address, &reciever_address_length );
-
-			if( result == SOCKET_ERROR )
+			if( received_datagram_index_ == received_datagram_count_ )
 			{
-				Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
-				return 0u;
+				ReceiveDatagrams();
+				if( received_datagram_count_ == 0u )
+					return 0u;
 			}
 
-			if( !( // Check for correct addres - discard messages from invalid address.
-				reciever_address.sin_addr.S_un.S_addr == destination_udp_address_.sin_addr.S_un.S_addr &&
-				reciever_address.sin_port == destination_udp_address_.sin_port ) )
-			{
-				return 0u;
-			}
-#else
-			sockaddr_in reciever_address;
-			socklen_t reciever_address_length= sizeof(reciever_address);
-			int result=
-				::recvfrom( udp_socket_, (char*) out_data, buffer_size, 0, (sockaddr*) &reciever_address, &reciever_address_length );
+			const ReceivedDatagram& datagram= received_datagrams_[ received_datagram_index_ ];
+			const unsigned int payload_offset= received_payload_offsets_[ received_datagram_index_ ];
 
-			if( result == -1 )
+			// Dropped datagram, or datagram without unreliable data.
+			if( datagram.size <= payload_offset )
 			{
-				Log::Warning( FUNC_NAME, " error: ", errno );
-				return 0u;
+				received_datagram_index_++;
+				continue;
 			}
 
-			if( !( // Check for correct addres - discard messages from invalid address.
-				reciever_address.sin_addr.s_addr == destination_udp_address_.sin_addr.s_addr &&
-				reciever_address.sin_port == destination_udp_address_.sin_port ) )
-			{
+			// Payload does not fit into buffer - leave datagram for next call.
+			const unsigned int data_size= datagram.size - payload_offset;
+			if( data_size > buffer_size )
 				return 0u;
-			}
-#endif
 
-			return std::max( result, 0 );
+			received_datagram_index_++;
+
+			std::memcpy( out_data, datagram.data + payload_offset, data_size );
+			return data_size;
 		}
-		return 0;
 	}
 
 	virtual void Disconnect() override
@@ -332,12 +914,12 @@ public: // IConnection
 #ifdef _WIN32
 		if( ::shutdown( tcp_socket_, SD_BOTH ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing tcp connection: ", ::WSAGetLastError() );
-		if( ::shutdown( udp_socket_, SD_BOTH ) != 0 )
+		if( shared_udp_socket_ == nullptr && ::shutdown( udp_socket_, SD_BOTH ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing udp connection: ", ::WSAGetLastError() );
 #else
 		if( ::shutdown( tcp_socket_, SHUT_RDWR ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing tcp connection: ", errno );
-		if( ::shutdown( udp_socket_, SHUT_RDWR ) != 0 )
+		if( shared_udp_socket_ == nullptr && ::shutdown( udp_socket_, SHUT_RDWR ) != 0 )
 			Log::Warning( FUNC_NAME, " error, during closing udp connection: ", errno );
 #endif
 	}
@@ -359,139 +941,504 @@ public: // IConnection
 	}
 
 private:
-	const SOCKET tcp_socket_= INVALID_SOCKET;
-	const SOCKET udp_socket_= INVALID_SOCKET;
-	const sockaddr_in destination_udp_address_;
+	static constexpr unsigned int c_max_received_datagrams= 16u;
+	static constexpr unsigned int c_max_datagrams_per_call= 16u;
+	static constexpr unsigned int c_max_reliable_datagrams= 16u; // Per one sending.
 
-	bool disconnected_= false;
-};
+	struct OutgoingDatagram
+	{
+		const void* reliable_data;
+		unsigned int reliable_size;
+		const void* data;
+		unsigned int size;
+	};
 
-class EstablishingConnection
-{
-public:
-	EstablishingConnection(
-		const SOCKET tcp_socket,
-		const IpAddress client_ip_address,
-		const uint16_t udp_port )
-		: tcp_socket_(tcp_socket)
-		, client_ip_address_(client_ip_address)
+private:
+	void SendDatagrams( const OutgoingDatagram* const datagrams, const unsigned int count )
 	{
-#ifdef _WIN32
-		// Send to client protocol version, wia tcp.
-		uint32_t protocol_version= Messages::c_protocol_version;
-		::send( tcp_socket_, (char*) &protocol_version, sizeof(protocol_version), 0 ); // TODO - check errors.
+		PC_ASSERT( count <= c_max_datagrams_per_call );
 
-		// Send to client input udp address, wia tcp.
-		::send( tcp_socket_, (char*) &udp_port, sizeof(udp_port), 0 ); // TODO - check errors.
+		UnreliablePacketHeader headers[ c_max_datagrams_per_call ];
+		for( unsigned int i= 0u; i < count; i++ )
+		{
+			UnreliablePacketHeader& header= headers[i];
+			header.token= token_;
+			header.sequence= send_sequence_;
+			header.batch= send_batch_;
+			header.ack_sequence= last_received_sequence_;
+			header.ack_bits= received_bits_;
+			header.reliable_size= static_cast<uint16_t>( datagrams[i].reliable_size );
+			send_sequence_++;
+		}
+
+		// Any datagram carries acknowledgements.
+		acknowledgement_pending_= false;
+		acknowledgement_delayed_= false;
 
-		udp_socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
-		if( udp_socket_ == INVALID_SOCKET )
+#ifdef __linux__
+		// Send all datagrams with one system call.
+		mmsghdr messages[ c_max_datagrams_per_call ];
+		iovec io_vectors[ c_max_datagrams_per_call ][3];
+		std::memset( messages, 0, sizeof(mmsghdr) * count );
+		for( unsigned int i= 0u; i < count; i++ )
 		{
-			Log::Warning( "Can not create udp socket. Error code: ", ::WSAGetLastError() );
-			// TODO - to something.
-			return;
+			io_vectors[i][0].iov_base= &headers[i];
+			io_vectors[i][0].iov_len= sizeof(UnreliablePacketHeader);
+			io_vectors[i][1].iov_base= const_cast<void*>( datagrams[i].reliable_data );
+			io_vectors[i][1].iov_len= datagrams[i].reliable_size;
+			io_vectors[i][2].iov_base= const_cast<void*>( datagrams[i].data );
+			io_vectors[i][2].iov_len= datagrams[i].size;
+
+			messages[i].msg_hdr.msg_name= const_cast<sockaddr_in*>( &destination_udp_address_ );
+			messages[i].msg_hdr.msg_namelen= sizeof(destination_udp_address_);
+			messages[i].msg_hdr.msg_iov= io_vectors[i];
+			messages[i].msg_hdr.msg_iovlen= 3u;
 		}
 
-		sockaddr_in udp_address;
-		udp_address.sin_family= AF_INET;
-		udp_address.sin_addr.s_addr= INADDR_ANY;
-		udp_address.sin_port= ::htons( udp_port );
-		const int bind_result= ::bind( udp_socket_, (sockaddr*) &udp_address, sizeof(udp_address) );
-		if( bind_result != 0 )
+		unsigned int sent= 0u;
+		while( sent < count )
 		{
-			Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", ::WSAGetLastError() );
-			return;
+			counters_->send_syscalls++;
+			const int result= ::sendmmsg( udp_socket_, messages + sent, count - sent, 0 );
+			if( result <= 0 )
+			{
+				Log::Warning( FUNC_NAME, " error: ", errno );
+				break;
+			}
+
+			for( unsigned int i= sent; i < sent + static_cast<unsigned int>(result); i++ )
+				counters_->bytes_sent+= messages[i].msg_len;
+			counters_->packets_sent+= result;
+			sent+= result;
 		}
 #else
-		// Send to client protocol version, wia tcp.
-		uint32_t protocol_version= Messages::c_protocol_version;
-		::send( tcp_socket_, (char*) &protocol_version, sizeof(protocol_version), 0 ); // TODO - check errors.
+		for( unsigned int i= 0u; i < count; i++ )
+		{
+			unsigned char datagram[ c_max_datagram_size ];
+			const unsigned int datagram_size= sizeof(UnreliablePacketHeader) + datagrams[i].reliable_size + datagrams[i].size;
+			PC_ASSERT( datagram_size <= c_max_datagram_size );
+			std::memcpy( datagram, &headers[i], sizeof(UnreliablePacketHeader) );
+			if( datagrams[i].reliable_size > 0u )
+				std::memcpy( datagram + sizeof(UnreliablePacketHeader), datagrams[i].reliable_data, datagrams[i].reliable_size );
+			if( datagrams[i].size > 0u )
+				std::memcpy( datagram + sizeof(UnreliablePacketHeader) + datagrams[i].reliable_size, datagrams[i].data, datagrams[i].size );
+
+			counters_->send_syscalls++;
+			const int result=
+				::sendto( udp_socket_, (const char*) datagram, datagram_size, 0, (sockaddr*) &destination_udp_address_, sizeof(destination_udp_address_) );
 
-		// Send to client input udp address, wia tcp.
-		::send( tcp_socket_, (char*) &udp_port, sizeof(udp_port), 0 ); // TODO - check errors.
+#ifdef _WIN32
+			if( result == SOCKET_ERROR )
+			{
+				Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
+				continue;
+			}
+#else
+			if( result == -1 )
+			{
+				Log::Warning( FUNC_NAME, " error: ", errno );
+				continue;
+			}
+#endif
+			if( result < static_cast<int>(datagram_size) )
+				Log::Warning( FUNC_NAME, " not all data transmited: ", result, " from ", datagram_size );
 
-		udp_socket_= ::socket( AF_INET, SOCK_DGRAM, 0 );
-		if( udp_socket_ == -1 )
+			counters_->packets_sent++;
+			counters_->bytes_sent+= result;
+		}
+#endif
+	}
+
+	// Build datagrams with reliable data, which must be sent now.
+	// These datagrams must be sent first in next "SendDatagrams" call, because their sequence numbers are used here.
+	unsigned int BuildReliableDatagrams()
+	{
+		if( !reliable_over_udp_ )
+			return 0u;
+
+		const Time current_time= Time::CurrentTime();
+
+		unsigned int count= 0u;
+		while( count < c_max_reliable_datagrams )
 		{
-			Log::Warning( "Can not create udp socket. Error code: ", errno );
-			// TODO - to something.
-			return;
+			const unsigned int size=
+				reliable_channel_.BuildDatagram(
+					static_cast<uint16_t>( send_sequence_ + count ),
+					current_time,
+					reliable_datagrams_[ count ],
+					c_max_unreliable_packet_size );
+			if( size == 0u )
+				break;
+
+			reliable_datagrams_size_[ count ]= size;
+			count++;
 		}
 
-		sockaddr_in udp_address;
-		udp_address.sin_family= AF_INET;
-		udp_address.sin_addr.s_addr= INADDR_ANY;
-		udp_address.sin_port= htons( udp_port );
-		const int bind_result= ::bind( udp_socket_, (sockaddr*) &udp_address, sizeof(udp_address) );
-		if( bind_result != 0 )
+		return count;
+	}
+
+	// Send reliable data and acknowledgements, if there are no unreliable packets for it.
+	void PumpReliableData()
+	{
+		if( reliable_channel_.TimedOut( Time::CurrentTime() ) )
 		{
-			Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", errno );
+			Log::Warning( "Reliable data is not acknowledged for too long time. Disconnect ", GetConnectionInfo() );
+			Disconnect();
 			return;
 		}
+
+		OutgoingDatagram datagrams[ c_max_reliable_datagrams ];
+		unsigned int count= BuildReliableDatagrams();
+		for( unsigned int i= 0u; i < count; i++ )
+		{
+			datagrams[i].reliable_data= reliable_datagrams_[i];
+			datagrams[i].reliable_size= reliable_datagrams_size_[i];
+			datagrams[i].data= nullptr;
+			datagrams[i].size= 0u;
+		}
+
+		if( count == 0u && acknowledgement_pending_ )
+		{
+			// Wait one more reading for unreliable packets, which carry acknowledgements, before sending of empty datagram.
+			if( !acknowledgement_delayed_ )
+			{
+				acknowledgement_delayed_= true;
+				return;
+			}
+
+			datagrams[0].reliable_data= nullptr;
+			datagrams[0].reliable_size= 0u;
+			datagrams[0].data= nullptr;
+			datagrams[0].size= 0u;
+			count= 1u;
+		}
+
+		if( count > 0u )
+			SendDatagrams( datagrams, count );
+	}
+
+	void CheckTcpClosed()
+	{
+		if( !reactor_->TakeReadiness( tcp_watch_ ) )
+			return;
+
+		unsigned char buffer[ 64u ];
+		counters_->receive_syscalls++;
+#ifdef _WIN32
+		const int result= ::recv( tcp_socket_, (char*) buffer, sizeof(buffer), 0 );
+#else
+		const int result= ::recv( tcp_socket_, (char*) buffer, sizeof(buffer), MSG_DONTWAIT );
 #endif
+		// If socket is ready, but recv return zero, this means, that other side closes connection.
+		if( result == 0 )
+			Disconnect();
 	}
 
-	IConnectionPtr TryCompleteConnection()
+	// Read available datagrams into queue and process their headers and reliable data.
+	void ReceiveDatagrams()
 	{
-		if( !IsSocketReady( udp_socket_ ) )
-			return nullptr;
+		ReceiveDatagramsImpl();
+
+		const Time current_time= Time::CurrentTime();
+		for( unsigned int i= 0u; i < received_datagram_count_; i++ )
+		{
+			if( !ProcessDatagram( received_datagrams_[i], received_payload_offsets_[i], current_time ) )
+				received_datagrams_[i].size= 0u;
+		}
+	}
 
-		// Recieve any message from client to estabelishing of connection.
-		// Use MSG_PEEK, because we not want to dump really meaning message.
-		unsigned char dummy_buffer[ IConnection::c_max_unreliable_packet_size ];
+	void ReceiveDatagramsImpl()
+	{
+		received_datagram_index_= 0u;
+		received_datagram_count_= 0u;
 
-		sockaddr_in reciever_address;
+		if( shared_udp_socket_ != nullptr )
+		{
+			received_datagram_count_= shared_udp_socket_->Receive( token_, received_datagrams_, c_max_received_datagrams );
+			return;
+		}
+
+#ifdef __linux__
+		// Read all available datagrams with one system call.
+		mmsghdr messages[ c_max_received_datagrams ];
+		iovec io_vectors[ c_max_received_datagrams ];
+		sockaddr_in reciever_addresses[ c_max_received_datagrams ];
+		std::memset( messages, 0, sizeof(messages) );
+		for( unsigned int i= 0u; i < c_max_received_datagrams; i++ )
+		{
+			io_vectors[i].iov_base= received_datagrams_[i].data;
+			io_vectors[i].iov_len= sizeof(received_datagrams_[i].data);
+
+			messages[i].msg_hdr.msg_name= &reciever_addresses[i];
+			messages[i].msg_hdr.msg_namelen= sizeof(reciever_addresses[i]);
+			messages[i].msg_hdr.msg_iov= &io_vectors[i];
+			messages[i].msg_hdr.msg_iovlen= 1u;
+		}
+
+		if( !reactor_->TakeReadiness( udp_watch_ ) )
+			return;
+
+		counters_->receive_syscalls++;
+		const int result= ::recvmmsg( udp_socket_, messages, c_max_received_datagrams, MSG_DONTWAIT, nullptr );
+		if( result == -1 )
+		{
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+				Log::Warning( FUNC_NAME, " error: ", errno );
+			return;
+		}
+
+		// Queue is full - socket may have more datagrams.
+		if( static_cast<unsigned int>(result) == c_max_received_datagrams )
+			reactor_->MarkReady( udp_watch_ );
+
+		for( unsigned int i= 0u; i < static_cast<unsigned int>(result); i++ )
+		{
+			received_datagrams_[i].size= messages[i].msg_len;
+			counters_->packets_received++;
+			counters_->bytes_received+= messages[i].msg_len;
+
+			// Check for correct addres - discard messages from invalid address.
+			if( !(
+				reciever_addresses[i].sin_addr.s_addr == destination_udp_address_.sin_addr.s_addr &&
+				reciever_addresses[i].sin_port == destination_udp_address_.sin_port ) )
+				received_datagrams_[i].size= 0u;
+		}
+		received_datagram_count_= static_cast<unsigned int>(result);
+#else
+		if( !reactor_->TakeReadiness( udp_watch_ ) )
+			return;
+
+		ReceivedDatagram& datagram= received_datagrams_[0];
+		counters_->receive_syscalls++;
 #ifdef _WIN32
+		sockaddr_in reciever_address;
 		int reciever_address_length= sizeof(reciever_address);
 		int result=
-			::recvfrom(
-				udp_socket_,
-				(char*) &dummy_buffer, sizeof(dummy_buffer),
-				MSG_PEEK,
-				(sockaddr*) &reciever_address, &reciever_address_length );
+			::recvfrom( udp_socket_, (char*) datagram.data, sizeof(datagram.data), 0, (sockaddr*) &reciever_address, &reciever_address_length );
 
 		if( result == SOCKET_ERROR )
 		{
 			Log::Warning( FUNC_NAME, " error: ", ::WSAGetLastError() );
-			return nullptr;
+			return;
 		}
 
-		if( reciever_address.sin_addr.S_un.S_addr != client_ip_address_ )
-		{
-			Log::Info( "Unknown user ", inet_ntoa( reciever_address.sin_addr ), " trying to connect. Discard him." );
-			return nullptr;
-		}
+		const bool address_is_correct=
+			reciever_address.sin_addr.S_un.S_addr == destination_udp_address_.sin_addr.S_un.S_addr &&
+			reciever_address.sin_port == destination_udp_address_.sin_port;
 #else
+		sockaddr_in reciever_address;
 		socklen_t reciever_address_length= sizeof(reciever_address);
 		int result=
-			::recvfrom(
-				udp_socket_,
-				(char*) &dummy_buffer, sizeof(dummy_buffer),
-				MSG_PEEK,
-				(sockaddr*) &reciever_address, &reciever_address_length );
+			::recvfrom( udp_socket_, (char*) datagram.data, sizeof(datagram.data), 0, (sockaddr*) &reciever_address, &reciever_address_length );
 
 		if( result == -1 )
 		{
 			Log::Warning( FUNC_NAME, " error: ", errno );
-			return nullptr;
+			return;
 		}
 
-		if( reciever_address.sin_addr.s_addr != client_ip_address_ )
+		const bool address_is_correct=
+			reciever_address.sin_addr.s_addr == destination_udp_address_.sin_addr.s_addr &&
+			reciever_address.sin_port == destination_udp_address_.sin_port;
+#endif
+		counters_->packets_received++;
+		counters_->bytes_received+= result;
+
+		// Check for correct addres - discard messages from invalid address.
+		datagram.size= address_is_correct ? static_cast<unsigned int>(result) : 0u;
+		received_datagram_count_= 1u;
+#endif
+	}
+
+	// Check header of datagram, update acknowledgement state, process reliable data.
+	// Returns true, if datagram contains unreliable data, which must be delivered.
+	// Datagrams without header (like handshake), duplicates and unreliable data of old batches are dropped.
+	bool ProcessDatagram( const ReceivedDatagram& datagram, unsigned int& out_payload_offset, const Time current_time )
+	{
+		if( datagram.size < sizeof(UnreliablePacketHeader) )
 		{
-			Log::Info( "Unknown user ", inet_ntoa( reciever_address.sin_addr ), " trying to connect. Discard him." );
-			return nullptr;
+			counters_->packets_dropped++;
+			return false;
 		}
-#endif
+
+		UnreliablePacketHeader header;
+		std::memcpy( &header, datagram.data, sizeof(UnreliablePacketHeader) );
+
+		if( header.token != token_ ||
+			header.reliable_size > datagram.size - sizeof(UnreliablePacketHeader) ||
+			!UpdateReceivedSequence( header.sequence ) )
+		{
+			counters_->packets_dropped++;
+			return false;
+		}
+
+		if( reliable_over_udp_ )
+			reliable_channel_.OnDatagramsAcknowledged( header.ack_sequence, header.ack_bits, current_time );
+
+		if( header.reliable_size > 0u )
+		{
+			if( !reliable_over_udp_ ||
+				!reliable_channel_.ProcessSegments( datagram.data + sizeof(UnreliablePacketHeader), header.reliable_size ) )
+			{
+				Log::Warning( "Broken reliable data. Disconnect ", GetConnectionInfo() );
+				Disconnect();
+				return false;
+			}
+			acknowledgement_pending_= true;
+		}
+
+		out_payload_offset= sizeof(UnreliablePacketHeader) + header.reliable_size;
+		if( out_payload_offset == datagram.size )
+			return false;
+
+		// Unreliable data of old batches is outdated. Drop it.
+		if( has_received_batch_ && int16_t( header.batch - last_received_batch_ ) < 0 )
+		{
+			counters_->packets_dropped++;
+			return false;
+		}
+		last_received_batch_= header.batch;
+		has_received_batch_= true;
+
+		return true;
+	}
+
+	// Returns false for duplicates and too old datagrams.
+	bool UpdateReceivedSequence( const uint16_t sequence )
+	{
+		if( !has_received_packets_ )
+		{
+			has_received_packets_= true;
+			last_received_sequence_= sequence;
+			received_bits_= 0u;
+			return true;
+		}
+
+		// Bit "i" of "received_bits_" means, that packet with sequence "last_received_sequence_ - i - 1" was received.
+		const int sequence_delta= int16_t( sequence - last_received_sequence_ );
+		if( sequence_delta > 0 )
+		{
+			received_bits_= sequence_delta <= 32 ? ( ( ( received_bits_ << 1u ) | 1u ) << ( sequence_delta - 1 ) ) : 0u;
+			last_received_sequence_= sequence;
+		}
+		else if( sequence_delta == 0 )
+			return false;
+		else
+		{
+			if( -sequence_delta > 32 )
+				return false;
+
+			const uint32_t bit= 1u << ( -sequence_delta - 1 );
+			if( ( received_bits_ & bit ) != 0u )
+				return false;
+			received_bits_|= bit;
+		}
+
+		return true;
+	}
+
+private:
+	const SOCKET tcp_socket_= INVALID_SOCKET;
+	const SOCKET udp_socket_= INVALID_SOCKET;
+	const sockaddr_in destination_udp_address_;
+	const uint32_t token_;
+	const bool reliable_over_udp_;
+	const std::shared_ptr<NetCounters> counters_;
+	const NetReactorPtr reactor_;
+	const SharedUdpSocketPtr shared_udp_socket_; // Null for client connections.
+	NetReactor::SocketWatch tcp_watch_;
+	NetReactor::SocketWatch udp_watch_;
+
+	// Sequence starts from 1, because before receiving of any datagram other side sends zero acknowledgement sequence.
+	uint16_t send_sequence_= 1u;
+	uint16_t send_batch_= 0u;
+
+	bool has_received_packets_= false;
+	uint16_t last_received_sequence_= 0u;
+	uint32_t received_bits_= 0u;
+	bool has_received_batch_= false;
+	uint16_t last_received_batch_= 0u;
+
+	ReliableChannel reliable_channel_;
+	bool acknowledgement_pending_= false; // Reliable data received, but not acknowledged.
+	bool acknowledgement_delayed_= false;
+
+	unsigned int received_datagram_index_= 0u;
+	unsigned int received_datagram_count_= 0u;
+
+	bool disconnected_= false;
+
+	// Put large objects here.
+	unsigned int reliable_datagrams_size_[ c_max_reliable_datagrams ];
+	unsigned char reliable_datagrams_[ c_max_reliable_datagrams ][ c_max_unreliable_packet_size ];
+	unsigned int received_payload_offsets_[ c_max_received_datagrams ];
+	ReceivedDatagram received_datagrams_[ c_max_received_datagrams ];
+};
+
+constexpr unsigned int NetConnection::c_max_received_datagrams;
+constexpr unsigned int NetConnection::c_max_datagrams_per_call;
+constexpr unsigned int NetConnection::c_max_reliable_datagrams;
+
+class EstablishingConnection
+{
+public:
+	EstablishingConnection(
+		const SOCKET tcp_socket,
+		const IpAddress client_ip_address,
+		SharedUdpSocketPtr udp_socket,
+		const bool reliable_over_udp,
+		std::shared_ptr<NetCounters> counters,
+		NetReactorPtr reactor )
+		: tcp_socket_(tcp_socket)
+		, udp_socket_( std::move(udp_socket) )
+		, reliable_over_udp_( reliable_over_udp )
+		, counters_( std::move(counters) )
+		, reactor_( std::move(reactor) )
+		, token_( udp_socket_->AddClient( client_ip_address ) )
+	{
+		// Send to client protocol version, wia tcp.
+		uint32_t protocol_version= Messages::c_protocol_version;
+		::send( tcp_socket_, (char*) &protocol_version, sizeof(protocol_version), 0 ); // TODO - check errors.
+
+		// Send to client input udp address, wia tcp.
+		const uint16_t udp_port= udp_socket_->GetPort();
+		::send( tcp_socket_, (char*) &udp_port, sizeof(udp_port), 0 ); // TODO - check errors.
+
+		// Send to client token for udp handshake, wia tcp.
+		::send( tcp_socket_, (char*) &token_, sizeof(token_), 0 ); // TODO - check errors.
+
+		// Send to client connection flags, wia tcp.
+		const uint32_t flags= reliable_over_udp_ ? c_connection_flag_reliable_over_udp : 0u;
+		::send( tcp_socket_, (char*) &flags, sizeof(flags), 0 ); // TODO - check errors.
+	}
+
+	~EstablishingConnection()
+	{
+		if( tcp_socket_ != INVALID_SOCKET )
+			udp_socket_->RemoveClient( token_ );
+	}
+
+	IConnectionPtr TryCompleteConnection()
+	{
+		// Wait for handshake from client, which binds client udp address to connection.
+		sockaddr_in client_udp_address;
+		if( !udp_socket_->GetClientAddress( token_, client_udp_address ) )
+			return nullptr;
 
 		const SOCKET tcp_socket= tcp_socket_; tcp_socket_= INVALID_SOCKET;
-		const SOCKET udp_socket= udp_socket_; udp_socket_= INVALID_SOCKET;
-		return std::make_shared<NetConnection>( tcp_socket, udp_socket, reciever_address );
+		return
+			std::make_shared<NetConnection>(
+				tcp_socket, udp_socket_->GetSocket(), client_udp_address, token_, reliable_over_udp_,
+				counters_, reactor_, udp_socket_ );
 	}
 
 private:
 	SOCKET tcp_socket_= INVALID_SOCKET;
-	SOCKET udp_socket_= INVALID_SOCKET;
-	const IpAddress client_ip_address_;
+	const SharedUdpSocketPtr udp_socket_;
+	const bool reliable_over_udp_;
+	const std::shared_ptr<NetCounters> counters_;
+	const NetReactorPtr reactor_;
+	const uint32_t token_;
 };
 
 typedef std::unique_ptr<EstablishingConnection> EstablishingConnectionPtr;
@@ -501,10 +1448,19 @@ class ServerListener final : public IConnectionsListener
 public:
 	ServerListener(
 		const uint16_t tcp_port,
-		const uint16_t base_udp_port )
+		const uint16_t udp_port,
+		const bool reliable_over_udp,
+		std::shared_ptr<NetCounters> counters,
+		NetReactorPtr reactor )
 		: listen_port_( tcp_port )
-		, next_in_udp_port_( base_udp_port )
+		, reliable_over_udp_( reliable_over_udp )
+		, counters_( std::move(counters) )
+		, reactor_( std::move(reactor) )
+		, udp_socket_( std::make_shared<SharedUdpSocket>( udp_port, counters_, reactor_ ) )
 	{
+		if( !udp_socket_->IsOk() )
+			return;
+
 #ifdef _WIN32
 		listen_socket_= ::socket( PF_INET, SOCK_STREAM, 0 );
 		if( listen_socket_ == INVALID_SOCKET )
@@ -564,13 +1520,20 @@ public:
 			::close( listen_socket_ );
 			return;
 		}
+
+		// Accept connections without blocking, because after readiness notification
+		// we accept until pending connections end.
+		::fcntl( listen_socket_, F_SETFL, ::fcntl( listen_socket_, F_GETFL, 0 ) | O_NONBLOCK );
 #endif
 
+		reactor_->Add( listen_watch_, listen_socket_ );
 		all_ok_= true;
 	}
 
 	~ServerListener()
 	{
+		reactor_->Remove( listen_watch_ );
+
 #ifdef _WIN32
 		if( listen_socket_ != INVALID_SOCKET )
 			::closesocket( listen_socket_ );
@@ -588,7 +1551,7 @@ public:
 public: // IConnectionsListener
 	virtual IConnectionPtr GetNewConnection() override
 	{
-		if( IsSocketReady( listen_socket_ ) )
+		if( reactor_->TakeReadiness( listen_watch_ ) )
 		{
 #ifdef _WIN32
 			sockaddr_in client_address;
@@ -614,20 +1577,24 @@ public: // IConnectionsListener
 
 			if( client_tcp_socket == -1 )
 			{
-				Log::Warning( "Can not accept client. Error code: ", errno );
+				if( errno != EAGAIN && errno != EWOULDBLOCK )
+					Log::Warning( "Can not accept client. Error code: ", errno );
 				return nullptr;
 			}
 
+			// More clients may wait for accepting.
+			reactor_->MarkReady( listen_watch_ );
+
 			const IpAddress client_ip_address= client_address.sin_addr.s_addr;
 #endif
-			const uint16_t connection_in_udp_port= next_in_udp_port_;
-			++next_in_udp_port_;
-
 			establishing_connections_.emplace_back(
 			new EstablishingConnection(
 				client_tcp_socket,
 				client_ip_address,
-				connection_in_udp_port ) );
+				udp_socket_,
+				reliable_over_udp_,
+				counters_,
+				reactor_ ) );
 		}
 
 		// Try complete establishing connections.
@@ -648,8 +1615,12 @@ public: // IConnectionsListener
 private:
 	SOCKET listen_socket_= INVALID_SOCKET;
 	const uint16_t listen_port_;
-	uint16_t next_in_udp_port_;
+	const bool reliable_over_udp_;
 	bool all_ok_= false;
+	const std::shared_ptr<NetCounters> counters_;
+	const NetReactorPtr reactor_;
+	const SharedUdpSocketPtr udp_socket_;
+	NetReactor::SocketWatch listen_watch_;
 
 	std::vector< EstablishingConnectionPtr> establishing_connections_;
 };
@@ -663,6 +1634,8 @@ struct Net::PlatformData
 };
 
 Net::Net()
+	: counters_( std::make_shared<NetCounters>() )
+	, reactor_( std::make_shared<NetReactor>( counters_ ) )
 {
 	platform_data_.reset( new PlatformData );
 
@@ -762,14 +1735,22 @@ IConnectionPtr Net::ConnectToServer( const InetAddress& address )
 	std::memcpy( &server_udp_address, &server_tcp_address, sizeof(sockaddr_in) );
 	server_udp_address.sin_port= ::htons( server_udp_port );
 
+	// Recive from server token of connection.
+	uint32_t token;
+	::recv( tcp_socket, (char*) &token, sizeof(token), 0 ); // TODO - check errors.
+
+	// Recive from server connection flags.
+	uint32_t flags;
+	::recv( tcp_socket, (char*) &flags, sizeof(flags), 0 ); // TODO - check errors.
+
 	// Send to server first udp message for establishing of connection.
 	// Make NAT happy.
 	// Make this multiple times, for better reliability.
+	UdpHandshake handshake;
+	handshake.magic= c_udp_handshake_magic;
+	handshake.token= token;
 	for( unsigned int n= 0u; n < 4u; n++ )
-	{
-		Messages::DummyNetMessage first_message;
-		::sendto( udp_socket, (char*) &first_message, sizeof(first_message), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
-	}
+		::sendto( udp_socket, (char*) &handshake, sizeof(handshake), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
 #else
 	// Create and open TCP socket.
 	const SOCKET tcp_socket= ::socket( AF_INET, SOCK_STREAM, 0 );
@@ -791,7 +1772,7 @@ IConnectionPtr Net::ConnectToServer( const InetAddress& address )
 	sockaddr_in udp_address;
 	udp_address.sin_family= AF_INET;
 	udp_address.sin_addr.s_addr= INADDR_ANY;
-	udp_address.sin_port= htons( in_udp_port );
+	udp_address.sin_port= 0;
 	if( ::bind( udp_socket, (sockaddr*) &udp_address, sizeof(udp_address) ) != 0 )
 	{
 		Log::Warning( FUNC_NAME, " can not bind udp socket. Error code: ", errno );
@@ -834,24 +1815,37 @@ IConnectionPtr Net::ConnectToServer( const InetAddress& address )
 	std::memcpy( &server_udp_address, &server_tcp_address, sizeof(sockaddr_in) );
 	server_udp_address.sin_port= htons( server_udp_port );
 
+	// Recive from server token of connection.
+	uint32_t token;
+	::recv( tcp_socket, (char*) &token, sizeof(token), 0 ); // TODO - check errors.
+
+	// Recive from server connection flags.
+	uint32_t flags;
+	::recv( tcp_socket, (char*) &flags, sizeof(flags), 0 ); // TODO - check errors.
+
 	// Send to server first udp message for establishing of connection.
 	// Make NAT happy.
 	// Make this multiple times, for better reliability.
+	UdpHandshake handshake;
+	handshake.magic= c_udp_handshake_magic;
+	handshake.token= token;
 	for( unsigned int n= 0u; n < 4u; n++ )
-	{
-		Messages::DummyNetMessage first_message;
-		::sendto( udp_socket, (char*) &first_message, sizeof(first_message), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
-	}
+		::sendto( udp_socket, (char*) &handshake, sizeof(handshake), 0, (sockaddr*) &server_udp_address, sizeof(server_udp_address) );
 #endif
 
-	return std::make_shared<NetConnection>( tcp_socket, udp_socket, server_udp_address );
+	return
+		std::make_shared<NetConnection>(
+			tcp_socket, udp_socket, server_udp_address, token,
+			( flags & c_connection_flag_reliable_over_udp ) != 0u,
+			counters_, reactor_ );
 }
 
 IConnectionsListenerPtr Net::CreateServerListener(
 	const uint16_t tcp_port,
-	const uint16_t base_udp_port )
+	const uint16_t udp_port,
+	const bool reliable_over_udp )
 {
-	const auto listener= std::make_shared<ServerListener>( tcp_port, base_udp_port );
+	const auto listener= std::make_shared<ServerListener>( tcp_port, udp_port, reliable_over_udp, counters_, reactor_ );
 
 	if( listener->IsOk() )
 		return listener;
@@ -859,4 +1853,38 @@ IConnectionsListenerPtr Net::CreateServerListener(
 	return nullptr;
 }
 
+void Net::Poll( const Time max_wait_time )
+{
+	reactor_->Poll( max_wait_time );
+}
+
+const NetCounters& Net::GetCounters() const
+{
+	return *counters_;
+}
+
+void Net::PrintStats() const
+{
+	const NetCounters& c= *counters_;
+	const uint64_t send_syscalls= c.send_syscalls.load();
+	const uint64_t packets_sent= c.packets_sent.load();
+
+	Log::Info( "Send syscalls: ", send_syscalls, ", packets sent: ", packets_sent, ", bytes sent: ", c.bytes_sent.load() );
+	Log::Info( "Receive syscalls: ", c.receive_syscalls.load(), ", packets received: ", c.packets_received.load(), ", bytes received: ", c.bytes_received.load() );
+	Log::Info( "Poll syscalls: ", c.poll_syscalls.load() );
+	Log::Info( "Packets dropped: ", c.packets_dropped.load() );
+
+	const uint64_t reliable_segments_acknowledged= c.reliable_segments_acknowledged.load();
+	Log::Info(
+		"Reliable segments sent: ", c.reliable_segments_sent.load(),
+		", resent: ", c.reliable_segments_resent.load(),
+		", acknowledged: ", reliable_segments_acknowledged );
+	if( reliable_segments_acknowledged > 0u )
+		Log::Info(
+			"Average reliable delivery time: ",
+			float( c.reliable_delivery_time_us.load() ) / float( reliable_segments_acknowledged ) / 1000.0f, " ms" );
+	if( send_syscalls > 0u )
+		Log::Info( "Packets per send syscall: ", float(packets_sent) / float(send_syscalls) );
+}
+
 } // namespace PanzerChasm
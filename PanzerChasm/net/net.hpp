@@ -1,5 +1,8 @@
 #pragma once
+#include <atomic>
+
 #include "../fwd.hpp"
+#include "../time.hpp"
 
 namespace PanzerChasm
 {
@@ -16,11 +19,32 @@ struct InetAddress
 	std::string ToString() const;
 };
 
+// Counters of network traffic, shared between all connections of one Net instance.
+// Connections may be used from different threads, so, counters are atomic.
+struct NetCounters
+{
+	std::atomic<uint64_t> send_syscalls{0u};
+	std::atomic<uint64_t> receive_syscalls{0u};
+	std::atomic<uint64_t> poll_syscalls{0u};
+	std::atomic<uint64_t> packets_sent{0u};
+	std::atomic<uint64_t> packets_received{0u};
+	std::atomic<uint64_t> bytes_sent{0u};
+	std::atomic<uint64_t> bytes_received{0u};
+	std::atomic<uint64_t> packets_dropped{0u}; // Invalid, duplicated or stale packets.
+
+	std::atomic<uint64_t> reliable_segments_sent{0u};
+	std::atomic<uint64_t> reliable_segments_resent{0u};
+	std::atomic<uint64_t> reliable_segments_acknowledged{0u};
+	std::atomic<uint64_t> reliable_delivery_time_us{0u}; // Sum of times between first sending and acknowledgement.
+};
+
+class NetReactor;
+
 class Net final
 {
 public:
 	static constexpr uint16_t c_default_server_tcp_port= 6666u;
-	static constexpr uint16_t c_default_server_udp_base_port= 8000u;
+	static constexpr uint16_t c_default_server_udp_base_port= 8000u; // Server uses one UDP port for all clients.
 
 	Net();
 	~Net();
@@ -29,13 +53,24 @@ public:
 
 	IConnectionsListenerPtr CreateServerListener(
 		uint16_t tcp_port= c_default_server_tcp_port,
-		uint16_t base_udp_port= c_default_server_udp_base_port );
+		uint16_t udp_port= c_default_server_udp_base_port,
+		bool reliable_over_udp= true ); // If false - send reliable data via TCP.
+
+	// Wait for network events no longer, than "max_wait_time". May return earlier, if some socket becomes ready.
+	// Connections read only sockets, reported as ready here, so, call it each tick.
+	// Thread-safe - connections may be read in other threads.
+	void Poll( Time max_wait_time );
+
+	const NetCounters& GetCounters() const;
+	void PrintStats() const;
 
 private:
 	struct PlatformData;
 
 private:
 	std::unique_ptr<PlatformData> platform_data_;
+	const std::shared_ptr<NetCounters> counters_;
+	const std::shared_ptr<NetReactor> reactor_;
 	bool successfully_started_= false;
 };
 
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../assert.hpp"
+
+#include "reliable_channel.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int ReliableChannel::c_max_segment_data_size;
+constexpr unsigned int ReliableChannel::c_max_unacknowledged_segments;
+
+// Segment in datagram: sequence, data size, data.
+static const unsigned int g_segment_header_size= sizeof(uint16_t) * 2u;
+
+static const float g_initial_retransmission_timeout= 0.1f; // In seconds.
+static const float g_min_retransmission_timeout= 0.02f;
+static const float g_max_retransmission_timeout= 2.0f;
+static const float g_connection_timeout= 10.0f;
+
+ReliableChannel::ReliableChannel( NetCounters& counters )
+	: counters_(counters)
+{}
+
+ReliableChannel::~ReliableChannel()
+{}
+
+void ReliableChannel::Write( const void* const data, const unsigned int size )
+{
+	const unsigned char* const bytes= static_cast<const unsigned char*>(data);
+	pending_data_.insert( pending_data_.end(), bytes, bytes + size );
+}
+
+unsigned int ReliableChannel::BuildDatagram(
+	const uint16_t datagram_sequence,
+	const Time current_time,
+	unsigned char* const out_data,
+	const unsigned int max_size )
+{
+	unsigned int pos= 0u;
+
+	// Resend lost segments.
+	for( Segment& segment : unacknowledged_segments_ )
+	{
+		if( segment.acknowledged ||
+			segment.transmissions == 0u ||
+			current_time - segment.last_send_time < GetRetransmissionTimeout( segment.transmissions ) )
+			continue;
+
+		if( !WriteSegment( segment, datagram_sequence, current_time, out_data, max_size, pos ) )
+			return pos;
+		counters_.reliable_segments_resent++;
+	}
+
+	// Send segments, which are not sent yet.
+	for( Segment& segment : unacknowledged_segments_ )
+	{
+		if( segment.transmissions != 0u )
+			continue;
+
+		if( !WriteSegment( segment, datagram_sequence, current_time, out_data, max_size, pos ) )
+			return pos;
+		counters_.reliable_segments_sent++;
+	}
+
+	// Split pending data into new segments.
+	unsigned int pending_data_pos= 0u;
+	while(
+		pending_data_pos < pending_data_.size() &&
+		unacknowledged_segments_.size() < c_max_unacknowledged_segments &&
+		pos + g_segment_header_size < max_size )
+	{
+		const unsigned int segment_size=
+			std::min(
+				std::min( static_cast<unsigned int>( pending_data_.size() ) - pending_data_pos, c_max_segment_data_size ),
+				max_size - pos - g_segment_header_size );
+
+		unacknowledged_segments_.emplace_back();
+		Segment& segment= unacknowledged_segments_.back();
+		segment.sequence= next_send_sequence_;
+		segment.data.assign(
+			pending_data_.begin() + pending_data_pos,
+			pending_data_.begin() + pending_data_pos + segment_size );
+
+		next_send_sequence_++;
+		pending_data_pos+= segment_size;
+
+		const bool written= WriteSegment( segment, datagram_sequence, current_time, out_data, max_size, pos );
+		PC_ASSERT( written );
+		PC_UNUSED( written );
+		counters_.reliable_segments_sent++;
+	}
+	pending_data_.erase( pending_data_.begin(), pending_data_.begin() + pending_data_pos );
+
+	return pos;
+}
+
+void ReliableChannel::OnDatagramsAcknowledged( const uint16_t ack_sequence, const uint32_t ack_bits, const Time current_time )
+{
+	for( Segment& segment : unacknowledged_segments_ )
+	{
+		if( segment.acknowledged || segment.transmissions == 0u )
+			continue;
+
+		const int delta= int16_t( ack_sequence - segment.datagram_sequence );
+		if( !( delta == 0 || ( delta > 0 && delta <= 32 && ( ack_bits & ( 1u << ( delta - 1 ) ) ) != 0u ) ) )
+			continue;
+
+		segment.acknowledged= true;
+		counters_.reliable_segments_acknowledged++;
+		counters_.reliable_delivery_time_us+=
+			( current_time - segment.first_send_time ).GetInternalRepresentation() * 1000000 /
+			Time::FromSeconds(1).GetInternalRepresentation();
+
+		// Take round-trip time samples only from segments, transmitted once - for others we do not know, which transmission is acknowledged.
+		if( segment.transmissions == 1u )
+		{
+			const float sample= ( current_time - segment.last_send_time ).ToSeconds();
+			if( !has_round_trip_time_ )
+			{
+				smoothed_round_trip_time_= sample;
+				round_trip_time_variation_= sample * 0.5f;
+				has_round_trip_time_= true;
+			}
+			else
+			{
+				round_trip_time_variation_= 0.75f * round_trip_time_variation_ + 0.25f * std::abs( smoothed_round_trip_time_ - sample );
+				smoothed_round_trip_time_= 0.875f * smoothed_round_trip_time_ + 0.125f * sample;
+			}
+		}
+	}
+
+	while( !unacknowledged_segments_.empty() && unacknowledged_segments_.front().acknowledged )
+		unacknowledged_segments_.pop_front();
+}
+
+bool ReliableChannel::TimedOut( const Time current_time ) const
+{
+	for( const Segment& segment : unacknowledged_segments_ )
+	{
+		if( !segment.acknowledged && segment.transmissions > 0u &&
+			( current_time - segment.first_send_time ).ToSeconds() > g_connection_timeout )
+			return true;
+	}
+
+	return false;
+}
+
+bool ReliableChannel::ProcessSegments( const unsigned char* const data, const unsigned int size )
+{
+	unsigned int pos= 0u;
+	while( pos < size )
+	{
+		if( size - pos < g_segment_header_size )
+			return false;
+
+		uint16_t sequence, segment_size;
+		std::memcpy( &sequence, data + pos, sizeof(uint16_t) );
+		std::memcpy( &segment_size, data + pos + sizeof(uint16_t), sizeof(uint16_t) );
+		pos+= g_segment_header_size;
+
+		if( size - pos < segment_size )
+			return false;
+
+		const unsigned char* const segment_data= data + pos;
+		pos+= segment_size;
+
+		const int delta= int16_t( sequence - next_receive_sequence_ );
+		if( delta < 0 || delta >= int(c_max_unacknowledged_segments) )
+			continue; // Duplicate, or garbage.
+
+		if( delta > 0 )
+		{
+			// Keep segment until missing segments arrive.
+			std::vector<unsigned char>& out_of_order_segment= out_of_order_segments_[ sequence ];
+			out_of_order_segment.assign( segment_data, segment_data + segment_size );
+			continue;
+		}
+
+		received_data_.insert( received_data_.end(), segment_data, segment_data + segment_size );
+		next_receive_sequence_++;
+
+		// Deliver next segments, received earlier.
+		while(1)
+		{
+			const auto it= out_of_order_segments_.find( next_receive_sequence_ );
+			if( it == out_of_order_segments_.end() )
+				break;
+
+			received_data_.insert( received_data_.end(), it->second.begin(), it->second.end() );
+			out_of_order_segments_.erase( it );
+			next_receive_sequence_++;
+		}
+	}
+
+	return true;
+}
+
+unsigned int ReliableChannel::Read( void* const out_data, const unsigned int buffer_size )
+{
+	const unsigned int size= std::min( buffer_size, static_cast<unsigned int>( received_data_.size() ) - received_data_pos_ );
+	if( size == 0u )
+		return 0u;
+
+	std::memcpy( out_data, received_data_.data() + received_data_pos_, size );
+	received_data_pos_+= size;
+
+	if( received_data_pos_ == received_data_.size() )
+	{
+		received_data_.clear();
+		received_data_pos_= 0u;
+	}
+
+	return size;
+}
+
+Time ReliableChannel::GetRetransmissionTimeout( const unsigned int transmissions ) const
+{
+	float timeout=
+		has_round_trip_time_
+			? smoothed_round_trip_time_ + std::max( 4.0f * round_trip_time_variation_, 0.005f )
+			: g_initial_retransmission_timeout;
+
+	// Exponential backoff for segments, lost many times.
+	timeout*= float( 1u << std::min( transmissions - 1u, 4u ) );
+
+	return Time::FromSeconds( std::max( g_min_retransmission_timeout, std::min( timeout, g_max_retransmission_timeout ) ) );
+}
+
+bool ReliableChannel::WriteSegment(
+	Segment& segment,
+	const uint16_t datagram_sequence,
+	const Time current_time,
+	unsigned char* const out_data,
+	const unsigned int max_size,
+	unsigned int& pos )
+{
+	if( pos + g_segment_header_size + segment.data.size() > max_size )
+		return false;
+
+	const uint16_t segment_size= static_cast<uint16_t>( segment.data.size() );
+	std::memcpy( out_data + pos, &segment.sequence, sizeof(uint16_t) );
+	std::memcpy( out_data + pos + sizeof(uint16_t), &segment_size, sizeof(uint16_t) );
+	pos+= g_segment_header_size;
+
+	std::memcpy( out_data + pos, segment.data.data(), segment.data.size() );
+	pos+= segment.data.size();
+
+	if( segment.transmissions == 0u )
+		segment.first_send_time= current_time;
+	segment.last_send_time= current_time;
+	segment.datagram_sequence= datagram_sequence;
+	segment.transmissions++;
+
+	return true;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "../time.hpp"
+#include "net.hpp"
+
+namespace PanzerChasm
+{
+
+// Reliable ordered byte stream over unreliable datagrams.
+// Data is split into segments with sequence numbers. Segments are transmitted inside datagrams,
+// receiver acknowledges datagrams (not segments), using sequence number and bitfield of last received datagrams.
+// Segment is resent, if datagram with it is not acknowledged during retransmission timeout,
+// which is calculated from smoothed round-trip time.
+// Receiver delivers segments in order, out of order segments are kept until missing segments arrive.
+class ReliableChannel final
+{
+public:
+	explicit ReliableChannel( NetCounters& counters );
+	~ReliableChannel();
+
+	// Sending.
+
+	void Write( const void* data, unsigned int size );
+
+	// Write segments, which must be sent now, into datagram. Returns size of written data, zero, if nothing to send.
+	unsigned int BuildDatagram( uint16_t datagram_sequence, Time current_time, unsigned char* out_data, unsigned int max_size );
+
+	// Process acknowledgement fields from header of received datagram.
+	void OnDatagramsAcknowledged( uint16_t ack_sequence, uint32_t ack_bits, Time current_time );
+
+	// Returns true, if some segment is not acknowledged for too long time. Connection must be closed in this case.
+	bool TimedOut( Time current_time ) const;
+
+	// Receiving.
+
+	// Process reliable section of received datagram. Returns false, if section is broken.
+	bool ProcessSegments( const unsigned char* data, unsigned int size );
+
+	// Returns size of read data.
+	unsigned int Read( void* out_data, unsigned int buffer_size );
+
+private:
+	struct Segment
+	{
+		uint16_t sequence;
+		std::vector<unsigned char> data;
+
+		Time first_send_time= Time::FromSeconds(0);
+		Time last_send_time= Time::FromSeconds(0);
+		uint16_t datagram_sequence= 0u; // Sequence of datagram with last transmission.
+		unsigned int transmissions= 0u;
+		bool acknowledged= false;
+	};
+
+	static constexpr unsigned int c_max_segment_data_size= 1024u;
+	static constexpr unsigned int c_max_unacknowledged_segments= 256u;
+
+private:
+	Time GetRetransmissionTimeout( unsigned int transmissions ) const;
+	static bool WriteSegment( Segment& segment, uint16_t datagram_sequence, Time current_time, unsigned char* out_data, unsigned int max_size, unsigned int& pos );
+
+private:
+	NetCounters& counters_;
+
+	// Sending.
+	std::vector<unsigned char> pending_data_; // Data, not splitted into segments yet.
+	std::deque<Segment> unacknowledged_segments_;
+	uint16_t next_send_sequence_= 0u;
+
+	bool has_round_trip_time_= false;
+	float smoothed_round_trip_time_= 0.0f; // In seconds.
+	float round_trip_time_variation_= 0.0f;
+
+	// Receiving.
+	uint16_t next_receive_sequence_= 0u;
+	std::map< uint16_t, std::vector<unsigned char> > out_of_order_segments_;
+	std::vector<unsigned char> received_data_;
+	unsigned int received_data_pos_= 0u;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "assert.hpp"
+#include "i_connection.hpp"
+#include "log.hpp"
+#include "rand.hpp"
+#include "time.hpp"
+
+#include "network_simulator.hpp"
+
+namespace PanzerChasm
+{
+
+// Unreliable packets, which wait for bandwidth longer, than this, are dropped - like in overflowed router queue.
+static const float g_max_bandwidth_queue_delay= 0.5f; // In seconds.
+// Minimal delay for resending of lost reliable data.
+static const float g_min_resend_delay= 0.02f;
+// Limit for resends of same reliable packet.
+static const unsigned int g_max_reliable_resends= 8u;
+
+class NetworkSimulator::Connection final : public IConnection
+{
+public:
+	Connection( IConnectionPtr connection, std::shared_ptr<State> state );
+	virtual ~Connection() override;
+
+public: // IConnection
+	virtual void SendReliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePacket( const void* data, unsigned int data_size ) override;
+	virtual void SendUnreliablePackets( const UnreliablePacket* packets, unsigned int packet_count ) override;
+
+	virtual unsigned int ReadRealiableData( void* out_data, unsigned int buffer_size ) override;
+	virtual unsigned int ReadUnrealiableData( void* out_data, unsigned int buffer_size ) override;
+
+	virtual unsigned char* BeginDirectWrite( bool reliable, unsigned int max_size ) override;
+	virtual void EndDirectWrite( bool reliable, unsigned int size ) override;
+	virtual bool PeekReceivedData( bool reliable, const unsigned char*& out_data, unsigned int& out_size ) override;
+	virtual void ConsumeReceivedData( bool reliable, unsigned int size ) override;
+
+	virtual void Disconnect() override;
+	virtual bool Disconnected() override;
+
+	virtual std::string GetConnectionInfo() override;
+
+private:
+	struct DelayedPacket
+	{
+		Time send_time= Time::FromSeconds(0);
+		std::vector<unsigned char> data;
+	};
+
+private:
+	void UpdateConditions();
+	bool CanSendDirectly() const;
+
+	// Returns false, if packet must be dropped because of bandwidth limit.
+	bool TakeBandwidth( unsigned int data_size, bool can_drop, Time current_time, Time& out_transmission_end_time );
+	Time GetRandomDelay();
+	void QueueUnreliablePacket( const void* data, unsigned int data_size, Time send_time, Time current_time );
+
+	// Send packets with reached send time.
+	void SendDelayedPackets( Time current_time );
+
+private:
+	const IConnectionPtr connection_;
+	const std::shared_ptr<State> state_;
+
+	NetworkConditions conditions_;
+	unsigned int conditions_revision_= ~0u;
+
+	LongRand rand_;
+
+	Time link_free_time_= Time::FromSeconds(0); // Time, when previous packet is fully transmitted, for bandwidth limit.
+	Time last_reliable_send_time_= Time::FromSeconds(0);
+
+	std::deque<DelayedPacket> reliable_packets_;
+	std::deque<DelayedPacket> unreliable_packets_; // Sorted by send time.
+};
+
+NetworkSimulator::Connection::Connection( IConnectionPtr connection, std::shared_ptr<State> state )
+	: connection_( std::move(connection) )
+	, state_( std::move(state) )
+	, rand_( state_->next_connection_seed.fetch_add( 1u ) )
+{
+	PC_ASSERT( connection_ != nullptr );
+	UpdateConditions();
+}
+
+NetworkSimulator::Connection::~Connection()
+{}
+
+void NetworkSimulator::Connection::SendReliablePacket( const void* const data, const unsigned int data_size )
+{
+	UpdateConditions();
+	const Time current_time= Time::CurrentTime();
+	SendDelayedPackets( current_time );
+
+	if( CanSendDirectly() )
+	{
+		connection_->SendReliablePacket( data, data_size );
+		return;
+	}
+
+	state_->reliable_packets++;
+
+	Time send_time= Time::FromSeconds(0);
+	TakeBandwidth( data_size, false, current_time, send_time );
+	send_time+= GetRandomDelay();
+
+	// Each loss of reliable data costs one more round trip for resending.
+	const Time resend_delay=
+		Time::FromSeconds( std::max( g_min_resend_delay, 2.0f * float(conditions_.latency_ms) / 1000.0f ) );
+	for( unsigned int i= 0u; i < g_max_reliable_resends && rand_.RandBool( conditions_.loss_percent, 100u ); i++ )
+	{
+		send_time+= resend_delay;
+		state_->reliable_packets_resent++;
+	}
+
+	// Reliable data must be delivered in order.
+	send_time= std::max( send_time, last_reliable_send_time_ );
+	last_reliable_send_time_= send_time;
+
+	state_->delay_us+=
+		( send_time - current_time ).GetInternalRepresentation() * 1000000 /
+		Time::FromSeconds(1).GetInternalRepresentation();
+
+	reliable_packets_.emplace_back();
+	reliable_packets_.back().send_time= send_time;
+	reliable_packets_.back().data.assign(
+		static_cast<const unsigned char*>(data),
+		static_cast<const unsigned char*>(data) + data_size );
+
+	SendDelayedPackets( current_time );
+}
+
+void NetworkSimulator::Connection::SendUnreliablePacket( const void* const data, const unsigned int data_size )
+{
+	const UnreliablePacket packet{ data, data_size };
+	SendUnreliablePackets( &packet, 1u );
+}
+
+void NetworkSimulator::Connection::SendUnreliablePackets( const UnreliablePacket* const packets, const unsigned int packet_count )
+{
+	UpdateConditions();
+	const Time current_time= Time::CurrentTime();
+	SendDelayedPackets( current_time );
+
+	if( CanSendDirectly() )
+	{
+		connection_->SendUnreliablePackets( packets, packet_count );
+		return;
+	}
+
+	for( unsigned int i= 0u; i < packet_count; i++ )
+	{
+		const UnreliablePacket& packet= packets[i];
+		state_->unreliable_packets++;
+
+		if( rand_.RandBool( conditions_.loss_percent, 100u ) )
+		{
+			state_->unreliable_packets_lost++;
+			continue;
+		}
+
+		Time transmission_end_time= Time::FromSeconds(0);
+		if( !TakeBandwidth( packet.size, true, current_time, transmission_end_time ) )
+		{
+			state_->unreliable_packets_overflowed++;
+			continue;
+		}
+
+		QueueUnreliablePacket( packet.data, packet.size, transmission_end_time + GetRandomDelay(), current_time );
+
+		if( rand_.RandBool( conditions_.duplication_percent, 100u ) )
+		{
+			state_->unreliable_packets_duplicated++;
+			QueueUnreliablePacket( packet.data, packet.size, transmission_end_time + GetRandomDelay(), current_time );
+		}
+	}
+
+	SendDelayedPackets( current_time );
+}
+
+unsigned int NetworkSimulator::Connection::ReadRealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	SendDelayedPackets( Time::CurrentTime() );
+	return connection_->ReadRealiableData( out_data, buffer_size );
+}
+
+unsigned int NetworkSimulator::Connection::ReadUnrealiableData( void* const out_data, const unsigned int buffer_size )
+{
+	SendDelayedPackets( Time::CurrentTime() );
+	return connection_->ReadUnrealiableData( out_data, buffer_size );
+}
+
+unsigned char* NetworkSimulator::Connection::BeginDirectWrite( const bool reliable, const unsigned int max_size )
+{
+	UpdateConditions();
+	SendDelayedPackets( Time::CurrentTime() );
+
+	// Direct writing bypasses simulation, so, it is possible only for ideal conditions.
+	if( !CanSendDirectly() )
+		return nullptr;
+
+	return connection_->BeginDirectWrite( reliable, max_size );
+}
+
+void NetworkSimulator::Connection::EndDirectWrite( const bool reliable, const unsigned int size )
+{
+	connection_->EndDirectWrite( reliable, size );
+}
+
+bool NetworkSimulator::Connection::PeekReceivedData( const bool reliable, const unsigned char*& out_data, unsigned int& out_size )
+{
+	SendDelayedPackets( Time::CurrentTime() );
+	return connection_->PeekReceivedData( reliable, out_data, out_size );
+}
+
+void NetworkSimulator::Connection::ConsumeReceivedData( const bool reliable, const unsigned int size )
+{
+	connection_->ConsumeReceivedData( reliable, size );
+}
+
+void NetworkSimulator::Connection::Disconnect()
+{
+	reliable_packets_.clear();
+	unreliable_packets_.clear();
+	connection_->Disconnect();
+}
+
+bool NetworkSimulator::Connection::Disconnected()
+{
+	return connection_->Disconnected();
+}
+
+std::string NetworkSimulator::Connection::GetConnectionInfo()
+{
+	return connection_->GetConnectionInfo() + " (simulated)";
+}
+
+void NetworkSimulator::Connection::UpdateConditions()
+{
+	const unsigned int revision= state_->conditions_revision.load();
+	if( revision == conditions_revision_ )
+		return;
+
+	std::lock_guard<std::mutex> lock( state_->conditions_mutex );
+	conditions_= state_->conditions;
+	conditions_revision_= state_->conditions_revision.load();
+}
+
+bool NetworkSimulator::Connection::CanSendDirectly() const
+{
+	// Wait for delayed packets after conditions change, because reliable data must be delivered in order.
+	return conditions_.IsIdeal() && reliable_packets_.empty() && unreliable_packets_.empty();
+}
+
+bool NetworkSimulator::Connection::TakeBandwidth(
+	const unsigned int data_size,
+	const bool can_drop,
+	const Time current_time,
+	Time& out_transmission_end_time )
+{
+	if( conditions_.bandwidth_kbps == 0u )
+	{
+		out_transmission_end_time= current_time;
+		return true;
+	}
+
+	const Time transmission_start_time= std::max( current_time, link_free_time_ );
+	if( can_drop && ( transmission_start_time - current_time ).ToSeconds() > g_max_bandwidth_queue_delay )
+		return false;
+
+	const Time transmission_duration=
+		Time::FromSeconds( double(data_size) / ( double(conditions_.bandwidth_kbps) * 1024.0 ) );
+
+	link_free_time_= transmission_start_time + transmission_duration;
+	out_transmission_end_time= link_free_time_;
+	return true;
+}
+
+Time NetworkSimulator::Connection::GetRandomDelay()
+{
+	const float delay_ms=
+		float(conditions_.latency_ms) +
+		( conditions_.jitter_ms > 0u ? rand_.RandValue( float(conditions_.jitter_ms) ) : 0.0f );
+	return Time::FromSeconds( delay_ms / 1000.0f );
+}
+
+void NetworkSimulator::Connection::QueueUnreliablePacket(
+	const void* const data, const unsigned int data_size,
+	const Time send_time, const Time current_time )
+{
+	state_->delay_us+=
+		( send_time - current_time ).GetInternalRepresentation() * 1000000 /
+		Time::FromSeconds(1).GetInternalRepresentation();
+
+	// Keep queue sorted. Packets with jitter may overtake previous packets.
+	const auto it=
+		std::upper_bound(
+			unreliable_packets_.begin(), unreliable_packets_.end(), send_time,
+			[]( const Time& time, const DelayedPacket& packet ) -> bool
+			{
+				return time < packet.send_time;
+			} );
+
+	const auto inserted_it= unreliable_packets_.emplace( it );
+	inserted_it->send_time= send_time;
+	inserted_it->data.assign(
+		static_cast<const unsigned char*>(data),
+		static_cast<const unsigned char*>(data) + data_size );
+}
+
+void NetworkSimulator::Connection::SendDelayedPackets( const Time current_time )
+{
+	while( !reliable_packets_.empty() && reliable_packets_.front().send_time <= current_time )
+	{
+		const DelayedPacket& packet= reliable_packets_.front();
+		connection_->SendReliablePacket( packet.data.data(), static_cast<unsigned int>( packet.data.size() ) );
+		reliable_packets_.pop_front();
+	}
+
+	// Send unreliable packets in groups, like it does sender.
+	const unsigned int c_max_packets_in_group= 16u;
+	while( !unreliable_packets_.empty() && unreliable_packets_.front().send_time <= current_time )
+	{
+		UnreliablePacket packets[ c_max_packets_in_group ];
+		unsigned int packet_count= 0u;
+		while(
+			packet_count < c_max_packets_in_group &&
+			packet_count < unreliable_packets_.size() &&
+			unreliable_packets_[ packet_count ].send_time <= current_time )
+		{
+			const DelayedPacket& packet= unreliable_packets_[ packet_count ];
+			packets[ packet_count ].data= packet.data.data();
+			packets[ packet_count ].size= static_cast<unsigned int>( packet.data.size() );
+			packet_count++;
+		}
+
+		connection_->SendUnreliablePackets( packets, packet_count );
+		unreliable_packets_.erase( unreliable_packets_.begin(), unreliable_packets_.begin() + packet_count );
+	}
+}
+
+class NetworkSimulator::ConnectionsListener final : public IConnectionsListener
+{
+public:
+	ConnectionsListener( IConnectionsListenerPtr connections_listener, std::shared_ptr<State> state )
+		: connections_listener_( std::move(connections_listener) )
+		, state_( std::move(state) )
+	{
+		PC_ASSERT( connections_listener_ != nullptr );
+	}
+
+	virtual ~ConnectionsListener() override {}
+
+public: // IConnectionsListener
+	virtual IConnectionPtr GetNewConnection() override
+	{
+		IConnectionPtr connection= connections_listener_->GetNewConnection();
+		if( connection == nullptr )
+			return nullptr;
+
+		return std::make_shared<Connection>( std::move(connection), state_ );
+	}
+
+private:
+	const IConnectionsListenerPtr connections_listener_;
+	const std::shared_ptr<State> state_;
+};
+
+bool NetworkConditions::IsIdeal() const
+{
+	return
+		latency_ms == 0u &&
+		jitter_ms == 0u &&
+		loss_percent == 0u &&
+		duplication_percent == 0u &&
+		bandwidth_kbps == 0u;
+}
+
+bool NetworkConditions::operator==( const NetworkConditions& other ) const
+{
+	return
+		latency_ms == other.latency_ms &&
+		jitter_ms == other.jitter_ms &&
+		loss_percent == other.loss_percent &&
+		duplication_percent == other.duplication_percent &&
+		bandwidth_kbps == other.bandwidth_kbps;
+}
+
+bool NetworkConditions::operator!=( const NetworkConditions& other ) const
+{
+	return !( *this == other );
+}
+
+NetworkSimulator::NetworkSimulator()
+	: state_( std::make_shared<State>() )
+{}
+
+NetworkSimulator::~NetworkSimulator()
+{}
+
+void NetworkSimulator::SetConditions( const NetworkConditions& conditions )
+{
+	NetworkConditions new_conditions= conditions;
+	new_conditions.loss_percent= std::min( new_conditions.loss_percent, 100u );
+	new_conditions.duplication_percent= std::min( new_conditions.duplication_percent, 100u );
+
+	{
+		std::lock_guard<std::mutex> lock( state_->conditions_mutex );
+		if( new_conditions == state_->conditions )
+			return;
+
+		state_->conditions= new_conditions;
+		state_->conditions_revision++;
+	}
+
+	if( new_conditions.IsIdeal() )
+		Log::Info( "Network simulation disabled" );
+	else
+		Log::Info(
+			"Network simulation: latency ", new_conditions.latency_ms, " ms",
+			", jitter ", new_conditions.jitter_ms, " ms",
+			", loss ", new_conditions.loss_percent, "%",
+			", duplication ", new_conditions.duplication_percent, "%",
+			", bandwidth ", new_conditions.bandwidth_kbps, " KB/s" );
+}
+
+NetworkConditions NetworkSimulator::GetConditions() const
+{
+	std::lock_guard<std::mutex> lock( state_->conditions_mutex );
+	return state_->conditions;
+}
+
+IConnectionPtr NetworkSimulator::WrapConnection( IConnectionPtr connection )
+{
+	if( connection == nullptr )
+		return nullptr;
+
+	return std::make_shared<Connection>( std::move(connection), state_ );
+}
+
+IConnectionsListenerPtr NetworkSimulator::WrapConnectionsListener( IConnectionsListenerPtr connections_listener )
+{
+	if( connections_listener == nullptr )
+		return nullptr;
+
+	return std::make_shared<ConnectionsListener>( std::move(connections_listener), state_ );
+}
+
+void NetworkSimulator::PrintStats() const
+{
+	const State& s= *state_;
+	const uint64_t unreliable_packets= s.unreliable_packets.load();
+	const uint64_t reliable_packets= s.reliable_packets.load();
+
+	const NetworkConditions conditions= GetConditions();
+	Log::Info(
+		"Network simulation: latency ", conditions.latency_ms, " ms",
+		", jitter ", conditions.jitter_ms, " ms",
+		", loss ", conditions.loss_percent, "%",
+		", duplication ", conditions.duplication_percent, "%",
+		", bandwidth ", conditions.bandwidth_kbps, " KB/s" );
+	Log::Info(
+		"Simulated unreliable packets: ", unreliable_packets,
+		", lost: ", s.unreliable_packets_lost.load(),
+		", duplicated: ", s.unreliable_packets_duplicated.load(),
+		", dropped by bandwidth limit: ", s.unreliable_packets_overflowed.load() );
+	Log::Info(
+		"Simulated reliable packets: ", reliable_packets,
+		", resent: ", s.reliable_packets_resent.load() );
+
+	const uint64_t delayed_packets=
+		unreliable_packets - s.unreliable_packets_lost.load() - s.unreliable_packets_overflowed.load() +
+		s.unreliable_packets_duplicated.load() + reliable_packets;
+	if( delayed_packets > 0u )
+		Log::Info( "Average simulated delay: ", float( s.delay_us.load() ) / float(delayed_packets) / 1000.0f, " ms" );
+}
+
+} // namespace PanzerChasm
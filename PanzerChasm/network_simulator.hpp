@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "server/i_connections_listener.hpp"
+
+namespace PanzerChasm
+{
+
+struct NetworkConditions
+{
+	unsigned int latency_ms= 0u; // One-way delay.
+	unsigned int jitter_ms= 0u; // Random additional delay in range [0; jitter].
+	unsigned int loss_percent= 0u;
+	unsigned int duplication_percent= 0u;
+	unsigned int bandwidth_kbps= 0u; // Kilobytes per second. Zero - unlimited.
+
+	bool IsIdeal() const;
+	bool operator==( const NetworkConditions& other ) const;
+	bool operator!=( const NetworkConditions& other ) const;
+};
+
+// Simulator of bad network. Wraps connections (loopback or net) and applies conditions to sent data.
+// Each connection simulates only direction from it, so, for simulation of both directions wrap both sides.
+// Unreliable packets may be lost, duplicated and reordered (because of jitter).
+// Reliable data is never lost or reordered - loss of it turns into delay for resending, which blocks all following data.
+// Conditions may be changed at any time, wrapped connections get them on next call.
+class NetworkSimulator final
+{
+public:
+	NetworkSimulator();
+	~NetworkSimulator();
+
+	void SetConditions( const NetworkConditions& conditions );
+	NetworkConditions GetConditions() const;
+
+	IConnectionPtr WrapConnection( IConnectionPtr connection );
+	IConnectionsListenerPtr WrapConnectionsListener( IConnectionsListenerPtr connections_listener );
+
+	void PrintStats() const;
+
+private:
+	class Connection;
+	class ConnectionsListener;
+
+	// Shared between simulator and connections, because connections may live longer, than simulator.
+	struct State
+	{
+		mutable std::mutex conditions_mutex;
+		NetworkConditions conditions;
+		std::atomic<unsigned int> conditions_revision{0u};
+
+		std::atomic<unsigned int> next_connection_seed{0u};
+
+		std::atomic<uint64_t> unreliable_packets{0u};
+		std::atomic<uint64_t> unreliable_packets_lost{0u};
+		std::atomic<uint64_t> unreliable_packets_duplicated{0u};
+		std::atomic<uint64_t> unreliable_packets_overflowed{0u}; // Dropped because of bandwidth limit.
+		std::atomic<uint64_t> reliable_packets{0u};
+		std::atomic<uint64_t> reliable_packets_resent{0u};
+		std::atomic<uint64_t> delay_us{0u}; // Sum of delays of all packets.
+	};
+
+private:
+	const std::shared_ptr<State> state_;
+};
+
+} // namespace PanzerChasm
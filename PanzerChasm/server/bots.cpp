@@ -0,0 +1,536 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "../assert.hpp"
+#include "../log.hpp"
+#include "../loopback_buffer.hpp"
+#include "../map_loader.hpp"
+#include "../math_utils.hpp"
+#include "../messages_extractor.inl"
+#include "../messages_sender.hpp"
+
+#include "bots.hpp"
+
+namespace PanzerChasm
+{
+
+static Messages::AngleType ToMessageAngle( const float angle )
+{
+	return AngleToMessageAngle( NormalizeAngle( angle ) );
+}
+
+class Bots::Bot final
+{
+public:
+	enum class Behavior
+	{
+		Wander, // Run in random directions.
+		Shoot, // Chase nearest player and shoot him.
+		Waypoints, // Run between items and spawn points of map.
+		NumBehaviors,
+	};
+
+	Bot( Behavior behavior, unsigned int number, const MapLoaderPtr& map_loader, LongRand::RandResultType seed );
+	~Bot();
+
+	// Returns server side connection once.
+	IConnectionPtr GetServerSideConnection();
+
+	bool Disconnected() const;
+
+	void Tick( Time current_time );
+
+	uint64_t GetBytesReceived() const;
+	uint64_t GetBytesSent() const;
+	void ResetTrafficStats();
+
+public: // Messages handlers
+	// Process only some of messages.
+	template<class Message>
+	void operator()( const Message& message )
+	{
+		ProcessMessage( message );
+	}
+
+private:
+	void ProcessMessage( const Messages::MessageBase& ) {}
+	void ProcessMessage( const Messages::ServerState& message );
+	void ProcessMessage( const Messages::ReliableUpdateMark& message );
+	void ProcessMessage( const Messages::MapChange& message );
+	void ProcessMessage( const Messages::PlayerSpawn& message );
+	void ProcessMessage( const Messages::PlayerPosition& message );
+	void ProcessMessage( const Messages::PlayerState& message );
+	void ProcessMessage( const Messages::MonsterState& message );
+	void ProcessMessage( const Messages::MonsterStateDelta& message );
+	void ProcessMessage( const Messages::MonsterBirth& message );
+	void ProcessMessage( const Messages::MonsterDeath& message );
+
+	static IConnectionPtr Connect( LoopbackBuffer& loopback_buffer );
+
+	// Returns nullptr, if there is no players.
+	const m_Vec3* SelectEnemy() const;
+	unsigned char SelectWeapon() const;
+
+	template<class Message>
+	void SendUnreliableMessage( const Message& message );
+
+private:
+	const Behavior behavior_;
+	const MapLoaderPtr map_loader_;
+	LongRand random_generator_;
+
+	LoopbackBuffer loopback_buffer_;
+	const IConnectionPtr connection_;
+	MessagesExtractor messages_extractor_;
+	MessagesSender messages_sender_;
+
+	unsigned short server_tick_number_= 0u;
+	// Acknowledge updates, like real client, only if all reliable messages of them are received.
+	unsigned short received_reliable_update_number_= 0u;
+	unsigned short acknowledged_update_number_= 0u;
+	EntityId player_monster_id_= 0u;
+	bool spawned_= false;
+	m_Vec3 pos_;
+	bool alive_= true;
+	unsigned char ammo_[ GameConstants::weapon_count ];
+	Messages::PlayerState::WeaponsMaskType weapons_mask_= 1u;
+
+	std::unordered_map<EntityId, m_Vec3> other_players_;
+
+	std::vector<m_Vec2> waypoints_;
+	unsigned int current_waypoint_= 0u;
+
+	float move_direction_= 0.0f;
+	bool strafe_left_= false;
+	Time next_direction_change_time_;
+	m_Vec2 progress_check_pos_;
+	Time progress_check_time_;
+
+	// Traffic is measured as encoded messages sizes - as they are sent via network.
+	uint64_t processed_bytes_at_stats_reset_= 0u;
+};
+
+Bots::Bot::Bot(
+	const Behavior behavior,
+	const unsigned int number,
+	const MapLoaderPtr& map_loader,
+	const LongRand::RandResultType seed )
+	: behavior_(behavior)
+	, map_loader_(map_loader)
+	, random_generator_(seed)
+	, connection_( Connect( loopback_buffer_ ) )
+	, messages_extractor_( connection_ )
+	, messages_sender_( connection_ )
+	, pos_( 0.0f, 0.0f, 0.0f )
+	, next_direction_change_time_( Time::FromSeconds(0) )
+	, progress_check_pos_( 0.0f, 0.0f )
+	, progress_check_time_( Time::FromSeconds(0) )
+{
+	std::memset( ammo_, 0, sizeof(ammo_) );
+
+	Messages::PlayerName name_message;
+	std::snprintf( name_message.name, sizeof(name_message.name), "bot_%u", number );
+	messages_sender_.SendReliableMessage( name_message );
+}
+
+Bots::Bot::~Bot()
+{}
+
+IConnectionPtr Bots::Bot::GetServerSideConnection()
+{
+	return loopback_buffer_.GetNewConnection();
+}
+
+bool Bots::Bot::Disconnected() const
+{
+	return connection_->Disconnected() || messages_extractor_.IsBroken();
+}
+
+void Bots::Bot::Tick( const Time current_time )
+{
+	messages_extractor_.ProcessMessages( *this );
+
+	Messages::PlayerMove message;
+	message.view_direction= ToMessageAngle( move_direction_ );
+	message.move_direction= ToMessageAngle( move_direction_ );
+	message.acceleration= 0u;
+	message.weapon_index= SelectWeapon();
+	message.view_dir_angle_x= 0u;
+	message.view_dir_angle_z= ToMessageAngle( move_direction_ - Constants::half_pi );
+	message.shoot_pressed= false;
+	message.jump_pressed= false;
+	message.color= 0u;
+	message.acknowledged_tick_number= server_tick_number_;
+	message.acknowledged_update_number= acknowledged_update_number_;
+	message.move_number= 0u;
+
+	if( !spawned_ )
+	{
+		SendUnreliableMessage( message );
+		return;
+	}
+
+	if( !alive_ )
+	{
+		// Respawn.
+		message.shoot_pressed= random_generator_.RandBool();
+		SendUnreliableMessage( message );
+		return;
+	}
+
+	// Change direction or waypoint, if bot is stuck.
+	const float c_progress_check_interval_s= 2.0f;
+	const float c_min_progress_distance= 0.5f;
+	bool stuck= false;
+	if( ( current_time - progress_check_time_ ).ToSeconds() >= c_progress_check_interval_s )
+	{
+		stuck= ( pos_.xy() - progress_check_pos_ ).SquareLength() < c_min_progress_distance * c_min_progress_distance;
+		progress_check_pos_= pos_.xy();
+		progress_check_time_= current_time;
+	}
+
+	const m_Vec3* const enemy_pos= behavior_ == Behavior::Shoot ? SelectEnemy() : nullptr;
+	if( enemy_pos != nullptr )
+	{
+		const m_Vec3 dir= *enemy_pos - pos_;
+		const float horizontal_distance= dir.xy().Length();
+		const float view_angle= std::atan2( dir.y, dir.x );
+		const float c_chase_distance= 3.0f;
+
+		// Run to enemy, if it is far, else strafe around it.
+		move_direction_= view_angle;
+		if( stuck )
+			strafe_left_= !strafe_left_;
+		if( horizontal_distance < c_chase_distance )
+			move_direction_+= strafe_left_ ? Constants::half_pi : -Constants::half_pi;
+
+		message.view_direction= ToMessageAngle( view_angle );
+		message.view_dir_angle_x= ToMessageAngle( std::atan2( dir.z, horizontal_distance ) );
+		message.view_dir_angle_z= ToMessageAngle( view_angle - Constants::half_pi );
+		message.move_direction= ToMessageAngle( move_direction_ );
+		message.acceleration= 255u;
+		message.shoot_pressed= true;
+	}
+	else if( behavior_ == Behavior::Waypoints && !waypoints_.empty() )
+	{
+		const float c_waypoint_reach_distance= 0.75f;
+		const m_Vec2 dir= waypoints_[ current_waypoint_ ] - pos_.xy();
+		if( stuck || dir.SquareLength() < c_waypoint_reach_distance * c_waypoint_reach_distance )
+			current_waypoint_= random_generator_.Rand() % waypoints_.size();
+
+		move_direction_= std::atan2( dir.y, dir.x );
+
+		message.view_direction= ToMessageAngle( move_direction_ );
+		message.view_dir_angle_z= ToMessageAngle( move_direction_ - Constants::half_pi );
+		message.move_direction= ToMessageAngle( move_direction_ );
+		message.acceleration= 255u;
+	}
+	else
+	{
+		if( stuck || current_time >= next_direction_change_time_ )
+		{
+			move_direction_= random_generator_.RandAngle();
+			next_direction_change_time_= current_time + Time::FromSeconds( double( random_generator_.RandValue( 1.0f, 4.0f ) ) );
+		}
+
+		message.view_direction= ToMessageAngle( move_direction_ );
+		message.view_dir_angle_z= ToMessageAngle( move_direction_ - Constants::half_pi );
+		message.move_direction= ToMessageAngle( move_direction_ );
+		message.acceleration= 255u;
+		message.jump_pressed= random_generator_.RandBool( 64u );
+	}
+
+	SendUnreliableMessage( message );
+}
+
+uint64_t Bots::Bot::GetBytesReceived() const
+{
+	return messages_extractor_.GetProcessedBytes() - processed_bytes_at_stats_reset_;
+}
+
+uint64_t Bots::Bot::GetBytesSent() const
+{
+	const MessagesSender::Stats& stats= messages_sender_.GetStats();
+
+	uint64_t result= 0u;
+	for( const uint64_t encoded_bytes : stats.encoded_bytes )
+		result+= encoded_bytes;
+	return result;
+}
+
+void Bots::Bot::ResetTrafficStats()
+{
+	processed_bytes_at_stats_reset_= messages_extractor_.GetProcessedBytes();
+	messages_sender_.ResetStats();
+}
+
+void Bots::Bot::ProcessMessage( const Messages::ServerState& message )
+{
+	server_tick_number_= message.tick_number;
+	if( message.reliable_update_number == received_reliable_update_number_ )
+		acknowledged_update_number_= message.update_number;
+}
+
+void Bots::Bot::ProcessMessage( const Messages::ReliableUpdateMark& message )
+{
+	received_reliable_update_number_= message.update_number;
+}
+
+void Bots::Bot::ProcessMessage( const Messages::MapChange& message )
+{
+	other_players_.clear();
+	waypoints_.clear();
+	current_waypoint_= 0u;
+	spawned_= false;
+
+	const MapDataConstPtr map_data= map_loader_->LoadMap( message.map_number );
+	if( map_data == nullptr )
+		return;
+
+	for( const MapData::Item& item : map_data->items )
+		waypoints_.push_back( item.pos );
+	for( const MapData::Monster& monster : map_data->monsters )
+	{
+		if( monster.monster_id == 0u ) // Players spawns
+			waypoints_.push_back( monster.pos );
+	}
+
+	if( !waypoints_.empty() )
+		current_waypoint_= random_generator_.Rand() % waypoints_.size();
+}
+
+void Bots::Bot::ProcessMessage( const Messages::PlayerSpawn& message )
+{
+	player_monster_id_= message.player_monster_id;
+	MessagePositionToPosition( message.xyz, pos_ );
+	move_direction_= MessageAngleToAngle( message.direction );
+	other_players_.erase( player_monster_id_ );
+	spawned_= true;
+	alive_= true;
+}
+
+void Bots::Bot::ProcessMessage( const Messages::PlayerPosition& message )
+{
+	MessagePositionToPosition( message.xyz, pos_ );
+}
+
+void Bots::Bot::ProcessMessage( const Messages::PlayerState& message )
+{
+	alive_= message.health > 0u;
+	weapons_mask_= message.weapons_mask;
+	std::memcpy( ammo_, message.ammo, sizeof(ammo_) );
+}
+
+void Bots::Bot::ProcessMessage( const Messages::MonsterState& message )
+{
+	if( message.monster_type != 0u || message.monster_id == player_monster_id_ )
+		return;
+
+	if( message.is_fully_dead )
+	{
+		other_players_.erase( message.monster_id );
+		return;
+	}
+
+	m_Vec3 pos;
+	MessagePositionToPosition( message.xyz, pos );
+	other_players_[ message.monster_id ]= pos;
+}
+
+void Bots::Bot::ProcessMessage( const Messages::MonsterStateDelta& message )
+{
+	// Players are added from full states, so, process only known players here.
+	const auto it= other_players_.find( message.monster_id );
+	if( it == other_players_.end() )
+		return;
+
+	Messages::MonsterState state;
+	PositionToMessagePosition( it->second, state.xyz );
+	state.is_fully_dead= false;
+	state.is_invisible= false;
+	state.color= 0u;
+	if( !UnpackMonsterStateDelta( message, state ) )
+		return;
+
+	if( state.is_fully_dead )
+		other_players_.erase( it );
+	else if( ( message.fields_mask & Messages::MonsterStateDelta::Position ) != 0u )
+		MessagePositionToPosition( state.xyz, it->second );
+}
+
+void Bots::Bot::ProcessMessage( const Messages::MonsterBirth& message )
+{
+	ProcessMessage( message.initial_state );
+}
+
+void Bots::Bot::ProcessMessage( const Messages::MonsterDeath& message )
+{
+	other_players_.erase( message.monster_id );
+}
+
+IConnectionPtr Bots::Bot::Connect( LoopbackBuffer& loopback_buffer )
+{
+	loopback_buffer.RequestConnect();
+	return loopback_buffer.GetClientSideConnection();
+}
+
+const m_Vec3* Bots::Bot::SelectEnemy() const
+{
+	const m_Vec3* nearest_enemy= nullptr;
+	float nearest_square_distance= 0.0f;
+
+	for( const auto& player_value : other_players_ )
+	{
+		const float square_distance= ( player_value.second - pos_ ).SquareLength();
+		if( nearest_enemy == nullptr || square_distance < nearest_square_distance )
+		{
+			nearest_enemy= &player_value.second;
+			nearest_square_distance= square_distance;
+		}
+	}
+
+	return nearest_enemy;
+}
+
+unsigned char Bots::Bot::SelectWeapon() const
+{
+	// Select best weapon with ammo.
+	for( unsigned int i= GameConstants::weapon_count - 1u; i > 0u; i-- )
+	{
+		if( ( weapons_mask_ & ( 1u << i ) ) != 0u && ammo_[i] > 0u )
+			return static_cast<unsigned char>(i);
+	}
+	return 0u;
+}
+
+template<class Message>
+void Bots::Bot::SendUnreliableMessage( const Message& message )
+{
+	messages_sender_.SendUnreliableMessage( message );
+	messages_sender_.Flush();
+}
+
+Bots::Bots( const IConnectionsListenerPtr& base_listener, const MapLoaderPtr& map_loader, std::string name )
+	: base_listener_(base_listener)
+	, map_loader_(map_loader)
+	, name_(std::move(name))
+	, stats_interval_( Time::FromSeconds(0) )
+	, last_stats_print_time_( Time::CurrentTime() )
+{
+	PC_ASSERT( map_loader_ != nullptr );
+}
+
+Bots::~Bots()
+{}
+
+void Bots::AddBots( unsigned int count )
+{
+	// Server does not accept more players.
+	if( bots_.size() + count > GameConstants::max_players )
+	{
+		count= GameConstants::max_players - std::min( static_cast<unsigned int>( bots_.size() ), GameConstants::max_players );
+		Log::Warning( name_, ": too many bots, only ", count, " bots will be added" );
+	}
+
+	for( unsigned int i= 0u; i < count; i++ )
+	{
+		const Bot::Behavior behavior=
+			static_cast<Bot::Behavior>( next_bot_number_ % static_cast<unsigned int>(Bot::Behavior::NumBehaviors) );
+
+		bots_.emplace_back( new Bot( behavior, next_bot_number_, map_loader_, random_generator_.Rand() ) );
+		new_connections_.push_back( bots_.back()->GetServerSideConnection() );
+		next_bot_number_++;
+	}
+
+	Log::Info( name_, ": added ", count, " bots, total ", bots_.size() );
+}
+
+void Bots::RemoveAllBots()
+{
+	bots_.clear();
+	new_connections_.clear();
+
+	Log::Info( name_, ": all bots removed" );
+}
+
+unsigned int Bots::GetBotCount() const
+{
+	return static_cast<unsigned int>( bots_.size() );
+}
+
+void Bots::SetStatsInterval( const Time stats_interval )
+{
+	stats_interval_= stats_interval;
+}
+
+void Bots::Tick()
+{
+	const Time current_time= Time::CurrentTime();
+
+	for( unsigned int b= 0u; b < bots_.size(); )
+	{
+		Bot& bot= *bots_[b];
+		if( bot.Disconnected() )
+		{
+			Log::Info( name_, ": bot disconnected" );
+			if( b != bots_.size() - 1u )
+				bots_[b]= std::move( bots_.back() );
+			bots_.pop_back();
+			continue;
+		}
+
+		bot.Tick( current_time );
+		b++;
+	}
+
+	if( stats_interval_ > Time::FromSeconds(0) && !bots_.empty() &&
+		current_time - last_stats_print_time_ >= stats_interval_ )
+		PrintStats();
+}
+
+void Bots::PrintStats()
+{
+	const Time current_time= Time::CurrentTime();
+	const float interval_s= std::max( ( current_time - last_stats_print_time_ ).ToSeconds(), 0.001f );
+	last_stats_print_time_= current_time;
+
+	uint64_t bytes_received= 0u, bytes_sent= 0u;
+	for( const BotPtr& bot : bots_ )
+	{
+		bytes_received+= bot->GetBytesReceived();
+		bytes_sent+= bot->GetBytesSent();
+		bot->ResetTrafficStats();
+	}
+
+	if( bots_.empty() )
+	{
+		Log::Info( name_, ": no bots" );
+		return;
+	}
+
+	const float bot_count= float( bots_.size() );
+	Log::Info(
+		name_, ": ", bots_.size(), " bots",
+		", per player down: ", float(bytes_received) / interval_s / bot_count / 1024.0f, " KB/s",
+		", up: ", float(bytes_sent) / interval_s / bot_count / 1024.0f, " KB/s" );
+}
+
+IConnectionPtr Bots::GetNewConnection()
+{
+	if( !new_connections_.empty() )
+	{
+		const IConnectionPtr connection= new_connections_.front();
+		new_connections_.erase( new_connections_.begin() );
+		return connection;
+	}
+
+	if( base_listener_ != nullptr )
+		return base_listener_->GetNewConnection();
+
+	return nullptr;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../rand.hpp"
+#include "../time.hpp"
+#include "i_connections_listener.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Bot players for server load testing.
+// Bots are connected to server via in-process loopback connections, like local client.
+// Each bot reads all server messages, without rendering, and sends synthetic "PlayerMove" messages.
+// Connections listener itself - returns bots connections first, than connections from base listener.
+class Bots final : public IConnectionsListener
+{
+public:
+	// Base listener may be null.
+	Bots( const IConnectionsListenerPtr& base_listener, const MapLoaderPtr& map_loader, std::string name );
+	virtual ~Bots() override;
+
+	void AddBots( unsigned int count );
+	void RemoveAllBots();
+	unsigned int GetBotCount() const;
+
+	// Print traffic statistics periodically. Zero interval disables printing.
+	void SetStatsInterval( Time stats_interval );
+
+	// Read messages from server and send new moves. Call it in server thread, before server loop.
+	void Tick();
+
+	void PrintStats();
+
+public: // IConnectionsListener
+	virtual IConnectionPtr GetNewConnection() override;
+
+private:
+	class Bot;
+	typedef std::unique_ptr<Bot> BotPtr;
+
+private:
+	const IConnectionsListenerPtr base_listener_;
+	const MapLoaderPtr map_loader_;
+	const std::string name_;
+
+	std::vector<BotPtr> bots_;
+	std::vector<IConnectionPtr> new_connections_; // Server side connections of new bots.
+	unsigned int next_bot_number_= 0u;
+
+	LongRand random_generator_;
+
+	Time stats_interval_;
+	Time last_stats_print_time_; // Real time
+};
+
+typedef std::shared_ptr<Bots> BotsPtr;
+
+} // namespace PanzerChasm
@@ -0,0 +1,200 @@
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../messages_encoding.hpp"
+
+#include "client_baselines.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int ClientBaselines::c_refresh_period;
+
+ClientBaselines::ClientBaselines()
+{}
+
+ClientBaselines::~ClientBaselines()
+{}
+
+void ClientBaselines::Reset()
+{
+	walls_.clear();
+	static_models_.clear();
+	items_.clear();
+	monsters_.clear();
+
+	has_map_start_update_= false;
+	map_start_acknowledged_= false;
+}
+
+void ClientBaselines::BeginUpdate( const uint16_t update_number )
+{
+	update_number_= update_number;
+	stats_.updates++;
+
+	if( !has_map_start_update_ )
+	{
+		map_start_update_number_= update_number;
+		has_map_start_update_= true;
+	}
+}
+
+void ClientBaselines::Acknowledge( const uint16_t update_number )
+{
+	// Ignore updates from future and old acknowledgements.
+	if( int16_t( update_number - update_number_ ) > 0 )
+		return;
+	if( has_acknowledged_update_ && int16_t( update_number - acknowledged_update_number_ ) <= 0 )
+		return;
+
+	acknowledged_update_number_= update_number;
+	has_acknowledged_update_= true;
+
+	// Remember it, because update numbers are compared with wrapping.
+	if( has_map_start_update_ && IsAcknowledged( map_start_update_number_ ) )
+		map_start_acknowledged_= true;
+}
+
+bool ClientBaselines::CheckWall( const Messages::WallPosition& message )
+{
+	return CheckSimpleEntity( walls_, message.wall_index, message );
+}
+
+bool ClientBaselines::CheckStaticModel( const Messages::StaticModelState& message )
+{
+	return CheckSimpleEntity( static_models_, message.static_model_index, message );
+}
+
+bool ClientBaselines::CheckItem( const Messages::ItemState& message )
+{
+	return CheckSimpleEntity( items_, message.item_index, message );
+}
+
+ClientBaselines::MonsterUpdate ClientBaselines::CheckMonster( const Messages::MonsterState& message, Messages::MonsterStateDelta& out_delta )
+{
+	MonsterBaseline& baseline= monsters_[ message.monster_id ];
+	const unsigned int full_size= GetEncodedMessageSize( message );
+	stats_.full_bytes+= full_size;
+
+	if( !baseline.birth_acknowledged && IsAcknowledged( baseline.birth_update_number ) )
+		baseline.birth_acknowledged= true;
+
+	// Client received last sent state - make it baseline.
+	// Client drops states of unknown monsters, so, state is not received, if birth is not received yet.
+	if( IsSentAcknowledged( baseline ) && IsMapStartAcknowledged() && baseline.birth_acknowledged )
+	{
+		baseline.acknowledged= baseline.sent;
+		baseline.has_acknowledged= true;
+		baseline.pending_fields= 0u;
+	}
+
+	const bool sent_changed= !baseline.has_sent || GetMonsterStateChangedFields( baseline.sent, message ) != 0u;
+	if( sent_changed )
+	{
+		baseline.sent= message;
+		baseline.sent_update_number= update_number_;
+		baseline.has_sent= true;
+		baseline.sent_acknowledged= false;
+	}
+
+	if( !baseline.has_acknowledged || NeedRefresh( message.monster_id ) )
+	{
+		if( baseline.has_acknowledged )
+			baseline.pending_fields|= GetMonsterStateChangedFields( baseline.acknowledged, message );
+
+		stats_.full_messages++;
+		stats_.bytes+= full_size;
+		return MonsterUpdate::Full;
+	}
+
+	// Send fields, changed since baseline, and fields, which client may receive after baseline.
+	const unsigned char fields_mask=
+		GetMonsterStateChangedFields( baseline.acknowledged, message ) | baseline.pending_fields;
+	if( fields_mask == 0u )
+	{
+		stats_.skipped_messages++;
+		return MonsterUpdate::Skip;
+	}
+
+	PackMonsterStateDelta( message, fields_mask, out_delta );
+	baseline.pending_fields|= fields_mask;
+
+	stats_.delta_messages++;
+	stats_.bytes+= GetEncodedMessageSize( out_delta );
+	return MonsterUpdate::Delta;
+}
+
+void ClientBaselines::BirthMonster( const EntityId monster_id )
+{
+	// State of this monster may be already sent in this update, before birth. Client drops it.
+	MonsterBaseline& baseline= monsters_[ monster_id ];
+	baseline.has_acknowledged= false;
+	baseline.pending_fields= 0u;
+	baseline.birth_update_number= update_number_;
+	baseline.birth_acknowledged= false;
+}
+
+void ClientBaselines::RemoveMonster( const EntityId monster_id )
+{
+	monsters_.erase( monster_id );
+}
+
+void ClientBaselines::ResetStats()
+{
+	stats_= Stats();
+}
+
+bool ClientBaselines::IsAcknowledged( const uint16_t update_number ) const
+{
+	return has_acknowledged_update_ && int16_t( acknowledged_update_number_ - update_number ) >= 0;
+}
+
+bool ClientBaselines::IsMapStartAcknowledged() const
+{
+	return map_start_acknowledged_;
+}
+
+template<class Message>
+bool ClientBaselines::IsSentAcknowledged( Baseline<Message>& baseline ) const
+{
+	if( baseline.has_sent && !baseline.sent_acknowledged && IsAcknowledged( baseline.sent_update_number ) )
+		baseline.sent_acknowledged= true;
+	return baseline.sent_acknowledged;
+}
+
+bool ClientBaselines::NeedRefresh( const unsigned int entity_number ) const
+{
+	return ( entity_number + update_number_ ) % c_refresh_period == 0u;
+}
+
+template<class Message>
+bool ClientBaselines::CheckSimpleEntity( std::vector< Baseline<Message> >& baselines, const unsigned int index, const Message& message )
+{
+	if( index >= baselines.size() )
+		baselines.resize( index + 1u );
+
+	Baseline<Message>& baseline= baselines[ index ];
+	const unsigned int size= GetEncodedMessageSize( message );
+	stats_.full_bytes+= size;
+
+	const bool same= baseline.has_sent && std::memcmp( &baseline.sent, &message, sizeof(Message) ) == 0;
+	if( same && IsSentAcknowledged( baseline ) && IsMapStartAcknowledged() && !NeedRefresh( index ) )
+	{
+		stats_.skipped_messages++;
+		return false;
+	}
+
+	if( !same )
+	{
+		baseline.sent= message;
+		baseline.sent_update_number= update_number_;
+		baseline.has_sent= true;
+		baseline.sent_acknowledged= false;
+	}
+
+	stats_.full_messages++;
+	stats_.bytes+= size;
+	return true;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../messages.hpp"
+
+namespace PanzerChasm
+{
+
+// Per-client states of map entities, known by client. Used for delta compression of map updates.
+// For each entity stored last sent state and number of update, in which this state was sent first time.
+// Client acknowledges number of last received update. When sent state is acknowledged, it becomes baseline.
+// Unchanged entities with acknowledged states are not sent. Monsters are sent as deltas against baseline.
+// Client ignores states of entities, until it receives map change and birth of entity via reliable channel.
+// So, states are not acknowledged until update with map change or entity birth is acknowledged.
+// Acknowledged update may be split into some packets, and one of them may be lost. So, each entity
+// is fully refreshed periodically.
+class ClientBaselines final
+{
+public:
+	struct Stats
+	{
+		unsigned int updates= 0u;
+		unsigned int full_messages= 0u;
+		unsigned int delta_messages= 0u;
+		unsigned int skipped_messages= 0u;
+		uint64_t bytes= 0u; // Sent states bytes, in network encoding.
+		uint64_t full_bytes= 0u; // Bytes, which are needed for sending all states without delta compression.
+	};
+
+	enum class MonsterUpdate
+	{
+		Skip,
+		Full,
+		Delta,
+	};
+
+	ClientBaselines();
+	~ClientBaselines();
+
+	// Forget all states. Call it after map change.
+	void Reset();
+
+	void BeginUpdate( uint16_t update_number );
+	void Acknowledge( uint16_t update_number );
+
+	// Returns true, if message must be sent.
+	bool CheckWall( const Messages::WallPosition& message );
+	bool CheckStaticModel( const Messages::StaticModelState& message );
+	bool CheckItem( const Messages::ItemState& message );
+
+	// Fills delta message, if delta is needed.
+	MonsterUpdate CheckMonster( const Messages::MonsterState& message, Messages::MonsterStateDelta& out_delta );
+	// Call it, when birth message of monster is sent.
+	void BirthMonster( EntityId monster_id );
+	void RemoveMonster( EntityId monster_id );
+
+	Stats& GetStats() { return stats_; }
+	const Stats& GetStats() const { return stats_; }
+	void ResetStats();
+
+private:
+	template<class Message>
+	struct Baseline
+	{
+		Message sent;
+		uint16_t sent_update_number= 0u;
+		bool has_sent= false;
+		// Latched, because update numbers wrap around and old sent update number may look not acknowledged.
+		bool sent_acknowledged= false;
+	};
+
+	struct MonsterBaseline : public Baseline<Messages::MonsterState>
+	{
+		Messages::MonsterState acknowledged;
+		bool has_acknowledged= false;
+		unsigned char pending_fields= 0u; // Fields, sent after acknowledged state.
+		uint16_t birth_update_number= 0u;
+		bool birth_acknowledged= true; // Monsters, existing at map start, are known by client since map start.
+	};
+
+	static constexpr unsigned int c_refresh_period= 32u; // In updates.
+
+private:
+	bool IsAcknowledged( uint16_t update_number ) const;
+	bool IsMapStartAcknowledged() const;
+	template<class Message>
+	bool IsSentAcknowledged( Baseline<Message>& baseline ) const;
+	bool NeedRefresh( unsigned int entity_number ) const;
+
+	template<class Message>
+	bool CheckSimpleEntity( std::vector< Baseline<Message> >& baselines, unsigned int index, const Message& message );
+
+private:
+	uint16_t update_number_= 0u;
+	uint16_t acknowledged_update_number_= 0u;
+	bool has_acknowledged_update_= false;
+
+	// First update after reset.
+	uint16_t map_start_update_number_= 0u;
+	bool has_map_start_update_= false;
+	bool map_start_acknowledged_= false;
+
+	std::vector< Baseline<Messages::WallPosition> > walls_;
+	std::vector< Baseline<Messages::StaticModelState> > static_models_;
+	std::vector< Baseline<Messages::ItemState> > items_;
+	std::unordered_map< EntityId, MonsterBaseline > monsters_;
+
+	Stats stats_;
+};
+
+} // namespace PanzerChasm
@@ -27,6 +27,14 @@ public:
 		const Func& func,
 		float max_cast_distance= Constants::max_float ) const;
 
+	// Process elements, placed in one cell of index. Dynamic models not processed.
+	template<class Func>
+	void ProcessCellElements( unsigned int x, unsigned int y, const Func& func ) const;
+
+	// Process models, which can`t be placed in index.
+	template<class Func>
+	void ProcessDynamicModels( const Func& func ) const;
+
 private:
 	void AddElementToIndex( unsigned int x, unsigned int y, const MapData::IndexElement& element );
 
@@ -34,13 +34,7 @@ void CollisionIndex::ProcessElementsInRadius(
 	}
 
 	// Process dynamic models without any optimizations
-	for( const unsigned short dynamic_model_index : dynamic_models_indeces_ )
-	{
-		MapData::IndexElement element;
-		element.type= MapData::IndexElement::StaticModel;
-		element.index= dynamic_model_index;
-		func( element );
-	}
+	ProcessDynamicModels( func );
 }
 
 template<class Func>
@@ -146,6 +140,29 @@ void CollisionIndex::RayCast(
 	} // line trace
 
 	// Process dynamic models without any optimizations.
+	ProcessDynamicModels( func );
+}
+
+template<class Func>
+void CollisionIndex::ProcessCellElements( const unsigned int x, const unsigned int y, const Func& func ) const
+{
+	PC_ASSERT( x < MapData::c_map_size );
+	PC_ASSERT( y < MapData::c_map_size );
+
+	unsigned short i= index_field_[ x + y * MapData::c_map_size ];
+	while( i != IndexElement::c_dummy_next )
+	{
+		PC_ASSERT( i <= index_elements_.size() );
+		const IndexElement& element= index_elements_[i];
+
+		func( element.index_element );
+		i= element.next;
+	}
+}
+
+template<class Func>
+void CollisionIndex::ProcessDynamicModels( const Func& func ) const
+{
 	for( const unsigned short dynamic_model_index : dynamic_models_indeces_ )
 	{
 		MapData::IndexElement element;
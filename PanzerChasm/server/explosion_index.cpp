@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+
+#include "explosion_index.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int ExplosionIndex::c_bucket_size_log2;
+constexpr unsigned int ExplosionIndex::c_buckets_in_row;
+constexpr unsigned int ExplosionIndex::c_bucket_count;
+
+ExplosionIndex::ExplosionIndex()
+{}
+
+ExplosionIndex::~ExplosionIndex()
+{}
+
+void ExplosionIndex::SetModel( const unsigned int model_index, const m_Vec2& pos, const float radius )
+{
+	if( model_index >= models_placement_.size() )
+	{
+		models_placement_.resize( model_index + 1u );
+		models_stamps_.resize( model_index + 1u, 0u );
+	}
+
+	ModelPlacement& placement= models_placement_[ model_index ];
+	const BucketsRect new_rect= GetBucketsRect( pos, radius );
+
+	if( placement.placed )
+	{
+		if( radius > 0.0f &&
+			placement.rect.x0 == new_rect.x0 && placement.rect.y0 == new_rect.y0 &&
+			placement.rect.x1 == new_rect.x1 && placement.rect.y1 == new_rect.y1 )
+			return; // Nothing changed.
+
+		for( unsigned int y= placement.rect.y0; y <= placement.rect.y1; y++ )
+		for( unsigned int x= placement.rect.x0; x <= placement.rect.x1; x++ )
+		{
+			Bucket& bucket= models_buckets_[ x + y * c_buckets_in_row ];
+			bucket.erase( std::find( bucket.begin(), bucket.end(), model_index ) );
+		}
+		placement.placed= false;
+	}
+
+	if( radius <= 0.0f )
+		return;
+
+	for( unsigned int y= new_rect.y0; y <= new_rect.y1; y++ )
+	for( unsigned int x= new_rect.x0; x <= new_rect.x1; x++ )
+		models_buckets_[ x + y * c_buckets_in_row ].push_back( model_index );
+
+	placement.placed= true;
+	placement.rect= new_rect;
+}
+
+bool ExplosionIndex::MonstersAreValid() const
+{
+	return monsters_valid_;
+}
+
+void ExplosionIndex::InvalidateMonsters()
+{
+	monsters_valid_= false;
+}
+
+void ExplosionIndex::ClearMonsters()
+{
+	for( Bucket& bucket : monsters_buckets_ )
+		bucket.clear();
+
+	monsters_.clear();
+	monsters_ids_.clear();
+	monsters_stamps_.clear();
+	monsters_current_stamp_= 0u;
+
+	monsters_valid_= true;
+}
+
+void ExplosionIndex::AddMonster( const EntityId monster_id, MonsterBase& monster, const m_Vec2& pos, const float radius )
+{
+	const unsigned int monster_number= static_cast<unsigned int>( monsters_.size() );
+	monsters_.push_back( &monster );
+	monsters_ids_.push_back( monster_id );
+	monsters_stamps_.push_back( 0u );
+
+	const BucketsRect rect= GetBucketsRect( pos, radius );
+	for( unsigned int y= rect.y0; y <= rect.y1; y++ )
+	for( unsigned int x= rect.x0; x <= rect.x1; x++ )
+		monsters_buckets_[ x + y * c_buckets_in_row ].push_back( monster_number );
+}
+
+void ExplosionIndex::GetModelsInRadius( const m_Vec2& pos, const float radius, std::vector<unsigned int>& out_models ) const
+{
+	GetObjectsInRect(
+		models_buckets_, GetBucketsRect( pos, radius ),
+		models_stamps_, models_current_stamp_,
+		out_models );
+}
+
+void ExplosionIndex::GetMonstersInRadius( const m_Vec2& pos, const float radius, std::vector<unsigned int>& out_monsters ) const
+{
+	PC_ASSERT( monsters_valid_ );
+
+	GetObjectsInRect(
+		monsters_buckets_, GetBucketsRect( pos, radius ),
+		monsters_stamps_, monsters_current_stamp_,
+		out_monsters );
+}
+
+MonsterBase& ExplosionIndex::GetMonster( const unsigned int monster_number ) const
+{
+	PC_ASSERT( monster_number < monsters_.size() );
+	return *monsters_[ monster_number ];
+}
+
+EntityId ExplosionIndex::GetMonsterId( const unsigned int monster_number ) const
+{
+	PC_ASSERT( monster_number < monsters_ids_.size() );
+	return monsters_ids_[ monster_number ];
+}
+
+ExplosionIndex::BucketsRect ExplosionIndex::GetBucketsRect( const m_Vec2& pos, const float radius )
+{
+	// Clamp coordinates to map. Objects and explosions outside map are placed in border buckets.
+	const auto to_bucket=
+	[]( const float coord ) -> unsigned char
+	{
+		const int cell= static_cast<int>( std::floor( coord ) );
+		const int cell_clamped= std::max( 0, std::min( cell, int(MapData::c_map_size) - 1 ) );
+		return static_cast<unsigned char>( cell_clamped >> c_bucket_size_log2 );
+	};
+
+	const float r= std::max( radius, 0.0f );
+
+	BucketsRect rect;
+	rect.x0= to_bucket( pos.x - r );
+	rect.y0= to_bucket( pos.y - r );
+	rect.x1= to_bucket( pos.x + r );
+	rect.y1= to_bucket( pos.y + r );
+	return rect;
+}
+
+void ExplosionIndex::GetObjectsInRect(
+	const Bucket* const buckets, const BucketsRect& rect,
+	std::vector<unsigned int>& stamps, unsigned int& current_stamp,
+	std::vector<unsigned int>& out_objects )
+{
+	out_objects.clear();
+
+	current_stamp++;
+	if( current_stamp == 0u )
+	{
+		// Stamp overflow - reset all stamps.
+		std::fill( stamps.begin(), stamps.end(), 0u );
+		current_stamp= 1u;
+	}
+
+	for( unsigned int y= rect.y0; y <= rect.y1; y++ )
+	for( unsigned int x= rect.x0; x <= rect.x1; x++ )
+	{
+		for( const unsigned int object : buckets[ x + y * c_buckets_in_row ] )
+		{
+			if( stamps[ object ] == current_stamp )
+				continue;
+
+			stamps[ object ]= current_stamp;
+			out_objects.push_back( object );
+		}
+	}
+
+	// Keep order of objects same, as in containers.
+	std::sort( out_objects.begin(), out_objects.end() );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../fwd.hpp"
+#include "../map_loader.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Spatial index for explosions damage - monsters and explodable static models.
+// Map is divided into buckets of cells. Each object is placed in all buckets, touched by its bounding box.
+// Models are placed at map start and replaced only when they move or change type.
+// Monsters move each tick, so, they are placed once per tick, before first explosion in this tick.
+class ExplosionIndex final
+{
+public:
+	ExplosionIndex();
+	~ExplosionIndex();
+
+	// Place model, or remove it, if radius is zero.
+	void SetModel( unsigned int model_index, const m_Vec2& pos, float radius );
+
+	bool MonstersAreValid() const;
+	void InvalidateMonsters();
+	// Remove all monsters. Call "AddMonster" for all monsters after it, in order of monsters container.
+	void ClearMonsters();
+	void AddMonster( EntityId monster_id, MonsterBase& monster, const m_Vec2& pos, float radius );
+
+	// Returns models indeces, sorted in ascending order.
+	void GetModelsInRadius( const m_Vec2& pos, float radius, std::vector<unsigned int>& out_models ) const;
+	// Returns monsters numbers, sorted in order of adding.
+	void GetMonstersInRadius( const m_Vec2& pos, float radius, std::vector<unsigned int>& out_monsters ) const;
+
+	MonsterBase& GetMonster( unsigned int monster_number ) const;
+	EntityId GetMonsterId( unsigned int monster_number ) const;
+
+private:
+	static constexpr unsigned int c_bucket_size_log2= 2u;
+	static constexpr unsigned int c_buckets_in_row= MapData::c_map_size >> c_bucket_size_log2;
+	static constexpr unsigned int c_bucket_count= c_buckets_in_row * c_buckets_in_row;
+
+	struct BucketsRect
+	{
+		// Inclusive.
+		unsigned char x0, y0;
+		unsigned char x1, y1;
+	};
+
+	struct ModelPlacement
+	{
+		bool placed= false;
+		BucketsRect rect;
+	};
+
+	typedef std::vector<unsigned int> Bucket;
+
+private:
+	static BucketsRect GetBucketsRect( const m_Vec2& pos, float radius );
+	static void GetObjectsInRect(
+		const Bucket* buckets, const BucketsRect& rect,
+		std::vector<unsigned int>& stamps, unsigned int& current_stamp,
+		std::vector<unsigned int>& out_objects );
+
+private:
+	std::vector<ModelPlacement> models_placement_;
+	Bucket models_buckets_[ c_bucket_count ];
+	mutable std::vector<unsigned int> models_stamps_;
+	mutable unsigned int models_current_stamp_= 0u;
+
+	bool monsters_valid_= false;
+	std::vector<MonsterBase*> monsters_;
+	std::vector<EntityId> monsters_ids_;
+	Bucket monsters_buckets_[ c_bucket_count ];
+	mutable std::vector<unsigned int> monsters_stamps_;
+	mutable unsigned int monsters_current_stamp_= 0u;
+};
+
+} // namespace PanzerChasm
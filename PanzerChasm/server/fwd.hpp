@@ -6,6 +6,8 @@ namespace PanzerChasm
 
 struct Backpack;
 
+class ClientBaselines;
+
 class Map;
 
 class MonsterBase;
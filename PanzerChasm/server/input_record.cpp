@@ -0,0 +1,159 @@
+#include <cstring>
+#include <limits>
+
+#include "../../Common/files.hpp"
+using namespace ChasmReverse;
+
+#include "../log.hpp"
+
+#include "input_record.hpp"
+
+namespace PanzerChasm
+{
+
+const char InputRecordHeader::c_expected_id[8]= "PanChIR"; // PanzerChasmInputRecord
+
+constexpr unsigned int InputRecordHeader::c_expected_version;
+
+std::unique_ptr<InputRecorder> InputRecorder::Create( const char* const file_name, const InputRecordHeader& header )
+{
+	std::FILE* const file= std::fopen( file_name, "wb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not write input record \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	InputRecordHeader file_header= header;
+	std::memcpy( file_header.id, InputRecordHeader::c_expected_id, sizeof(file_header.id) );
+	file_header.version= InputRecordHeader::c_expected_version;
+	file_header.protocol_version= Messages::c_protocol_version;
+	FileWrite( file, &file_header, sizeof(InputRecordHeader) );
+
+	return std::unique_ptr<InputRecorder>( new InputRecorder( file ) );
+}
+
+InputRecorder::InputRecorder( std::FILE* const file )
+	: file_(file)
+{
+	PC_ASSERT( file_ != nullptr );
+}
+
+InputRecorder::~InputRecorder()
+{
+	std::fclose( file_ );
+}
+
+void InputRecorder::WriteTick( const uint64_t state_hash, const std::vector<InputRecordPlayerInput>& inputs )
+{
+	InputRecordTickHeader tick_header;
+	tick_header.state_hash= state_hash;
+	tick_header.input_count= inputs.size();
+	tick_header.reserved= 0u;
+
+	FileWrite( file_, &tick_header, sizeof(InputRecordTickHeader) );
+	if( !inputs.empty() )
+		FileWrite( file_, inputs.data(), inputs.size() * sizeof(InputRecordPlayerInput) );
+
+	tick_count_++;
+}
+
+unsigned int InputRecorder::GetTickCount() const
+{
+	return tick_count_;
+}
+
+std::unique_ptr<InputReplayer> InputReplayer::Load( const char* const file_name )
+{
+	std::FILE* const file= std::fopen( file_name, "rb" );
+	if( file == nullptr )
+	{
+		Log::Warning( "Can not read input record \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	std::fseek( file, 0, SEEK_END );
+	const long file_size= std::ftell( file );
+	std::fseek( file, 0, SEEK_SET );
+
+	if( file_size < 0 || static_cast<unsigned long>(file_size) > std::numeric_limits<unsigned int>::max() )
+	{
+		std::fclose( file );
+		Log::Warning( "Can not read input record \"", file_name, "\"" );
+		return nullptr;
+	}
+
+	std::vector<unsigned char> data( static_cast<size_t>(file_size) );
+	FileRead( file, data.data(), data.size() );
+	std::fclose( file );
+
+	if( data.size() < sizeof(InputRecordHeader) )
+	{
+		Log::Warning( "Input record is broken - it is too small" );
+		return nullptr;
+	}
+
+	InputRecordHeader header;
+	std::memcpy( &header, data.data(), sizeof(InputRecordHeader) );
+	if( std::memcmp( header.id, InputRecordHeader::c_expected_id, sizeof(header.id) ) != 0 )
+	{
+		Log::Warning( "File is not a PanzerChasm input record" );
+		return nullptr;
+	}
+	if( header.version != InputRecordHeader::c_expected_version || header.protocol_version != Messages::c_protocol_version )
+	{
+		Log::Warning( "Input record has different version" );
+		return nullptr;
+	}
+
+	return std::unique_ptr<InputReplayer>( new InputReplayer( std::move(data) ) );
+}
+
+InputReplayer::InputReplayer( std::vector<unsigned char> data )
+	: data_( std::move(data) )
+	, pos_( sizeof(InputRecordHeader) )
+{
+	PC_ASSERT( data_.size() >= sizeof(InputRecordHeader) );
+	std::memcpy( &header_, data_.data(), sizeof(InputRecordHeader) );
+}
+
+InputReplayer::~InputReplayer()
+{}
+
+const InputRecordHeader& InputReplayer::GetHeader() const
+{
+	return header_;
+}
+
+bool InputReplayer::NextTick( std::vector<InputRecordPlayerInput>& out_inputs, uint64_t& out_state_hash )
+{
+	out_inputs.clear();
+
+	if( data_.size() - pos_ < sizeof(InputRecordTickHeader) )
+		return false;
+
+	InputRecordTickHeader tick_header;
+	std::memcpy( &tick_header, data_.data() + pos_, sizeof(InputRecordTickHeader) );
+
+	// Last tick may be incomplete, if server was terminated while recording.
+	const unsigned int inputs_size= tick_header.input_count * sizeof(InputRecordPlayerInput);
+	if( tick_header.input_count > ( data_.size() - pos_ - sizeof(InputRecordTickHeader) ) / sizeof(InputRecordPlayerInput) )
+		return false;
+	pos_+= sizeof(InputRecordTickHeader);
+
+	out_inputs.resize( tick_header.input_count );
+	if( inputs_size > 0u )
+		std::memcpy( out_inputs.data(), data_.data() + pos_, inputs_size );
+	pos_+= inputs_size;
+
+	out_state_hash= tick_header.state_hash;
+	tick_count_++;
+	return true;
+}
+
+unsigned int InputReplayer::GetTickCount() const
+{
+	return tick_count_;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "../assert.hpp"
+#include "../messages.hpp"
+
+namespace PanzerChasm
+{
+
+// Record of one map run in fixed tick mode - inputs of players, stamped with tick numbers, and map state hashes.
+// Replay of record in same build must produce same map state hash on each tick.
+// File structure: header, than ticks. Each tick is tick header, than inputs, applied before this tick.
+
+struct InputRecordHeader
+{
+public:
+	static const char c_expected_id[8];
+	static constexpr unsigned int c_expected_version= 0x100u; // Change each time, when format changed.
+
+public:
+	unsigned char id[8]; // must be equal to c_expected_id
+	uint32_t version;
+	uint32_t protocol_version; // Inputs are stored as messages, so, they can be read only with same protocol.
+
+	uint32_t map_number;
+	uint32_t difficulty;
+	uint32_t game_rules;
+	uint32_t random_seed;
+	uint32_t tick_rate;
+	uint32_t player_count;
+	uint64_t initial_state_hash; // Hash of map state after map start, before first tick.
+};
+
+SIZE_ASSERT( InputRecordHeader, 48u );
+
+struct InputRecordTickHeader
+{
+	uint64_t state_hash; // After tick.
+	uint32_t input_count;
+	uint32_t reserved;
+};
+
+SIZE_ASSERT( InputRecordTickHeader, 16u );
+
+struct InputRecordPlayerInput
+{
+	uint32_t player_index; // In server players list.
+	Messages::PlayerMove message;
+};
+
+// Writes ticks into file immediately, so, record is valid even if server is terminated.
+class InputRecorder final
+{
+public:
+	// Returns nullptr, if can not create file.
+	static std::unique_ptr<InputRecorder> Create( const char* file_name, const InputRecordHeader& header );
+
+	explicit InputRecorder( std::FILE* file );
+	~InputRecorder();
+
+	void WriteTick( uint64_t state_hash, const std::vector<InputRecordPlayerInput>& inputs );
+	unsigned int GetTickCount() const;
+
+private:
+	InputRecorder& operator=( const InputRecorder& )= delete;
+
+private:
+	std::FILE* const file_;
+	unsigned int tick_count_= 0u;
+};
+
+class InputReplayer final
+{
+public:
+	// Returns nullptr, if can not load record.
+	static std::unique_ptr<InputReplayer> Load( const char* file_name );
+
+	explicit InputReplayer( std::vector<unsigned char> data );
+	~InputReplayer();
+
+	const InputRecordHeader& GetHeader() const;
+
+	// Returns false, if there is no more ticks.
+	bool NextTick( std::vector<InputRecordPlayerInput>& out_inputs, uint64_t& out_state_hash );
+	unsigned int GetTickCount() const; // Ticks, returned by "NextTick".
+
+private:
+	const std::vector<unsigned char> data_;
+	InputRecordHeader header_;
+	unsigned int pos_;
+	unsigned int tick_count_= 0u;
+};
+
+} // namespace PanzerChasm
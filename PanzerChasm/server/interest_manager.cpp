@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "collisions.hpp"
+#include "collision_index.inl"
+
+#include "interest_manager.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int InterestManager::c_block_size_log2;
+constexpr unsigned int InterestManager::c_blocks_in_row;
+constexpr unsigned int InterestManager::c_block_count;
+constexpr unsigned int InterestManager::c_row_words;
+constexpr float InterestManager::c_always_relevant_distance;
+constexpr float InterestManager::c_max_relevant_distance;
+constexpr unsigned int InterestManager::c_far_refresh_period;
+
+// Sample points inside block - center and corners, moved inside block.
+static const float g_block_sample_points[][2]=
+{
+	{ 0.5f, 0.5f },
+	{ 0.1f, 0.1f }, { 0.9f, 0.1f },
+	{ 0.1f, 0.9f }, { 0.9f, 0.9f },
+};
+
+InterestManager::InterestManager( const MapDataConstPtr& map_data, const CollisionIndex& collision_index )
+	: map_data_(map_data)
+	, collision_index_(collision_index)
+{
+	PC_ASSERT( map_data_ != nullptr );
+
+	std::fill( block_calculated_, block_calculated_ + c_block_count, false );
+	std::memset( visible_blocks_, 0, sizeof(visible_blocks_) );
+}
+
+InterestManager::~InterestManager()
+{}
+
+void InterestManager::SetViewer( const m_Vec2& viewer_pos )
+{
+	const unsigned int block= GetBlock( viewer_pos );
+	if( !block_calculated_[ block ] )
+		CalculateBlockVisibility( block );
+
+	viewer_pos_= viewer_pos;
+	viewer_visible_blocks_= visible_blocks_ + block * c_row_words;
+}
+
+bool InterestManager::IsRelevant( const m_Vec2& pos, const unsigned int entity_number )
+{
+	if( IsEventRelevant( pos ) ||
+		( entity_number + update_number_ ) % c_far_refresh_period == 0u )
+	{
+		stats_.sent++;
+		return true;
+	}
+
+	stats_.culled++;
+	return false;
+}
+
+bool InterestManager::IsEventRelevant( const m_Vec2& pos ) const
+{
+	PC_ASSERT( viewer_visible_blocks_ != nullptr );
+
+	const float square_distance= ( pos - viewer_pos_ ).SquareLength();
+	if( square_distance <= c_always_relevant_distance * c_always_relevant_distance )
+		return true;
+	if( square_distance > c_max_relevant_distance * c_max_relevant_distance )
+		return false;
+
+	const unsigned int block= GetBlock( pos );
+	return ( viewer_visible_blocks_[ block >> 5u ] & ( 1u << ( block & 31u ) ) ) != 0u;
+}
+
+void InterestManager::NextUpdate()
+{
+	update_number_++;
+}
+
+void InterestManager::ResetStats()
+{
+	stats_= Stats();
+}
+
+unsigned int InterestManager::GetBlock( const m_Vec2& pos )
+{
+	const int max_coord= int(MapData::c_map_size) - 1;
+	const int x= std::max( 0, std::min( static_cast<int>( std::floor( pos.x ) ), max_coord ) ) >> c_block_size_log2;
+	const int y= std::max( 0, std::min( static_cast<int>( std::floor( pos.y ) ), max_coord ) ) >> c_block_size_log2;
+
+	return static_cast<unsigned int>( x + y * int(c_blocks_in_row) );
+}
+
+void InterestManager::CalculateBlockVisibility( const unsigned int block )
+{
+	PC_ASSERT( block < c_block_count );
+
+	const float c_block_size= float( 1u << c_block_size_log2 );
+	// Blocks farther, than this, are not needed - entities in it are not relevant anyway.
+	const float max_distance= c_max_relevant_distance + c_block_size * 2.0f;
+
+	uint32_t* const row= visible_blocks_ + block * c_row_words;
+	std::memset( row, 0, sizeof(uint32_t) * c_row_words );
+
+	const m_Vec2 block_pos(
+		float( block % c_blocks_in_row ) * c_block_size,
+		float( block / c_blocks_in_row ) * c_block_size );
+
+	for( unsigned int other_block= 0u; other_block < c_block_count; other_block++ )
+	{
+		bool visible= false;
+
+		if( other_block == block )
+			visible= true;
+		else if( block_calculated_[ other_block ] )
+		{
+			// Visibility is symmetric - take result from other block.
+			const uint32_t* const other_row= visible_blocks_ + other_block * c_row_words;
+			visible= ( other_row[ block >> 5u ] & ( 1u << ( block & 31u ) ) ) != 0u;
+		}
+		else
+		{
+			const m_Vec2 other_block_pos(
+				float( other_block % c_blocks_in_row ) * c_block_size,
+				float( other_block / c_blocks_in_row ) * c_block_size );
+
+			if( ( other_block_pos - block_pos ).SquareLength() <= max_distance * max_distance )
+			{
+				for( const float* from_sample : g_block_sample_points )
+				{
+					const m_Vec2 from= block_pos + m_Vec2( from_sample[0], from_sample[1] ) * c_block_size;
+					for( const float* to_sample : g_block_sample_points )
+					{
+						const m_Vec2 to= other_block_pos + m_Vec2( to_sample[0], to_sample[1] ) * c_block_size;
+						if( IsRayClear( from, to ) )
+						{
+							visible= true;
+							break;
+						}
+					}
+					if( visible )
+						break;
+				}
+			}
+		}
+
+		if( visible )
+			row[ other_block >> 5u ]|= 1u << ( other_block & 31u );
+	}
+
+	block_calculated_[ block ]= true;
+	stats_.blocks_calculated++;
+}
+
+bool InterestManager::IsRayClear( const m_Vec2& from, const m_Vec2& to ) const
+{
+	const m_Vec3 from_3d( from, GameConstants::walls_height * 0.5f );
+	m_Vec3 direction( to - from, 0.0f );
+	const float max_distance= direction.Length();
+	if( max_distance <= 0.0f )
+		return true;
+	direction/= max_distance;
+
+	bool clear= true;
+	collision_index_.RayCast(
+		from_3d, direction,
+		[&]( const MapData::IndexElement& element ) -> bool
+		{
+			if( element.type != MapData::IndexElement::StaticWall )
+				return false;
+
+			PC_ASSERT( element.index < map_data_->static_walls.size() );
+			const MapData::Wall& wall= map_data_->static_walls[ element.index ];
+
+			const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
+			if( wall_texture.gso[1] )
+				return false;
+
+			m_Vec3 intersection_pos;
+			if( RayIntersectWall(
+					wall.vert_pos[0], wall.vert_pos[1],
+					0.0f, GameConstants::walls_height,
+					from_3d, direction,
+					intersection_pos ) &&
+				( intersection_pos - from_3d ).SquareLength() <= max_distance * max_distance )
+			{
+				clear= false;
+				return true;
+			}
+			return false;
+		},
+		max_distance );
+
+	return clear;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../fwd.hpp"
+#include "../map_loader.hpp"
+#include "collision_index.hpp"
+
+namespace PanzerChasm
+{
+
+// Per-client relevance filter for map update messages.
+// Map is divided into blocks of cells. Block is potentially visible from other block, if some ray between
+// sample points of these blocks is not blocked by static walls. Dynamic walls are ignored, so, visibility is conservative.
+// Visibility of blocks is calculated lazily - for one source block at once, when some viewer enters this block.
+// Entities near viewer, or visible from viewer block, are relevant each update.
+// Other entities are refreshed with low rate, so, client state for them never becomes too old.
+class InterestManager final
+{
+public:
+	struct Stats
+	{
+		unsigned int sent= 0u;
+		unsigned int culled= 0u;
+		unsigned int blocks_calculated= 0u;
+	};
+
+	InterestManager( const MapDataConstPtr& map_data, const CollisionIndex& collision_index );
+	~InterestManager();
+
+	// Select viewer for next "IsRelevant" calls. Calculates visibility for viewer block, if needed.
+	void SetViewer( const m_Vec2& viewer_pos );
+
+	// Returns true, if state of entity must be sent to current viewer in this update.
+	// Entity number is used for distribution of far entities refreshing between updates.
+	bool IsRelevant( const m_Vec2& pos, unsigned int entity_number );
+	// Same as above, but without refreshing - for one-time events.
+	bool IsEventRelevant( const m_Vec2& pos ) const;
+
+	// Call it once after sending updates to all clients.
+	void NextUpdate();
+
+	Stats& GetStats() { return stats_; }
+	const Stats& GetStats() const { return stats_; }
+	void ResetStats();
+
+private:
+	static constexpr unsigned int c_block_size_log2= 2u;
+	static constexpr unsigned int c_blocks_in_row= MapData::c_map_size >> c_block_size_log2;
+	static constexpr unsigned int c_block_count= c_blocks_in_row * c_blocks_in_row;
+	static constexpr unsigned int c_row_words= c_block_count / 32u;
+
+	static constexpr float c_always_relevant_distance= 6.0f;
+	static constexpr float c_max_relevant_distance= 40.0f;
+	static constexpr unsigned int c_far_refresh_period= 8u; // In updates.
+
+private:
+	static unsigned int GetBlock( const m_Vec2& pos );
+	void CalculateBlockVisibility( unsigned int block );
+	bool IsRayClear( const m_Vec2& from, const m_Vec2& to ) const;
+
+private:
+	const MapDataConstPtr map_data_;
+	const CollisionIndex& collision_index_;
+
+	m_Vec2 viewer_pos_;
+	const uint32_t* viewer_visible_blocks_= nullptr;
+
+	unsigned int update_number_= 0u;
+
+	Stats stats_;
+
+	bool block_calculated_[ c_block_count ];
+	// Put large objects here.
+	uint32_t visible_blocks_[ c_block_count * c_row_words ]; // Bit matrix.
+};
+
+} // namespace PanzerChasm
@@ -3,14 +3,17 @@
 #include <matrix.hpp>
 
 #include "../game_constants.hpp"
+#include "../log.hpp"
 #include "../math_utils.hpp"
 #include "../particles.hpp"
 #include "../sound/sound_id.hpp"
 #include "a_code.hpp"
+#include "client_baselines.hpp"
 #include "collisions.hpp"
-#include "collision_index.inl"
+#include "map_collisions.inl"
 #include "monster.hpp"
 #include "player.hpp"
+#include "shots_broad_phase.inl"
 
 #include "map.hpp"
 
@@ -28,20 +31,6 @@ static unsigned int AnimationNumberToModelNumber( const unsigned int animation_n
 	return animation_number - 33u;
 }
 
-template<class Wall>
-static m_Vec3 GetNormalForWall( const Wall& wall )
-{
-	m_Vec3 n( wall.vert_pos[0].y - wall.vert_pos[1].y, wall.vert_pos[1].x - wall.vert_pos[0].x, 0.0f );
-	return n / n.xy().Length();
-}
-
-static bool CollideWithSquare( const MapData::ModelDescription& model_description )
-{
-	// CYKABLAT!
-	// It seems, that original game uses cicrcles collision, if lower radius bit is 0, and square, if this bit is 1.
-	return ( int(model_description.radius * 256.0f) & 1 ) == 1;
-}
-
 Map::Rocket::Rocket(
 	const EntityId in_rocket_id,
 	const EntityId in_owner_id,
@@ -77,13 +66,13 @@ void Map::ProcessElementLinks(
 	const unsigned int index,
 	const Func& func )
 {
-	for( const MapData::Link& link : map_data_->links )
-	{
-		const MapData::IndexElement& index_element= map_data_->map_index[ link.x + link.y * MapData::c_map_size ];
+	PC_ASSERT( element_type <= MapData::IndexElement::Item );
+	const std::vector<unsigned int>& offsets= map_data_->elements_links_offsets[ element_type ];
+	if( index + 1u >= offsets.size() )
+		return;
 
-		if( index_element.type == element_type && index_element.index == index )
-			func( link );
-	}
+	for( unsigned int i= offsets[ index ]; i < offsets[ index + 1u ]; i++ )
+		func( map_data_->links[ map_data_->elements_links[i] ] );
 }
 
 Map::Map(
@@ -92,6 +81,7 @@ Map::Map(
 	const MapDataConstPtr& map_data,
 	const GameResourcesConstPtr& game_resources,
 	const Time map_start_time,
+	const LongRand::RandResultType random_seed,
 	MapEndCallback map_end_callback,
 	TextMessageCallback text_message_callback )
 	: difficulty_(difficulty)
@@ -100,18 +90,17 @@ Map::Map(
 	, game_resources_(game_resources)
 	, map_end_callback_( std::move( map_end_callback ) )
 	, text_message_callback_(std::move(text_message_callback) )
-	, random_generator_( std::make_shared<LongRand>() )
+	, random_generator_( std::make_shared<LongRand>( random_seed ) )
+	, procedures_scheduler_( static_cast<unsigned int>( map_data->procedures.size() ) )
 	, collision_index_( map_data )
+	, visibility_cache_( map_data, collision_index_ )
+	, interest_manager_( map_data, collision_index_ )
 {
 	PC_ASSERT( map_data_ != nullptr );
 	PC_ASSERT( game_resources_ != nullptr );
 
 	unsigned int difficulty_mask= static_cast<unsigned int>( difficulty_ );
 
-	std::memset( wind_field_, 0, sizeof(wind_field_) );
-	std::memset( death_field_, 0, sizeof(death_field_) );
-	std::memset( quake_field_, 0, sizeof(quake_field_) );
-
 	procedures_.resize( map_data_->procedures.size() );
 	for( unsigned int p= 0u; p < procedures_.size(); p++ )
 	{
@@ -202,6 +191,8 @@ Map::Map(
 
 		model.pos.z= model.baze_z= GetFloorLevel( model.pos.xy(), description.radius );
 	}
+	for( unsigned int m= 0u; m < static_models_.size(); m++ )
+		UpdateModelExplosionIndex( m );
 
 	// Spawn monsters
 	if( game_rules_ != GameRules::Deathmatch )
@@ -306,6 +297,7 @@ EntityId Map::SpawnPlayer( const PlayerPtr& player )
 	players_.emplace( player_id, player );
 	const MonstersContainer::value_type& monster_value=
 		* monsters_.emplace( player_id, player ).first;
+	explosion_index_.InvalidateMonsters();
 
 	monsters_birth_messages_.emplace_back();
 	Messages::MonsterBirth& message= monsters_birth_messages_.back();
@@ -321,6 +313,7 @@ void Map::DespawnPlayer( const EntityId player_id )
 {
 	const bool erased= players_.erase( player_id ) != 0u;
 	monsters_.erase( player_id );
+	explosion_index_.InvalidateMonsters();
 
 	if( erased )
 	{
@@ -341,6 +334,23 @@ void Map::Shoot(
 	next_rocket_id_++;
 
 	Rocket& rocket= rockets_.back();
+
+	// Player saw monsters with delay. Check his hitscan shot against monsters positions, which he saw.
+	if( rocket.HasInfiniteSpeed( *game_resources_ ) )
+	{
+		const auto player_it= players_.find( owner_id );
+		if( player_it != players_.end() )
+		{
+			const unsigned int lag_ticks= player_it->second->GetLagCompensationTicks();
+			const uint32_t last_tick= monsters_history_.GetLastTick();
+			if( lag_ticks > 0u && lag_ticks <= last_tick )
+			{
+				rocket.lag_compensated= true;
+				rocket.lag_compensation_tick= last_tick - lag_ticks;
+			}
+		}
+	}
+
 	if( !rocket.HasInfiniteSpeed( *game_resources_ ) )
 	{
 		Messages::RocketBirth message;
@@ -467,200 +477,11 @@ m_Vec3 Map::CollideWithMap(
 	const Time tick_delta,
 	bool& out_on_floor, MovementRestriction& out_movement_restriction ) const
 {
-	m_Vec2 pos= in_pos.xy();
-	out_on_floor= false;
-
-	const float z_bottom= in_pos.z;
-	const float z_top= z_bottom + height;
-	float new_z= in_pos.z;
-
-	// Store list of objects, collisions with which alread processed.
-	constexpr unsigned int c_max_collisions= 32u;
-	MapData::IndexElement processed_collisions[ c_max_collisions ];
-	unsigned int processed_collisions_count= 0u;
-	const auto collision_processed=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		if( processed_collisions_count == c_max_collisions )
-			return true;
-		for( unsigned int i= 0u; i < processed_collisions_count; i++ )
-			if( std::memcmp( &processed_collisions[i], &index_element, sizeof(MapData::IndexElement) ) == 0 )
-				return true;
-		return false;
-	};
-	const auto process_collision=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		PC_ASSERT( processed_collisions_count < c_max_collisions );
-		processed_collisions[ processed_collisions_count ]= index_element;
-		processed_collisions_count++;
-	};
-
-	const auto elements_process_func=
-	[&]( const MapData::IndexElement& index_element )
-	{
-		if( collision_processed(index_element) )
-			return;
-
-		if( index_element.type == MapData::IndexElement::StaticWall )
-		{
-			PC_ASSERT( index_element.index < map_data_->static_walls.size() );
-			const MapData::Wall& wall= map_data_->static_walls[ index_element.index ];
-
-			const MapData::WallTextureDescription& tex= map_data_->walls_textures[ wall.texture_id ];
-			if( tex.gso[0] )
-				return;
-
-			// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
-			if( wall.texture_id < MapData::c_first_transparent_texture_id &&
-				mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
-				return;
-
-			m_Vec2 new_pos;
-			if( CollideCircleWithLineSegment(
-					wall.vert_pos[0], wall.vert_pos[1],
-					pos, radius,
-					new_pos ) )
-			{
-				process_collision( index_element );
-				pos= new_pos;
-				out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
-			}
-		}
-		else if( index_element.type == MapData::IndexElement::StaticModel )
-		{
-			const StaticModel& model= static_models_[ index_element.index ];
-			if( model.model_id >= map_data_->models_description.size() )
-				return;
-
-			const MapData::ModelDescription& model_description= map_data_->models_description[ model.model_id ];
-			if( model_description.radius <= 0.0f )
-				return;
-
-			const ACode a_code= static_cast<ACode>( model_description.ac );
-			if( a_code >= ACode::RedKey && a_code <= ACode::BlueKey )
-				return; // Skip keys
-
-			const Model& model_geometry= map_data_->models[ model.model_id ];
-
-			const float model_z_min= model_geometry.z_min + model.pos.z;
-			const float model_z_max= model_geometry.z_max + model.pos.z;
-			if( z_top < model_z_min || z_bottom > model_z_max )
-				return;
-
-			bool collided= false;
-
-			m_Vec2 collide_pos;
-			if( CollideWithSquare( model_description ) )
-			{
-				collided=
-					CollideCircleWithSquare(
-						model.pos.xy(), model.angle, model_description.radius,
-						pos, radius,
-						collide_pos );
-			}
-			else
-			{
-				const float min_distance= radius + model_description.radius;
-				const m_Vec2 vec_to_pos= pos - model.pos.xy();
-				const float square_distance= vec_to_pos.SquareLength();
-				if( square_distance > 0.0f && square_distance < min_distance * min_distance )
-				{
-					collided= true;
-					collide_pos= model.pos.xy() + vec_to_pos * min_distance / std::sqrt( square_distance );
-				}
-			}
-
-			if( collided )
-			{
-				process_collision( index_element );
-				// Pull up or down player.
-				if( model_z_max - z_bottom <= GameConstants::z_pull_distance &&
-					model_z_max + height <= GameConstants::walls_height )
-				{
-					if( new_z < model_z_max )
-					{
-						new_z+= GameConstants::z_pull_speed * tick_delta.ToSeconds();
-						new_z= std::min( new_z, model_z_max );
-						if( new_z >= model_z_max )
-							out_on_floor= true;
-					}
-				}
-				else if( z_top - model_z_min <= GameConstants::z_pull_distance &&
-					model_z_min - height >= 0.0f )
-				{
-					if( new_z > model_z_min - height )
-					{
-						new_z-= GameConstants::z_pull_speed * tick_delta.ToSeconds();
-						new_z= std::max( new_z, model_z_min - height );
-					}
-				}
-				// Push sideways.
-				else
-				{
-					const m_Vec2 normal= collide_pos - pos;
-					const float normal_square_length= normal.SquareLength();
-					if( normal_square_length > 0.0f )
-						out_movement_restriction.AddRestriction( normal / normal_square_length );
-
-					pos.x= collide_pos.x;
-					pos.y= collide_pos.y;
-				}
-			}
-		}
-		else
-		{
-			// TODO
-		}
-	};
-
-	collision_index_.ProcessElementsInRadius(
-		pos, radius,
-		elements_process_func );
-
-	// Dynamic walls
-	for( const DynamicWall& wall : dynamic_walls_ )
-	{
-		if( wall.vert_pos[0] == wall.vert_pos[1] )
-			continue;
-
-		const MapData::WallTextureDescription& tex= map_data_->walls_textures[ wall.texture_id ];
-		if( tex.gso[0] )
-			continue;
-
-		// PROCESS.05:
-		// ;  up            [ x,y] [ H]   [s:num]     ,if H>=80 then walktrough
-		if( wall.z >= 80.0f / 64.0f )
-			continue;
-
-		if( z_top < wall.z || z_bottom > wall.z + GameConstants::walls_height )
-			continue;
-
-		// Do not collide with wall, if we are behind it. But collide, if wall is transparent.
-		if( wall.texture_id < MapData::c_first_transparent_texture_id &&
-			mVec2Cross( pos - wall.vert_pos[0], wall.vert_pos[1] - wall.vert_pos[0] ) > 0.0f )
-			continue;
-
-		m_Vec2 new_pos;
-		if( CollideCircleWithLineSegment(
-				wall.vert_pos[0], wall.vert_pos[1],
-				pos, radius,
-				new_pos ) )
-		{
-			pos= new_pos;
-			out_movement_restriction.AddRestriction( GetNormalForWall( wall ).xy() );
-		}
-	}
-
-	if( new_z <= 0.0f )
-	{
-		out_on_floor= true;
-		new_z= 0.0f;
-	}
-	else if( new_z + height > GameConstants::walls_height )
-		new_z= GameConstants::walls_height - height;
-
-	return m_Vec3( pos, new_z );
+	return
+		CollideWithMapGeometry(
+			*map_data_, collision_index_, static_models_, dynamic_walls_,
+			in_pos, height, radius, tick_delta,
+			out_on_floor, out_movement_restriction );
 }
 
 bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
@@ -668,6 +489,12 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 	if( from == to )
 		return true;
 
+	const bool region_is_clear= visibility_cache_.IsRegionClear( from.xy(), to.xy() );
+	if( region_is_clear )
+		visibility_cache_.GetStats().clear_hits++;
+	else
+		visibility_cache_.GetStats().fallbacks++;
+
 	m_Vec3 direction= to - from;
 	const float max_see_distance= direction.Length();
 	direction.Normalize();
@@ -740,6 +567,13 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 		return false;
 	};
 
+	if( region_is_clear )
+	{
+		// There are no walls and indexed models near ray. Check only models outside index.
+		collision_index_.ProcessDynamicModels( element_process_func );
+		return can_see;
+	}
+
 	// Static walls and map models.
 	collision_index_.RayCast(
 		from, direction,
@@ -768,6 +602,125 @@ bool Map::CanSee( const m_Vec3& from, const m_Vec3& to ) const
 	return can_see;
 }
 
+bool Map::CanSee( const m_Vec3& from, const m_Vec3& to, const EntityId from_monster_id, const EntityId to_monster_id ) const
+{
+	bool can_see;
+	if( visibility_cache_.FindMemo( from_monster_id, to_monster_id, from, to, can_see ) )
+		return can_see;
+
+	can_see= CanSee( from, to );
+	visibility_cache_.AddMemo( from_monster_id, to_monster_id, from, to, can_see );
+	return can_see;
+}
+
+const VisibilityCache::Stats& Map::GetVisibilityCacheStats() const
+{
+	return visibility_cache_.GetStats();
+}
+
+void Map::ResetVisibilityCacheStats()
+{
+	visibility_cache_.ResetStats();
+}
+
+const ProceduresScheduler& Map::GetProceduresScheduler() const
+{
+	return procedures_scheduler_;
+}
+
+void Map::ResetProceduresSchedulerStats()
+{
+	procedures_scheduler_.ResetStats();
+}
+
+void Map::SetTickProfiler( TickProfiler* const profiler )
+{
+	tick_profiler_= profiler;
+}
+
+void Map::SetInterestManagement( const bool enabled )
+{
+	interest_management_enabled_= enabled;
+}
+
+const InterestManager::Stats& Map::GetInterestManagerStats() const
+{
+	return interest_manager_.GetStats();
+}
+
+void Map::ResetInterestManagerStats()
+{
+	interest_manager_.ResetStats();
+}
+
+void Map::RunShotsBenchmark( const unsigned int shots_count )
+{
+	struct Shot
+	{
+		m_Vec3 pos;
+		m_Vec3 dir;
+		float max_distance;
+	};
+
+	// Use own generator, because map random generator is part of map state.
+	LongRand rand( 0u );
+
+	std::vector<Shot> shots( shots_count );
+	for( Shot& shot : shots )
+	{
+		shot.pos=
+			m_Vec3(
+				rand.RandValue( float(MapData::c_map_size) ),
+				rand.RandValue( float(MapData::c_map_size) ),
+				rand.RandValue( 0.1f, GameConstants::walls_height - 0.1f ) );
+		shot.dir= rand.RandDirection();
+
+		// Each fourth shot is bullet, other shots are rockets steps.
+		shot.max_distance=
+			( &shot - shots.data() ) % 4u == 0u
+				? Constants::max_float
+				: GameConstants::fast_rockets_speed / 60.0f;
+	}
+
+	const unsigned int c_ticks= 16u;
+	std::vector<HitResult> hits[2];
+	Time ticks_time[2]= { Time::FromSeconds(0), Time::FromSeconds(0) };
+
+	for( unsigned int mode= 0u; mode < 2u; mode++ )
+	{
+		const bool use_broad_phase= mode == 1u;
+		const Time start_time= Time::CurrentTime();
+
+		for( unsigned int t= 0u; t < c_ticks; t++ )
+		{
+			if( use_broad_phase )
+				BuildShotsBroadPhase();
+
+			hits[mode].clear();
+			for( const Shot& shot : shots )
+				hits[mode].push_back( ProcessShot( shot.pos, shot.dir, shot.max_distance, 0u, nullptr, use_broad_phase ) );
+		}
+
+		ticks_time[mode]= Time::CurrentTime() - start_time;
+	}
+
+	unsigned int mismatches= 0u;
+	for( unsigned int i= 0u; i < shots_count; i++ )
+	{
+		if( hits[0][i].object_type != hits[1][i].object_type ||
+			( hits[0][i].object_type != HitResult::ObjectType::None && hits[0][i].object_index != hits[1][i].object_index ) )
+			mismatches++;
+	}
+
+	Log::Info(
+		"Shots: ", shots_count,
+		" monsters: ", monsters_.size(),
+		" dynamic walls: ", dynamic_walls_.size(),
+		" tick time without broad phase: ", ticks_time[0].ToSeconds() * 1000.0f / float(c_ticks), " ms",
+		" with broad phase: ", ticks_time[1].ToSeconds() * 1000.0f / float(c_ticks), " ms",
+		" mismatches: ", mismatches );
+}
+
 const Map::MonstersContainer& Map::GetMonsters() const
 {
 	return monsters_;
@@ -1104,9 +1057,23 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 
 	const float last_tick_delta_s= last_tick_delta.ToSeconds();
 
-	// Update state of procedures
-	for( unsigned int p= 0u; p < procedures_.size(); p++ )
+	if( tick_profiler_ != nullptr )
+	{
+		tick_profiler_->AddCount( TickProfiler::Counter::MapTicks, 1u );
+		tick_profiler_->AddCount( TickProfiler::Counter::Monsters, monsters_.size() );
+		tick_profiler_->AddCount( TickProfiler::Counter::Rockets, rockets_.size() );
+	}
+	TickProfiler::ScopedTimer profile_timer( tick_profiler_, TickProfiler::Section::Procedures );
+
+	// Update state of procedures. Process only moving procedures and procedures with expired waiting.
+	unsigned int processed_procedures= 0u;
+	procedures_scheduler_.BeginTick( current_time );
+	for( unsigned int p= procedures_scheduler_.GetNextProcedure( 0u );
+		p != ProceduresScheduler::c_no_procedure;
+		p= procedures_scheduler_.GetNextProcedure( p + 1u ) )
 	{
+		processed_procedures++;
+
 		const MapData::Procedure& procedure= map_data_->procedures[p];
 		ProcedureState& procedure_state= procedures_[p];
 
@@ -1187,10 +1154,17 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 				procedure_state.movement_stage= new_stage;
 			break;
 		}; // switch state
+
+		UpdateProcedureSchedule( p, current_time );
 	} // for procedures
+	procedures_scheduler_.EndTick();
+	if( tick_profiler_ != nullptr )
+		tick_profiler_->AddCount( TickProfiler::Counter::Procedures, processed_procedures );
 
+	profile_timer.Switch( TickProfiler::Section::MapObjects );
 	MoveMapObjects( current_time );
 
+	profile_timer.Switch( TickProfiler::Section::StaticModels );
 	// Process static models
 	for( StaticModel& model : static_models_ )
 	{
@@ -1257,7 +1231,14 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			model.current_animation_frame= model.animation_start_frame;
 	} // for static models
 
+	profile_timer.Switch( TickProfiler::Section::Rockets );
 	// Process shots
+	if( !rockets_.empty() )
+		BuildShotsBroadPhase();
+
+	// Monsters moved since previous explosions.
+	explosion_index_.InvalidateMonsters();
+
 	for( unsigned int r= 0u; r < rockets_.size(); )
 	{
 		Rocket& rocket= rockets_[r];
@@ -1269,7 +1250,10 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		HitResult hit_result;
 
 		if( has_infinite_speed )
-			hit_result= ProcessShot( rocket.start_point, rocket.normalized_direction, Constants::max_float, rocket.owner_id );
+			hit_result=
+				ProcessShot(
+					rocket.start_point, rocket.normalized_direction, Constants::max_float, rocket.owner_id,
+					rocket.lag_compensated ? monsters_history_.GetSnapshot( rocket.lag_compensation_tick ) : nullptr );
 		else
 		{
 			const float c_length_eps= 1.0f / 64.0f;
@@ -1546,6 +1530,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			r++;
 	} // for rockets
 
+	profile_timer.Switch( TickProfiler::Section::Mines );
 	// Process mines
 	for( unsigned int m= 0u; m < mines_.size(); )
 	{
@@ -1619,6 +1604,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 	// Process monsters
 	for( MonstersContainer::value_type& monster_value : monsters_ )
 	{
+		profile_timer.Switch( TickProfiler::Section::MonstersAI );
 		monster_value.second->Tick( *this, monster_value.first, current_time, last_tick_delta );
 
 		// Process teleports for monster
@@ -1666,8 +1652,10 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			const auto wind_fetch=
 			[&]( int x, int y )
 			{
-				const char* const wind_cell= wind_field_[ x + y * int(MapData::c_map_size) ];
-				return m_Vec2( wind_cell[0], wind_cell[1] );
+				const WindFieldCell* const wind_cell= wind_field_.GetValue( x, y );
+				if( wind_cell == nullptr )
+					return m_Vec2( 0.0f, 0.0f );
+				return m_Vec2( wind_cell->dir[0], wind_cell->dir[1] );
 			};
 			const float dx= monster.Position().x - 0.5f - float(wind_x);
 			const float dy= monster.Position().y - 0.5f - float(wind_y);
@@ -1688,6 +1676,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			}
 		}
 
+		profile_timer.Switch( TickProfiler::Section::DeathFields );
 		// Process death cells for everyone and quake cells for players.
 		// TODO - make death zone intersection calculation correct, like with wind zones.
 		const int monster_x= static_cast<int>( monster.Position().x );
@@ -1695,20 +1684,20 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		if( monster_x >= 0 && monster_x < int(MapData::c_map_size) &&
 			monster_y >= 0 && monster_y < int(MapData::c_map_size) )
 		{
-			const DamageFiledCell& cell= death_field_[ monster_x + monster_y * int(MapData::c_map_size) ];
-			if( cell.damage > 0u && death_ticks > 0u )
+			const DamageFiledCell* const cell= death_field_.GetValue( monster_x, monster_y );
+			if( cell != nullptr && death_ticks > 0u )
 			{
 				if( monster.MonsterId() == 0u )
 				{
 					// It looks, like damage field with "z_bottom" == -1 does not damage players.
-					if( cell.z_bottom < 0 )
+					if( cell->z_bottom < 0 )
 						continue;
 				}
 				// TODO - select correct monster height
-				if( !( monster.Position().z > float(cell.z_top) / 64u ||
-					   monster.Position().z + GameConstants::player_height < float(cell.z_bottom) / 64u ) )
+				if( !( monster.Position().z > float(cell->z_top) / 64u ||
+					   monster.Position().z + GameConstants::player_height < float(cell->z_bottom) / 64u ) )
 					monster.Hit(
-						int( cell.damage * death_ticks ), 
+						int( cell->damage * death_ticks ), 
 						monster.Position(),
 						m_Vec2( 0.0f, 0.0f ), 0u,
 						*this,
@@ -1717,13 +1706,13 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 			// If this is a player, apply quake if there's any in the cell.
 			if( monster.MonsterId() == 0u )
 			{
-				const int quake= quake_field_[ monster_x + monster_y * int(MapData::c_map_size) ];
-				if( quake )
-					static_cast<Player&>(monster).SetQuake( current_time, quake );
+				if( const QuakeFieldCell* const quake= quake_field_.GetValue( monster_x, monster_y ) )
+					static_cast<Player&>(monster).SetQuake( current_time, quake->power );
 			}
 		}
 	}
 
+	profile_timer.Switch( TickProfiler::Section::Collisions );
 	// Collide monsters with map
 	for( MonstersContainer::value_type& monster_value : monsters_ )
 	{
@@ -1763,6 +1752,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		monster.SetMovementRestriction( movement_restriction );
 	}
 
+	profile_timer.Switch( TickProfiler::Section::DeathFields );
 	// Process mortal walls for monsters.
 	const float c_min_mortal_angle_cos= 0.2f;
 	for( const DynamicWall& wall : dynamic_walls_ )
@@ -1877,6 +1867,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		}
 	}
 
+	profile_timer.Switch( TickProfiler::Section::Collisions );
 	// Collide monsters together
 	for( MonstersContainer::value_type& first_monster_value : monsters_ )
 	{
@@ -1943,6 +1934,7 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		}
 	}
 
+	profile_timer.Switch( TickProfiler::Section::Other );
 	// Process backpacks
 	for( auto& backpack_value : backpacks_ )
 	{
@@ -1970,6 +1962,12 @@ void Map::Tick( const Time current_time, const Time last_tick_delta )
 		}
 	}
 
+	// Save positions of monsters for lag compensation.
+	monsters_history_.BeginSnapshot();
+	for( const MonstersContainer::value_type& monster_value : monsters_ )
+		monsters_history_.AddMonster( monster_value.first, monster_value.second->Position(), monster_value.second->Health() > 0 );
+	monsters_history_.EndSnapshot();
+
 	// At end of this procedure, report about map change, if this needed.
 	// Do it here, because map can be desctructed at callback call.
 	if( game_rules_ != GameRules::Deathmatch &&
@@ -2041,12 +2039,39 @@ void Map::SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender )
 	}
 }
 
-void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
+void Map::SendUpdateMessages( MessagesSender& messages_sender, const EntityId player_monster_id, ClientBaselines* const baselines ) const
 {
+	bool filter_updates= false;
+	if( interest_management_enabled_ && player_monster_id != 0u )
+	{
+		const auto it= monsters_.find( player_monster_id );
+		if( it != monsters_.end() )
+		{
+			interest_manager_.SetViewer( it->second->Position().xy() );
+			filter_updates= true;
+		}
+	}
+
+	// States of entities are sent to client with low rate, if they are not relevant.
+	// Events are sent only if they are relevant. Sounds, births and deaths are sent always.
+	const auto is_relevant=
+	[&]( const m_Vec2& pos, const unsigned int entity_number ) -> bool
+	{
+		return !filter_updates || interest_manager_.IsRelevant( pos, entity_number );
+	};
+	const auto is_event_relevant=
+	[&]( const m_Vec2& pos ) -> bool
+	{
+		return !filter_updates || interest_manager_.IsEventRelevant( pos );
+	};
+
 	Messages::WallPosition wall_message;
 
 	for( const DynamicWall& wall : dynamic_walls_ )
 	{
+		if( !is_relevant( ( wall.vert_pos[0] + wall.vert_pos[1] ) * 0.5f, &wall - dynamic_walls_.data() ) )
+			continue;
+
 		wall_message.wall_index= &wall - dynamic_walls_.data();
 
 		PositionToMessagePosition( wall.vert_pos[0], wall_message.vertices_xy[0] );
@@ -2054,7 +2079,8 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 		wall_message.z= CoordToMessageCoord( wall.z );
 		wall_message.texture_id= wall.texture_id;
 
-		messages_sender.SendUnreliableMessage( wall_message );
+		if( baselines == nullptr || baselines->CheckWall( wall_message ) )
+			messages_sender.SendUnreliableMessage( wall_message );
 	}
 
 	Messages::StaticModelState model_message;
@@ -2062,6 +2088,8 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 	for( unsigned int m= 0u; m < static_models_.size(); m++ )
 	{
 		const StaticModel& model= static_models_[m];
+		if( !is_relevant( model.pos.xy(), m ) )
+			continue;
 
 		model_message.static_model_index= m;
 		model_message.animation_frame= model.current_animation_frame;
@@ -2072,43 +2100,82 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 		PositionToMessagePosition( model.pos, model_message.xyz );
 		model_message.angle= AngleToMessageAngle( model.angle );
 
-		messages_sender.SendUnreliableMessage( model_message );
+		if( baselines == nullptr || baselines->CheckStaticModel( model_message ) )
+			messages_sender.SendUnreliableMessage( model_message );
 	}
 
 	for( const Item& item : items_ )
 	{
+		if( !is_relevant( item.pos.xy(), &item - items_.data() ) )
+			continue;
+
 		Messages::ItemState message;
 		message.item_index= &item - items_.data();
 		message.z= CoordToMessageCoord( item.pos.z );
 		message.picked= item.picked_up || !item.enabled; // TODO - transfer enabled flag separately.
 
-		messages_sender.SendUnreliableMessage( message );
+		if( baselines == nullptr || baselines->CheckItem( message ) )
+			messages_sender.SendUnreliableMessage( message );
 	}
 
 	Messages::SpriteEffectBirth sprite_message;
 
 	for( const SpriteEffect& effect : sprite_effects_ )
 	{
+		if( !is_event_relevant( effect.pos.xy() ) )
+			continue;
+
 		sprite_message.effect_id= effect.effect_id;
 		PositionToMessagePosition( effect.pos, sprite_message.xyz );
 
 		messages_sender.SendUnreliableMessage( sprite_message );
 	}
 
+	Messages::MonsterStateDelta monster_delta_message;
+
 	for( const MonstersContainer::value_type& monster_value : monsters_ )
 	{
+		// Own monster of player is always relevant.
+		if( monster_value.first != player_monster_id &&
+			!is_relevant( monster_value.second->Position().xy(), monster_value.first ) )
+			continue;
+
 		Messages::MonsterState monster_message;
 
 		monster_value.second->BuildStateMessage( monster_message );
 		monster_message.monster_id= monster_value.first;
 
-		messages_sender.SendUnreliableMessage( monster_message );
+		if( baselines == nullptr )
+		{
+			messages_sender.SendUnreliableMessage( monster_message );
+			continue;
+		}
+
+		switch( baselines->CheckMonster( monster_message, monster_delta_message ) )
+		{
+		case ClientBaselines::MonsterUpdate::Skip:
+			break;
+		case ClientBaselines::MonsterUpdate::Full:
+			messages_sender.SendUnreliableMessage( monster_message );
+			break;
+		case ClientBaselines::MonsterUpdate::Delta:
+			messages_sender.SendUnreliableVariableSizeMessage( monster_delta_message );
+			break;
+		};
 	}
 
 	for( const Messages::MonsterBirth& message : monsters_birth_messages_ )
+	{
 		messages_sender.SendReliableMessage( message );
+		if( baselines != nullptr )
+			baselines->BirthMonster( message.monster_id );
+	}
 	for( const Messages::MonsterDeath& message : monsters_death_messages_ )
+	{
 		messages_sender.SendReliableMessage( message );
+		if( baselines != nullptr )
+			baselines->RemoveMonster( message.monster_id );
+	}
 
 	for( const Messages::RocketBirth& message : rockets_birth_messages_ )
 		messages_sender.SendUnreliableMessage( message );
@@ -2131,11 +2198,21 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 		messages_sender.SendReliableMessage( message );
 
 	for( const Messages::ParticleEffectBirth& message : particles_effects_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+	{
+		m_Vec2 pos;
+		MessagePositionToPosition( message.xyz, pos );
+		if( is_event_relevant( pos ) )
+			messages_sender.SendUnreliableMessage( message );
+	}
 	for( const Messages::FullscreenBlendEffect& message : fullscreen_blend_messages_ )
 		messages_sender.SendUnreliableMessage( message );
 	for( const Messages::MonsterPartBirth& message : monsters_parts_birth_messages_ )
-		messages_sender.SendUnreliableMessage( message );
+	{
+		m_Vec2 pos;
+		MessagePositionToPosition( message.xyz, pos );
+		if( is_event_relevant( pos ) )
+			messages_sender.SendUnreliableMessage( message );
+	}
 
 	for( const Messages::MapEventSound& message : map_events_sounds_messages_ )
 		messages_sender.SendUnreliableMessage( message );
@@ -2146,6 +2223,9 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 
 	for( const Rocket& rocket : rockets_ )
 	{
+		if( !is_relevant( rocket.previous_position.xy(), rocket.rocket_id ) )
+			continue;
+
 		Messages::RocketState rocket_message;
 		PrepareRocketStateMessage( rocket, rocket_message );
 		messages_sender.SendUnreliableMessage( rocket_message );
@@ -2153,6 +2233,9 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 
 	for( const auto& backpack_value : backpacks_ )
 	{
+		if( !is_relevant( backpack_value.second->pos.xy(), backpack_value.first ) )
+			continue;
+
 		Messages::DynamicItemUpdate message;
 		message.item_id= backpack_value.first;
 		PositionToMessagePosition( backpack_value.second->pos, message.xyz );
@@ -2163,6 +2246,8 @@ void Map::SendUpdateMessages( MessagesSender& messages_sender ) const
 
 void Map::ClearUpdateEvents()
 {
+	interest_manager_.NextUpdate();
+
 	sprite_effects_.clear();
 	monsters_birth_messages_.clear();
 	monsters_death_messages_.clear();
@@ -2189,6 +2274,57 @@ void Map::ActivateProcedure( const unsigned int procedure_number, const Time cur
 	procedure_state.movement_stage= 0.0f;
 	procedure_state.movement_state= ProcedureState::MovementState::StartWait;
 	procedure_state.last_state_change_time= current_time;
+
+	UpdateProcedureSchedule( procedure_number, current_time );
+}
+
+void Map::UpdateProcedureSchedule( const unsigned int procedure_number, const Time current_time )
+{
+	const MapData::Procedure& procedure= map_data_->procedures[ procedure_number ];
+	const ProcedureState& procedure_state= procedures_[ procedure_number ];
+
+	switch( procedure_state.movement_state )
+	{
+	case ProcedureState::MovementState::None:
+		procedures_scheduler_.SetIdle( procedure_number );
+		break;
+
+	case ProcedureState::MovementState::StartWait:
+	case ProcedureState::MovementState::Movement:
+	case ProcedureState::MovementState::ReverseMovement:
+		procedures_scheduler_.SetActive( procedure_number );
+		break;
+
+	case ProcedureState::MovementState::BackWait:
+	{
+		// Procedure in back wait state needs processing only for return or for map end check.
+		// Wake up it a bit earlier, because exact check in "Tick" uses seconds.
+		const Time c_wakeup_advance= Time::FromSeconds( 0.001 );
+
+		bool need_wakeup= false;
+		Time wakeup_time= Time::FromSeconds(0);
+		for( const float delay_s : { procedure.back_wait_s, procedure.end_delay_s } )
+		{
+			if( delay_s <= 0.0f )
+				continue;
+
+			const Time t= procedure_state.last_state_change_time + Time::FromSeconds( double(delay_s) ) - c_wakeup_advance;
+			if( !need_wakeup || t < wakeup_time )
+				wakeup_time= t;
+			need_wakeup= true;
+		}
+
+		if( need_wakeup )
+		{
+			// Check expired procedures in next tick again.
+			const Time min_wakeup_time= current_time + Time::FromInternalRepresentation(1);
+			procedures_scheduler_.SetSleeping( procedure_number, std::max( wakeup_time, min_wakeup_time ) );
+		}
+		else
+			procedures_scheduler_.SetIdle( procedure_number ); // Wait forever.
+	}
+		break;
+	};
 }
 
 void Map::TryActivateProcedure(
@@ -2221,6 +2357,7 @@ void Map::TryActivateProcedure(
 
 		procedure_state.last_state_change_time= current_time - Time::FromSeconds( dt_s );
 		procedure_state.movement_state= ProcedureState::MovementState::Movement;
+		UpdateProcedureSchedule( procedure_number, current_time );
 		return;
 	}
 
@@ -2426,6 +2563,8 @@ void Map::DoProcedureImmediateCommands( const MapData::Procedure& procedure, con
 					}
 
 					model.model_id= id - 163u;
+					visibility_cache_.ClearMemo();
+					UpdateModelExplosionIndex( index_element.index );
 				}
 				else if( index_element.type == MapData::IndexElement::DynamicWall )
 				{
@@ -2671,6 +2810,8 @@ void Map::ReturnProcedure( const unsigned int procedure_number, const Time curre
 		procedure_state.last_state_change_time= current_time;
 		break;
 	};
+
+	UpdateProcedureSchedule( procedure_number, current_time );
 }
 
 void Map::ProcessWind( const MapData::Procedure::ActionCommand& command, bool activate )
@@ -2684,18 +2825,16 @@ void Map::ProcessWind( const MapData::Procedure::ActionCommand& command, bool ac
 	const int dir_x= static_cast<int>( command.args[4] );
 	const int dir_y= static_cast<int>( command.args[5] );
 
-	for( unsigned int y= y0; y <= y1 && y < MapData::c_map_size; y++ )
-	for( unsigned int x= x0; x <= x1 && x < MapData::c_map_size; x++ )
+	WindFieldCell cell;
+	if( activate )
 	{
-		char* const cell= wind_field_[ x + y * MapData::c_map_size ];
-		if( activate )
-		{
-			cell[0]= dir_x;
-			cell[1]= dir_y;
-		}
-		else
-			cell[0]= cell[1]= 0;
+		cell.dir[0]= dir_x;
+		cell.dir[1]= dir_y;
 	}
+	else
+		cell.dir[0]= cell.dir[1]= 0;
+
+	wind_field_.SetZone( x0, y0, x1, y1, cell );
 }
 
 void Map::ProcessQuake( const MapData::Procedure::ActionCommand& command, bool activate )
@@ -2708,11 +2847,10 @@ void Map::ProcessQuake( const MapData::Procedure::ActionCommand& command, bool a
 	const unsigned int y1= static_cast<unsigned int>( command.args[3] );
 	const int pow= static_cast<int>( command.args[4] );
 
-	for( unsigned int y= y0; y <= y1 && y < MapData::c_map_size; y++ )
-	for( unsigned int x= x0; x <= x1 && x < MapData::c_map_size; x++ )
-	{
-		quake_field_[ x + y * MapData::c_map_size ] = activate ? pow : 0;
-	}
+	QuakeFieldCell cell;
+	cell.power= activate ? pow : 0;
+
+	quake_field_.SetZone( x0, y0, x1, y1, cell );
 }
 
 void Map::ProcessDeathZone( const MapData::Procedure::ActionCommand& command, const bool activate )
@@ -2727,19 +2865,12 @@ void Map::ProcessDeathZone( const MapData::Procedure::ActionCommand& command, co
 	const int z_1= static_cast<int>( command.args[5] );
 	const unsigned char damage= static_cast<unsigned char>( command.args[6] );
 
-	for( unsigned int y= y0; y <= y1 && y < MapData::c_map_size; y++ )
-	for( unsigned int x= x0; x <= x1 && x < MapData::c_map_size; x++ )
-	{
-		DamageFiledCell& cell= death_field_[ x + y * MapData::c_map_size ];
-		if( activate )
-		{
-			cell.damage= damage;
-			cell.z_bottom= std::max( std::min( z_0, 127 ), -128 );
-			cell.z_top   = std::max( std::min( z_1, 127 ), -128 );
-		}
-		else
-			cell.damage= 0u;
-	}
+	DamageFiledCell cell;
+	cell.damage= activate ? damage : 0u;
+	cell.z_bottom= std::max( std::min( z_0, 127 ), -128 );
+	cell.z_top   = std::max( std::min( z_1, 127 ), -128 );
+
+	death_field_.SetZone( x0, y0, x1, y1, cell );
 }
 
 void Map::DestroyModel( const unsigned int model_index )
@@ -2750,6 +2881,8 @@ void Map::DestroyModel( const unsigned int model_index )
 	EmitModelDestructionEffects( model_index );
 
 	model.model_id++; // now, this model has other model type
+	visibility_cache_.ClearMemo();
+	UpdateModelExplosionIndex( model_index );
 
 	// Reset animation. Animation must be consistent with model.
 	model.animation_start_frame= 0u;
@@ -2775,13 +2908,33 @@ void Map::DoExplosionDamage(
 		return std::round( float(base_damage) * ( 1.0f - distance / explosion_radius ) );
 	};
 
-	for( MonstersContainer::value_type& monster_value : monsters_ )
+	const auto get_monster_radius=
+	[&]( const MonsterBase& monster ) -> float
 	{
-		MonsterBase& monster= *monster_value.second;
-		const float monster_radius=
+		return
 			monster.MonsterId() == 0u
 			? GameConstants::player_radius
 			: game_resources_->monsters_description[ monster.MonsterId() ].w_radius;
+	};
+
+	// Place monsters in index once for all explosions in this tick.
+	if( !explosion_index_.MonstersAreValid() )
+	{
+		explosion_index_.ClearMonsters();
+		for( MonstersContainer::value_type& monster_value : monsters_ )
+		{
+			MonsterBase& monster= *monster_value.second;
+			explosion_index_.AddMonster( monster_value.first, monster, monster.Position().xy(), get_monster_radius( monster ) );
+		}
+	}
+
+	std::vector<unsigned int> candidates;
+
+	explosion_index_.GetMonstersInRadius( explosion_center.xy(), explosion_radius, candidates );
+	for( const unsigned int monster_number : candidates )
+	{
+		MonsterBase& monster= explosion_index_.GetMonster( monster_number );
+		const float monster_radius= get_monster_radius( monster );
 
 		const m_Vec2 monster_z_minmax= monster.GetZMinMax();
 
@@ -2801,11 +2954,13 @@ void Map::DoExplosionDamage(
 				monster.Position(),
 				( monster.Position().xy() - explosion_center.xy() ), explosion_owner_monster_id,
 				*this,
-				monster_value.first, current_time );
+				explosion_index_.GetMonsterId( monster_number ), current_time );
 	}
 
-	for( StaticModel& model : static_models_ )
+	explosion_index_.GetModelsInRadius( explosion_center.xy(), explosion_radius, candidates );
+	for( const unsigned int model_index : candidates )
 	{
+		StaticModel& model= static_models_[ model_index ];
 		if( model.model_id >= map_data_->models_description.size() )
 			continue;
 
@@ -2831,7 +2986,6 @@ void Map::DoExplosionDamage(
 		model.health-= damage;
 		if( model.health <= 0 )
 		{
-			const unsigned int model_index= &model - static_models_.data();
 			DestroyModel( model_index );
 
 			ProcessElementLinks(
@@ -2846,6 +3000,21 @@ void Map::DoExplosionDamage(
 	}
 }
 
+void Map::UpdateModelExplosionIndex( const unsigned int model_index )
+{
+	const StaticModel& model= static_models_[ model_index ];
+
+	float radius= 0.0f; // Zero for not explodable models.
+	if( model.model_id < map_data_->models_description.size() )
+	{
+		const MapData::ModelDescription& description= map_data_->models_description[ model.model_id ];
+		if( description.blow_effect != 0 )
+			radius= std::max( description.radius, 0.0f );
+	}
+
+	explosion_index_.SetModel( model_index, model.pos.xy(), radius );
+}
+
 void Map::TryWarnMonsters( const m_Vec3& pos, const Time current_time )
 {
 	for( const MonstersContainer::value_type& monster_value : monsters_ )
@@ -3099,7 +3268,10 @@ void Map::MoveMapObjects( const Time current_time )
 			wall.vert_pos[j]= map_wall.vert_pos[j] * wall.transformation.mat;
 
 		wall.z= wall.transformation.d_z;
+
+		visibility_cache_.SetDynamicWallPosition( w, wall.vert_pos[0], wall.vert_pos[1] );
 	}
+	visibility_cache_.UpdateDynamicOccluders();
 
 	for( unsigned int m= 0u; m < static_models_.size(); m++ )
 	{
@@ -3112,14 +3284,21 @@ void Map::MoveMapObjects( const Time current_time )
 		model.pos.z= model.baze_z + model.transformation.d_z;
 
 		model.angle= map_model.angle + model.transformation_angle_delta;
+
+		UpdateModelExplosionIndex( m );
 	}
+
+	// Walls and models moved - previous visibility checks results are invalid now.
+	visibility_cache_.ClearMemo();
 }
 
 Map::HitResult Map::ProcessShot(
 	const m_Vec3& shot_start_point,
 	const m_Vec3& shot_direction_normalized,
 	const float max_distance,
-	const EntityId skip_monster_id ) const
+	const EntityId skip_monster_id,
+	const MonstersHistory::Snapshot* const monsters_snapshot,
+	const bool use_broad_phase ) const
 {
 	HitResult result;
 	float nearest_shot_point_square_distance= max_distance * max_distance;
@@ -3199,12 +3378,12 @@ Map::HitResult Map::ProcessShot(
 		func,
 		max_distance );
 
-	// Dynamic walls
-	for( const DynamicWall& wall : dynamic_walls_ )
+	const auto process_dynamic_wall=
+	[&]( const DynamicWall& wall )
 	{
 		const MapData::WallTextureDescription& wall_texture= map_data_->walls_textures[ wall.texture_id ];
 		if( wall_texture.gso[1] )
-			continue;
+			return;
 
 		m_Vec3 candidate_pos;
 		if( RayIntersectWall(
@@ -3215,23 +3394,78 @@ Map::HitResult Map::ProcessShot(
 		{
 			process_candidate_shot_pos( candidate_pos, HitResult::ObjectType::DynamicWall, &wall - dynamic_walls_.data() );
 		}
-	}
+	};
 
-	// Monsters
-	for( const MonstersContainer::value_type& monster_value : monsters_ )
+	const auto process_monster=
+	[&]( const EntityId monster_id, const MonsterBase& monster )
 	{
-		if( monster_value.first == skip_monster_id )
-			continue;
+		if( monster_id == skip_monster_id )
+			return;
 
 		m_Vec3 candidate_pos;
-		if( monster_value.second->TryShot(
-				shot_start_point, shot_direction_normalized,
-				candidate_pos ) )
+		m_Vec3 snapshot_pos;
+		bool snapshot_alive= false;
+		bool hit;
+		if( monsters_snapshot != nullptr && monsters_snapshot->GetMonster( monster_id, snapshot_pos, snapshot_alive ) )
+		{
+			// Monster, which was dead, when player shot, can not be hit (for example, respawned player).
+			hit=
+				snapshot_alive &&
+				monster.TryShot( snapshot_pos, shot_start_point, shot_direction_normalized, candidate_pos );
+		}
+		else
+			hit= monster.TryShot( shot_start_point, shot_direction_normalized, candidate_pos );
+		if( hit )
 		{
 			process_candidate_shot_pos(
 				candidate_pos, HitResult::ObjectType::Monster,
-				monster_value.first );
+				monster_id );
+		}
+	};
+
+	// Broad phase contains current monsters positions, so, it is not used for shots against old positions.
+	if( use_broad_phase && monsters_snapshot == nullptr )
+	{
+		// Check only dynamic walls and monsters near segment between shot start and nearest static hit point.
+		const m_Vec2 dir_xy= shot_direction_normalized.xy();
+		const float dir_xy_length= dir_xy.Length();
+
+		m_Vec2 segment_end= shot_start_point.xy();
+		if( dir_xy_length > 0.0f )
+		{
+			const m_Vec2 map_center( float(MapData::c_map_size) * 0.5f, float(MapData::c_map_size) * 0.5f );
+			const float max_distance_xy=
+				( shot_start_point.xy() - map_center ).Length() + float(MapData::c_map_size);
+
+			const float distance_xy=
+				std::min(
+					std::sqrt( nearest_shot_point_square_distance ) * dir_xy_length,
+					max_distance_xy );
+
+			segment_end+= dir_xy * ( distance_xy / dir_xy_length );
 		}
+
+		shots_broad_phase_.ProcessSegment(
+			shot_start_point.xy(), segment_end,
+			[&]( const ShotsBroadPhase::Element& element )
+			{
+				if( element.type == ShotsBroadPhase::Element::Type::Monster )
+					process_monster( element.monster_id, *element.monster );
+				else
+				{
+					PC_ASSERT( element.wall_index < dynamic_walls_.size() );
+					process_dynamic_wall( dynamic_walls_[ element.wall_index ] );
+				}
+			} );
+	}
+	else
+	{
+		// Check all dynamic walls and monsters.
+		for( const DynamicWall& wall : dynamic_walls_ )
+			process_dynamic_wall( wall );
+
+		for( const MonstersContainer::value_type& monster_value : monsters_ )
+			process_monster( monster_value.first, *monster_value.second );
 	}
 
 	// Floors, ceilings
@@ -3264,6 +3498,25 @@ Map::HitResult Map::ProcessShot(
 	return result;
 }
 
+void Map::BuildShotsBroadPhase()
+{
+	shots_broad_phase_.Clear();
+
+	for( const DynamicWall& wall : dynamic_walls_ )
+		shots_broad_phase_.AddDynamicWall( &wall - dynamic_walls_.data(), wall.vert_pos[0], wall.vert_pos[1] );
+
+	for( const MonstersContainer::value_type& monster_value : monsters_ )
+	{
+		const MonsterBase& monster= *monster_value.second;
+
+		// Same radius, as in "MonsterBase::TryShot".
+		shots_broad_phase_.AddMonster(
+			monster_value.first, monster,
+			monster.Position().xy(),
+			game_resources_->monsters_description[ monster.MonsterId() ].w_radius );
+	}
+}
+
 bool Map::FindNearestPlayerPos( const m_Vec3& pos, m_Vec3& out_pos ) const
 {
 	if( players_.empty() )
@@ -10,8 +10,16 @@
 #include "../time.hpp"
 #include "collision_index.hpp"
 #include "backpack.hpp"
+#include "explosion_index.hpp"
 #include "fwd.hpp"
+#include "interest_manager.hpp"
+#include "monsters_history.hpp"
 #include "movement_restriction.hpp"
+#include "procedures_scheduler.hpp"
+#include "shots_broad_phase.hpp"
+#include "tick_profiler.hpp"
+#include "visibility_cache.hpp"
+#include "zones_field.hpp"
 
 namespace PanzerChasm
 {
@@ -32,6 +40,7 @@ public:
 		const MapDataConstPtr& map_data,
 		const GameResourcesConstPtr& game_resources,
 		Time map_start_time,
+		LongRand::RandResultType random_seed,
 		MapEndCallback map_end_callback,
 		TextMessageCallback text_message_callback );
 
@@ -51,6 +60,11 @@ public:
 
 	void Save( SaveStream& save_stream ) const;
 
+	// Hash of whole map state, including monsters, players and random generator.
+	// Equal hashes on same ticks mean equal simulation.
+	// Times are hashed relative to base time, so, runs with different start time have same hashes.
+	uint64_t GetStateHash( Time base_time ) const;
+
 	// Returns monster_id for spawned player
 	EntityId SpawnPlayer( const PlayerPtr& player );
 	void DespawnPlayer( EntityId player_id );
@@ -87,6 +101,27 @@ public:
 		bool& out_on_floor, MovementRestriction& out_movement_restriction ) const;
 
 	bool CanSee( const m_Vec3& from, const m_Vec3& to ) const;
+	// Same as above, but result for pair of monsters may be taken from per-tick memo.
+	bool CanSee( const m_Vec3& from, const m_Vec3& to, EntityId from_monster_id, EntityId to_monster_id ) const;
+
+	const VisibilityCache::Stats& GetVisibilityCacheStats() const;
+	void ResetVisibilityCacheStats();
+
+	const ProceduresScheduler& GetProceduresScheduler() const;
+	void ResetProceduresSchedulerStats();
+
+	// Profiler is not owned by map. Null profiler allowed.
+	void SetTickProfiler( TickProfiler* profiler );
+
+	// If enabled, each client receives updates only for entities, which are near its player or potentially visible for it.
+	// Other entities are updated with low rate.
+	void SetInterestManagement( bool enabled );
+	const InterestManager::Stats& GetInterestManagerStats() const;
+	void ResetInterestManagerStats();
+
+	// Emulate rockets processing for one tick with given amount of rockets, using current map state.
+	// Compare time of shots tracing with and without broad phase. Map state is not changed.
+	void RunShotsBenchmark( unsigned int shots_count );
 
 	const MonstersContainer& GetMonsters() const;
 	const PlayersContainer& GetPlayers() const;
@@ -95,7 +130,9 @@ public:
 	void Tick( Time current_time, Time last_tick_delta );
 
 	void SendMessagesForNewlyConnectedPlayer( MessagesSender& messages_sender ) const;
-	void SendUpdateMessages( MessagesSender& messages_sender ) const;
+	// Player monster id is used for interest management. Pass zero for sending of all updates.
+	// If baselines are not null, unchanged states are not sent and monsters states are sent as deltas.
+	void SendUpdateMessages( MessagesSender& messages_sender, EntityId player_monster_id, ClientBaselines* baselines ) const;
 
 	void ClearUpdateEvents();
 
@@ -217,6 +254,11 @@ private:
 		float track_length;
 
 		m_Vec3 speed; // For reflecting rockets.
+
+		// Hitscan shots of players are checked against monsters positions in this tick of monsters history.
+		// Do not save.
+		bool lag_compensated= false;
+		uint32_t lag_compensation_tick= 0u;
 	};
 
 	typedef std::vector<Rocket> Rockets;
@@ -278,10 +320,28 @@ private:
 	{
 		unsigned char damage; // 0 - means no damage
 		signed char z_bottom, z_top; // 64 units/m
+
+		bool IsEmpty() const { return damage == 0u; }
+	};
+
+	struct WindFieldCell
+	{
+		char dir[2];
+
+		bool IsEmpty() const { return dir[0] == 0 && dir[1] == 0; }
+	};
+
+	struct QuakeFieldCell
+	{
+		int power;
+
+		bool IsEmpty() const { return power == 0; }
 	};
 
 private:
 	void ActivateProcedure( unsigned int procedure_number, Time current_time );
+	// Call it after each change of procedure state.
+	void UpdateProcedureSchedule( unsigned int procedure_number, Time current_time );
 	void TryActivateProcedure( unsigned int procedure_number, Time current_time, Player& player, MessagesSender& messages_sender );
 	void ProcedureProcessDestroy( unsigned int procedure_number, Time current_time );
 	void ProcedureProcessShoot( unsigned int procedure_number, Time current_time );
@@ -296,12 +356,15 @@ private:
 	void ProcessQuake( const MapData::Procedure::ActionCommand& command, bool activate );
 	void ProcessDeathZone( const MapData::Procedure::ActionCommand& command, bool activate );
 	void DestroyModel( unsigned int model_index );
+	// Call it after each change of model position or type.
+	void UpdateModelExplosionIndex( unsigned int model_index );
 	void DoExplosionDamage(
 		const m_Vec3& explosion_center, float explosion_radius,
 		int base_damage, EntityId explosion_owner_monster_id, Time current_time );
 
 	void TryWarnMonsters( const m_Vec3& pos, Time current_time );
 	void MoveMapObjects( Time current_time );
+	void BuildShotsBroadPhase();
 
 	template<class Func>
 	void ProcessElementLinks(
@@ -313,7 +376,10 @@ private:
 		const m_Vec3& shot_start_point,
 		const m_Vec3& shot_direction_normalized,
 		float max_distance,
-		EntityId skip_monster_id ) const;
+		EntityId skip_monster_id,
+		// If not null, monsters are checked in positions from this snapshot.
+		const MonstersHistory::Snapshot* monsters_snapshot= nullptr,
+		bool use_broad_phase= true ) const;
 
 	bool FindNearestPlayerPos( const m_Vec3& pos, m_Vec3& out_pos ) const;
 
@@ -341,11 +407,15 @@ private:
 
 	const LongRandPtr random_generator_;
 
+	TickProfiler* tick_profiler_= nullptr;
+	bool interest_management_enabled_= false;
+
 	unsigned int next_spawn_number_= 0u; // For multiplayer modes only. Do not save.
 
 	DynamicWalls dynamic_walls_;
 
 	std::vector<ProcedureState> procedures_;
+	ProceduresScheduler procedures_scheduler_; // Do not save - it is rebuilt from procedures states.
 
 	bool map_end_triggered_= false;
 
@@ -384,14 +454,18 @@ private:
 	std::vector<Messages::MonsterLinkedSound> monster_linked_sounds_messages_;
 	std::vector<Messages::MonsterSound> monsters_sounds_messages_;
 
-	// Put large objects here.
+	ZonesField<WindFieldCell> wind_field_;
+	ZonesField<QuakeFieldCell> quake_field_;
+	ZonesField<DamageFiledCell> death_field_;
 
-	// TODO - compress this fields
-	char wind_field_[ MapData::c_map_size * MapData::c_map_size ][2];
-	int quake_field_[ MapData::c_map_size * MapData::c_map_size ];
-	DamageFiledCell death_field_[ MapData::c_map_size * MapData::c_map_size ];
+	// Put large objects here.
 
 	const CollisionIndex collision_index_;
+	mutable VisibilityCache visibility_cache_; // Mutable, because "CanSee" writes memo and stats.
+	ShotsBroadPhase shots_broad_phase_; // Valid only during rockets processing.
+	ExplosionIndex explosion_index_;
+	MonstersHistory monsters_history_; // Do not save.
+	mutable InterestManager interest_manager_; // Mutable, because "SendUpdateMessages" calculates visibility lazily and writes stats.
 };
 
 } // PanzerChasm
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../map_loader.hpp"
+#include "../time.hpp"
+#include "collision_index.hpp"
+#include "movement_restriction.hpp"
+
+namespace PanzerChasm
+{
+
+// Collide cylinder with static walls, static models and dynamic walls of map.
+// Shared between server map logic and client-side movement prediction.
+// StaticModels elements must have "pos", "angle", "model_id" fields.
+// DynamicWalls elements must have "vert_pos", "z", "texture_id" fields.
+template<class StaticModels, class DynamicWalls>
+m_Vec3 CollideWithMapGeometry(
+	const MapData& map_data,
+	const CollisionIndex& collision_index,
+	const StaticModels& static_models,
+	const DynamicWalls& dynamic_walls,
+	const m_Vec3& in_pos, float height, float radius,
+	Time tick_delta,
+	bool& out_on_floor, MovementRestriction& out_movement_restriction );
+
+} // namespace PanzerChasm
@@ -6,6 +6,21 @@
 namespace PanzerChasm
 {
 
+template<class Zone>
+static void SaveZoneRect( const Zone& zone, SaveStream& save_stream )
+{
+	save_stream.WriteUInt8( zone.x0 );
+	save_stream.WriteUInt8( zone.y0 );
+	save_stream.WriteUInt8( zone.x1 );
+	save_stream.WriteUInt8( zone.y1 );
+}
+
+static void LoadZoneRect( unsigned char* const out_rect, LoadStream& load_stream )
+{
+	for( unsigned int i= 0u; i < 4u; i++ )
+		load_stream.ReadUInt8( out_rect[i] );
+}
+
 void Map::Save( SaveStream& save_stream ) const
 {
 	// Random generator.
@@ -161,28 +176,48 @@ void Map::Save( SaveStream& save_stream ) const
 	}
 
 	// Wind field
-	// TODO - optimize large arrays saving
-	for( const char* const wind_field_cell : wind_field_ )
+	save_stream.WriteUInt32( static_cast<uint32_t>( wind_field_.GetZones().size() ) );
+	for( const ZonesField<WindFieldCell>::Zone& zone : wind_field_.GetZones() )
 	{
-		save_stream.WriteInt8( int8_t( wind_field_cell[0] ) );
-		save_stream.WriteInt8( int8_t( wind_field_cell[1] ) );
+		SaveZoneRect( zone, save_stream );
+		save_stream.WriteInt8( int8_t( zone.value.dir[0] ) );
+		save_stream.WriteInt8( int8_t( zone.value.dir[1] ) );
 	}
 
 	// Death field
-	for( const DamageFiledCell& damage_field_cell : death_field_ )
+	save_stream.WriteUInt32( static_cast<uint32_t>( death_field_.GetZones().size() ) );
+	for( const ZonesField<DamageFiledCell>::Zone& zone : death_field_.GetZones() )
 	{
-		save_stream.WriteUInt8( damage_field_cell.damage );
-		save_stream.WriteInt8( damage_field_cell.z_bottom );
-		save_stream.WriteInt8( damage_field_cell.z_top );
+		SaveZoneRect( zone, save_stream );
+		save_stream.WriteUInt8( zone.value.damage );
+		save_stream.WriteInt8( zone.value.z_bottom );
+		save_stream.WriteInt8( zone.value.z_top );
 	}
 
-	// Quake field not really important enough to save, leaving this out for compatibility for now
-	/*
-	for ( const int quake_field_cell : quake_field_ )
+	// Quake field
+	save_stream.WriteUInt32( static_cast<uint32_t>( quake_field_.GetZones().size() ) );
+	for( const ZonesField<QuakeFieldCell>::Zone& zone : quake_field_.GetZones() )
 	{
-		save_stream.WriteInt32( quake_field_cell );
+		SaveZoneRect( zone, save_stream );
+		save_stream.WriteInt32( zone.value.power );
 	}
-	*/
+}
+
+uint64_t Map::GetStateHash( const Time base_time ) const
+{
+	// Save whole state and calculate FNV-1a hash of it.
+	SaveLoadBuffer buffer;
+	SaveStream save_stream( buffer, base_time );
+	Save( save_stream );
+
+	uint64_t hash= 14695981039346656037ull;
+	for( const unsigned char c : buffer )
+	{
+		hash^= uint64_t(c);
+		hash*= 1099511628211ull;
+	}
+
+	return hash;
 }
 
 Map::Map(
@@ -200,7 +235,10 @@ Map::Map(
 	, map_end_callback_( std::move( map_end_callback ) )
 	, text_message_callback_( std::move(text_message_callback) )
 	, random_generator_( std::make_shared<LongRand>() )
+	, procedures_scheduler_( static_cast<unsigned int>( map_data->procedures.size() ) )
 	, collision_index_( map_data )
+	, visibility_cache_( map_data, collision_index_ )
+	, interest_manager_( map_data, collision_index_ )
 {
 	PC_ASSERT( map_data_ != nullptr );
 	PC_ASSERT( game_resources_ != nullptr );
@@ -224,7 +262,10 @@ Map::Map(
 		load_stream.ReadFloat( wall.z );
 		load_stream.ReadUInt8( wall.texture_id );
 		load_stream.ReadBool( wall.mortal );
+
+		visibility_cache_.SetDynamicWallPosition( &wall - dynamic_walls_.data(), wall.vert_pos[0], wall.vert_pos[1] );
 	}
+	visibility_cache_.UpdateDynamicOccluders();
 
 	// Procedures
 	unsigned int procedures_count;
@@ -240,6 +281,8 @@ Map::Map(
 		procedure_state.movement_state= static_cast<ProcedureState::MovementState>( movement_state );
 		load_stream.ReadFloat( procedure_state.movement_stage );
 		load_stream.ReadTime( procedure_state.last_state_change_time );
+
+		UpdateProcedureSchedule( &procedure_state - procedures_.data(), procedure_state.last_state_change_time );
 	}
 
 	// Map end flag
@@ -268,6 +311,8 @@ Map::Map(
 		load_stream.ReadBool( model.mortal );
 		load_stream.ReadBool( model.switch_activated );
 
+		UpdateModelExplosionIndex( &model - static_models_.data() );
+
 		// Load optional rotating light
 		bool is_rotating_light;
 		load_stream.ReadBool( is_rotating_light );
@@ -402,19 +447,45 @@ Map::Map(
 	}
 
 	// Wind field
-	// TODO - optimize large arrays saving
-	for( char* const wind_field_cell : wind_field_ )
+	unsigned int wind_zones_count;
+	load_stream.ReadUInt32( wind_zones_count );
+	for( unsigned int i= 0u; i < wind_zones_count; i++ )
 	{
-		load_stream.ReadInt8( reinterpret_cast<int8_t&>(wind_field_cell[0]) );
-		load_stream.ReadInt8( reinterpret_cast<int8_t&>(wind_field_cell[1]) );
+		unsigned char rect[4];
+		LoadZoneRect( rect, load_stream );
+
+		WindFieldCell cell;
+		load_stream.ReadInt8( reinterpret_cast<int8_t&>(cell.dir[0]) );
+		load_stream.ReadInt8( reinterpret_cast<int8_t&>(cell.dir[1]) );
+		wind_field_.SetZone( rect[0], rect[1], rect[2], rect[3], cell );
 	}
 
 	// Death field
-	for( DamageFiledCell& damage_field_cell : death_field_ )
+	unsigned int death_zones_count;
+	load_stream.ReadUInt32( death_zones_count );
+	for( unsigned int i= 0u; i < death_zones_count; i++ )
 	{
-		load_stream.ReadUInt8( damage_field_cell.damage );
-		load_stream.ReadInt8( damage_field_cell.z_bottom );
-		load_stream.ReadInt8( damage_field_cell.z_top );
+		unsigned char rect[4];
+		LoadZoneRect( rect, load_stream );
+
+		DamageFiledCell cell;
+		load_stream.ReadUInt8( cell.damage );
+		load_stream.ReadInt8( cell.z_bottom );
+		load_stream.ReadInt8( cell.z_top );
+		death_field_.SetZone( rect[0], rect[1], rect[2], rect[3], cell );
+	}
+
+	// Quake field
+	unsigned int quake_zones_count;
+	load_stream.ReadUInt32( quake_zones_count );
+	for( unsigned int i= 0u; i < quake_zones_count; i++ )
+	{
+		unsigned char rect[4];
+		LoadZoneRect( rect, load_stream );
+
+		QuakeFieldCell cell;
+		load_stream.ReadInt32( cell.power );
+		quake_field_.SetZone( rect[0], rect[1], rect[2], rect[3], cell );
 	}
 }
 
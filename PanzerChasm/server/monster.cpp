@@ -150,7 +150,7 @@ void Monster::Tick(
 	{
 		target_is_alive= target->Health() > 0;
 
-		if( CanSee( map, target->Position() ) )
+		if( CanSee( map, target->Position(), monster_id, target_.monster_id ) )
 		{
 			target_.position= target->Position();
 			target_.have_position= true;
@@ -167,7 +167,7 @@ void Monster::Tick(
 	switch( state_ )
 	{
 	case State::Idle:
-		if( SelectTarget( map ) )
+		if( SelectTarget( map, monster_id ) )
 		{
 			map.PlayMonsterSound( monster_id, Sound::MonsterSoundId::Alarmed );
 			state_= State::MoveToTarget;
@@ -213,14 +213,14 @@ void Monster::Tick(
 			{
 				if( description.rock >= 0 && target_is_alive &&
 					have_right_hand_ && // Monster hold weapon in right hand
-					CanSee( map, target->Position() ) )
+					CanSee( map, target->Position(), monster_id, target_.monster_id ) )
 				{
 					state_= State::RemoteAttack;
 					current_animation_= GetAnimation( AnimationId::RemoteAttack );
 					attack_was_done_= false;
 				}
 				else
-					SelectTarget( map );
+					SelectTarget( map, monster_id );
 
 				if( target != nullptr && !target_is_alive )
 				{
@@ -242,7 +242,7 @@ void Monster::Tick(
 		if( animation_frame_unwrapped >= frame_count )
 		{
 			state_= State::MoveToTarget;
-			SelectTarget( map );
+			SelectTarget( map, monster_id );
 			current_animation_= GetAnimation( AnimationId::Run );
 			current_animation_start_time_+= animation_duration;
 		}
@@ -281,7 +281,7 @@ void Monster::Tick(
 			{
 				if( target_is_alive || target == nullptr )
 				{
-					SelectTarget( map );
+					SelectTarget( map, monster_id );
 					current_animation_= GetAnimation( AnimationId::Run );
 				}
 				else
@@ -333,7 +333,7 @@ void Monster::Tick(
 				if( target_is_alive || target == nullptr )
 				{
 					state_= State::MoveToTarget;
-					SelectTarget( map );
+					SelectTarget( map, monster_id );
 					current_animation_= GetAnimation( AnimationId::Run );
 				}
 				else
@@ -686,9 +686,9 @@ bool Monster::IsFinalBoss() const
 	return monster_id_ == 20u;
 }
 
-bool Monster::CanSee( const Map& map, const m_Vec3& pos ) const
+bool Monster::CanSee( const Map& map, const m_Vec3& pos, const EntityId monster_id, const EntityId target_monster_id ) const
 {
-	return map.CanSee( pos_ + g_see_point_delta, pos + g_see_point_delta );
+	return map.CanSee( pos_ + g_see_point_delta, pos + g_see_point_delta, monster_id, target_monster_id );
 }
 
 unsigned int Monster::GetIdleAnimation() const
@@ -796,7 +796,7 @@ void Monster::RotateToTarget( float time_delta_s )
 	}
 }
 
-bool Monster::SelectTarget( const Map& map )
+bool Monster::SelectTarget( const Map& map, const EntityId monster_id )
 {
 	{
 		// Clear current target, if needed.
@@ -849,7 +849,7 @@ bool Monster::SelectTarget( const Map& map )
 				continue;
 		}
 
-		if( CanSee( map, player.Position() ) )
+		if( CanSee( map, player.Position(), monster_id, player_value.first ) )
 		{
 			nearest_player_distance= distance_to_player;
 			nearest_player= &player_value;
@@ -77,14 +77,14 @@ private:
 	bool IsBoss() const;
 	bool IsFinalBoss() const;
 
-	bool CanSee( const Map& map, const m_Vec3& pos ) const;
+	bool CanSee( const Map& map, const m_Vec3& pos, EntityId monster_id, EntityId target_monster_id ) const;
 
 	unsigned int GetIdleAnimation() const;
 	void DoShoot( const m_Vec3& target_pos, Map& map, EntityId monster_id, Time current_time );
 	void FallDown( float time_delta_s );
 	void MoveToTarget( float time_delta_s );
 	void RotateToTarget( float time_delta_s );
-	bool SelectTarget( const Map& map ); // returns true, if selected
+	bool SelectTarget( const Map& map, EntityId monster_id ); // returns true, if selected
 	int SelectMeleeAttackAnimation();
 	m_Vec3 GetBodyPartPosition( unsigned char part_id );
 	void SpawnBodyPart( Map& map, unsigned char part_id );
@@ -100,6 +100,11 @@ unsigned char MonsterBase::GetBodyPartsMask() const
 }
 
 bool MonsterBase::TryShot( const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const
+{
+	return TryShot( pos_, from, direction_normalized, out_pos );
+}
+
+bool MonsterBase::TryShot( const m_Vec3& monster_pos, const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const
 {
 	if( health_ <= 0 )
 		return false;
@@ -109,8 +114,8 @@ bool MonsterBase::TryShot( const m_Vec3& from, const m_Vec3& direction_normalize
 
 	return
 		RayIntersectCylinder(
-			pos_.xy(), description.w_radius,
-			pos_.z + model.z_min, pos_.z + model.z_max,
+			monster_pos.xy(), description.w_radius,
+			monster_pos.z + model.z_min, monster_pos.z + model.z_max,
 			from, direction_normalized,
 			out_pos );
 }
@@ -42,6 +42,8 @@ public:
 	unsigned char GetBodyPartsMask() const;
 
 	bool TryShot( const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const;
+	// Same as above, but monster is placed in given position.
+	bool TryShot( const m_Vec3& monster_pos, const m_Vec3& from, const m_Vec3& direction_normalized, m_Vec3& out_pos ) const;
 
 	void SetMovementRestriction( const MovementRestriction& restriction );
 	const MovementRestriction& GetMovementRestriction() const;
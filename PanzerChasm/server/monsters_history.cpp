@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+
+#include "monsters_history.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int MonstersHistory::c_snapshot_count;
+constexpr unsigned int MonstersHistory::c_max_monsters_in_snapshot;
+
+static bool MonsterEntryCompare( const MonstersHistory::MonsterEntry& a, const MonstersHistory::MonsterEntry& b )
+{
+	return a.monster_id < b.monster_id;
+}
+
+bool MonstersHistory::Snapshot::GetMonster( const EntityId monster_id, m_Vec3& out_pos, bool& out_alive ) const
+{
+	MonsterEntry key;
+	key.monster_id= monster_id;
+
+	const MonsterEntry* const it= std::lower_bound( monsters, monsters + monster_count, key, MonsterEntryCompare );
+	if( it == monsters + monster_count || it->monster_id != monster_id )
+		return false;
+
+	for( unsigned int j= 0u; j < 3u; j++ )
+		out_pos.ToArr()[j]= float(it->xyz[j]) / 256.0f;
+	out_alive= it->alive;
+	return true;
+}
+
+MonstersHistory::MonstersHistory()
+	: monsters_( c_snapshot_count * c_max_monsters_in_snapshot )
+{
+	for( unsigned int i= 0u; i < c_snapshot_count; i++ )
+	{
+		snapshots_[i].tick= 0u;
+		snapshots_[i].monster_count= 0u;
+		snapshots_[i].monsters= monsters_.data() + i * c_max_monsters_in_snapshot;
+	}
+}
+
+MonstersHistory::~MonstersHistory()
+{}
+
+void MonstersHistory::BeginSnapshot()
+{
+	Snapshot& snapshot= snapshots_[ recorded_ticks_ % c_snapshot_count ];
+	snapshot.tick= recorded_ticks_;
+	snapshot.monster_count= 0u;
+}
+
+void MonstersHistory::AddMonster( const EntityId monster_id, const m_Vec3& pos, const bool alive )
+{
+	const unsigned int snapshot_index= recorded_ticks_ % c_snapshot_count;
+	Snapshot& snapshot= snapshots_[ snapshot_index ];
+	if( snapshot.monster_count >= c_max_monsters_in_snapshot )
+		return;
+
+	MonsterEntry& entry= monsters_[ snapshot_index * c_max_monsters_in_snapshot + snapshot.monster_count ];
+	entry.monster_id= monster_id;
+	for( unsigned int j= 0u; j < 3u; j++ )
+	{
+		const float coord= std::round( pos.ToArr()[j] * 256.0f );
+		entry.xyz[j]= static_cast<int16_t>( std::max( -32768.0f, std::min( coord, 32767.0f ) ) );
+	}
+	entry.alive= alive;
+
+	snapshot.monster_count++;
+}
+
+void MonstersHistory::EndSnapshot()
+{
+	const unsigned int snapshot_index= recorded_ticks_ % c_snapshot_count;
+	MonsterEntry* const monsters= monsters_.data() + snapshot_index * c_max_monsters_in_snapshot;
+	std::sort( monsters, monsters + snapshots_[ snapshot_index ].monster_count, MonsterEntryCompare );
+
+	recorded_ticks_++;
+}
+
+uint32_t MonstersHistory::GetLastTick() const
+{
+	return recorded_ticks_ == 0u ? 0u : recorded_ticks_ - 1u;
+}
+
+const MonstersHistory::Snapshot* MonstersHistory::GetSnapshot( const uint32_t tick ) const
+{
+	if( tick >= recorded_ticks_ || recorded_ticks_ - tick > c_snapshot_count )
+		return nullptr;
+
+	const Snapshot& snapshot= snapshots_[ tick % c_snapshot_count ];
+	PC_ASSERT( snapshot.tick == tick );
+	return &snapshot;
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Positions of monsters and players in last map ticks, for lag compensation of hitscan shots.
+// Shots of player are checked against monsters positions, which player saw, when he shoots.
+// Hit test uses also monster size, but it depends only on monster type, so, it is not recorded.
+// All memory is allocated in constructor. Recording of tick does not allocate anything.
+class MonstersHistory final
+{
+public:
+	static constexpr unsigned int c_snapshot_count= 32u;
+	static constexpr unsigned int c_max_monsters_in_snapshot= 256u;
+
+	struct MonsterEntry
+	{
+		EntityId monster_id;
+		int16_t xyz[3]; // In 1/256 of map unit.
+		bool alive;
+	};
+
+	struct Snapshot
+	{
+		uint32_t tick;
+		unsigned int monster_count;
+		const MonsterEntry* monsters; // Sorted by id.
+
+		// Returns false, if monster does not exist in snapshot.
+		bool GetMonster( EntityId monster_id, m_Vec3& out_pos, bool& out_alive ) const;
+	};
+
+	MonstersHistory();
+	~MonstersHistory();
+
+	// Record snapshot for next tick. Monsters over limit are not recorded.
+	// Tick numbers start from 0.
+	void BeginSnapshot();
+	void AddMonster( EntityId monster_id, const m_Vec3& pos, bool alive );
+	void EndSnapshot();
+
+	// Returns number of last recorded tick. Returns 0 if there is no snapshots.
+	uint32_t GetLastTick() const;
+
+	// Returns nullptr, if snapshot for this tick is not recorded or already overwritten.
+	const Snapshot* GetSnapshot( uint32_t tick ) const;
+
+private:
+	MonstersHistory& operator=( const MonstersHistory& )= delete;
+
+private:
+	uint32_t recorded_ticks_= 0u;
+
+	Snapshot snapshots_[ c_snapshot_count ];
+	// Put large objects here.
+	std::vector<MonsterEntry> monsters_; // c_snapshot_count * c_max_monsters_in_snapshot
+};
+
+} // namespace PanzerChasm
@@ -7,6 +7,7 @@
 #include "../messages_sender.hpp"
 #include "../sound/sound_id.hpp"
 #include "map.hpp"
+#include "player_movement.hpp"
 
 #include "player.hpp"
 
@@ -57,6 +58,7 @@ void Player::Tick(
 	const Time last_tick_delta )
 {
 	teleported_= false;
+	applied_move_number_= received_move_number_;
 
 	// Process invisibility
 	if( has_invisibility_ )
@@ -437,16 +439,13 @@ void Player::TryWarn(
 
 void Player::ClampSpeed( const m_Vec3& clamp_surface_normal )
 {
-	const float projection= clamp_surface_normal * speed_;
-	if( projection < 0.0f )
-		speed_-= clamp_surface_normal * projection;
+	ClampPlayerSpeed( clamp_surface_normal, speed_ );
 }
 
 void Player::SetOnFloor( const bool on_floor )
 {
 	on_floor_= on_floor;
-	if( on_floor_ && speed_.z < 0.0f )
-		speed_.z= 0.0f;
+	SetPlayerOnFloor( on_floor_, speed_ );
 }
 
 void Player::Teleport( const m_Vec3& pos, const float angle )
@@ -676,7 +675,9 @@ bool Player::TryPickupBackpack( const Backpack& backpack )
 void Player::BuildPositionMessage( Messages::PlayerPosition& out_position_message ) const
 {
 	PositionToMessagePosition( pos_, out_position_message.xyz );
-	out_position_message.speed= CoordToMessageCoord( speed_.xy().Length() );
+	PositionToMessagePosition( speed_, out_position_message.speed );
+	out_position_message.on_floor= on_floor_;
+	out_position_message.acknowledged_move_number= applied_move_number_;
 }
 
 void Player::BuildStateMessage( Messages::PlayerState& out_state_message ) const
@@ -698,6 +699,7 @@ void Player::BuildStateMessage( Messages::PlayerState& out_state_message ) const
 	out_state_message.is_invisible= inviible_in_this_moment_;
 	out_state_message.show_shield= shield_visible_in_this_moment_;
 	out_state_message.show_chojin= chojin_visible_in_this_moment_;
+	out_state_message.noclip= noclip_;
 }
 
 void Player::BuildWeaponMessage( Messages::PlayerWeapon& out_weapon_message ) const
@@ -742,6 +744,14 @@ void Player::OnMapChange()
 
 void Player::UpdateMovement( const Messages::PlayerMove& move_message )
 {
+	// Unreliable messages may arrive out of order. Ignore moves, older than last received - they are outdated.
+	if( has_received_move_ &&
+		static_cast<int16_t>( static_cast<uint16_t>( move_message.move_number - received_move_number_ ) ) < 0 )
+		return;
+
+	received_move_number_= move_message.move_number;
+	has_received_move_= true;
+
 	if( state_ != State::Alive )
 		return;
 
@@ -774,6 +784,16 @@ bool Player::IsNoclip() const
 	return noclip_;
 }
 
+void Player::SetLagCompensationTicks( const unsigned int ticks )
+{
+	lag_compensation_ticks_= ticks;
+}
+
+unsigned int Player::GetLagCompensationTicks() const
+{
+	return lag_compensation_ticks_;
+}
+
 void Player::SetGodMode( const bool god_mode )
 {
 	god_mode_= god_mode;
@@ -903,108 +923,12 @@ void Player::SetQuake( const Time current_time, int quake_power )
 
 bool Player::Move( const Time time_delta )
 {
-	const float time_delta_s= time_delta.ToSeconds();
-
-	// TODO - calibrate this
-	const float c_acceleration= 40.0f;
-	const float c_deceleration= 20.0f;
-	const float c_jump_speed_delta= 2.9f;
-
-	const float speed_delta= time_delta_s * mevement_acceleration_ * c_acceleration;
-	const float deceleration_speed_delta= time_delta_s * c_deceleration;
-
-	// Accelerate
-	m_Vec2 acceleration( 0.0f, 0.0f );
-	if( state_ == State::Alive )
-	{
-		acceleration.x= std::cos( movement_direction_ ) * speed_delta;
-		acceleration.y= std::sin( movement_direction_ ) * speed_delta;
-	}
-
-	// Decelerate
-	const float new_speed_length= speed_.xy().Length();
-	if( new_speed_length >= deceleration_speed_delta )
-	{
-		const float k= ( new_speed_length - deceleration_speed_delta ) / new_speed_length;
-		speed_.x*= k;
-		speed_.y*= k;
-	}
-	else
-		speed_.x= speed_.y= 0.0f;
-
-	const m_Vec2 current_speed_xy= speed_.xy();
-	const float acceleration_projection_to_current_speed= acceleration * current_speed_xy;
-	if( acceleration_projection_to_current_speed > 0.0f )
-	{
-		const float max_square_speed= GameConstants::player_max_speed * GameConstants::player_max_speed;
+	PlayerMovementInput input;
+	input.movement_direction= movement_direction_;
+	input.acceleration= mevement_acceleration_;
+	input.jump_pressed= jump_pessed_;
 
-		const float current_speed_square_length= current_speed_xy.SquareLength();
-		const m_Vec2 acceleration_projection= current_speed_xy * ( acceleration_projection_to_current_speed / current_speed_square_length );
-		const m_Vec2 acceleration_orthogonal= acceleration - acceleration_projection;
-
-		// If speed greater, then maximal speed by player, just add only orthogonal to current speed aceleration part.
-		if( current_speed_square_length >= max_square_speed )
-		{
-			speed_.x+= acceleration_orthogonal.x;
-			speed_.y+= acceleration_orthogonal.y;
-		}
-		else
-		{
-			// Extend current speed as much, as can and add orthogonal ecceleration component.
-			m_Vec2 speed_plus_acceleration_projection= current_speed_xy + acceleration_projection;
-			const float speed_plus_acceleration_projection_squar_length= speed_plus_acceleration_projection.SquareLength();
-			if( speed_plus_acceleration_projection_squar_length > max_square_speed )
-				speed_plus_acceleration_projection*=
-					GameConstants::player_max_speed / std::sqrt( speed_plus_acceleration_projection_squar_length );
-
-			speed_.x= speed_plus_acceleration_projection.x + acceleration_orthogonal.x;
-			speed_.y= speed_plus_acceleration_projection.y + acceleration_orthogonal.y;
-		}
-	}
-	else
-	{
-		speed_.x+= acceleration.x;
-		speed_.y+= acceleration.y;
-	}
-
-	// If speed is veery hight - clamp it.
-	const float new_speed_square_length= speed_.xy().SquareLength();
-	if( new_speed_square_length > GameConstants::player_max_absolute_speed * GameConstants::player_max_absolute_speed )
-	{
-		const float k= GameConstants::player_max_absolute_speed / std::sqrt( new_speed_square_length );
-		speed_.x*= k;
-		speed_.y*= k;
-	}
-
-	// Fall down
-	speed_.z+= GameConstants::vertical_acceleration * time_delta_s;
-
-	bool jumped= false;
-
-	// Jump
-	if( state_ == State::Alive )
-	{
-		if( jump_pessed_ && noclip_ )
-			speed_.z-= 2.0f * GameConstants::vertical_acceleration * time_delta_s;
-		else if( jump_pessed_ && on_floor_ && speed_.z <= 0.0f )
-		{
-			jumped= true;
-			speed_.z+= c_jump_speed_delta;
-		}
-	}
-
-	// Clamp vertical speed
-	if( std::abs( speed_.z ) > GameConstants::max_vertical_speed )
-		speed_.z*= GameConstants::max_vertical_speed / std::abs( speed_.z );
-
-	pos_+= speed_ * time_delta_s;
-
-	if( noclip_ && pos_.z < 0.0f )
-	{
-		pos_.z= 0.0f;
-		speed_.z= 0.0f;
-	}
-	return jumped;
+	return MovePlayer( input, state_ == State::Alive, noclip_, on_floor_, time_delta, pos_, speed_ );
 }
 
 void Player::GenItemPickupMessage( const unsigned char item_id )
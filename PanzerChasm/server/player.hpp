@@ -74,6 +74,10 @@ public:
 	void SetNoclip( bool noclip );
 	bool IsNoclip() const;
 
+	// How many ticks back hitscan shots of this player are checked.
+	void SetLagCompensationTicks( unsigned int ticks );
+	unsigned int GetLagCompensationTicks() const;
+
 	void SetGodMode( bool god_mode );
 
 	void GiveWeapon();
@@ -133,6 +137,7 @@ private:
 	bool noclip_;
 	bool god_mode_;
 	bool teleported_;
+	unsigned int lag_compensation_ticks_= 0u;
 
 	unsigned char ammo_[ GameConstants::weapon_count ];
 	bool have_weapon_[ GameConstants::weapon_count ];
@@ -145,6 +150,10 @@ private:
 	float mevement_acceleration_= 0.0f;
 	float movement_direction_= 0.0f;
 	bool jump_pessed_= false;
+	// Numbers of last received move message and of move message, applied in last tick. Do not save.
+	unsigned short received_move_number_= 0u;
+	unsigned short applied_move_number_= 0u;
+	bool has_received_move_= false;
 
 	State state_= State::Alive;
 	Time last_state_change_time_= Time::FromSeconds(0);
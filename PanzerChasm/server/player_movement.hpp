@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vec.hpp>
+
+#include "../time.hpp"
+
+namespace PanzerChasm
+{
+
+// Player movement physics. Shared between server player logic and client-side movement prediction.
+
+struct PlayerMovementInput
+{
+	float movement_direction= 0.0f;
+	float acceleration= 0.0f; // 0 - stay, 1 - run
+	bool jump_pressed= false;
+};
+
+// Accelerate, decelerate, apply gravity and jump, move position.
+// Returns true, if jumped.
+bool MovePlayer(
+	const PlayerMovementInput& input,
+	bool alive, bool noclip, bool on_floor,
+	Time time_delta,
+	m_Vec3& pos, m_Vec3& speed );
+
+// Reactions to collision with map.
+void ClampPlayerSpeed( const m_Vec3& clamp_surface_normal, m_Vec3& speed );
+void SetPlayerOnFloor( bool on_floor, m_Vec3& speed );
+
+} // namespace PanzerChasm
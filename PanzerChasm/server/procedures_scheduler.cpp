@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "../assert.hpp"
+
+#include "procedures_scheduler.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int ProceduresScheduler::c_no_procedure;
+constexpr unsigned int ProceduresScheduler::c_mask_word_bits;
+
+ProceduresScheduler::ProceduresScheduler( const unsigned int procedure_count )
+	: procedure_count_(procedure_count)
+	, states_( procedure_count, State::Idle )
+	, wakeup_times_( procedure_count, Time::FromSeconds(0) )
+	, active_mask_( ( procedure_count + c_mask_word_bits - 1u ) / c_mask_word_bits, 0u )
+	, woken_mask_( active_mask_.size(), 0u )
+{}
+
+ProceduresScheduler::~ProceduresScheduler()
+{}
+
+void ProceduresScheduler::SetIdle( const unsigned int procedure_number )
+{
+	PC_ASSERT( procedure_number < procedure_count_ );
+
+	states_[ procedure_number ]= State::Idle;
+	ClearBit( active_mask_, procedure_number );
+}
+
+void ProceduresScheduler::SetActive( const unsigned int procedure_number )
+{
+	PC_ASSERT( procedure_number < procedure_count_ );
+
+	states_[ procedure_number ]= State::Active;
+	SetBit( active_mask_, procedure_number );
+}
+
+void ProceduresScheduler::SetSleeping( const unsigned int procedure_number, const Time wakeup_time )
+{
+	PC_ASSERT( procedure_number < procedure_count_ );
+
+	ClearBit( active_mask_, procedure_number );
+
+	if( states_[ procedure_number ] == State::Sleeping && wakeup_times_[ procedure_number ] == wakeup_time )
+		return; // Already in queue.
+
+	states_[ procedure_number ]= State::Sleeping;
+	wakeup_times_[ procedure_number ]= wakeup_time;
+
+	WakeupEvent event{ wakeup_time, procedure_number };
+	wakeup_queue_.push_back( event );
+	std::push_heap( wakeup_queue_.begin(), wakeup_queue_.end(), WakeupEventCompare );
+}
+
+void ProceduresScheduler::BeginTick( const Time current_time )
+{
+	stats_.ticks++;
+
+	while( !wakeup_queue_.empty() && wakeup_queue_.front().time <= current_time )
+	{
+		const WakeupEvent event= wakeup_queue_.front();
+		std::pop_heap( wakeup_queue_.begin(), wakeup_queue_.end(), WakeupEventCompare );
+		wakeup_queue_.pop_back();
+
+		// Skip outdated events.
+		if( states_[ event.procedure_number ] != State::Sleeping ||
+			wakeup_times_[ event.procedure_number ] != event.time )
+			continue;
+
+		// Procedure is processed in this tick and than put to sleep again, or changes state.
+		states_[ event.procedure_number ]= State::Idle;
+		SetBit( woken_mask_, event.procedure_number );
+	}
+}
+
+unsigned int ProceduresScheduler::GetNextProcedure( const unsigned int start_procedure_number )
+{
+	for( unsigned int w= start_procedure_number / c_mask_word_bits; w < active_mask_.size(); w++ )
+	{
+		MaskWord word= active_mask_[w] | woken_mask_[w];
+		if( w == start_procedure_number / c_mask_word_bits )
+			word&= ~MaskWord(0) << ( start_procedure_number % c_mask_word_bits );
+
+		if( word == 0u )
+			continue;
+
+		unsigned int bit= 0u;
+		while( ( word & ( MaskWord(1) << bit ) ) == 0u )
+			bit++;
+
+		stats_.processed_procedures++;
+		return w * c_mask_word_bits + bit;
+	}
+
+	return c_no_procedure;
+}
+
+void ProceduresScheduler::EndTick()
+{
+	std::fill( woken_mask_.begin(), woken_mask_.end(), MaskWord(0) );
+}
+
+unsigned int ProceduresScheduler::GetProcedureCount() const
+{
+	return procedure_count_;
+}
+
+const ProceduresScheduler::Stats& ProceduresScheduler::GetStats() const
+{
+	return stats_;
+}
+
+void ProceduresScheduler::ResetStats()
+{
+	stats_= Stats();
+}
+
+void ProceduresScheduler::SetBit( std::vector<MaskWord>& mask, const unsigned int procedure_number )
+{
+	mask[ procedure_number / c_mask_word_bits ]|= MaskWord(1) << ( procedure_number % c_mask_word_bits );
+}
+
+void ProceduresScheduler::ClearBit( std::vector<MaskWord>& mask, const unsigned int procedure_number )
+{
+	mask[ procedure_number / c_mask_word_bits ]&= ~( MaskWord(1) << ( procedure_number % c_mask_word_bits ) );
+}
+
+bool ProceduresScheduler::WakeupEventCompare( const WakeupEvent& a, const WakeupEvent& b )
+{
+	// Inverted, because std heap functions build max-heap.
+	return a.time > b.time;
+}
+
+} // namespace PanzerChasm
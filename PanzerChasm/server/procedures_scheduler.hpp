@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../time.hpp"
+
+namespace PanzerChasm
+{
+
+// Selects procedures, which must be processed in current tick.
+// Idle procedures are not processed at all, moving procedures are processed each tick,
+// waiting procedures are stored in queue, ordered by wakeup time.
+class ProceduresScheduler final
+{
+public:
+	struct Stats
+	{
+		unsigned int ticks= 0u;
+		unsigned int processed_procedures= 0u;
+	};
+
+	static constexpr unsigned int c_no_procedure= ~0u;
+
+	explicit ProceduresScheduler( unsigned int procedure_count );
+	~ProceduresScheduler();
+
+	void SetIdle( unsigned int procedure_number );
+	void SetActive( unsigned int procedure_number );
+	void SetSleeping( unsigned int procedure_number, Time wakeup_time );
+
+	// Wake up sleeping procedures. Call it before "GetNextProcedure" calls.
+	void BeginTick( Time current_time );
+
+	// Returns first procedure with number >= start_procedure_number, which must be processed in current tick,
+	// or c_no_procedure. Procedures, activated during iteration, are returned too, if their numbers are greater.
+	unsigned int GetNextProcedure( unsigned int start_procedure_number );
+
+	void EndTick();
+
+	unsigned int GetProcedureCount() const;
+	const Stats& GetStats() const;
+	void ResetStats();
+
+private:
+	enum class State : unsigned char
+	{
+		Idle,
+		Active,
+		Sleeping,
+	};
+
+	struct WakeupEvent
+	{
+		Time time;
+		unsigned int procedure_number;
+	};
+
+	typedef uint64_t MaskWord;
+	static constexpr unsigned int c_mask_word_bits= 64u;
+
+private:
+	static bool WakeupEventCompare( const WakeupEvent& a, const WakeupEvent& b );
+
+	void SetBit( std::vector<MaskWord>& mask, unsigned int procedure_number );
+	void ClearBit( std::vector<MaskWord>& mask, unsigned int procedure_number );
+
+private:
+	const unsigned int procedure_count_;
+
+	std::vector<State> states_;
+	std::vector<Time> wakeup_times_;
+
+	std::vector<MaskWord> active_mask_;
+	std::vector<MaskWord> woken_mask_; // Procedures, woken in current tick.
+
+	// Min-heap. Contains outdated events sometimes - check state and wakeup time of procedure for it.
+	std::vector<WakeupEvent> wakeup_queue_;
+
+	Stats stats_;
+};
+
+} // namespace PanzerChasm
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include "../assert.hpp"
 #include "../game_constants.hpp"
 #include "../log.hpp"
@@ -33,6 +36,9 @@ Server::Server(
 	, text_message_callback_( std::bind( &Server::AddTextMessage, this, std::placeholders::_1 ) )
 	, last_tick_( Time::CurrentTime() )
 	, server_accumulated_time_( Time::FromSeconds(0) )
+	, fixed_tick_duration_( Time::FromSeconds(0) )
+	, fixed_tick_accumulator_( Time::FromSeconds(0) )
+	, map_start_time_( Time::FromSeconds(0) )
 {
 	PC_ASSERT( game_resources_ != nullptr );
 	PC_ASSERT( map_loader_ != nullptr );
@@ -46,6 +52,16 @@ Server::Server(
 	commands->emplace( "keys", std::bind( &Server::GiveKeys, this ) );
 	commands->emplace( "chojin", std::bind( &Server::ToggleGodMode, this ) );
 	commands->emplace( "noclip", std::bind( &Server::ToggleNoclip, this ) );
+	commands->emplace( "vis_stats", std::bind( &Server::PrintVisibilityStats, this ) );
+	commands->emplace( "interest_stats", std::bind( &Server::PrintInterestStats, this ) );
+	commands->emplace( "delta_stats", std::bind( &Server::PrintDeltaStats, this ) );
+	commands->emplace( "encoding_stats", std::bind( &Server::PrintEncodingStats, this ) );
+	commands->emplace( "procedures_stats", std::bind( &Server::PrintProceduresStats, this ) );
+	commands->emplace( "shots_benchmark", std::bind( &Server::RunShotsBenchmark, this, std::placeholders::_1 ) );
+	commands->emplace( "tick_profile", std::bind( &Server::PrintTickProfile, this ) );
+	commands->emplace( "tick_profile_reset", std::bind( &Server::ResetTickProfile, this ) );
+	commands->emplace( "record_input", std::bind( &Server::RecordInput, this, std::placeholders::_1 ) );
+	commands->emplace( "replay_input", std::bind( &Server::ReplayInput, this, std::placeholders::_1 ) );
 
 	commands_= std::move( commands );
 	commands_processor.RegisterCommands( commands_ );
@@ -64,6 +80,9 @@ void Server::Loop( bool paused )
 		return;
 	}
 
+	tick_profiler_.BeginTick();
+	TickProfiler::ScopedTimer profile_timer( &tick_profiler_, TickProfiler::Section::Connections );
+
 	// Accept new connections.
 	while( const IConnectionPtr connection= connections_listener_->GetNewConnection() )
 	{
@@ -119,6 +138,7 @@ void Server::Loop( bool paused )
 
 		Messages::ServerState server_state_message;
 		BuildServerStateMessage( server_state_message );
+		server_state_message.reliable_update_number= connected_player.reliable_update_number;
 		connected_player.connection_info.messages_sender.SendReliableMessage( server_state_message );
 
 		connected_player.connection_info.messages_sender.Flush();
@@ -152,6 +172,9 @@ void Server::Loop( bool paused )
 			p++;
 	}
 
+	tick_profiler_.AddCount( TickProfiler::Counter::Players, players_.size() );
+
+	profile_timer.Switch( TickProfiler::Section::ReceiveMessages );
 	// Recieve messages.
 	for( const ConnectedPlayerPtr& connected_player : players_ )
 	{
@@ -167,9 +190,14 @@ void Server::Loop( bool paused )
 	for( unsigned int t= 0u; t < map_tick_count_; t++ )
 	{
 		// Process map inner logic
+		profile_timer.Switch( TickProfiler::Section::MapTicks );
+		if( fixed_tick_rate_ != 0u )
+			ApplyTickInputs();
 		if( map_ != nullptr )
 			map_->Tick( map_ticks_[t].end, map_ticks_[t].duration );
+		tick_number_++;
 
+		profile_timer.Switch( TickProfiler::Section::PlayersPositions );
 		// Process players position
 		for( const ConnectedPlayerPtr& connected_player : players_ )
 		{
@@ -179,17 +207,25 @@ void Server::Loop( bool paused )
 					connected_player->player_monster_id,
 					connected_player->connection_info.messages_sender );
 		}
+
+		ProcessTickStateHash();
 	}
 
+	profile_timer.Switch( TickProfiler::Section::SendMessages );
 	// Send messages
+	update_number_++;
 	Messages::ServerState server_state_message;
 	BuildServerStateMessage( server_state_message );
 
 	for( const ConnectedPlayerPtr& connected_player : players_ )
 	{
 		MessagesSender& messages_sender= connected_player->connection_info.messages_sender;
+		connected_player->baselines.BeginUpdate( update_number_ );
 		if( map_ != nullptr )
-			map_->SendUpdateMessages( messages_sender );
+			map_->SendUpdateMessages(
+				messages_sender,
+				connected_player->player_monster_id,
+				delta_compression_enabled_ ? &connected_player->baselines : nullptr );
 
 		Messages::PlayerPosition position_msg;
 		Messages::PlayerState state_msg;
@@ -212,6 +248,18 @@ void Server::Loop( bool paused )
 		messages_sender.SendUnreliableMessage( position_msg );
 		messages_sender.SendUnreliableMessage( state_msg );
 		messages_sender.SendUnreliableMessage( weapon_msg );
+
+		// Client acknowledges updates only after receiving of reliable messages of them - births, map change, etc.
+		if( messages_sender.GetReliableMessagesSent() != connected_player->marked_reliable_messages )
+		{
+			Messages::ReliableUpdateMark mark_message;
+			mark_message.update_number= update_number_;
+			messages_sender.SendReliableMessage( mark_message );
+
+			connected_player->marked_reliable_messages= messages_sender.GetReliableMessagesSent();
+			connected_player->reliable_update_number= update_number_;
+		}
+		server_state_message.reliable_update_number= connected_player->reliable_update_number;
 		messages_sender.SendUnreliableMessage( server_state_message );
 		connected_player->player->SendInternalMessages( messages_sender );
 		messages_sender.Flush();
@@ -222,6 +270,7 @@ void Server::Loop( bool paused )
 
 	text_massages_.clear();
 
+	profile_timer.Switch( TickProfiler::Section::MapChange );
 	// Change map, if needed at end of this loop
 	if( map_end_triggered_ )
 	{
@@ -242,6 +291,9 @@ void Server::Loop( bool paused )
 			// TODO - maybe stop map here ?
 		}
 	}
+
+	profile_timer.Stop();
+	tick_profiler_.EndTick();
 }
 
 bool Server::ChangeMap(
@@ -273,6 +325,9 @@ bool Server::ChangeMap(
 	}
 
 	show_progress( 0.5f );
+	StopInputRecord();
+	FinishInputReplay();
+
 	game_rules_= game_rules;
 	map_changed_from_previous_map_= is_next_map_change;
 	current_map_data_= map_data;
@@ -283,11 +338,21 @@ bool Server::ChangeMap(
 			map_data,
 			game_resources_,
 			server_accumulated_time_,
+			random_seed_,
 			map_end_callback_,
 			text_message_callback_ ) );
+	map_->SetTickProfiler( &tick_profiler_ );
+	map_->SetInterestManagement( interest_management_enabled_ );
 
 	map_end_triggered_= false;
 	join_first_client_with_existing_player_= false;
+	tick_number_= 0u;
+	map_start_time_= server_accumulated_time_;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		connected_player->baselines.Reset();
+		connected_player->pending_moves.clear();
+	}
 
 	for( const ConnectedPlayerPtr& connected_player : players_ )
 	{
@@ -326,6 +391,9 @@ void Server::StopMap()
 {
 	Log::Info( "Stopping server map" );
 
+	StopInputRecord();
+	FinishInputReplay();
+
 	current_map_data_= 0u;
 	map_= nullptr;
 }
@@ -382,6 +450,9 @@ bool Server::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 
 	show_progress( 0.5f );
 
+	StopInputRecord();
+	FinishInputReplay();
+
 	game_rules_= static_cast<GameRules>( game_rules );
 	map_changed_from_previous_map_= false;
 	current_map_data_= map_data;
@@ -394,9 +465,18 @@ bool Server::Load( const SaveLoadBuffer& buffer, unsigned int& buffer_pos )
 			game_resources_,
 			map_end_callback_,
 			text_message_callback_ ) );
+	map_->SetTickProfiler( &tick_profiler_ );
+	map_->SetInterestManagement( interest_management_enabled_ );
 
 	map_end_triggered_= false;
 	join_first_client_with_existing_player_= true;
+	tick_number_= 0u;
+	map_start_time_= server_accumulated_time_;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		connected_player->baselines.Reset();
+		connected_player->pending_moves.clear();
+	}
 
 	show_progress( 1.0f );
 
@@ -431,6 +511,8 @@ void Server::operator()( const Messages::MessageBase& message )
 void Server::operator()( const Messages::PlayerMove& message )
 {
 	PC_ASSERT( current_player_ != nullptr );
+
+	current_player_->baselines.Acknowledge( message.acknowledged_update_number );
 	if( current_map_data_ == nullptr )
 		return;
 
@@ -466,8 +548,15 @@ void Server::operator()( const Messages::PlayerMove& message )
 			}
 		}
 	}
+	else if( fixed_tick_rate_ != 0u )
+	{
+		// Apply input before next tick, not when loop reads it. So, record of stamped inputs can be replayed.
+		current_player_->pending_moves.emplace_back();
+		current_player_->pending_moves.back().tick_number= tick_number_ + 1u;
+		current_player_->pending_moves.back().message= message;
+	}
 	else
-		current_player_->player->UpdateMovement( message );
+		ApplyPlayerMove( *current_player_, message );
 }
 
 void Server::operator()( const Messages::PlayerName& message )
@@ -488,8 +577,76 @@ void Server::operator()( const Messages::PlayerName& message )
 	}
 }
 
+unsigned int Server::GetPlayerCount() const
+{
+	return static_cast<unsigned int>( players_.size() );
+}
+
+void Server::SetFixedTickRate( const unsigned int ticks_per_second )
+{
+	fixed_tick_rate_= ticks_per_second;
+	fixed_tick_accumulator_= Time::FromSeconds(0);
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+		connected_player->pending_moves.clear();
+	if( fixed_tick_rate_ != 0u )
+	{
+		// Calculate duration in integer time units, so, all ticks have exactly same duration.
+		fixed_tick_duration_=
+			Time::FromInternalRepresentation(
+				std::max(
+					int64_t(1),
+					Time::FromSeconds(1).GetInternalRepresentation() / int64_t(fixed_tick_rate_) ) );
+
+		Log::Info( "Server fixed tick rate: ", fixed_tick_rate_ );
+	}
+	else
+		Log::Info( "Server variable tick rate" );
+}
+
+void Server::SetRandomSeed( const LongRand::RandResultType seed )
+{
+	// Seed will be used at next map start.
+	random_seed_= seed;
+}
+
+void Server::SetStateHashLogging( const bool enabled )
+{
+	log_state_hash_= enabled;
+}
+
+void Server::SetLagCompensation( const unsigned int max_ticks )
+{
+	lag_compensation_max_ticks_= std::min( max_ticks, MonstersHistory::c_snapshot_count - 1u );
+}
+
+void Server::SetDeltaCompression( const bool enabled )
+{
+	delta_compression_enabled_= enabled;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+		connected_player->baselines.Reset();
+}
+
+void Server::SetInterestManagement( const bool enabled )
+{
+	interest_management_enabled_= enabled;
+	if( map_ != nullptr )
+		map_->SetInterestManagement( enabled );
+}
+
+void Server::SetTickProfileCsvFile( const char* const file_name )
+{
+	if( tick_profiler_.OpenCsvFile( file_name ) && file_name != nullptr && file_name[0] != '\0' )
+		Log::Info( "Writing tick profile into \"", file_name, "\"" );
+}
+
 void Server::UpdateTimes()
 {
+	if( fixed_tick_rate_ != 0u )
+	{
+		UpdateTimesFixed();
+		return;
+	}
+
 	const Time current_time= Time::CurrentTime();
 	Time dt= current_time - last_tick_;
 
@@ -555,11 +712,168 @@ void Server::UpdateTimes()
 	last_tick_= current_time;
 }
 
+void Server::UpdateTimesFixed()
+{
+	const Time current_time= Time::CurrentTime();
+	fixed_tick_accumulator_+= current_time - last_tick_;
+	last_tick_= current_time;
+
+	map_tick_count_= 0u;
+	while( fixed_tick_accumulator_ >= fixed_tick_duration_ && map_tick_count_ < c_max_multiple_map_ticks )
+	{
+		fixed_tick_accumulator_-= fixed_tick_duration_;
+		server_accumulated_time_+= fixed_tick_duration_;
+
+		map_ticks_[ map_tick_count_ ].end= server_accumulated_time_;
+		map_ticks_[ map_tick_count_ ].duration= fixed_tick_duration_;
+		map_tick_count_++;
+	}
+
+	// If server is too slow, drop unsimulated time. Game time slows down in this case.
+	if( fixed_tick_accumulator_ >= fixed_tick_duration_ )
+		fixed_tick_accumulator_= Time::FromSeconds(0);
+}
+
+void Server::ApplyPlayerMove( ConnectedPlayer& connected_player, const Messages::PlayerMove& message )
+{
+	connected_player.player->UpdateMovement( message );
+
+	// Client sees state of map with delay. Calculate delay in ticks, using tick number, which client received.
+	if( lag_compensation_max_ticks_ > 0u )
+	{
+		const unsigned int lag_ticks= static_cast<uint16_t>( uint16_t(tick_number_) - message.acknowledged_tick_number );
+		connected_player.player->SetLagCompensationTicks( std::min( lag_ticks, lag_compensation_max_ticks_ ) );
+	}
+}
+
+void Server::ApplyTickInputs()
+{
+	const uint64_t tick_number= tick_number_ + 1u;
+	tick_inputs_.clear();
+
+	if( input_replayer_ != nullptr )
+	{
+		// Inputs from network are ignored in replay.
+		for( const ConnectedPlayerPtr& connected_player : players_ )
+			connected_player->pending_moves.clear();
+
+		if( !input_replayer_->NextTick( tick_inputs_, replay_expected_state_hash_ ) )
+		{
+			FinishInputReplay();
+			return;
+		}
+
+		for( const InputRecordPlayerInput& input : tick_inputs_ )
+		{
+			if( input.player_index < players_.size() )
+				ApplyPlayerMove( *players_[ input.player_index ], input.message );
+		}
+		return;
+	}
+
+	for( unsigned int p= 0u; p < players_.size(); p++ )
+	{
+		ConnectedPlayer& connected_player= *players_[p];
+
+		unsigned int applied_move_count= 0u;
+		for( const PendingMove& pending_move : connected_player.pending_moves )
+		{
+			if( pending_move.tick_number > tick_number )
+				break;
+
+			ApplyPlayerMove( connected_player, pending_move.message );
+			applied_move_count++;
+
+			if( input_recorder_ != nullptr )
+			{
+				tick_inputs_.emplace_back();
+				tick_inputs_.back().player_index= p;
+				tick_inputs_.back().message= pending_move.message;
+			}
+		}
+
+		connected_player.pending_moves.erase(
+			connected_player.pending_moves.begin(),
+			connected_player.pending_moves.begin() + applied_move_count );
+	}
+}
+
+void Server::ProcessTickStateHash()
+{
+	if( map_ == nullptr ||
+		!( log_state_hash_ || input_recorder_ != nullptr || input_replayer_ != nullptr ) )
+		return;
+
+	const uint64_t state_hash= map_->GetStateHash( map_start_time_ );
+
+	if( log_state_hash_ )
+		Log::Info( "Tick ", tick_number_, " state hash: ", state_hash );
+
+	if( input_recorder_ != nullptr )
+		input_recorder_->WriteTick( state_hash, tick_inputs_ );
+
+	if( input_replayer_ != nullptr && state_hash != replay_expected_state_hash_ )
+	{
+		if( replay_mismatch_count_ == 0u )
+		{
+			replay_first_mismatch_tick_= tick_number_;
+			Log::Warning( "Input replay: state hash mismatch at tick ", tick_number_ );
+		}
+		replay_mismatch_count_++;
+	}
+}
+
+bool Server::RestartMapForInputRecord( const InputRecordHeader& header )
+{
+	random_seed_= header.random_seed;
+
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		connected_player->player= std::make_shared<Player>( game_resources_, server_accumulated_time_ );
+		connected_player->player->SetName( connected_player->name );
+	}
+
+	return
+		ChangeMap(
+			header.map_number,
+			static_cast<DifficultyType>( header.difficulty ),
+			static_cast<GameRules>( header.game_rules ) );
+}
+
+void Server::StopInputRecord()
+{
+	if( input_recorder_ == nullptr )
+		return;
+
+	Log::Info( "Input recording finished. ", input_recorder_->GetTickCount(), " ticks recorded" );
+	input_recorder_= nullptr;
+}
+
+void Server::FinishInputReplay()
+{
+	if( input_replayer_ == nullptr )
+		return;
+
+	if( replay_mismatch_count_ == 0u )
+		Log::Info( "Input replay finished. ", input_replayer_->GetTickCount(), " ticks, all state hashes match" );
+	else
+		Log::Warning(
+			"Input replay finished. ", input_replayer_->GetTickCount(), " ticks, ",
+			replay_mismatch_count_, " state hashes mismatch, first at tick ", replay_first_mismatch_tick_ );
+
+	input_replayer_= nullptr;
+}
+
 void Server::BuildServerStateMessage( Messages::ServerState& message )
 {
 	PC_ASSERT( players_.size() <= GameConstants::max_players );
 
-	message.map_time_s= 0; // TODO - calculate time.
+	message.map_time_ms=
+		static_cast<unsigned int>(
+			server_accumulated_time_.GetInternalRepresentation() * 1000 / Time::FromSeconds(1).GetInternalRepresentation() );
+	message.tick_number= static_cast<unsigned short>( tick_number_ );
+	message.update_number= update_number_;
+	message.reliable_update_number= 0u; // Set it for each client.
 	message.game_rules= game_rules_;
 	message.player_count= players_.size();
 	for( unsigned int i= 0u; i < players_.size(); i++ )
@@ -626,4 +940,228 @@ void Server::ToggleNoclip()
 	Log::Info( noclip_ ? "noclip on" : "noclip off" );
 }
 
+void Server::PrintVisibilityStats()
+{
+	if( map_ == nullptr )
+	{
+		Log::Info( "no map" );
+		return;
+	}
+
+	const VisibilityCache::Stats& stats= map_->GetVisibilityCacheStats();
+	Log::Info( "Visibility checks - memo hits: ", stats.memo_hits, " clear region hits: ", stats.clear_hits, " raycasts: ", stats.fallbacks );
+
+	map_->ResetVisibilityCacheStats();
+}
+
+void Server::PrintInterestStats()
+{
+	if( map_ == nullptr )
+	{
+		Log::Info( "no map" );
+		return;
+	}
+
+	const InterestManager::Stats& stats= map_->GetInterestManagerStats();
+	const unsigned int total= stats.sent + stats.culled;
+	Log::Info(
+		"Interest management ", interest_management_enabled_ ? "enabled" : "disabled",
+		" - entity updates sent: ", stats.sent, " culled: ", stats.culled,
+		" (", total == 0u ? 0u : stats.culled * 100u / total, "%)",
+		" visibility blocks calculated: ", stats.blocks_calculated );
+
+	map_->ResetInterestManagerStats();
+}
+
+void Server::PrintDeltaStats()
+{
+	ClientBaselines::Stats stats;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		ClientBaselines::Stats& player_stats= connected_player->baselines.GetStats();
+		stats.updates+= player_stats.updates;
+		stats.full_messages+= player_stats.full_messages;
+		stats.delta_messages+= player_stats.delta_messages;
+		stats.skipped_messages+= player_stats.skipped_messages;
+		stats.bytes+= player_stats.bytes;
+		stats.full_bytes+= player_stats.full_bytes;
+		connected_player->baselines.ResetStats();
+	}
+
+	if( stats.updates == 0u )
+	{
+		Log::Info( "Delta compression ", delta_compression_enabled_ ? "enabled" : "disabled", " - no updates" );
+		return;
+	}
+
+	Log::Info(
+		"Delta compression ", delta_compression_enabled_ ? "enabled" : "disabled",
+		" - clients updates: ", stats.updates,
+		" full states: ", stats.full_messages, " deltas: ", stats.delta_messages, " skipped: ", stats.skipped_messages );
+	Log::Info(
+		"States bytes per client update: ", stats.bytes / stats.updates,
+		" without delta compression: ", stats.full_bytes / stats.updates );
+}
+
+void Server::PrintEncodingStats()
+{
+	MessagesSender::Stats stats;
+	for( const ConnectedPlayerPtr& connected_player : players_ )
+	{
+		const MessagesSender::Stats& player_stats= connected_player->connection_info.messages_sender.GetStats();
+		for( size_t i= 0u; i < size_t(MessageId::NumMessages); i++ )
+		{
+			stats.messages[i]+= player_stats.messages[i];
+			stats.raw_bytes[i]+= player_stats.raw_bytes[i];
+			stats.encoded_bytes[i]+= player_stats.encoded_bytes[i];
+		}
+		connected_player->connection_info.messages_sender.ResetStats();
+	}
+
+	uint64_t total_raw_bytes= 0u, total_encoded_bytes= 0u;
+	for( size_t i= 0u; i < size_t(MessageId::NumMessages); i++ )
+	{
+		if( stats.messages[i] == 0u )
+			continue;
+
+		total_raw_bytes+= stats.raw_bytes[i];
+		total_encoded_bytes+= stats.encoded_bytes[i];
+		Log::Info(
+			GetMessageName( MessageId(i) ), ": ", stats.messages[i], " messages, ",
+			stats.raw_bytes[i], " bytes raw, ", stats.encoded_bytes[i], " bytes encoded, ratio ",
+			double(stats.raw_bytes[i]) / double(stats.encoded_bytes[i]) );
+	}
+
+	if( total_encoded_bytes == 0u )
+	{
+		Log::Info( "No messages sent" );
+		return;
+	}
+
+	Log::Info(
+		"Total: ", total_raw_bytes, " bytes raw, ", total_encoded_bytes, " bytes encoded, ratio ",
+		double(total_raw_bytes) / double(total_encoded_bytes) );
+}
+
+void Server::PrintProceduresStats()
+{
+	if( map_ == nullptr )
+	{
+		Log::Info( "no map" );
+		return;
+	}
+
+	const ProceduresScheduler& scheduler= map_->GetProceduresScheduler();
+	const ProceduresScheduler::Stats& stats= scheduler.GetStats();
+	Log::Info(
+		"Procedures: ", scheduler.GetProcedureCount(),
+		" ticks: ", stats.ticks,
+		" processed: ", stats.processed_procedures,
+		" processed per tick: ", stats.ticks == 0u ? 0.0f : float(stats.processed_procedures) / float(stats.ticks) );
+
+	map_->ResetProceduresSchedulerStats();
+}
+
+void Server::RunShotsBenchmark( const CommandsArguments& args )
+{
+	if( map_ == nullptr )
+	{
+		Log::Info( "no map" );
+		return;
+	}
+
+	if( args.empty() )
+	{
+		for( const unsigned int shots_count : { 100u, 500u, 2000u } )
+			map_->RunShotsBenchmark( shots_count );
+	}
+	else
+		map_->RunShotsBenchmark( static_cast<unsigned int>( std::max( 0, std::atoi( args.front().c_str() ) ) ) );
+}
+
+void Server::PrintTickProfile()
+{
+	tick_profiler_.PrintReport();
+}
+
+void Server::ResetTickProfile()
+{
+	tick_profiler_.Reset();
+	Log::Info( "Tick profile reset" );
+}
+
+void Server::RecordInput( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		if( input_recorder_ == nullptr )
+			Log::Info( "Usage: record_input [file_name]. Call without arguments to stop recording" );
+		StopInputRecord();
+		return;
+	}
+	if( fixed_tick_rate_ == 0u )
+	{
+		Log::Info( "Input recording needs fixed tick rate" );
+		return;
+	}
+	if( map_ == nullptr || current_map_data_ == nullptr )
+	{
+		Log::Info( "no map" );
+		return;
+	}
+
+	InputRecordHeader header;
+	header.map_number= current_map_data_->number;
+	header.difficulty= static_cast<uint32_t>( map_->GetDifficulty() );
+	header.game_rules= static_cast<uint32_t>( game_rules_ );
+	header.random_seed= random_seed_;
+	header.tick_rate= fixed_tick_rate_;
+	header.player_count= players_.size();
+
+	// Record starts from map start, because replay can reproduce only initial map state.
+	if( !RestartMapForInputRecord( header ) )
+		return;
+	header.initial_state_hash= map_->GetStateHash( map_start_time_ );
+
+	input_recorder_= InputRecorder::Create( args.front().c_str(), header );
+	if( input_recorder_ != nullptr )
+		Log::Info( "Recording input into \"", args.front(), "\"" );
+}
+
+void Server::ReplayInput( const CommandsArguments& args )
+{
+	if( args.empty() )
+	{
+		Log::Info( "Usage: replay_input [file_name]" );
+		return;
+	}
+
+	std::unique_ptr<InputReplayer> input_replayer= InputReplayer::Load( args.front().c_str() );
+	if( input_replayer == nullptr )
+		return;
+
+	const InputRecordHeader& header= input_replayer->GetHeader();
+	if( header.player_count != players_.size() )
+	{
+		Log::Warning( "Input record has ", header.player_count, " players, but server has ", players_.size() );
+		return;
+	}
+
+	if( header.tick_rate != fixed_tick_rate_ )
+		SetFixedTickRate( header.tick_rate );
+	if( !RestartMapForInputRecord( header ) )
+		return;
+
+	Log::Info( "Replaying input \"", args.front(), "\"" );
+	input_replayer_= std::move(input_replayer);
+	replay_mismatch_count_= 0u;
+	replay_first_mismatch_tick_= 0u;
+
+	if( map_->GetStateHash( map_start_time_ ) != header.initial_state_hash )
+	{
+		Log::Warning( "Input replay: initial state hash mismatch" );
+		replay_mismatch_count_++;
+	}
+}
+
 } // namespace PanzerChasm
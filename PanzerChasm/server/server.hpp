@@ -3,9 +3,12 @@
 #include "../commands_processor.hpp"
 #include "../connection_info.hpp"
 #include "../time.hpp"
+#include "client_baselines.hpp"
 #include "i_connections_listener.hpp"
 #include "fwd.hpp"
+#include "input_record.hpp"
 #include "map.hpp"
+#include "tick_profiler.hpp"
 
 namespace PanzerChasm
 {
@@ -32,6 +35,24 @@ public:
 
 	void DisconnectAllClients();
 
+	unsigned int GetPlayerCount() const;
+
+	// Deterministic mode. If tick rate is nonzero, server makes only ticks with fixed duration.
+	// With same random seed and same input server produces same map state on each tick.
+	void SetFixedTickRate( unsigned int ticks_per_second );
+	void SetRandomSeed( LongRand::RandResultType seed );
+	// Print map state hash after each tick.
+	void SetStateHashLogging( bool enabled );
+	// Write profile of each loop into CSV file.
+	void SetTickProfileCsvFile( const char* file_name );
+	// Check hitscan shots of players against monsters positions, which players saw.
+	// Max ticks - limit of client latency compensation. 0 - disabled.
+	void SetLagCompensation( unsigned int max_ticks );
+	// Do not send unchanged states, send only changed fields of monsters states. Enabled by default.
+	void SetDeltaCompression( bool enabled );
+	// Send to clients updates only for relevant entities - near players, or potentially visible for them.
+	void SetInterestManagement( bool enabled );
+
 public: // Messages handlers
 	void operator()( const Messages::MessageBase& message );
 	void operator()( const Messages::DummyNetMessage& ) {}
@@ -39,6 +60,13 @@ public: // Messages handlers
 	void operator()( const Messages::PlayerName& message );
 
 private:
+	// Input of player, stamped with number of tick, before which it must be applied.
+	struct PendingMove
+	{
+		uint64_t tick_number;
+		Messages::PlayerMove message;
+	};
+
 	struct ConnectedPlayer final
 	{
 		ConnectedPlayer(
@@ -47,10 +75,15 @@ private:
 			Time current_time );
 
 		ConnectionInfo connection_info;
+		ClientBaselines baselines;
+		// Reliable messages counter at last "ReliableUpdateMark" and number of update of this mark.
+		uint64_t marked_reliable_messages= 0u;
+		unsigned short reliable_update_number= 0u;
 		PlayerPtr player;
 		EntityId player_monster_id;
 		std::string name;
 		bool entered_message_printed= false;
+		std::vector<PendingMove> pending_moves; // Only in fixed tick mode. Sorted by tick.
 	};
 
 	typedef std::unique_ptr<ConnectedPlayer> ConnectedPlayerPtr;
@@ -64,8 +97,19 @@ private:
 
 private:
 	void UpdateTimes();
+	void UpdateTimesFixed();
 	void BuildServerStateMessage( Messages::ServerState& message );
 
+	void ApplyPlayerMove( ConnectedPlayer& connected_player, const Messages::PlayerMove& message );
+	// Apply inputs, stamped with number of next tick, or inputs from replayed record.
+	void ApplyTickInputs();
+	void ProcessTickStateHash();
+
+	// Restart map from initial state of record - with new players and same random seed.
+	bool RestartMapForInputRecord( const InputRecordHeader& header );
+	void StopInputRecord();
+	void FinishInputReplay();
+
 	void AddTextMessage( const char* text );
 
 	void GiveAmmo();
@@ -75,6 +119,17 @@ private:
 	void ToggleGodMode();
 	void ToggleNoclip();
 
+	void PrintVisibilityStats();
+	void PrintInterestStats();
+	void PrintDeltaStats();
+	void PrintEncodingStats();
+	void PrintProceduresStats();
+	void RunShotsBenchmark( const CommandsArguments& args );
+	void PrintTickProfile();
+	void ResetTickProfile();
+	void RecordInput( const CommandsArguments& args );
+	void ReplayInput( const CommandsArguments& args );
+
 private:
 	const GameResourcesConstPtr game_resources_;
 	const MapLoaderPtr map_loader_;
@@ -103,6 +158,30 @@ private:
 	TickTime map_ticks_[ c_max_multiple_map_ticks ];
 	unsigned int map_tick_count_;
 
+	// Fixed timestep mode.
+	unsigned int fixed_tick_rate_= 0u; // 0 - variable timestep.
+	Time fixed_tick_duration_;
+	Time fixed_tick_accumulator_; // Real time, not simulated yet.
+	uint64_t tick_number_= 0u; // Number of map tick since map start.
+	Time map_start_time_;
+
+	// Record and replay of players inputs in fixed tick mode.
+	std::unique_ptr<InputRecorder> input_recorder_;
+	std::unique_ptr<InputReplayer> input_replayer_;
+	std::vector<InputRecordPlayerInput> tick_inputs_; // Inputs of current tick.
+	uint64_t replay_expected_state_hash_= 0u;
+	unsigned int replay_mismatch_count_= 0u;
+	uint64_t replay_first_mismatch_tick_= 0u;
+
+	LongRand::RandResultType random_seed_= 0u;
+	bool log_state_hash_= false;
+	unsigned int lag_compensation_max_ticks_= 0u;
+	bool interest_management_enabled_= false;
+	bool delta_compression_enabled_= true;
+	uint16_t update_number_= 0u; // Number of last sent update.
+
+	TickProfiler tick_profiler_;
+
 	std::vector<Messages::DynamicTextMessage> text_massages_;
 
 	// Cheats
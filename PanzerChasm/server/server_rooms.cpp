@@ -0,0 +1,200 @@
+#include <mutex>
+#include <queue>
+
+#include "../assert.hpp"
+#include "../game_constants.hpp"
+#include "../i_connection.hpp"
+#include "../log.hpp"
+#include "../tick_scheduler.hpp"
+
+#include "server_rooms.hpp"
+
+namespace PanzerChasm
+{
+
+// Connections listener for one room. Connections are pushed into it from main thread.
+class ServerRooms::RoomConnectionsQueue final : public IConnectionsListener
+{
+public:
+	RoomConnectionsQueue(){}
+	virtual ~RoomConnectionsQueue() override {}
+
+	void PushConnection( IConnectionPtr connection )
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		connections_.push( std::move(connection) );
+	}
+
+	unsigned int GetSize()
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		return static_cast<unsigned int>( connections_.size() );
+	}
+
+public: // IConnectionsListener
+	virtual IConnectionPtr GetNewConnection() override
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		if( connections_.empty() )
+			return nullptr;
+
+		IConnectionPtr connection= std::move( connections_.front() );
+		connections_.pop();
+		return connection;
+	}
+
+private:
+	std::mutex mutex_;
+	std::queue<IConnectionPtr> connections_;
+};
+
+ServerRooms::Room::Room( Settings& settings )
+	: commands_processor( settings )
+	, player_count( 0u )
+{}
+
+ServerRooms::ServerRooms(
+	const unsigned int room_count,
+	Settings& settings,
+	const GameResourcesConstPtr& game_resources,
+	const MapLoaderPtr& map_loader,
+	const IConnectionsListenerPtr& connections_listener )
+	: connections_listener_(connections_listener)
+	, quit_requested_( false )
+{
+	PC_ASSERT( room_count > 0u );
+	PC_ASSERT( connections_listener_ != nullptr );
+
+	rooms_.resize( room_count );
+	for( unsigned int r= 0u; r < room_count; r++ )
+	{
+		RoomPtr& room= rooms_[r];
+		room.reset( new Room( settings ) );
+		room->connections_queue= std::make_shared<RoomConnectionsQueue>();
+		room->bots= std::make_shared<Bots>( room->connections_queue, map_loader, "Room " + std::to_string( r ) );
+		room->server.reset(
+			new Server(
+				room->commands_processor,
+				game_resources,
+				map_loader,
+				room->bots,
+				nullptr ) );
+	}
+}
+
+ServerRooms::~ServerRooms()
+{
+	quit_requested_.store( true );
+	for( const RoomPtr& room : rooms_ )
+	{
+		if( room->thread.joinable() )
+			room->thread.join();
+	}
+
+	for( const RoomPtr& room : rooms_ )
+	{
+		room->server->DisconnectAllClients();
+		room->server->StopMap();
+	}
+}
+
+bool ServerRooms::Start( const RoomsParams& params )
+{
+	params_= params;
+
+	// Start maps in main thread. Map data loaded only once, because map loader caches it.
+	for( unsigned int r= 0u; r < rooms_.size(); r++ )
+	{
+		const RoomPtr& room= rooms_[r];
+		room->server->SetFixedTickRate( params_.fixed_tick_rate );
+		room->server->SetRandomSeed( params_.random_seed );
+		room->server->SetLagCompensation( params_.lag_compensation_max_ticks );
+		room->server->SetInterestManagement( params_.interest_management );
+		room->server->SetDeltaCompression( params_.delta_compression );
+
+		if( !params_.profile_csv_file.empty() )
+		{
+			// "profile.csv" -> "profile_room0.csv"
+			std::string file_name= params_.profile_csv_file;
+			const std::string::size_type dot_pos= file_name.find_last_of( '.' );
+			const std::string::size_type slash_pos= file_name.find_last_of( "/\\" );
+			const std::string::size_type insert_pos=
+				dot_pos != std::string::npos && ( slash_pos == std::string::npos || dot_pos > slash_pos )
+					? dot_pos
+					: file_name.size();
+			file_name.insert( insert_pos, "_room" + std::to_string( r ) );
+
+			room->server->SetTickProfileCsvFile( file_name.c_str() );
+		}
+
+		if( !room->server->ChangeMap( params_.map_number, params_.difficulty, params_.game_rules ) )
+			return false;
+
+		room->bots->SetStatsInterval( params_.stats_interval );
+		room->bots->AddBots( params_.bots_per_room );
+		room->player_count.store( room->bots->GetBotCount() ); // Reserve places for bots before room start.
+	}
+
+	for( unsigned int r= 0u; r < rooms_.size(); r++ )
+		rooms_[r]->thread= std::thread( &ServerRooms::RoomThreadFunc, this, std::ref( *rooms_[r] ), r );
+
+	Log::Info( "Started ", rooms_.size(), " server rooms" );
+	return true;
+}
+
+void ServerRooms::RouteNewConnections()
+{
+	while( IConnectionPtr connection= connections_listener_->GetNewConnection() )
+	{
+		// Select room with minimal players count.
+		Room* selected_room= nullptr;
+		unsigned int selected_room_number= 0u;
+		unsigned int min_player_count= GameConstants::max_players;
+		for( unsigned int r= 0u; r < rooms_.size(); r++ )
+		{
+			Room& room= *rooms_[r];
+			const unsigned int player_count= room.player_count.load() + room.connections_queue->GetSize();
+			if( player_count < min_player_count )
+			{
+				min_player_count= player_count;
+				selected_room= &room;
+				selected_room_number= r;
+			}
+		}
+
+		if( selected_room == nullptr )
+		{
+			Log::Info( "All rooms are full. Client \"", connection->GetConnectionInfo(), "\" rejected" );
+			continue; // Connection closed here.
+		}
+
+		Log::Info( "Client \"", connection->GetConnectionInfo(), "\" sent to room ", selected_room_number );
+		selected_room->connections_queue->PushConnection( std::move(connection) );
+	}
+}
+
+unsigned int ServerRooms::GetRoomCount() const
+{
+	return static_cast<unsigned int>( rooms_.size() );
+}
+
+void ServerRooms::RoomThreadFunc( Room& room, const unsigned int room_number )
+{
+	TickScheduler scheduler(
+		params_.tick_duration,
+		params_.stats_interval,
+		"Room " + std::to_string( room_number ) );
+
+	while( !quit_requested_.load() )
+	{
+		scheduler.BeginTick();
+
+		room.bots->Tick();
+		room.server->Loop( false );
+		room.player_count.store( room.server->GetPlayerCount() );
+
+		scheduler.EndTick();
+	}
+}
+
+} // namespace PanzerChasm
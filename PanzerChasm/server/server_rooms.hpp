@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../commands_processor.hpp"
+#include "bots.hpp"
+#include "i_connections_listener.hpp"
+#include "fwd.hpp"
+#include "server.hpp"
+
+namespace PanzerChasm
+{
+
+// Set of independent servers ("rooms") in one process.
+// Each room has own map and own players and runs in own thread.
+// All rooms share immutable game resources and maps data, loaded by one map loader.
+class ServerRooms final
+{
+public:
+	struct RoomsParams
+	{
+		unsigned int map_number= 1u;
+		DifficultyType difficulty= Difficulty::Normal;
+		GameRules game_rules= GameRules::Deathmatch;
+
+		unsigned int fixed_tick_rate= 0u; // 0 - variable timestep.
+		LongRand::RandResultType random_seed= 0u;
+
+		Time tick_duration= Time::FromSeconds(0); // Duration of room thread loop.
+		Time stats_interval= Time::FromSeconds(10);
+
+		// If not empty, each room writes tick profile into own file, with room number added to file name.
+		std::string profile_csv_file;
+
+		unsigned int bots_per_room= 0u;
+		unsigned int lag_compensation_max_ticks= 0u;
+		bool interest_management= false;
+		bool delta_compression= true;
+	};
+
+	ServerRooms(
+		unsigned int room_count,
+		Settings& settings,
+		const GameResourcesConstPtr& game_resources,
+		const MapLoaderPtr& map_loader,
+		const IConnectionsListenerPtr& connections_listener );
+	~ServerRooms();
+
+	// Start maps and rooms threads. Returns false, if can not start maps.
+	bool Start( const RoomsParams& params );
+
+	// Accept new connections and send it to rooms. Call it from main thread.
+	void RouteNewConnections();
+
+	unsigned int GetRoomCount() const;
+
+private:
+	class RoomConnectionsQueue;
+
+	struct Room
+	{
+		explicit Room( Settings& settings );
+
+		// Each room has own commands processor, because commands can not be executed in other threads.
+		CommandsProcessor commands_processor;
+		std::shared_ptr<RoomConnectionsQueue> connections_queue;
+		BotsPtr bots; // Bots live in room thread. Server gets connections through bots listener.
+		std::unique_ptr<Server> server;
+		std::thread thread;
+
+		std::atomic<unsigned int> player_count; // Written by room thread.
+	};
+
+	typedef std::unique_ptr<Room> RoomPtr;
+
+private:
+	void RoomThreadFunc( Room& room, unsigned int room_number );
+
+private:
+	const IConnectionsListenerPtr connections_listener_;
+	RoomsParams params_;
+
+	std::vector<RoomPtr> rooms_;
+	std::atomic<bool> quit_requested_;
+};
+
+} // namespace PanzerChasm
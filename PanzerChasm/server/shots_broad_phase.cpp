@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+
+#include "shots_broad_phase.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int ShotsBroadPhase::c_dummy_next;
+constexpr float ShotsBroadPhase::c_bbox_eps;
+
+ShotsBroadPhase::ShotsBroadPhase()
+{
+	Clear();
+}
+
+ShotsBroadPhase::~ShotsBroadPhase()
+{}
+
+void ShotsBroadPhase::Clear()
+{
+	elements_.clear();
+	nodes_.clear();
+	outside_elements_.clear();
+	elements_stamps_.clear();
+	current_stamp_= 0u;
+
+	for( unsigned int& head : cells_heads_ )
+		head= c_dummy_next;
+}
+
+void ShotsBroadPhase::AddMonster( const EntityId monster_id, const MonsterBase& monster, const m_Vec2& pos, const float radius )
+{
+	Element element;
+	element.type= Element::Type::Monster;
+	element.monster_id= monster_id;
+	element.wall_index= 0u;
+	element.monster= &monster;
+
+	AddElement(
+		element,
+		pos - m_Vec2( radius, radius ),
+		pos + m_Vec2( radius, radius ) );
+}
+
+void ShotsBroadPhase::AddDynamicWall( const unsigned int wall_index, const m_Vec2& v0, const m_Vec2& v1 )
+{
+	Element element;
+	element.type= Element::Type::DynamicWall;
+	element.monster_id= 0u;
+	element.wall_index= wall_index;
+	element.monster= nullptr;
+
+	AddElement(
+		element,
+		m_Vec2( std::min( v0.x, v1.x ), std::min( v0.y, v1.y ) ),
+		m_Vec2( std::max( v0.x, v1.x ), std::max( v0.y, v1.y ) ) );
+}
+
+void ShotsBroadPhase::AddElement( const Element& element, const m_Vec2& bb_min, const m_Vec2& bb_max )
+{
+	const unsigned int element_index= static_cast<unsigned int>( elements_.size() );
+	elements_.push_back( element );
+	elements_stamps_.push_back( 0u );
+
+	const float c_map_size_f= float(MapData::c_map_size);
+	if( !( bb_min.x - c_bbox_eps >= 0.0f && bb_min.y - c_bbox_eps >= 0.0f &&
+		bb_max.x + c_bbox_eps < c_map_size_f && bb_max.y + c_bbox_eps < c_map_size_f ) )
+	{
+		outside_elements_.push_back( element_index );
+		return;
+	}
+
+	const int x_start= static_cast<int>( std::floor( bb_min.x - c_bbox_eps ) );
+	const int x_end  = static_cast<int>( std::floor( bb_max.x + c_bbox_eps ) );
+	const int y_start= static_cast<int>( std::floor( bb_min.y - c_bbox_eps ) );
+	const int y_end  = static_cast<int>( std::floor( bb_max.y + c_bbox_eps ) );
+
+	for( int y= y_start; y <= y_end; y++ )
+	for( int x= x_start; x <= x_end; x++ )
+	{
+		unsigned int& head= cells_heads_[ x + y * int(MapData::c_map_size) ];
+
+		Node node;
+		node.element_index= element_index;
+		node.next= head;
+
+		head= static_cast<unsigned int>( nodes_.size() );
+		nodes_.push_back( node );
+	}
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+
+#include <vec.hpp>
+
+#include "../fwd.hpp"
+#include "../map_loader.hpp"
+#include "fwd.hpp"
+
+namespace PanzerChasm
+{
+
+// Grid of moving objects for shots tracing - monsters and dynamic walls.
+// Static walls and models are placed in collision index, but monsters and dynamic walls not,
+// so, without this grid, each shot must check all monsters and all dynamic walls.
+// Objects move each tick, so, rebuild grid before processing of rockets.
+class ShotsBroadPhase final
+{
+public:
+	struct Element
+	{
+		enum class Type : unsigned char
+		{
+			Monster,
+			DynamicWall,
+		};
+
+		Type type;
+		EntityId monster_id;
+		unsigned int wall_index;
+		const MonsterBase* monster;
+	};
+
+	ShotsBroadPhase();
+	~ShotsBroadPhase();
+
+	void Clear();
+	void AddMonster( EntityId monster_id, const MonsterBase& monster, const m_Vec2& pos, float radius );
+	void AddDynamicWall( unsigned int wall_index, const m_Vec2& v0, const m_Vec2& v1 );
+
+	// Process once each element, which bounding box touches cells along segment.
+	// Any ray intersection with element inside this segment can be found only in such elements.
+	template<class Func>
+	void ProcessSegment( const m_Vec2& from, const m_Vec2& to, const Func& func ) const;
+
+private:
+	struct Node
+	{
+		unsigned int element_index;
+		unsigned int next;
+	};
+
+	static constexpr unsigned int c_dummy_next= ~0u;
+	static constexpr float c_bbox_eps= 1.0f / 16.0f;
+
+private:
+	void AddElement( const Element& element, const m_Vec2& bb_min, const m_Vec2& bb_max );
+
+	template<class Func>
+	void ProcessElement( unsigned int element_index, const Func& func ) const;
+
+private:
+	std::vector<Element> elements_;
+	std::vector<Node> nodes_;
+
+	// Elements, which bounding box is not fully inside map.
+	// Segment is clipped by map borders, so, check such elements for each segment.
+	std::vector<unsigned int> outside_elements_;
+
+	// Stamps for skipping elements, placed in many cells.
+	mutable std::vector<unsigned int> elements_stamps_;
+	mutable unsigned int current_stamp_= 0u;
+
+	// Put large objects here.
+
+	// Linked lists heads.
+	unsigned int cells_heads_[ MapData::c_map_size * MapData::c_map_size ];
+};
+
+} // namespace PanzerChasm
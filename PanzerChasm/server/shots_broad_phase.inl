@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "shots_broad_phase.hpp"
+
+namespace PanzerChasm
+{
+
+template<class Func>
+void ShotsBroadPhase::ProcessSegment( const m_Vec2& from, const m_Vec2& to, const Func& func ) const
+{
+	current_stamp_++;
+	if( current_stamp_ == 0u )
+	{
+		// Stamp overflow - reset all stamps.
+		for( unsigned int& stamp : elements_stamps_ )
+			stamp= 0u;
+		current_stamp_= 1u;
+	}
+
+	for( const unsigned int element_index : outside_elements_ )
+		ProcessElement( element_index, func );
+
+	// Clip segment by map borders.
+	const float c_map_size_f= float(MapData::c_map_size);
+	const m_Vec2 dir= to - from;
+
+	float t_min= 0.0f, t_max= 1.0f;
+	for( unsigned int i= 0u; i < 2u; i++ )
+	{
+		const float start= i == 0u ? from.x : from.y;
+		const float d= i == 0u ? dir.x : dir.y;
+		if( d == 0.0f )
+		{
+			if( start < 0.0f || start > c_map_size_f )
+				return;
+			continue;
+		}
+
+		float t0= ( 0.0f - start ) / d;
+		float t1= ( c_map_size_f - start ) / d;
+		if( t0 > t1 )
+			std::swap( t0, t1 );
+
+		t_min= std::max( t_min, t0 );
+		t_max= std::min( t_max, t1 );
+	}
+	if( t_min > t_max )
+		return;
+
+	const m_Vec2 clipped_from= from + dir * t_min;
+	const m_Vec2 clipped_dir= dir * ( t_max - t_min );
+
+	const int c_max_cell= int(MapData::c_map_size) - 1;
+	int x= std::min( std::max( static_cast<int>( std::floor( clipped_from.x ) ), 0 ), c_max_cell );
+	int y= std::min( std::max( static_cast<int>( std::floor( clipped_from.y ) ), 0 ), c_max_cell );
+
+	// Grid traversal. "t" is in range [0; 1] for clipped segment.
+	const float c_inf= std::numeric_limits<float>::infinity();
+
+	const int step_x= clipped_dir.x > 0.0f ? 1 : ( clipped_dir.x < 0.0f ? -1 : 0 );
+	const int step_y= clipped_dir.y > 0.0f ? 1 : ( clipped_dir.y < 0.0f ? -1 : 0 );
+
+	const float t_delta_x= step_x != 0 ? 1.0f / std::abs( clipped_dir.x ) : c_inf;
+	const float t_delta_y= step_y != 0 ? 1.0f / std::abs( clipped_dir.y ) : c_inf;
+
+	float t_next_x= step_x != 0 ? ( float( x + ( step_x > 0 ? 1 : 0 ) ) - clipped_from.x ) / clipped_dir.x : c_inf;
+	float t_next_y= step_y != 0 ? ( float( y + ( step_y > 0 ? 1 : 0 ) ) - clipped_from.y ) / clipped_dir.y : c_inf;
+
+	while( true )
+	{
+		for( unsigned int n= cells_heads_[ x + y * int(MapData::c_map_size) ]; n != c_dummy_next; n= nodes_[n].next )
+			ProcessElement( nodes_[n].element_index, func );
+
+		if( std::min( t_next_x, t_next_y ) > 1.0f )
+			break;
+
+		if( t_next_x < t_next_y )
+		{
+			x+= step_x;
+			t_next_x+= t_delta_x;
+		}
+		else
+		{
+			y+= step_y;
+			t_next_y+= t_delta_y;
+		}
+
+		if( x < 0 || x > c_max_cell || y < 0 || y > c_max_cell )
+			break;
+	}
+}
+
+template<class Func>
+void ShotsBroadPhase::ProcessElement( const unsigned int element_index, const Func& func ) const
+{
+	unsigned int& stamp= elements_stamps_[ element_index ];
+	if( stamp == current_stamp_ )
+		return;
+
+	stamp= current_stamp_;
+	func( elements_[ element_index ] );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstring>
+
+#include "../assert.hpp"
+#include "../log.hpp"
+
+#include "tick_profiler.hpp"
+
+namespace PanzerChasm
+{
+
+constexpr unsigned int TickProfiler::c_section_count;
+constexpr unsigned int TickProfiler::c_counter_count;
+constexpr unsigned int TickProfiler::c_value_count;
+constexpr unsigned int TickProfiler::c_window_size;
+
+// Names of values - whole loop, sections, counters.
+static const char* const g_values_names[]=
+{
+	"loop",
+
+	"connections",
+	"receive_messages",
+	"map_ticks",
+	"players_positions",
+	"send_messages",
+	"map_change",
+
+	"procedures",
+	"map_objects",
+	"static_models",
+	"rockets",
+	"mines",
+	"monsters_ai",
+	"death_fields",
+	"collisions",
+	"other",
+
+	"n_map_ticks",
+	"n_players",
+	"n_monsters",
+	"n_rockets",
+	"n_procedures",
+};
+
+static_assert(
+	sizeof(g_values_names) / sizeof(g_values_names[0]) ==
+		1u + unsigned(TickProfiler::Section::Count) + unsigned(TickProfiler::Counter::Count),
+	"Invalid values names count" );
+
+// Map tick sections are nested in "map_ticks" section.
+static bool IsMapTickSection( const unsigned int section_index )
+{
+	return section_index >= static_cast<unsigned int>(TickProfiler::Section::Procedures);
+}
+
+TickProfiler::ScopedTimer::ScopedTimer( TickProfiler* const profiler, const Section section )
+	: profiler_(profiler), section_(section), running_( profiler != nullptr )
+{
+	if( running_ )
+		start_time_= std::chrono::steady_clock::now();
+}
+
+TickProfiler::ScopedTimer::~ScopedTimer()
+{
+	Stop();
+}
+
+void TickProfiler::ScopedTimer::Switch( const Section section )
+{
+	if( profiler_ == nullptr )
+		return;
+
+	const std::chrono::steady_clock::time_point current_time= std::chrono::steady_clock::now();
+	if( running_ )
+		profiler_->AddTime( section_, current_time - start_time_ );
+
+	section_= section;
+	start_time_= current_time;
+	running_= true;
+}
+
+void TickProfiler::ScopedTimer::Stop()
+{
+	if( !running_ )
+		return;
+
+	profiler_->AddTime( section_, std::chrono::steady_clock::now() - start_time_ );
+	running_= false;
+}
+
+TickProfiler::TickProfiler()
+{
+	Reset();
+}
+
+TickProfiler::~TickProfiler()
+{
+	if( csv_file_ != nullptr )
+		std::fclose( csv_file_ );
+}
+
+void TickProfiler::BeginTick()
+{
+	std::fill( current_times_, current_times_ + c_section_count, std::chrono::steady_clock::duration::zero() );
+	std::fill( current_values_, current_values_ + c_value_count, 0u );
+	tick_start_time_= std::chrono::steady_clock::now();
+	tick_started_= true;
+}
+
+void TickProfiler::EndTick()
+{
+	if( !tick_started_ )
+		return;
+	tick_started_= false;
+
+	current_values_[0]=
+		static_cast<uint32_t>(
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - tick_start_time_ ).count() );
+
+	for( unsigned int s= 0u; s < c_section_count; s++ )
+		current_values_[ 1u + s ]=
+			static_cast<uint32_t>( std::chrono::duration_cast<std::chrono::microseconds>( current_times_[s] ).count() );
+
+	for( unsigned int v= 0u; v < c_value_count; v++ )
+		samples_[v][ window_pos_ ]= current_values_[v];
+
+	window_pos_= ( window_pos_ + 1u ) % c_window_size;
+	samples_in_window_= std::min( samples_in_window_ + 1u, c_window_size );
+	total_ticks_++;
+
+	if( csv_file_ != nullptr )
+	{
+		std::fprintf( csv_file_, "%u", total_ticks_ );
+		for( unsigned int v= 0u; v < c_value_count; v++ )
+			std::fprintf( csv_file_, ",%u", static_cast<unsigned int>( current_values_[v] ) );
+		std::fprintf( csv_file_, "\n" );
+	}
+}
+
+void TickProfiler::AddTime( const Section section, const std::chrono::steady_clock::duration duration )
+{
+	PC_ASSERT( section < Section::Count );
+
+	current_times_[ static_cast<unsigned int>(section) ]+= duration;
+}
+
+void TickProfiler::AddCount( const Counter counter, const unsigned int count )
+{
+	PC_ASSERT( counter < Counter::Count );
+
+	current_values_[ 1u + c_section_count + static_cast<unsigned int>(counter) ]+= count;
+}
+
+bool TickProfiler::OpenCsvFile( const char* const file_name )
+{
+	if( csv_file_ != nullptr )
+	{
+		std::fclose( csv_file_ );
+		csv_file_= nullptr;
+	}
+
+	if( file_name == nullptr || file_name[0] == '\0' )
+		return true;
+
+	csv_file_= std::fopen( file_name, "wb" );
+	if( csv_file_ == nullptr )
+	{
+		Log::Warning( "Can not open tick profile file \"", file_name, "\"" );
+		return false;
+	}
+
+	WriteCsvHeader();
+	return true;
+}
+
+void TickProfiler::PrintReport() const
+{
+	if( samples_in_window_ == 0u )
+	{
+		Log::Info( "Tick profile: no samples" );
+		return;
+	}
+
+	Log::Info( "Tick profile for last ", samples_in_window_, " loops (total ", total_ticks_, "), microseconds:" );
+
+	char line[128];
+	std::snprintf( line, sizeof(line), "%-22s %8s %8s %8s %8s", "", "min", "avg", "p99", "max" );
+	Log::Info( line );
+
+	for( unsigned int v= 0u; v < c_value_count; v++ )
+	{
+		if( v == 1u + c_section_count )
+			Log::Info( "Counters:" );
+
+		const ValueStats stats= CalculateStats( v );
+
+		const bool nested= v > 0u && v < 1u + c_section_count && IsMapTickSection( v - 1u );
+
+		std::snprintf(
+			line, sizeof(line),
+			"%s%-*s %8u %8u %8u %8u",
+			nested ? "  " : "", nested ? 20 : 22, g_values_names[v],
+			static_cast<unsigned int>(stats.min), static_cast<unsigned int>(stats.avg),
+			static_cast<unsigned int>(stats.p99), static_cast<unsigned int>(stats.max) );
+		Log::Info( line );
+	}
+}
+
+void TickProfiler::Reset()
+{
+	tick_started_= false;
+	total_ticks_= 0u;
+	window_pos_= 0u;
+	samples_in_window_= 0u;
+	std::fill( current_times_, current_times_ + c_section_count, std::chrono::steady_clock::duration::zero() );
+	std::fill( current_values_, current_values_ + c_value_count, 0u );
+}
+
+TickProfiler::ValueStats TickProfiler::CalculateStats( const unsigned int value_index ) const
+{
+	PC_ASSERT( samples_in_window_ > 0u );
+
+	uint32_t sorted[ c_window_size ];
+	std::memcpy( sorted, samples_[ value_index ], sizeof(uint32_t) * samples_in_window_ );
+	std::sort( sorted, sorted + samples_in_window_ );
+
+	uint64_t sum= 0u;
+	for( unsigned int i= 0u; i < samples_in_window_; i++ )
+		sum+= sorted[i];
+
+	// Nearest-rank percentile.
+	const unsigned int p99_rank= ( samples_in_window_ * 99u + 99u ) / 100u;
+
+	ValueStats stats;
+	stats.min= sorted[0];
+	stats.avg= static_cast<uint32_t>( sum / samples_in_window_ );
+	stats.p99= sorted[ p99_rank - 1u ];
+	stats.max= sorted[ samples_in_window_ - 1u ];
+	return stats;
+}
+
+void TickProfiler::WriteCsvHeader()
+{
+	std::fprintf( csv_file_, "tick" );
+	for( unsigned int v= 0u; v < c_value_count; v++ )
+		std::fprintf( csv_file_, ",%s", g_values_names[v] );
+	std::fprintf( csv_file_, "\n" );
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,121 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace PanzerChasm
+{
+
+// Measures time of server loop subsystems.
+// One profiler tick is one server loop iteration, which can contain several map ticks.
+// Keeps last ticks samples and calculates min/avg/p99/max for each section and counter.
+class TickProfiler final
+{
+public:
+	enum class Section : unsigned int
+	{
+		// Server loop.
+		Connections,
+		ReceiveMessages,
+		MapTicks, // Includes map tick sections.
+		PlayersPositions,
+		SendMessages,
+		MapChange,
+
+		// Map tick.
+		Procedures,
+		MapObjects,
+		StaticModels,
+		Rockets,
+		Mines,
+		MonstersAI,
+		DeathFields,
+		Collisions,
+		Other,
+
+		Count
+	};
+
+	enum class Counter : unsigned int
+	{
+		MapTicks,
+		Players,
+		Monsters,
+		Rockets,
+		Procedures, // Processed procedures.
+
+		Count
+	};
+
+	// Timer for sequence of sections. Null profiler allowed.
+	class ScopedTimer final
+	{
+	public:
+		ScopedTimer( TickProfiler* profiler, Section section );
+		~ScopedTimer();
+
+		// Finish current section and start next.
+		void Switch( Section section );
+		void Stop();
+
+	private:
+		TickProfiler* const profiler_;
+		Section section_;
+		bool running_;
+		std::chrono::steady_clock::time_point start_time_;
+	};
+
+public:
+	TickProfiler();
+	~TickProfiler();
+
+	void BeginTick();
+	void EndTick();
+
+	void AddTime( Section section, std::chrono::steady_clock::duration duration );
+	void AddCount( Counter counter, unsigned int count );
+
+	// Write each tick samples into file. Empty file name closes file.
+	bool OpenCsvFile( const char* file_name );
+
+	void PrintReport() const;
+	void Reset();
+
+private:
+	static constexpr unsigned int c_section_count= static_cast<unsigned int>(Section::Count);
+	static constexpr unsigned int c_counter_count= static_cast<unsigned int>(Counter::Count);
+	// Whole loop + sections + counters.
+	static constexpr unsigned int c_value_count= 1u + c_section_count + c_counter_count;
+	static constexpr unsigned int c_window_size= 256u;
+
+	struct ValueStats
+	{
+		uint32_t min, avg, p99, max;
+	};
+
+private:
+	TickProfiler& operator=( const TickProfiler& )= delete;
+
+	ValueStats CalculateStats( unsigned int value_index ) const;
+	void WriteCsvHeader();
+
+private:
+	std::chrono::steady_clock::time_point tick_start_time_;
+	bool tick_started_= false;
+
+	// Sections times of current tick. Accumulated in clock units, because single section time may be less, than microsecond.
+	std::chrono::steady_clock::duration current_times_[ c_section_count ];
+	// Times in microseconds.
+	uint32_t current_values_[ c_value_count ];
+
+	unsigned int total_ticks_= 0u;
+	unsigned int window_pos_= 0u;
+	unsigned int samples_in_window_= 0u;
+
+	std::FILE* csv_file_= nullptr;
+
+	// Put large objects here.
+	uint32_t samples_[ c_value_count ][ c_window_size ];
+};
+
+} // namespace PanzerChasm
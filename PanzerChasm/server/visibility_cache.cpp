@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../assert.hpp"
+#include "collision_index.inl"
+
+#include "visibility_cache.hpp"
+
+namespace PanzerChasm
+{
+
+static int ClampCellCoord( const int coord )
+{
+	return std::max( 0, std::min( coord, int(MapData::c_map_size) - 1 ) );
+}
+
+static int PosToCell( const float pos )
+{
+	// Clamp first, for prevention of float to int conversion overflow.
+	const float c_max_pos= float( MapData::c_map_size + 1u );
+	return static_cast<int>( std::floor( std::max( -1.0f, std::min( pos, c_max_pos ) ) ) );
+}
+
+VisibilityCache::VisibilityCache( const MapDataConstPtr& map_data, const CollisionIndex& collision_index )
+	: map_data_(map_data)
+{
+	PC_ASSERT( map_data_ != nullptr );
+
+	// Static occluders - static walls, exclude transparent, and all models from index.
+	unsigned short static_occluders_count[ MapData::c_map_size * MapData::c_map_size ];
+	for( unsigned int y= 0u; y < MapData::c_map_size; y++ )
+	for( unsigned int x= 0u; x < MapData::c_map_size; x++ )
+	{
+		unsigned short& count= static_occluders_count[ x + y * MapData::c_map_size ];
+		count= 0u;
+
+		collision_index.ProcessCellElements(
+			x, y,
+			[&]( const MapData::IndexElement& element )
+			{
+				if( element.type == MapData::IndexElement::StaticWall )
+				{
+					PC_ASSERT( element.index < map_data_->static_walls.size() );
+					const MapData::Wall& wall= map_data_->static_walls[ element.index ];
+					if( map_data_->walls_textures[ wall.texture_id ].gso[1] )
+						return;
+				}
+				count++;
+			} );
+	}
+	BuildSumTable( static_occluders_count, static_occluders_sum_ );
+
+	// Position of dynamic walls is unknown now. Assume, that each wall covers whole map.
+	CellsRect whole_map_rect;
+	whole_map_rect.x_min= whole_map_rect.y_min= 0;
+	whole_map_rect.x_max= whole_map_rect.y_max= int(MapData::c_map_size) - 1;
+	dynamic_walls_rects_.resize( map_data_->dynamic_walls.size(), whole_map_rect );
+
+	for( unsigned short& count : dynamic_occluders_count_ )
+		count= static_cast<unsigned short>( dynamic_walls_rects_.size() );
+
+	UpdateDynamicOccluders();
+}
+
+VisibilityCache::~VisibilityCache()
+{}
+
+void VisibilityCache::SetDynamicWallPosition( const unsigned int wall_index, const m_Vec2& v0, const m_Vec2& v1 )
+{
+	PC_ASSERT( wall_index < dynamic_walls_rects_.size() );
+
+	CellsRect new_rect;
+	new_rect.x_min= ClampCellCoord( PosToCell( std::min( v0.x, v1.x ) ) );
+	new_rect.y_min= ClampCellCoord( PosToCell( std::min( v0.y, v1.y ) ) );
+	new_rect.x_max= ClampCellCoord( PosToCell( std::max( v0.x, v1.x ) ) );
+	new_rect.y_max= ClampCellCoord( PosToCell( std::max( v0.y, v1.y ) ) );
+
+	CellsRect& rect= dynamic_walls_rects_[ wall_index ];
+	if( rect.x_min == new_rect.x_min && rect.y_min == new_rect.y_min &&
+		rect.x_max == new_rect.x_max && rect.y_max == new_rect.y_max )
+		return;
+
+	for( int y= rect.y_min; y <= rect.y_max; y++ )
+	for( int x= rect.x_min; x <= rect.x_max; x++ )
+	{
+		PC_ASSERT( dynamic_occluders_count_[ x + y * int(MapData::c_map_size) ] > 0u );
+		dynamic_occluders_count_[ x + y * int(MapData::c_map_size) ]--;
+	}
+
+	for( int y= new_rect.y_min; y <= new_rect.y_max; y++ )
+	for( int x= new_rect.x_min; x <= new_rect.x_max; x++ )
+		dynamic_occluders_count_[ x + y * int(MapData::c_map_size) ]++;
+
+	rect= new_rect;
+	dynamic_occluders_changed_= true;
+}
+
+void VisibilityCache::UpdateDynamicOccluders()
+{
+	if( !dynamic_occluders_changed_ )
+		return;
+
+	BuildSumTable( dynamic_occluders_count_, dynamic_occluders_sum_ );
+	dynamic_occluders_changed_= false;
+}
+
+bool VisibilityCache::IsRegionClear( const m_Vec2& from, const m_Vec2& to ) const
+{
+	PC_ASSERT( !dynamic_occluders_changed_ );
+
+	// Raycast in collision index can check cells up to one cell after ray end, so, extend rect.
+	const int from_x= PosToCell( from.x ), from_y= PosToCell( from.y );
+	const int   to_x= PosToCell(   to.x ),   to_y= PosToCell(   to.y );
+
+	CellsRect rect;
+	rect.x_min= ClampCellCoord( std::min( from_x, to_x ) - 1 );
+	rect.y_min= ClampCellCoord( std::min( from_y, to_y ) - 1 );
+	rect.x_max= ClampCellCoord( std::max( from_x, to_x ) + 1 );
+	rect.y_max= ClampCellCoord( std::max( from_y, to_y ) + 1 );
+
+	return
+		GetRectSum( static_occluders_sum_ , rect ) == 0u &&
+		GetRectSum( dynamic_occluders_sum_, rect ) == 0u;
+}
+
+bool VisibilityCache::FindMemo(
+	const EntityId from_monster_id, const EntityId to_monster_id,
+	const m_Vec3& from, const m_Vec3& to,
+	bool& out_can_see )
+{
+	const unsigned int key= ( static_cast<unsigned int>(from_monster_id) << 16u ) | static_cast<unsigned int>(to_monster_id);
+
+	const auto it= memo_.find( key );
+	if( it == memo_.end() )
+		return false;
+
+	// Monsters can move between checks. Result is valid only for exactly same positions.
+	const MemoEntry& entry= it->second;
+	if( !( entry.from == from && entry.to == to ) )
+		return false;
+
+	out_can_see= entry.can_see;
+	stats_.memo_hits++;
+	return true;
+}
+
+void VisibilityCache::AddMemo(
+	const EntityId from_monster_id, const EntityId to_monster_id,
+	const m_Vec3& from, const m_Vec3& to,
+	const bool can_see )
+{
+	const unsigned int key= ( static_cast<unsigned int>(from_monster_id) << 16u ) | static_cast<unsigned int>(to_monster_id);
+
+	MemoEntry& entry= memo_[ key ];
+	entry.from= from;
+	entry.to= to;
+	entry.can_see= can_see;
+}
+
+void VisibilityCache::ClearMemo()
+{
+	memo_.clear();
+}
+
+void VisibilityCache::ResetStats()
+{
+	stats_= Stats();
+}
+
+void VisibilityCache::BuildSumTable( const unsigned short* const cells_count, unsigned int* const out_sum_table )
+{
+	// sum[x,y] - sum of cells in rect [0; x) * [0; y).
+	for( unsigned int x= 0u; x < c_sum_table_size; x++ )
+		out_sum_table[x]= 0u;
+
+	for( unsigned int y= 1u; y < c_sum_table_size; y++ )
+	{
+		out_sum_table[ y * c_sum_table_size ]= 0u;
+
+		unsigned int row_sum= 0u;
+		for( unsigned int x= 1u; x < c_sum_table_size; x++ )
+		{
+			row_sum+= cells_count[ ( x - 1u ) + ( y - 1u ) * MapData::c_map_size ];
+			out_sum_table[ x + y * c_sum_table_size ]=
+				out_sum_table[ x + ( y - 1u ) * c_sum_table_size ] + row_sum;
+		}
+	}
+}
+
+unsigned int VisibilityCache::GetRectSum( const unsigned int* const sum_table, const CellsRect& rect )
+{
+	const unsigned int x0= rect.x_min, y0= rect.y_min;
+	const unsigned int x1= rect.x_max + 1, y1= rect.y_max + 1;
+
+	return
+		sum_table[ x1 + y1 * c_sum_table_size ] -
+		sum_table[ x0 + y1 * c_sum_table_size ] -
+		sum_table[ x1 + y0 * c_sum_table_size ] +
+		sum_table[ x0 + y0 * c_sum_table_size ];
+}
+
+} // namespace PanzerChasm
@@ -0,0 +1,94 @@
+#pragma once
+#include <unordered_map>
+
+#include <vec.hpp>
+
+#include "../fwd.hpp"
+#include "../map_loader.hpp"
+#include "collision_index.hpp"
+
+namespace PanzerChasm
+{
+
+// Acceleration structure for line of sight checks.
+// Keeps amount of potential occluders in each map cell and builds summed area tables for it.
+// If rectangle of cells between two points contains no occluders, exact raycast between these points
+// can not find anything, except models, which are not placed in collision index.
+// Also, stores results of checks between pairs of monsters. This results are valid until
+// map geometry changes, or until next tick.
+class VisibilityCache final
+{
+public:
+	struct Stats
+	{
+		unsigned int memo_hits= 0u; // Result taken from memo.
+		unsigned int clear_hits= 0u; // Raycast through static and dynamic walls skipped.
+		unsigned int fallbacks= 0u; // Exact raycast performed.
+	};
+
+	VisibilityCache( const MapDataConstPtr& map_data, const CollisionIndex& collision_index );
+	~VisibilityCache();
+
+	// Update cells, covered by dynamic wall.
+	// Sums are not recalculated here - call "UpdateDynamicOccluders" after walls moving.
+	void SetDynamicWallPosition( unsigned int wall_index, const m_Vec2& v0, const m_Vec2& v1 );
+	void UpdateDynamicOccluders();
+
+	// Returns true, if there are no static and dynamic walls and no indexed models in cells, touched by ray.
+	bool IsRegionClear( const m_Vec2& from, const m_Vec2& to ) const;
+
+	bool FindMemo(
+		EntityId from_monster_id, EntityId to_monster_id,
+		const m_Vec3& from, const m_Vec3& to,
+		bool& out_can_see );
+
+	void AddMemo(
+		EntityId from_monster_id, EntityId to_monster_id,
+		const m_Vec3& from, const m_Vec3& to,
+		bool can_see );
+
+	// Call it each tick and after each map geometry change.
+	void ClearMemo();
+
+	Stats& GetStats() { return stats_; }
+	const Stats& GetStats() const { return stats_; }
+	void ResetStats();
+
+private:
+	struct CellsRect
+	{
+		// Inclusive.
+		int x_min, y_min;
+		int x_max, y_max;
+	};
+
+	struct MemoEntry
+	{
+		m_Vec3 from;
+		m_Vec3 to;
+		bool can_see;
+	};
+
+	static constexpr unsigned int c_sum_table_size= MapData::c_map_size + 1u;
+
+private:
+	static void BuildSumTable( const unsigned short* cells_count, unsigned int* out_sum_table );
+	static unsigned int GetRectSum( const unsigned int* sum_table, const CellsRect& rect );
+
+private:
+	const MapDataConstPtr map_data_;
+
+	std::vector<CellsRect> dynamic_walls_rects_;
+	bool dynamic_occluders_changed_= true;
+
+	std::unordered_map<unsigned int, MemoEntry> memo_;
+
+	Stats stats_;
+
+	// Put large objects here.
+	unsigned short dynamic_occluders_count_[ MapData::c_map_size * MapData::c_map_size ];
+	unsigned int static_occluders_sum_ [ c_sum_table_size * c_sum_table_size ];
+	unsigned int dynamic_occluders_sum_[ c_sum_table_size * c_sum_table_size ];
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../map_loader.hpp"
+
+namespace PanzerChasm
+{
+
+// Sparse field of map cells values, which are set by rectangle zones - wind, quake, death zones.
+// Value of cell is value of latest zone, containing this cell. Zone with empty value clears cells.
+// Zones, fully covered by newer zones, are removed, so, list of zones is short.
+// Value type must have method "bool IsEmpty() const".
+template<class Value>
+class ZonesField final
+{
+public:
+	struct Zone
+	{
+		// Inclusive.
+		unsigned char x0, y0;
+		unsigned char x1, y1;
+		Value value;
+	};
+
+	ZonesField()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		zones_.clear();
+		for( uint64_t& row : mask_ )
+			row= 0u;
+	}
+
+	// Zone is clipped by map borders. Inverted zones are ignored.
+	void SetZone( const unsigned int x0, const unsigned int y0, unsigned int x1, unsigned int y1, const Value& value )
+	{
+		if( x0 > x1 || y0 > y1 || x0 >= MapData::c_map_size || y0 >= MapData::c_map_size )
+			return;
+		x1= std::min( x1, MapData::c_map_size - 1u );
+		y1= std::min( y1, MapData::c_map_size - 1u );
+
+		Zone zone;
+		zone.x0= static_cast<unsigned char>(x0);
+		zone.y0= static_cast<unsigned char>(y0);
+		zone.x1= static_cast<unsigned char>(x1);
+		zone.y1= static_cast<unsigned char>(y1);
+		zone.value= value;
+
+		// Remove covered zones.
+		for( unsigned int i= 0u; i < zones_.size(); )
+		{
+			const Zone& old_zone= zones_[i];
+			if( old_zone.x0 >= zone.x0 && old_zone.x1 <= zone.x1 &&
+				old_zone.y0 >= zone.y0 && old_zone.y1 <= zone.y1 )
+				zones_.erase( zones_.begin() + i );
+			else
+				i++;
+		}
+
+		zones_.push_back( zone );
+
+		// Remove empty zones, which clear nothing.
+		for( unsigned int i= 0u; i < zones_.size(); )
+		{
+			bool useless= zones_[i].value.IsEmpty();
+			for( unsigned int j= 0u; j < i && useless; j++ )
+			{
+				if( !zones_[j].value.IsEmpty() && ZonesIntersects( zones_[i], zones_[j] ) )
+					useless= false;
+			}
+
+			if( useless )
+				zones_.erase( zones_.begin() + i );
+			else
+				i++;
+		}
+
+		UpdateMask();
+	}
+
+	// Returns nullptr for empty cells.
+	const Value* GetValue( const unsigned int x, const unsigned int y ) const
+	{
+		if( x >= MapData::c_map_size || y >= MapData::c_map_size )
+			return nullptr;
+		if( ( mask_[y] & ( uint64_t(1) << x ) ) == 0u )
+			return nullptr;
+
+		for( unsigned int i= static_cast<unsigned int>( zones_.size() ); i > 0u; i-- )
+		{
+			const Zone& zone= zones_[ i - 1u ];
+			if( x >= zone.x0 && x <= zone.x1 && y >= zone.y0 && y <= zone.y1 )
+				return zone.value.IsEmpty() ? nullptr : &zone.value;
+		}
+
+		return nullptr;
+	}
+
+	// Zones in order of setting.
+	const std::vector<Zone>& GetZones() const
+	{
+		return zones_;
+	}
+
+private:
+	static_assert( MapData::c_map_size <= 64u, "Map row must fit into mask word" );
+
+private:
+	static bool ZonesIntersects( const Zone& a, const Zone& b )
+	{
+		return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+	}
+
+	void UpdateMask()
+	{
+		for( uint64_t& row : mask_ )
+			row= 0u;
+
+		for( const Zone& zone : zones_ )
+		{
+			if( zone.value.IsEmpty() )
+				continue;
+
+			const uint64_t row_bits=
+				( ( zone.x1 == 63u ? ~uint64_t(0) : ( ( uint64_t(1) << ( zone.x1 + 1u ) ) - 1u ) ) ) &
+				~( ( uint64_t(1) << zone.x0 ) - 1u );
+
+			for( unsigned int y= zone.y0; y <= zone.y1; y++ )
+				mask_[y]|= row_bits;
+		}
+	}
+
+private:
+	std::vector<Zone> zones_;
+
+	// Bit for each cell, which can be non-empty.
+	uint64_t mask_[ MapData::c_map_size ];
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,34 @@
+// server_main.cpp - entry point of dedicated server
+
+#include <csignal>
+#include <memory>
+
+#include "dedicated_host.hpp"
+using namespace PanzerChasm;
+
+static volatile std::sig_atomic_t g_quit_signal_received= 0;
+
+extern "C" void QuitSignalHandler( int )
+{
+	g_quit_signal_received= 1;
+}
+
+extern "C" int main( int argc, char *argv[] )
+{
+	// Skip first param - program path.
+	argc--;
+	argv++;
+
+	std::signal( SIGINT , QuitSignalHandler );
+	std::signal( SIGTERM, QuitSignalHandler );
+
+	std::unique_ptr<DedicatedHost> host( new DedicatedHost( argc, argv ) );
+
+	while( host->Loop() )
+	{
+		if( g_quit_signal_received != 0 )
+			host->Quit();
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "stdin_commands_reader.hpp"
+
+namespace PanzerChasm
+{
+
+struct StdinCommandsReader::SharedState
+{
+	std::mutex mutex;
+	std::vector<std::string> lines;
+};
+
+StdinCommandsReader::StdinCommandsReader()
+	: shared_state_( std::make_shared<SharedState>() )
+{
+	const std::shared_ptr<SharedState> shared_state= shared_state_;
+	std::thread(
+		[shared_state]
+		{
+			std::string line;
+			while( std::getline( std::cin, line ) )
+			{
+				if( line.empty() )
+					continue;
+
+				std::lock_guard<std::mutex> lock( shared_state->mutex );
+				shared_state->lines.push_back( std::move(line) );
+			}
+			// End of input - for example, server started without terminal. Commands are not available anymore.
+		} ).detach();
+}
+
+StdinCommandsReader::~StdinCommandsReader()
+{}
+
+std::vector<std::string> StdinCommandsReader::TakeLines()
+{
+	std::vector<std::string> result;
+
+	std::lock_guard<std::mutex> lock( shared_state_->mutex );
+	result.swap( shared_state_->lines );
+	return result;
+}
+
+} // namespace PanzerChasm
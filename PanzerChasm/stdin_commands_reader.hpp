@@ -0,0 +1,29 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PanzerChasm
+{
+
+// Reads console commands of dedicated server from standard input.
+// Reading is blocking, so, it works in separate thread. Main loop only takes already read lines.
+class StdinCommandsReader final
+{
+public:
+	StdinCommandsReader();
+	~StdinCommandsReader();
+
+	// Returns lines, read since previous call. Never blocks.
+	std::vector<std::string> TakeLines();
+
+private:
+	struct SharedState;
+
+private:
+	// State is shared with reading thread. Thread can not be stopped while it waits for input,
+	// so, it is detached and owns state together with reader.
+	const std::shared_ptr<SharedState> shared_state_;
+};
+
+} // namespace PanzerChasm
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <thread>
+
+#include "log.hpp"
+
+#include "tick_scheduler.hpp"
+
+namespace PanzerChasm
+{
+
+TickScheduler::TickScheduler( const Time tick_duration, const Time stats_interval, std::string name )
+	: tick_duration_(tick_duration)
+	, stats_interval_(stats_interval)
+	, name_( std::move(name) )
+	, tick_start_time_( Time::CurrentTime() )
+	, next_tick_time_( tick_start_time_ )
+	, last_stats_print_time_( tick_start_time_ )
+{}
+
+TickScheduler::~TickScheduler()
+{}
+
+Time TickScheduler::GetTickDuration() const
+{
+	return tick_duration_;
+}
+
+void TickScheduler::SetWaitFunction( WaitFunction wait_function )
+{
+	wait_function_= std::move( wait_function );
+}
+
+void TickScheduler::BeginTick()
+{
+	tick_start_time_= Time::CurrentTime();
+}
+
+void TickScheduler::EndTick()
+{
+	const Time current_time= Time::CurrentTime();
+	UpdateStats( current_time - tick_start_time_ );
+
+	next_tick_time_+= tick_duration_;
+	if( next_tick_time_ <= current_time )
+	{
+		// Loop is too slow. Do not try to catch up - start next tick right now.
+		next_tick_time_= current_time;
+		return;
+	}
+
+	if( wait_function_ )
+	{
+		Time time= current_time;
+		while( time < next_tick_time_ )
+		{
+			wait_function_( next_tick_time_ - time );
+			time= Time::CurrentTime();
+		}
+		return;
+	}
+
+	const int64_t sleep_time_us=
+		( next_tick_time_ - current_time ).GetInternalRepresentation() *
+		1000000 / Time::FromSeconds(1).GetInternalRepresentation();
+
+	std::this_thread::sleep_for( std::chrono::microseconds( sleep_time_us ) );
+}
+
+void TickScheduler::UpdateStats( const Time tick_duration )
+{
+	if( stats_.ticks == 0u || tick_duration < stats_.min )
+		stats_.min= tick_duration;
+	if( stats_.ticks == 0u || tick_duration > stats_.max )
+		stats_.max= tick_duration;
+	stats_.sum+= tick_duration;
+	stats_.ticks++;
+
+	if( tick_duration > tick_duration_ )
+		stats_.overruns++;
+
+	const Time current_time= Time::CurrentTime();
+	if( current_time - last_stats_print_time_ < stats_interval_ )
+		return;
+
+	const float avg_ms= stats_.sum.ToSeconds() * 1000.0f / float(stats_.ticks);
+	Log::Info(
+		name_, " ticks: ", stats_.ticks,
+		" min: ", stats_.min.ToSeconds() * 1000.0f, " ms",
+		" avg: ", avg_ms, " ms",
+		" max: ", stats_.max.ToSeconds() * 1000.0f, " ms",
+		" overruns: ", stats_.overruns );
+
+	stats_= Stats();
+	last_stats_print_time_= current_time;
+}
+
+} // namespace PanzerChasm
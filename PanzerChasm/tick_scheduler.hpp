@@ -0,0 +1,57 @@
+#pragma once
+#include <functional>
+#include <string>
+
+#include "time.hpp"
+
+namespace PanzerChasm
+{
+
+// Helper for loops with fixed rate.
+// Sleeps until start of next tick and collects loop time statistics.
+class TickScheduler final
+{
+public:
+	// Function for waiting, which may return earlier, than requested - for example, waiting for network events.
+	typedef std::function<void(Time)> WaitFunction;
+
+	TickScheduler( Time tick_duration, Time stats_interval, std::string name );
+	~TickScheduler();
+
+	Time GetTickDuration() const;
+
+	// Use given function instead of sleeping.
+	void SetWaitFunction( WaitFunction wait_function );
+
+	void BeginTick();
+	// Updates statistics, prints it sometimes, sleeps until next tick.
+	void EndTick();
+
+private:
+	struct Stats
+	{
+		unsigned int ticks= 0u;
+		unsigned int overruns= 0u; // Ticks, which took more time, than tick duration.
+		Time min= Time::FromSeconds(0);
+		Time max= Time::FromSeconds(0);
+		Time sum= Time::FromSeconds(0);
+	};
+
+private:
+	void UpdateStats( Time tick_duration );
+
+private:
+	const Time tick_duration_;
+	const Time stats_interval_;
+	const std::string name_;
+
+	WaitFunction wait_function_;
+
+	Time tick_start_time_; // Real time
+	Time next_tick_time_; // Real time
+
+	Time last_stats_print_time_; // Real time
+	Stats stats_;
+};
+
+} // namespace PanzerChasm
@@ -197,6 +197,8 @@ void Vfs::ReadFile( const char* const file_path, FileContent& out_file_content )
 	{
 		const VirtualFile& file= it->second;
 		out_file_content.resize( file.size );
+
+		std::lock_guard<std::mutex> lock( archive_file_mutex_ );
 		std::fseek( archive_file_, file.offset, SEEK_SET );
 		FileRead( archive_file_, out_file_content.data(), out_file_content.size() );
 
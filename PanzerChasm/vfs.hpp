@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdio>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -17,6 +18,7 @@ public:
 	explicit Vfs( const char* archive_file_name, const char* addon_path= nullptr );
 	~Vfs();
 
+	// Thread-safe.
 	FileContent ReadFile( const char* file_path ) const;
 	void ReadFile( const char* file_path, FileContent& out_file_content ) const;
 
@@ -45,6 +47,7 @@ private:
 
 private:
 	std::FILE* const archive_file_;
+	mutable std::mutex archive_file_mutex_; // Seek and read must be atomic.
 	const std::string addon_path_;
 
 	VirtualFiles virtual_files_;